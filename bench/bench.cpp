@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "bench.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "sled/cmdline.h"
+
+namespace sled::bench {
+
+std::vector<benchmark> &registry() {
+  static std::vector<benchmark> benchmarks;
+  return benchmarks;
+}
+
+registrar::registrar(char const *name, bench_fn fn,
+                     std::initializer_list<int64_t> args) {
+  if (args.size() == 0) {
+    registry().push_back(benchmark{name, fn, 0});
+    return;
+  }
+  for (auto arg : args) {
+    registry().push_back(
+        benchmark{std::string(name) + "/" + std::to_string(arg), fn, arg});
+  }
+}
+
+static double run_once(benchmark const &bench, uint64_t iterations,
+                       uint64_t *bytes, uint64_t *items) {
+  state st(iterations, bench.arg);
+  bench.fn(st);
+  auto elapsed = st.elapsed();
+  *bytes = st.bytes_per_iteration();
+  *items = st.items_per_iteration();
+  return static_cast<double>(elapsed.v);
+}
+
+result run(benchmark const &bench, options const &opts) {
+  result r;
+  r.name = bench.name;
+  uint64_t bytes = 0;
+  uint64_t items = 0;
+
+  // Prime one-time initialization (static state, clock calibration) so it
+  // doesn't skew the iteration count.
+  run_once(bench, 1, &bytes, &items);
+
+  // Find an iteration count taking at least min_time.
+  auto target = static_cast<double>(opts.min_time.v);
+  uint64_t iterations = 1;
+  for (;;) {
+    auto ns = run_once(bench, iterations, &bytes, &items);
+    if (ns >= target || iterations >= 1'000'000'000) {
+      break;
+    }
+    if (ns < target / 100) {
+      iterations *= 10;
+    } else {
+      iterations = static_cast<uint64_t>(
+          std::ceil(static_cast<double>(iterations) * target * 1.2 / ns));
+    }
+  }
+  r.iterations = iterations;
+
+  for (int i = 0; i < opts.warmup; i++) {
+    run_once(bench, iterations, &bytes, &items);
+  }
+  for (int i = 0; i < opts.repetitions; i++) {
+    auto ns = run_once(bench, iterations, &bytes, &items);
+    r.samples.push_back(ns / static_cast<double>(iterations));
+  }
+  r.stats = summarize(r.samples);
+  if (r.stats.median > 0) {
+    r.bytes_per_second = static_cast<double>(bytes) * 1e9 / r.stats.median;
+    r.items_per_second = static_cast<double>(items) * 1e9 / r.stats.median;
+  }
+  return r;
+}
+
+static std::string json_escape(std::string const &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out += ' ';
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+static std::string cpu_model() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("model name", 0) == 0) {
+      auto pos = line.find(':');
+      if (pos != std::string::npos && pos + 2 <= line.size()) {
+        return line.substr(pos + 2);
+      }
+    }
+  }
+  return "unknown";
+}
+
+void write_json(std::ostream &os, std::vector<result> const &results,
+                quiet_environment const *env) {
+  char host[256] = {};
+  gethostname(host, sizeof(host) - 1);
+  char date[64] = {};
+  auto now = std::time(nullptr);
+  struct tm tm {};
+  gmtime_r(&now, &tm);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+  auto f = os.flags();
+  os << std::setprecision(6) << std::fixed;
+  os << "{\n";
+  os << "  \"context\": {\n";
+  os << "    \"date\": \"" << date << "\",\n";
+  os << "    \"host\": \"" << json_escape(host) << "\",\n";
+  os << "    \"cpu\": \"" << json_escape(cpu_model()) << "\",\n";
+  os << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+  os << "    \"invariant_tsc\": " << (tsc_clock::invariant() ? "true" : "false")
+     << ",\n";
+  os << "    \"pinned_cpu\": " << (env != nullptr ? env->cpu() : -1) << ",\n";
+  os << "    \"governor\": \""
+     << json_escape(env != nullptr ? env->governor() : "") << "\",\n";
+  os << "    \"low_latency\": "
+     << (env != nullptr && env->low_latency() ? "true" : "false") << "\n";
+  os << "  },\n";
+  os << "  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    auto const &r = results[i];
+    os << (i == 0 ? "\n" : ",\n");
+    os << "    {\n";
+    os << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+    os << "      \"iterations\": " << r.iterations << ",\n";
+    os << "      \"median_ns\": " << r.stats.median << ",\n";
+    os << "      \"mad_ns\": " << r.stats.mad << ",\n";
+    os << "      \"mean_ns\": " << r.stats.mean << ",\n";
+    os << "      \"robust_mean_ns\": " << r.stats.robust_mean << ",\n";
+    os << "      \"min_ns\": " << r.stats.min << ",\n";
+    os << "      \"max_ns\": " << r.stats.max << ",\n";
+    os << "      \"bytes_per_second\": " << r.bytes_per_second << ",\n";
+    os << "      \"items_per_second\": " << r.items_per_second << ",\n";
+    os << "      \"samples_ns\": [";
+    for (size_t j = 0; j < r.samples.size(); j++) {
+      os << (j == 0 ? "" : ", ") << r.samples[j];
+    }
+    os << "]\n";
+    os << "    }";
+  }
+  os << "\n  ]\n}\n";
+  os.flags(f);
+}
+
+static void print_result(std::ostream &os, result const &r) {
+  auto f = os.flags();
+  os << std::left << std::setw(40) << r.name << std::right << std::fixed
+     << std::setprecision(2) << std::setw(14) << r.stats.median << " ns"
+     << std::setw(12) << r.stats.mad << " mad" << std::setw(12)
+     << r.iterations << " iters";
+  if (r.bytes_per_second > 0) {
+    os << std::setw(10) << r.bytes_per_second / (1024 * 1024) << " MiB/s";
+  } else if (r.items_per_second > 0) {
+    os << std::setw(12) << r.items_per_second << " items/s";
+  }
+  os << std::endl;
+  os.flags(f);
+}
+
+}  // namespace sled::bench
+
+namespace cli = sled::cli;
+
+int main(int argc, char **argv) {
+  cli::option_inst<cli::option_definition<std::string>> filter{
+      {"--filter", ""}};
+  cli::option_inst<cli::option_definition<int>> repetitions{
+      {"--repetitions", 10}};
+  cli::option_inst<cli::option_definition<int>> warmup{{"--warmup", 2}};
+  cli::option_inst<cli::option_definition<int>> min_time_ms{
+      {"--min-time-ms", 20}};
+  cli::option_inst<cli::option_definition<int>> cpu{{"--cpu", -1}};
+  cli::option_inst<cli::option_definition<std::string>> json{{"--json", ""}};
+  cli::option_inst<cli::option_definition<bool>> list{{"--list", false}};
+
+  cli::command cmd;
+  cmd.add_option(&filter);
+  cmd.add_option(&repetitions);
+  cmd.add_option(&warmup);
+  cmd.add_option(&min_time_ms);
+  cmd.add_option(&cpu);
+  cmd.add_option(&json);
+  cmd.add_option(&list);
+  cmd.parse_cmd(argc, argv);
+
+  sled::bench::options opts;
+  opts.filter = filter.value_or_default();
+  opts.repetitions = std::max(1, repetitions.value_or_default());
+  opts.warmup = std::max(0, warmup.value_or_default());
+  opts.min_time = sled::msec(std::max(1, min_time_ms.value_or_default()));
+  opts.cpu = cpu.value_or_default();
+
+  std::unique_ptr<sled::bench::quiet_environment> env;
+  if (!list.value_or_default()) {
+    env = std::make_unique<sled::bench::quiet_environment>(opts.cpu);
+    for (auto const &warning : env->warnings()) {
+      std::cerr << "warning: " << warning << std::endl;
+    }
+  }
+
+  // Keep stdout valid JSON when the results go there.
+  auto const &path = json.value_or_default();
+  std::ostream &table = (path == "-") ? std::cerr : std::cout;
+
+  std::vector<sled::bench::result> results;
+  for (auto const &bench : sled::bench::registry()) {
+    if (bench.name.find(opts.filter) == std::string::npos) {
+      continue;
+    }
+    if (list.value_or_default()) {
+      table << bench.name << std::endl;
+      continue;
+    }
+    results.push_back(sled::bench::run(bench, opts));
+    sled::bench::print_result(table, results.back());
+  }
+
+  if (path == "-") {
+    sled::bench::write_json(std::cout, results, env.get());
+  } else if (!path.empty()) {
+    std::ofstream out(path);
+    sled::bench::write_json(out, results, env.get());
+    if (!out) {
+      std::cerr << "Unable to write " << path << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sled/platform.h"
+#include "sled/time.h"
+
+#include "stats.h"
+
+namespace sled::bench {
+
+/**
+ * Per-run benchmark state.
+ *
+ * The body runs iterations() times.  Timing starts before the body is
+ * called; expensive setup should be followed by reset_timer() and teardown
+ * preceded by stop_timer().
+ */
+class state {
+ public:
+  state(uint64_t iterations, int64_t arg) : iterations_(iterations), arg_(arg) {
+    reset_timer();
+  }
+
+  uint64_t iterations() const { return iterations_; }
+
+  /**
+   * Argument of a parameterized benchmark, e.g. the buffer size.
+   */
+  int64_t arg() const { return arg_; }
+
+  void reset_timer() {
+    start_ = stopwatch::now();
+    stopped_ = false;
+  }
+
+  void stop_timer() {
+    if (!stopped_) {
+      elapsed_ = stopwatch::now() - start_;
+      stopped_ = true;
+    }
+  }
+
+  time elapsed() {
+    stop_timer();
+    return elapsed_;
+  }
+
+  /**
+   * Bytes processed by each iteration, reported as throughput.
+   */
+  void set_bytes_per_iteration(uint64_t bytes) { bytes_ = bytes; }
+  uint64_t bytes_per_iteration() const { return bytes_; }
+
+  /**
+   * Items processed by each iteration, reported as a rate.
+   */
+  void set_items_per_iteration(uint64_t items) { items_ = items; }
+  uint64_t items_per_iteration() const { return items_; }
+
+ private:
+  uint64_t iterations_;
+  int64_t arg_;
+  time start_{};
+  time elapsed_{};
+  bool stopped_{false};
+  uint64_t bytes_{0};
+  uint64_t items_{0};
+};
+
+/**
+ * Prevent the compiler from discarding @a value.
+ */
+template <typename T>
+a_forceinline void do_not_optimize(T const &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Force pending memory writes to be considered observable.
+ */
+a_forceinline void clobber_memory() { asm volatile("" : : : "memory"); }
+
+using bench_fn = void (*)(state &);
+
+struct benchmark {
+  std::string name;
+  bench_fn fn;
+  int64_t arg;
+};
+
+/**
+ * All registered benchmarks.
+ */
+std::vector<benchmark> &registry();
+
+/**
+ * Static registration helper, see SLED_BENCHMARK.
+ */
+struct registrar {
+  registrar(char const *name, bench_fn fn, std::initializer_list<int64_t> args);
+};
+
+struct options {
+  std::string filter;       /**< Substring of benchmark names to run. */
+  int cpu{-1};              /**< CPU to pin to, -1 leaves affinity alone. */
+  int repetitions{10};      /**< Timed samples per benchmark. */
+  int warmup{2};            /**< Untimed runs before sampling. */
+  time min_time{msec(20)};  /**< Minimum duration of each sample. */
+};
+
+struct result {
+  std::string name;
+  uint64_t iterations{0};
+  std::vector<double> samples; /**< Nanoseconds per iteration. */
+  summary stats;
+  double bytes_per_second{0};
+  double items_per_second{0};
+};
+
+result run(benchmark const &bench, options const &opts);
+
+/**
+ * Reduce run-to-run noise for the lifetime of the object.
+ *
+ * Pins the calling thread to a cpu, switches that cpu to the "performance"
+ * cpufreq governor and holds /dev/cpu_dma_latency at zero to keep it out of
+ * deep C-states.  Every step is best effort, most need root; failures are
+ * reported as warnings.  The previous governor is restored on destruction.
+ */
+class quiet_environment {
+ public:
+  explicit quiet_environment(int cpu);
+  ~quiet_environment();
+  quiet_environment(quiet_environment const &) = delete;
+  quiet_environment &operator=(quiet_environment const &) = delete;
+
+  /**
+   * Pinned cpu, -1 if affinity was not changed.
+   */
+  int cpu() const { return cpu_; }
+
+  /**
+   * Active cpufreq governor of the pinned cpu, empty if unknown.
+   */
+  std::string const &governor() const { return governor_; }
+
+  /**
+   * True while C-state exit latency is held at zero.
+   */
+  bool low_latency() const { return latency_fd_ != -1; }
+
+  std::vector<std::string> const &warnings() const { return warnings_; }
+
+ private:
+  int cpu_{-1};
+  std::string governor_;
+  std::string saved_governor_;
+  int governor_cpu_{-1};
+  int latency_fd_{-1};
+  std::vector<std::string> warnings_;
+};
+
+void write_json(std::ostream &os, std::vector<result> const &results,
+                quiet_environment const *env = nullptr);
+
+}  // namespace sled::bench
+
+#define SLED_BENCH_CONCAT_(a, b) a##b
+#define SLED_BENCH_CONCAT(a, b) SLED_BENCH_CONCAT_(a, b)
+
+/**
+ * Define and register a benchmark, optionally run once per argument.
+ *
+ * SLED_BENCHMARK(crc32c, 64, 4096) {
+ *   std::vector<uint8_t> data(state.arg());
+ *   state.set_bytes_per_iteration(data.size());
+ *   state.reset_timer();
+ *   for (uint64_t i = 0; i < state.iterations(); i++) {
+ *     sled::bench::do_not_optimize(sled::calculate_crc32c(data));
+ *   }
+ * }
+ */
+#define SLED_BENCHMARK(name, ...)                                        \
+  static void name(::sled::bench::state &state);                        \
+  static ::sled::bench::registrar SLED_BENCH_CONCAT(name, _registrar)(   \
+      #name, name, {__VA_ARGS__});                                       \
+  static void name(::sled::bench::state &state)
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+/**
+ * Compare two sled-bench --json result sets.
+ *
+ * sled-bench-compare --baseline old.json --contender new.json --threshold 5
+ *
+ * Each benchmark present in both sets is tested with Mann-Whitney U over the
+ * per-repetition samples.  The exit status is 1 if any benchmark is
+ * significantly slower by more than --threshold percent.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "sled/cmdline.h"
+#include "sled/exception.h"
+#include "stats.h"
+
+namespace sled::bench {
+
+using sample_map = std::map<std::string, std::vector<double>>;
+
+static sample_map load_samples(std::string const &path) {
+  auto doc = read_json(path);
+  auto const *benchmarks = doc.find("benchmarks");
+  if (benchmarks == nullptr || benchmarks->type != json_value::kind::array) {
+    throw sled::Exception(path, ": missing benchmarks array");
+  }
+  sample_map samples;
+  for (auto const &b : benchmarks->array) {
+    auto const *name = b.find("name");
+    auto const *values = b.find("samples_ns");
+    if (name == nullptr || values == nullptr) {
+      throw sled::Exception(path, ": benchmark without name or samples_ns");
+    }
+    auto &v = samples[name->string];
+    for (auto const &s : values->array) {
+      v.push_back(s.number);
+    }
+  }
+  return samples;
+}
+
+struct comparison {
+  std::string name;
+  double baseline{0};  /**< Median ns per iteration. */
+  double contender{0}; /**< Median ns per iteration. */
+  double change{0};    /**< Percent, positive is slower. */
+  double p_value{1};
+};
+
+static int report(sample_map const &baseline, sample_map const &contender,
+                  double threshold, double alpha) {
+  std::vector<comparison> rows;
+  for (auto const &[name, old_samples] : baseline) {
+    auto it = contender.find(name);
+    if (it == contender.end()) {
+      std::cout << "only in baseline: " << name << std::endl;
+      continue;
+    }
+    comparison c;
+    c.name = name;
+    c.baseline = summarize(old_samples).median;
+    c.contender = summarize(it->second).median;
+    if (c.baseline > 0) {
+      c.change = (c.contender - c.baseline) * 100 / c.baseline;
+    }
+    c.p_value = mann_whitney_u(old_samples, it->second).p_value;
+    rows.push_back(c);
+  }
+  for (auto const &entry : contender) {
+    if (baseline.count(entry.first) == 0) {
+      std::cout << "only in contender: " << entry.first << std::endl;
+    }
+  }
+
+  auto f = std::cout.flags();
+  std::cout << std::left << std::setw(40) << "benchmark" << std::right
+            << std::setw(14) << "baseline ns" << std::setw(14)
+            << "contender ns" << std::setw(10) << "change" << std::setw(10)
+            << "p-value" << std::endl;
+  int regressions = 0;
+  for (auto const &c : rows) {
+    char const *verdict = "";
+    if (c.p_value < alpha && c.change > threshold) {
+      verdict = "  REGRESSION";
+      regressions++;
+    } else if (c.p_value < alpha && c.change < -threshold) {
+      verdict = "  faster";
+    } else if (c.p_value < alpha && c.change != 0) {
+      verdict = "  (within threshold)";
+    }
+    std::cout << std::left << std::setw(40) << c.name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(14)
+              << c.baseline << std::setw(14) << c.contender << std::setw(9)
+              << std::showpos << c.change << std::noshowpos << "%"
+              << std::setprecision(4) << std::setw(10) << c.p_value << verdict
+              << std::endl;
+  }
+  std::cout.flags(f);
+  std::cout << rows.size() << " compared, " << regressions
+            << " significant regressions over " << threshold << "%"
+            << std::endl;
+  return regressions == 0 ? 0 : 1;
+}
+
+}  // namespace sled::bench
+
+namespace cli = sled::cli;
+
+int main(int argc, char **argv) {
+  cli::option_inst<cli::option_definition<std::string>> baseline{
+      {"--baseline", ""}};
+  cli::option_inst<cli::option_definition<std::string>> contender{
+      {"--contender", ""}};
+  cli::option_inst<cli::option_definition<double>> threshold{
+      {"--threshold", 5.0}};
+  cli::option_inst<cli::option_definition<double>> alpha{{"--alpha", 0.05}};
+
+  cli::command cmd;
+  cmd.add_option(&baseline);
+  cmd.add_option(&contender);
+  cmd.add_option(&threshold);
+  cmd.add_option(&alpha);
+  cmd.parse_cmd(argc, argv);
+
+  if (baseline.value_or_default().empty() ||
+      contender.value_or_default().empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " --baseline old.json --contender new.json"
+                 " [--threshold percent] [--alpha p]"
+              << std::endl;
+    return 2;
+  }
+
+  try {
+    auto old_samples = sled::bench::load_samples(baseline.value_or_default());
+    auto new_samples = sled::bench::load_samples(contender.value_or_default());
+    return sled::bench::report(old_samples, new_samples,
+                               threshold.value_or_default(),
+                               alpha.value_or_default());
+  } catch (sled::Exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+}
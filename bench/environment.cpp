@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "bench.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+namespace sled::bench {
+
+static std::string governor_path(int cpu) {
+  return "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+         "/cpufreq/scaling_governor";
+}
+
+static std::string read_governor(int cpu) {
+  std::ifstream in(governor_path(cpu));
+  std::string value;
+  std::getline(in, value);
+  return value;
+}
+
+static bool write_governor(int cpu, std::string const &value) {
+  std::ofstream out(governor_path(cpu));
+  out << value << std::endl;
+  return static_cast<bool>(out);
+}
+
+quiet_environment::quiet_environment(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (::sched_setaffinity(0, sizeof(set), &set) == 0) {
+    cpu_ = cpu;
+  } else {
+    warnings_.push_back("unable to pin to cpu " + std::to_string(cpu) + ": " +
+                        strerror(errno));
+  }
+
+  governor_ = read_governor(cpu);
+  if (governor_.empty()) {
+    warnings_.push_back("cpufreq governor unavailable, frequency may vary");
+  } else if (governor_ != "performance") {
+    if (write_governor(cpu, "performance")) {
+      saved_governor_ = governor_;
+      governor_cpu_ = cpu;
+      governor_ = "performance";
+    } else {
+      warnings_.push_back("cpufreq governor is " + governor_ +
+                          ", frequency may vary");
+    }
+  }
+
+  // The latency request stays in effect while the file is open.
+  latency_fd_ = ::open("/dev/cpu_dma_latency", O_WRONLY | O_CLOEXEC);
+  if (latency_fd_ != -1) {
+    int32_t zero = 0;
+    if (::write(latency_fd_, &zero, sizeof(zero)) != sizeof(zero)) {
+      ::close(latency_fd_);
+      latency_fd_ = -1;
+    }
+  }
+  if (latency_fd_ == -1) {
+    warnings_.push_back("unable to hold /dev/cpu_dma_latency, C-states on");
+  }
+}
+
+quiet_environment::~quiet_environment() {
+  if (latency_fd_ != -1) {
+    ::close(latency_fd_);
+  }
+  if (!saved_governor_.empty()) {
+    write_governor(governor_cpu_, saved_governor_);
+  }
+}
+
+}  // namespace sled::bench
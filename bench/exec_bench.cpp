@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include <memory>
+#include <thread>
+
+#include "bench.h"
+#include "sled/channel.h"
+#include "sled/coexecutor.h"
+#include "sled/coroutine.h"
+#include "sled/future.h"
+
+namespace ex = sled::executor;
+
+//
+// Coroutine context switch
+//
+
+struct PingPong {
+  std::unique_ptr<ex::Coroutine> co;
+  sled::stack_ctx main_ctx{};
+};
+
+static void ping_pong_fn(PingPong *pp) {
+  for (;;) {
+    pp->co->yield(&pp->main_ctx);
+  }
+}
+
+/**
+ * One iteration is a round trip: two SwitchContext calls.
+ */
+SLED_BENCHMARK(switch_context) {
+  PingPong pp;
+  pp.co = std::make_unique<ex::Coroutine>(ping_pong_fn, &pp);
+  pp.co->start(&pp.main_ctx);
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    pp.co->resume(&pp.main_ctx);
+  }
+  state.stop_timer();
+}
+
+//
+// CoExecutor
+//
+
+/**
+ * Adopts the benchmark thread for the lifetime of the object.
+ */
+struct AdoptedExecutor {
+  AdoptedExecutor() : task(exec_ctx.adopt_thread()) {}
+  ~AdoptedExecutor() { exec_ctx.unadopt_thread(task); }
+
+  ex::CoExecutor exec_ctx;
+  ex::Task *task;
+};
+
+SLED_BENCHMARK(coexecutor_spawn) {
+  AdoptedExecutor ae;
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    auto task = ae.exec_ctx.create_task([]() { return 5; });
+    auto f = task.queue_start();
+    ae.exec_ctx.resume_pending();
+    sled::bench::do_not_optimize(f->wait());
+  }
+  state.stop_timer();
+}
+
+SLED_BENCHMARK(coexecutor_yield) {
+  AdoptedExecutor ae;
+  auto iterations = state.iterations();
+  auto task = ae.exec_ctx.create_task([iterations]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      ex::CoExecutor::yield();
+    }
+  });
+  state.reset_timer();
+  auto f = task.queue_start();
+  f->wait();
+  state.stop_timer();
+}
+
+/**
+ * One iteration is a suspend and wake of each of two tasks.
+ */
+SLED_BENCHMARK(coexecutor_wake) {
+  AdoptedExecutor ae;
+  auto iterations = state.iterations();
+  ex::Channel<uint64_t, ex::CoExecutor> ping;
+  ex::Channel<uint64_t, ex::CoExecutor> pong;
+  auto pinger = ae.exec_ctx.create_task([&]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      ping.put(i);
+      pong.get();
+    }
+  });
+  auto ponger = ae.exec_ctx.create_task([&]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      pong.put(ping.get());
+    }
+  });
+  state.reset_timer();
+  auto f1 = ponger.queue_start();
+  auto f2 = pinger.queue_start();
+  f2->wait();
+  f1->wait();
+  state.stop_timer();
+}
+
+//
+// Channels
+//
+
+SLED_BENCHMARK(channel_throughput) {
+  AdoptedExecutor ae;
+  auto iterations = state.iterations();
+  ex::Channel<uint64_t, ex::CoExecutor> channel;
+  uint64_t total = 0;
+  auto consumer = ae.exec_ctx.create_task([&]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      total += channel.get();
+    }
+  });
+  auto producer = ae.exec_ctx.create_task([&]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      channel.put(i);
+    }
+  });
+  state.set_items_per_iteration(1);
+  state.reset_timer();
+  auto f1 = consumer.queue_start();
+  auto f2 = producer.queue_start();
+  f2->wait();
+  f1->wait();
+  state.stop_timer();
+  sled::bench::do_not_optimize(total);
+}
+
+SLED_BENCHMARK(sync_channel_throughput) {
+  ex::SyncChannel<uint64_t> channel;
+  auto iterations = state.iterations();
+  uint64_t total = 0;
+  state.set_items_per_iteration(1);
+  state.reset_timer();
+  std::thread consumer([&]() {
+    for (uint64_t i = 0; i < iterations; i++) {
+      total += channel.get().value();
+    }
+  });
+  for (uint64_t i = 0; i < iterations; i++) {
+    channel.put(i);
+  }
+  consumer.join();
+  state.stop_timer();
+  sled::bench::do_not_optimize(total);
+}
+
+//
+// Future
+//
+
+SLED_BENCHMARK(future_set_wait) {
+  AdoptedExecutor ae;
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    ex::Future<uint64_t, ex::CoExecutor> f;
+    f.set_result(i);
+    sled::bench::do_not_optimize(f.wait());
+  }
+  state.stop_timer();
+}
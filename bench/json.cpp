@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "json.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "sled/exception.h"
+
+namespace sled::bench {
+
+json_value const *json_value::find(std::string const &key) const {
+  for (auto const &member : object) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+namespace {
+
+class json_parser {
+ public:
+  explicit json_parser(std::string const &text) : text_(text) {}
+
+  json_value parse() {
+    auto v = parse_value();
+    skip_ws();
+    if (pos_ != text_.size()) {
+      error("trailing characters");
+    }
+    return v;
+  }
+
+ private:
+  [[noreturn]] void error(char const *what) {
+    throw sled::Exception("JSON parse error at offset ", pos_, ": ", what);
+  }
+
+  static bool is_ws(char c) {
+    // strchr() would also match an embedded NUL.
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  void skip_ws() {
+    while (pos_ < text_.size() && is_ws(text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  char peek() {
+    skip_ws();
+    return pos_ < text_.size() ? text_[pos_] : '\0';
+  }
+
+  void expect(char c) {
+    if (peek() != c) {
+      error("unexpected character");
+    }
+    pos_++;
+  }
+
+  bool literal(char const *word) {
+    auto len = strlen(word);
+    if (text_.compare(pos_, len, word) != 0) {
+      return false;
+    }
+    pos_ += len;
+    return true;
+  }
+
+  json_value parse_value() {
+    json_value v;
+    switch (peek()) {
+      case '{':
+        v.type = json_value::kind::object;
+        pos_++;
+        if (peek() == '}') {
+          pos_++;
+          break;
+        }
+        for (;;) {
+          auto key = parse_string();
+          expect(':');
+          v.object.emplace_back(std::move(key), parse_value());
+          if (peek() == ',') {
+            pos_++;
+            continue;
+          }
+          expect('}');
+          break;
+        }
+        break;
+      case '[':
+        v.type = json_value::kind::array;
+        pos_++;
+        if (peek() == ']') {
+          pos_++;
+          break;
+        }
+        for (;;) {
+          v.array.push_back(parse_value());
+          if (peek() == ',') {
+            pos_++;
+            continue;
+          }
+          expect(']');
+          break;
+        }
+        break;
+      case '"':
+        v.type = json_value::kind::string;
+        v.string = parse_string();
+        break;
+      case 't':
+      case 'f':
+        v.type = json_value::kind::boolean;
+        v.boolean = literal("true");
+        if (!v.boolean && !literal("false")) {
+          error("invalid literal");
+        }
+        break;
+      case 'n':
+        if (!literal("null")) {
+          error("invalid literal");
+        }
+        break;
+      default: {
+        char const *start = text_.c_str() + pos_;
+        char *end = nullptr;
+        v.type = json_value::kind::number;
+        v.number = strtod(start, &end);
+        if (end == start) {
+          error("expected a value");
+        }
+        pos_ += static_cast<size_t>(end - start);
+        break;
+      }
+    }
+    return v;
+  }
+
+  std::string parse_string() {
+    expect('"');
+    std::string s;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (c == '\\') {
+        if (pos_ >= text_.size()) {
+          break;
+        }
+        c = text_[pos_++];
+        switch (c) {
+          case 'n':
+            c = '\n';
+            break;
+          case 't':
+            c = '\t';
+            break;
+          case 'r':
+            c = '\r';
+            break;
+          case 'b':
+            c = '\b';
+            break;
+          case 'f':
+            c = '\f';
+            break;
+          case 'u':
+            // Benchmark names are ASCII, keep a placeholder.
+            pos_ = std::min(pos_ + 4, text_.size());
+            c = '?';
+            break;
+          default:
+            break;
+        }
+      }
+      s.push_back(c);
+    }
+    if (pos_ >= text_.size()) {
+      error("unterminated string");
+    }
+    pos_++;
+    return s;
+  }
+
+  std::string const &text_;
+  size_t pos_{0};
+};
+
+}  // namespace
+
+json_value parse_json(std::string const &text) {
+  return json_parser(text).parse();
+}
+
+json_value read_json(std::string const &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw sled::Exception("Unable to open ", path);
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return parse_json(ss.str());
+}
+
+}  // namespace sled::bench
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sled::bench {
+
+/**
+ * Minimal JSON document, enough to read back benchmark results.
+ */
+struct json_value {
+  enum class kind { null, boolean, number, string, array, object };
+
+  kind type{kind::null};
+  bool boolean{false};
+  double number{0};
+  std::string string;
+  std::vector<json_value> array;
+  std::vector<std::pair<std::string, json_value>> object;
+
+  /**
+   * Member @a key of an object, nullptr if missing.
+   */
+  json_value const *find(std::string const &key) const;
+};
+
+/**
+ * Parse @a text, throwing sled::Exception on malformed input.
+ */
+json_value parse_json(std::string const &text);
+
+/**
+ * Read and parse the file at @a path.
+ */
+json_value read_json(std::string const &path);
+
+}  // namespace sled::bench
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "json.h"
+
+#include "gtest/gtest.h"
+#include "sled/exception.h"
+
+using sled::bench::json_value;
+using sled::bench::parse_json;
+
+TEST(BenchJsonTest, scalars) {
+  EXPECT_EQ(json_value::kind::null, parse_json("null").type);
+  EXPECT_TRUE(parse_json("true").boolean);
+  EXPECT_EQ(json_value::kind::boolean, parse_json(" false ").type);
+  EXPECT_FALSE(parse_json("false").boolean);
+  EXPECT_EQ(-12.5, parse_json("-12.5").number);
+  EXPECT_EQ(1e3, parse_json("1e3").number);
+  EXPECT_EQ("abc", parse_json("\"abc\"").string);
+}
+
+TEST(BenchJsonTest, escapes) {
+  auto v = parse_json(R"("a\"b\\c\/d\n\t\r\b\f")");
+  EXPECT_EQ("a\"b\\c/d\n\t\r\b\f", v.string);
+  // \u escapes are replaced with a placeholder.
+  EXPECT_EQ("x?y", parse_json(R"("x\u00e9y")").string);
+}
+
+TEST(BenchJsonTest, nesting) {
+  auto v = parse_json(R"(
+    {
+      "context": {"host": "box", "cpu": -1},
+      "benchmarks": [
+        {"name": "a", "samples": [1, 2.5, 3]},
+        {"name": "b", "samples": []}
+      ],
+      "empty": {}
+    })");
+  ASSERT_EQ(json_value::kind::object, v.type);
+  ASSERT_NE(nullptr, v.find("context"));
+  EXPECT_EQ("box", v.find("context")->find("host")->string);
+  EXPECT_EQ(-1, v.find("context")->find("cpu")->number);
+  EXPECT_EQ(nullptr, v.find("missing"));
+
+  auto const *benchmarks = v.find("benchmarks");
+  ASSERT_NE(nullptr, benchmarks);
+  ASSERT_EQ(2u, benchmarks->array.size());
+  EXPECT_EQ("a", benchmarks->array[0].find("name")->string);
+  auto const &samples = benchmarks->array[0].find("samples")->array;
+  ASSERT_EQ(3u, samples.size());
+  EXPECT_EQ(2.5, samples[1].number);
+  EXPECT_TRUE(benchmarks->array[1].find("samples")->array.empty());
+  EXPECT_TRUE(v.find("empty")->object.empty());
+}
+
+TEST(BenchJsonTest, malformed) {
+  for (auto const *text :
+       {"", "   ", "[1, 2", "[1,]", "{\"a\" 1}", "{\"a\": 1,}", "{1: 2}",
+        "\"abc", "\"abc\\", "tru", "nul", "[1] x", "{} {}", "-"}) {
+    EXPECT_THROW(parse_json(text), sled::Exception) << text;
+  }
+}
+
+TEST(BenchJsonTest, embedded_nul) {
+  EXPECT_THROW(parse_json(std::string("[1]\0", 4)), sled::Exception);
+  EXPECT_THROW(parse_json(std::string("[1,\0 2]", 7)), sled::Exception);
+}
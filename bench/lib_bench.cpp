@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+#include "sled/base64.h"
+#include "sled/bitfield.h"
+#include "sled/bitstream.h"
+#include "sled/bytestream.h"
+#include "sled/crc.h"
+#include "sled/fmt.h"
+#include "sled/hash.h"
+#include "sled/log.h"
+#include "sled/numeric.h"
+#include "sled/serialize.h"
+#include "sled/sha1.h"
+#include "sled/varint.h"
+
+/**
+ * Deterministic pseudo-random test data.
+ */
+static std::vector<uint8_t> test_data(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t x = 0x12345678;
+  for (auto &b : data) {
+    x = x * 1664525 + 1013904223;
+    b = static_cast<uint8_t>(x >> 24);
+  }
+  return data;
+}
+
+//
+// crc32c
+//
+
+SLED_BENCHMARK(crc32c, 64, 256, 4096, 65536, 1 << 20, 16 << 20, 64 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::calculate_crc32c(data.data(), data.data() + data.size()));
+  }
+}
+
+SLED_BENCHMARK(crc32c_serial, 64, 256, 4096, 65536, 1 << 20, 16 << 20,
+               64 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::crc32c_update<sled::hwarch>(
+        sled::crc32c{0}, data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(crc32_ieee, 64, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::crc32_ieee::compute(data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(crc16_ccitt, 64, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::crc16_ccitt::compute(data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(crc16_ccitt_bytewise, 4096) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::crc16_ccitt crc;
+    for (auto b : data) {
+      crc.update(b);
+    }
+    sled::bench::do_not_optimize(crc.value());
+  }
+}
+
+//
+// fast_hash
+//
+
+SLED_BENCHMARK(fast_hash64, 8, 64, 240, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::fast_hash64(data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(fast_hash64_scalar, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::fast_hash64<sled::hwarch>(data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(std_hash_string, 8, 64, 4096) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  std::string str(data.begin(), data.end());
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(std::hash<std::string>()(str));
+  }
+}
+
+//
+// sha1
+//
+
+SLED_BENCHMARK(sha1, 64, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::sha1_hash::compute(data.data(), data.size()));
+  }
+}
+
+SLED_BENCHMARK(sha1_compress_scalar, 4096) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  uint32_t digest[5] = {};
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::sha1_compress<sled::hwarch>(digest, data.data(), data.size() / 64);
+  }
+  sled::bench::do_not_optimize(digest);
+}
+
+SLED_BENCHMARK(sha1_hash_many_x8, 64, 4096, 1 << 20) {
+  std::vector<std::vector<uint8_t>> inputs(8);
+  std::vector<void const *> data;
+  std::vector<size_t> len;
+  for (auto &input : inputs) {
+    input = test_data(static_cast<size_t>(state.arg()));
+    data.push_back(input.data());
+    len.push_back(input.size());
+  }
+  std::vector<sled::sha1> out(inputs.size());
+  state.set_bytes_per_iteration(inputs.size() * len[0]);
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::sha1_hash_many(data.data(), len.data(), out.data(), out.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+//
+// base64
+//
+
+SLED_BENCHMARK(base64_encode, 16, 256, 4096, 65536, 1 << 20, 16 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte const *>(data.data());
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::base64_encode(begin, begin + data.size()));
+  }
+}
+
+SLED_BENCHMARK(base64_decode, 16, 256, 4096, 65536, 1 << 20, 16 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte const *>(data.data());
+  auto encoded = sled::base64_encode(begin, begin + data.size());
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::base64_decode(encoded));
+  }
+}
+
+/**
+ * Encode in 4 KiB chunks into a reused buffer.
+ */
+SLED_BENCHMARK(base64_encoder_stream, 1 << 20, 16 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  char out[sled::base64_encoder::max_update_size(4096) + 4];
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::base64_encoder encoder;
+    for (size_t off = 0; off < data.size(); off += 4096) {
+      size_t len = std::min<size_t>(4096, data.size() - off);
+      encoder.update(out, sizeof(out), data.data() + off, len);
+      sled::bench::clobber_memory();
+    }
+    encoder.finalize(out, sizeof(out));
+  }
+}
+
+SLED_BENCHMARK(base64_encode_scalar, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  std::string out(data.size() / 3 * 4, '\0');
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::base64_encode_blocks<sled::hwarch>(out.data(), data.data(),
+                                             data.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+SLED_BENCHMARK(base64_decode_scalar, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto encoded = sled::base64_encode(data);
+  std::vector<uint8_t> out(encoded.size() / 4 * 3);
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::base64_decode_blocks<sled::hwarch>(out.data(), encoded.data(),
+                                             encoded.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+//
+// bytestream
+//
+
+/**
+ * Read the buffer as a mix of bit widths.
+ */
+SLED_BENCHMARK(bytestream_bits_read, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte *>(data.data());
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bytestream bs(begin, begin + data.size());
+    int sum = 0;
+    while (!bs.overflow()) {
+      sum += bs.bits_read(1);
+      sum += bs.bits_read(3);
+      sum += bs.bits_read(12);
+    }
+    sled::bench::do_not_optimize(sum);
+  }
+}
+
+SLED_BENCHMARK(be_to_host_array32, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  std::vector<uint32_t> out(data.size() / 4);
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::be_to_host_array(out.data(), data.data(), out.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+SLED_BENCHMARK(be_pread32_loop, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte *>(data.data());
+  std::vector<uint32_t> out(data.size() / 4);
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bytestream bs(begin, begin + data.size());
+    for (size_t n = 0; n < out.size(); n++) {
+      out[n] = bs.be_pread<uint32_t>(static_cast<int>(n * 4));
+    }
+    sled::bench::clobber_memory();
+  }
+}
+
+/**
+ * be_pread32_loop with one bounds check per 64 byte record.
+ */
+SLED_BENCHMARK(byte_cursor_be_read32, 4096, 1 << 20) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte *>(data.data());
+  std::vector<uint32_t> out(data.size() / 4);
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::byte_cursor c(begin, begin + data.size());
+    auto *o = out.data();
+    while (c.reserve(64)) {
+      for (int n = 0; n < 16; n++) {
+        *o++ = c.be_read_unchecked<uint32_t>();
+      }
+    }
+    sled::bench::clobber_memory();
+  }
+}
+
+/**
+ * Encode count trace-like deltas, mostly 1 and 2 byte values.
+ */
+static std::vector<uint8_t> varint_data(size_t count,
+                                        std::vector<uint32_t> &values) {
+  auto data = test_data(count * 2);
+  values.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    values[i] = data[i * 2] < 192 ? data[i * 2] & 0x7f
+                                  : (data[i * 2] << 8 | data[i * 2 + 1]);
+  }
+  std::vector<uint8_t> buf(count * sled::varint32_max_size);
+  buf.resize(sled::varint_encode_array(buf.data(), values.data(), count));
+  return buf;
+}
+
+template <typename Arch>
+static void varint_decode_bench(sled::bench::state &state) {
+  std::vector<uint32_t> values;
+  auto buf = varint_data(static_cast<size_t>(state.arg()), values);
+  state.set_bytes_per_iteration(values.size() * sizeof(uint32_t));
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::varint_decode_array<Arch>(values.data(), values.size(), buf.data(),
+                                    buf.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+SLED_BENCHMARK(varint_decode_array, 4096, 1 << 20) {
+  varint_decode_bench<sled::ssse3_hwarch>(state);
+}
+
+SLED_BENCHMARK(varint_decode_array_scalar, 4096, 1 << 20) {
+  varint_decode_bench<sled::hwarch>(state);
+}
+
+SLED_BENCHMARK(varint_encode_array, 4096, 1 << 20) {
+  std::vector<uint32_t> values;
+  auto buf = varint_data(static_cast<size_t>(state.arg()), values);
+  buf.resize(values.size() * sled::varint32_max_size);
+  state.set_bytes_per_iteration(values.size() * sizeof(uint32_t));
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::varint_encode_array(buf.data(), values.data(), values.size());
+    sled::bench::clobber_memory();
+  }
+}
+
+/**
+ * Typical save-state record.
+ */
+struct bench_record final : sled::serializable<bench_record> {
+  uint16_t pc{0x1234};
+  uint8_t a{1};
+  uint8_t x{2};
+  uint8_t flags{0x15};
+  uint8_t irq{3};
+  uint32_t cycles{0};
+  uint64_t timestamp{5};
+  std::optional<uint16_t> breakpoint;
+
+  static constexpr auto fields = std::make_tuple(
+      make_be_field(&bench_record::pc, "pc"),
+      make_be_field(&bench_record::a, "a"),
+      make_be_field(&bench_record::x, "x"),
+      make_bits_field(&bench_record::flags, 5, "flags"),
+      make_bits_field(&bench_record::irq, 3, "irq"),
+      make_le_field(&bench_record::cycles, "cycles"),
+      make_be_field(&bench_record::timestamp, "timestamp"),
+      make_be_field(&bench_record::breakpoint, "breakpoint"));
+};
+
+SLED_BENCHMARK(serializable_encode, 1 << 16) {
+  std::vector<std::byte> data(static_cast<size_t>(state.arg()));
+  bench_record r;
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::byte_cursor c(data.data(), data.data() + data.size());
+    while (r.encode(c)) {
+      r.cycles++;
+    }
+    sled::bench::clobber_memory();
+  }
+}
+
+SLED_BENCHMARK(serializable_decode, 1 << 16) {
+  std::vector<std::byte> data(static_cast<size_t>(state.arg()));
+  bench_record r;
+  sled::byte_cursor w(data.data(), data.data() + data.size());
+  while (r.encode(w)) {
+  }
+  state.set_bytes_per_iteration(w.position());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::byte_cursor c(data.data(), data.data() + w.position());
+    uint64_t sum = 0;
+    while (r.decode(c)) {
+      sum += r.cycles;
+    }
+    sled::bench::do_not_optimize(sum);
+  }
+}
+
+template <sled::bit_order Order>
+static void bit_reader_bench(sled::bench::state &state) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  auto *begin = reinterpret_cast<std::byte *>(data.data());
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bit_reader<Order> br(begin, begin + data.size());
+    uint64_t sum = 0;
+    while (!br.overflow()) {
+      br.refill();
+      sum += br.read_unchecked(1);
+      sum += br.read_unchecked(3);
+      sum += br.read_unchecked(12);
+    }
+    sled::bench::do_not_optimize(sum);
+  }
+}
+
+SLED_BENCHMARK(bit_reader_msb, 4096, 1 << 20) {
+  bit_reader_bench<sled::bit_order::msb_first>(state);
+}
+
+SLED_BENCHMARK(bit_reader_lsb, 4096, 1 << 20) {
+  bit_reader_bench<sled::bit_order::lsb_first>(state);
+}
+
+SLED_BENCHMARK(bit_writer_msb, 4096, 1 << 20) {
+  std::vector<std::byte> data(static_cast<size_t>(state.arg()));
+  state.set_bytes_per_iteration(data.size());
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bit_writer<sled::bit_order::msb_first> bw(
+        data.data(), data.data() + data.size());
+    for (size_t n = 0; n < data.size() / 2; n++) {
+      bw.write(n, 1);
+      bw.write(n, 3);
+      bw.write(n, 12);
+    }
+    bw.flush();
+    sled::bench::clobber_memory();
+  }
+}
+
+template <typename Arch>
+static void bits_extract_bench(sled::bench::state &state) {
+  auto data = test_data(static_cast<size_t>(state.arg()));
+  std::vector<uint64_t> src(data.size() / sizeof(uint64_t));
+  std::vector<uint64_t> dst(src.size());
+  memcpy(src.data(), data.data(), src.size() * sizeof(uint64_t));
+  state.set_bytes_per_iteration(src.size() * sizeof(uint64_t));
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    // Four scattered fields, as in a packed status register.
+    sled::bits_extract_array<Arch>(dst.data(), src.data(), src.size(),
+                                   0x00f0'3c00'0007'81c3);
+    sled::bench::clobber_memory();
+  }
+}
+
+SLED_BENCHMARK(bits_extract_array, 4096, 1 << 20) {
+  if (sled::bmi2_hwarch::available()) {
+    bits_extract_bench<sled::bmi2_hwarch>(state);
+  } else {
+    bits_extract_bench<sled::hwarch>(state);
+  }
+}
+
+SLED_BENCHMARK(bits_extract_array_scalar, 4096, 1 << 20) {
+  bits_extract_bench<sled::hwarch>(state);
+}
+
+//
+// Formatting
+//
+
+SLED_BENCHMARK(hexfmt) {
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        fmt_string(sled::HexFmt(static_cast<uint32_t>(i))));
+  }
+}
+
+SLED_BENCHMARK(fmt_obj_format) {
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::format(
+        "pc=", sled::HexFmt(static_cast<uint16_t>(i)), " cycles=",
+        sled::HexFmt(i)));
+  }
+}
+
+SLED_BENCHMARK(compiled_format) {
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(
+        sled::format(SLED_FMT("pc={} cycles={}"),
+                     sled::HexFmt(static_cast<uint16_t>(i)), sled::HexFmt(i)));
+  }
+}
+
+SLED_BENCHMARK(compiled_format_to) {
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::fmt_buffer<64> buf;
+    sled::format_to(buf, SLED_FMT("pc={} cycles={}"),
+                    sled::HexFmt(static_cast<uint16_t>(i)), sled::HexFmt(i));
+    sled::bench::do_not_optimize(buf.view());
+  }
+}
+
+//
+// Logging
+//
+
+namespace {
+
+struct null_sink {
+  friend void sink_msg(null_sink &, sled::log::message &msg) {
+    sled::bench::do_not_optimize(msg.format());
+  }
+};
+
+}  // namespace
+
+using sled::log::Facility;
+using sled::log::Severity;
+
+SLED_BENCHMARK(log_disabled) {
+  null_sink sink;
+  sled::log::LoggingManager logman(sled::log::Sink{sink});
+  logman.set_threshold(Severity::V::Warning);
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    SLED_DEBUG(logman, Facility::V::Exec, "value=", i);
+  }
+}
+
+SLED_BENCHMARK(log_enabled) {
+  null_sink sink;
+  sled::log::LoggingManager logman(sled::log::Sink{sink});
+  logman.set_threshold(Severity::V::Trace);
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    SLED_INFO(logman, Facility::V::Exec, "value=", i);
+  }
+}
+
+SLED_BENCHMARK(log_rate_limited) {
+  null_sink sink;
+  sled::log::LoggingManager logman(sled::log::Sink{sink});
+  logman.set_threshold(Severity::V::Trace);
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    SLED_LOG_RATE_LIMITED(logman, Facility::V::Exec, Severity::V::Warning, 10,
+                          1, "value=", i);
+  }
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace sled::bench {
+
+static double median_of(std::vector<double> &v) {
+  std::sort(v.begin(), v.end());
+  auto n = v.size();
+  if (n == 0) {
+    return 0;
+  }
+  return (n % 2 == 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+summary summarize(std::vector<double> samples) {
+  summary s;
+  if (samples.empty()) {
+    return s;
+  }
+  s.median = median_of(samples);
+  s.min = samples.front();
+  s.max = samples.back();
+  double sum = 0;
+  for (auto v : samples) {
+    sum += v;
+  }
+  s.mean = sum / static_cast<double>(samples.size());
+
+  std::vector<double> deviations;
+  deviations.reserve(samples.size());
+  for (auto v : samples) {
+    deviations.push_back(std::fabs(v - s.median));
+  }
+  // 1.4826 scales the MAD to the standard deviation of a normal
+  // distribution.
+  s.mad = 1.4826 * median_of(deviations);
+
+  double kept_sum = 0;
+  size_t kept = 0;
+  for (auto v : samples) {
+    if (std::fabs(v - s.median) <= 3 * s.mad) {
+      kept_sum += v;
+      kept++;
+    }
+  }
+  s.robust_mean = kept == 0 ? s.median : kept_sum / static_cast<double>(kept);
+  return s;
+}
+
+/**
+ * Number of orderings of @a n1 and @a n2 distinct samples giving each U.
+ *
+ * These are the coefficients of the Gaussian binomial [n1 + n2, n1]_q,
+ * built as the product of (1 - q^(n2 + k)) / (1 - q^k) for k = 1 .. n1.
+ * Counts stay below 2^53 for exact_max samples per set.
+ */
+static std::vector<double> u_counts(size_t n1, size_t n2) {
+  std::vector<double> c(n1 * n2 + 1, 0);
+  c[0] = 1;
+  for (size_t k = 1; k <= n1; k++) {
+    for (size_t u = c.size(); u-- > n2 + k;) {
+      c[u] -= c[u - (n2 + k)];
+    }
+    for (size_t u = k; u < c.size(); u++) {
+      c[u] += c[u - k];
+    }
+  }
+  return c;
+}
+
+/**
+ * Exact two-sided p-value of @a u without ties.
+ */
+static double exact_p_value(size_t n1, size_t n2, double u) {
+  auto counts = u_counts(n1, n2);
+  auto k = static_cast<size_t>(u);
+  double total = 0;
+  double below = 0;
+  double above = 0;
+  for (size_t i = 0; i < counts.size(); i++) {
+    total += counts[i];
+    below += i <= k ? counts[i] : 0;
+    above += i >= k ? counts[i] : 0;
+  }
+  return std::min(1.0, 2 * std::min(below, above) / total);
+}
+
+mann_whitney mann_whitney_u(std::vector<double> const &a,
+                            std::vector<double> const &b) {
+  mann_whitney r;
+  auto n1 = static_cast<double>(a.size());
+  auto n2 = static_cast<double>(b.size());
+  if (a.empty() || b.empty()) {
+    return r;
+  }
+
+  // Rank the pooled samples, ties share the average of their ranks.
+  std::vector<std::pair<double, bool>> pooled;
+  pooled.reserve(a.size() + b.size());
+  for (auto v : a) {
+    pooled.emplace_back(v, true);
+  }
+  for (auto v : b) {
+    pooled.emplace_back(v, false);
+  }
+  std::sort(pooled.begin(), pooled.end());
+
+  double rank_sum = 0;
+  double tie_sum = 0;
+  for (size_t i = 0; i < pooled.size();) {
+    size_t j = i + 1;
+    while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+      j++;
+    }
+    // Ranks are 1-based: i + 1 ... j.
+    double rank = static_cast<double>(i + 1 + j) / 2;
+    for (size_t k = i; k < j; k++) {
+      if (pooled[k].second) {
+        rank_sum += rank;
+      }
+    }
+    auto t = static_cast<double>(j - i);
+    tie_sum += t * t * t - t;
+    i = j;
+  }
+
+  r.u = rank_sum - n1 * (n1 + 1) / 2;
+  if (tie_sum == 0 && a.size() <= exact_max && b.size() <= exact_max) {
+    r.exact = true;
+    r.p_value = exact_p_value(a.size(), b.size(), r.u);
+  }
+  double n = n1 + n2;
+  double mu = n1 * n2 / 2;
+  double var = n1 * n2 / 12 * ((n + 1) - tie_sum / (n * (n - 1)));
+  if (var <= 0) {
+    // Every sample is identical.
+    return r;
+  }
+  double delta = r.u - mu;
+  double correction = delta > 0 ? -0.5 : (delta < 0 ? 0.5 : 0);
+  r.z = (delta + correction) / std::sqrt(var);
+  if (!r.exact) {
+    r.p_value = std::min(1.0, std::erfc(std::fabs(r.z) / std::sqrt(2.0)));
+  }
+  return r;
+}
+
+}  // namespace sled::bench
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace sled::bench {
+
+/**
+ * Outlier-robust summary of samples (nanoseconds per iteration).
+ */
+struct summary {
+  double median{0};
+  double mad{0}; /**< Median absolute deviation, scaled to a stddev. */
+  double mean{0};
+  double robust_mean{0}; /**< Mean of samples within 3 MADs of the median. */
+  double min{0};
+  double max{0};
+};
+
+summary summarize(std::vector<double> samples);
+
+/**
+ * Result of a two-sided Mann-Whitney U test.
+ */
+struct mann_whitney {
+  double u{0};       /**< U statistic of the first sample set. */
+  double z{0};       /**< Normal approximation, tie and continuity corrected. */
+  double p_value{1}; /**< Probability both sets share a distribution. */
+  bool exact{false}; /**< p_value is exact rather than approximated. */
+};
+
+/**
+ * Test whether samples @a a and @a b come from the same distribution.
+ *
+ * Makes no assumption of normality, which suits timing samples with a long
+ * right tail.  Without ties and with at most exact_max samples per set the
+ * p-value comes from the exact distribution of U; otherwise from the normal
+ * approximation.
+ */
+constexpr size_t exact_max = 20;
+
+mann_whitney mann_whitney_u(std::vector<double> const &a,
+                            std::vector<double> const &b);
+
+}  // namespace sled::bench
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "stats.h"
+
+#include "gtest/gtest.h"
+
+using sled::bench::mann_whitney_u;
+using sled::bench::summarize;
+
+TEST(BenchStatsTest, summarize_empty) {
+  auto s = summarize({});
+  EXPECT_EQ(0, s.median);
+  EXPECT_EQ(0, s.mad);
+  EXPECT_EQ(0, s.mean);
+}
+
+TEST(BenchStatsTest, summarize) {
+  auto s = summarize({5, 1, 4, 2, 3});
+  EXPECT_EQ(3, s.median);
+  EXPECT_EQ(3, s.mean);
+  EXPECT_EQ(1, s.min);
+  EXPECT_EQ(5, s.max);
+  // Deviations 0, 1, 1, 2, 2 have a median of 1.
+  EXPECT_DOUBLE_EQ(1.4826, s.mad);
+  EXPECT_EQ(3, s.robust_mean);
+}
+
+TEST(BenchStatsTest, summarize_even) {
+  auto s = summarize({4, 1, 3, 2});
+  EXPECT_EQ(2.5, s.median);
+  EXPECT_EQ(2.5, s.mean);
+}
+
+TEST(BenchStatsTest, summarize_outlier) {
+  auto s = summarize({10, 11, 9, 10, 10, 1000});
+  EXPECT_EQ(10, s.median);
+  EXPECT_NEAR(175, s.mean, 1e-9);
+  // The outlier is dropped from the robust mean.
+  EXPECT_EQ(10, s.robust_mean);
+}
+
+TEST(BenchStatsTest, mann_whitney_empty) {
+  auto r = mann_whitney_u({}, {1, 2});
+  EXPECT_EQ(1, r.p_value);
+}
+
+TEST(BenchStatsTest, mann_whitney_identical) {
+  auto r = mann_whitney_u({5, 5, 5}, {5, 5, 5});
+  EXPECT_EQ(4.5, r.u);
+  EXPECT_EQ(1, r.p_value);
+}
+
+TEST(BenchStatsTest, mann_whitney_exact) {
+  auto r = mann_whitney_u({1, 2, 3}, {4, 5, 6});
+  EXPECT_TRUE(r.exact);
+  EXPECT_EQ(0, r.u);
+  EXPECT_DOUBLE_EQ(0.1, r.p_value);
+
+  r = mann_whitney_u({1, 2, 3, 4, 5}, {6, 7, 8, 9, 10});
+  EXPECT_TRUE(r.exact);
+  EXPECT_DOUBLE_EQ(2.0 / 252, r.p_value);
+
+  r = mann_whitney_u({19, 22, 16, 29, 24}, {20, 11, 17, 12});
+  EXPECT_TRUE(r.exact);
+  EXPECT_EQ(17, r.u);
+  EXPECT_DOUBLE_EQ(1.0 / 9, r.p_value);
+}
+
+TEST(BenchStatsTest, mann_whitney_symmetric) {
+  auto ab = mann_whitney_u({19, 22, 16, 29, 24}, {20, 11, 17, 12});
+  auto ba = mann_whitney_u({20, 11, 17, 12}, {19, 22, 16, 29, 24});
+  EXPECT_EQ(20, ab.u + ba.u);
+  EXPECT_DOUBLE_EQ(ab.p_value, ba.p_value);
+}
+
+TEST(BenchStatsTest, mann_whitney_ties) {
+  auto r = mann_whitney_u({1, 2, 2, 3, 3, 3, 4}, {3, 4, 4, 5, 5, 6});
+  EXPECT_FALSE(r.exact);
+  EXPECT_EQ(3.5, r.u);
+  EXPECT_NEAR(-2.483773282901211, r.z, 1e-12);
+  EXPECT_NEAR(0.012999854364387314, r.p_value, 1e-12);
+}
+
+TEST(BenchStatsTest, mann_whitney_normal) {
+  std::vector<double> a;
+  std::vector<double> b;
+  for (int i = 1; i <= 25; i++) {
+    a.push_back(i);
+    b.push_back(i + 20);
+  }
+  // Overlapping values are ties.
+  auto r = mann_whitney_u(a, b);
+  EXPECT_FALSE(r.exact);
+  EXPECT_EQ(12.5, r.u);
+  EXPECT_NEAR(-5.811851318993167, r.z, 1e-12);
+  EXPECT_NEAR(6.178570519634069e-09, r.p_value, 1e-18);
+}
+
+TEST(BenchStatsTest, mann_whitney_large) {
+  std::vector<double> a;
+  std::vector<double> b;
+  for (int i = 0; i < 25; i++) {
+    a.push_back(2 * i);
+    b.push_back(2 * i + 11);
+  }
+  // No ties, but too many samples for the exact distribution.
+  auto r = mann_whitney_u(a, b);
+  EXPECT_FALSE(r.exact);
+  EXPECT_EQ(190, r.u);
+  EXPECT_NEAR(-2.36714770035461, r.z, 1e-12);
+  EXPECT_NEAR(0.017925777357406487, r.p_value, 1e-12);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "bench.h"
+#include "sled/time.h"
+
+SLED_BENCHMARK(stopwatch_now) {
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::stopwatch::now());
+  }
+}
+
+SLED_BENCHMARK(tsc_clock_now) {
+  sled::tsc_clock::now();
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::tsc_clock::now());
+  }
+}
+
+SLED_BENCHMARK(coarse_clock_now) {
+  sled::coarse_clock::start();
+  state.reset_timer();
+  for (uint64_t i = 0; i < state.iterations(); i++) {
+    sled::bench::do_not_optimize(sled::coarse_clock::now());
+  }
+  state.stop_timer();
+  sled::coarse_clock::stop();
+}
@@ -23,6 +23,51 @@ struct hwarch {
 };
 
 #if SLED_X86_64
+/**
+ * SSSE3 hardware (Core 2)
+ */
+struct ssse3_hwarch : public hwarch {
+  static bool available() {
+    sled::x86::CPUID1 cpuid;
+    return cpuid.ecx().is_set(sled::x86::CPUID1_ECX_FEATURE::V::SSSE3);
+  }
+};
+
+/**
+ * SSE4.2 and carry-less multiply hardware (Westmere)
+ */
+struct pclmul_hwarch : public hwarch {
+  static bool available() {
+    sled::x86::CPUID1 cpuid;
+    return cpuid.ecx().is_set(sled::x86::CPUID1_ECX_FEATURE::V::SSE42) &&
+           cpuid.ecx().is_set(sled::x86::CPUID1_ECX_FEATURE::V::PCLMULQDQ);
+  }
+};
+
+/**
+ * SHA extensions (Goldmont, Zen)
+ */
+struct sha_hwarch : public hwarch {
+  static bool available() {
+    sled::x86::CPUID1 cpuid1;
+    sled::x86::CPUID7 cpuid7;
+    return cpuid1.ecx().is_set(sled::x86::CPUID1_ECX_FEATURE::V::SSE41) &&
+           cpuid7.ebx().is_set(sled::x86::CPUID7_EBX_FEATURE::V::SHA);
+  }
+};
+
+/**
+ * BMI2 bit manipulation (Haswell, Zen)
+ *
+ * pext/pdep are microcoded and slow before Zen 3.
+ */
+struct bmi2_hwarch : public hwarch {
+  static bool available() {
+    sled::x86::CPUID7 cpuid;
+    return cpuid.ebx().is_set(sled::x86::CPUID7_EBX_FEATURE::V::BMI2);
+  }
+};
+
 /**
  * AVX2 hardware (Broadwell-ish)
  */
@@ -43,6 +88,22 @@ struct avx512_hwarch : public avx2_hwarch {
   }
 };
 #else
+struct ssse3_hwarch : public hwarch {
+  static constexpr bool available() { return false; }
+};
+
+struct pclmul_hwarch : public hwarch {
+  static constexpr bool available() { return false; }
+};
+
+struct sha_hwarch : public hwarch {
+  static constexpr bool available() { return false; }
+};
+
+struct bmi2_hwarch : public hwarch {
+  static constexpr bool available() { return false; }
+};
+
 struct avx2_hwarch : public hwarch {
   constexpr bool available() { return false; }
 };
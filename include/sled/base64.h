@@ -9,10 +9,247 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "sled/arch.h"
+#include "sled/enum.h"
+
 namespace sled {
 
+/**
+ * Base64 variant flags.
+ *
+ * url selects the RFC 4648 URL and filename safe alphabet ('-' and '_' in
+ * place of '+' and '/').  no_padding omits the trailing '=' when encoding
+ * and allows it to be missing when decoding.
+ */
+struct base64_flag final : enum_struct<uint32_t, base64_flag> {
+  static constexpr std::array<name_type, 2> names{
+      std::make_pair(0x01, "url"), std::make_pair(0x02, "no_padding")};
+
+  using enum_struct::enum_struct;
+
+  struct V;
+};
+
+struct base64_flag::V {
+  static constexpr base64_flag url{0x01};
+  static constexpr base64_flag no_padding{0x02};
+};
+
+struct base64_flags : public sled::flags_struct<base64_flag, base64_flags> {
+  using flags_struct::flags_struct;
+};
+
+/**
+ * Base64 error codes.
+ */
+struct base64_error final : enum_struct<uint32_t, base64_error> {
+  static constexpr std::array<name_type, 4> names{
+      std::make_pair(0, "ok"), std::make_pair(1, "invalid_character"),
+      std::make_pair(2, "invalid_length"),
+      std::make_pair(3, "buffer_too_small")};
+
+  using enum_struct::enum_struct;
+
+  struct V;
+};
+
+struct base64_error::V {
+  static constexpr base64_error ok{0};
+  static constexpr base64_error invalid_character{1};
+  static constexpr base64_error invalid_length{2};
+  static constexpr base64_error buffer_too_small{3};
+};
+
+/**
+ * Result of an allocation-free base64 operation.
+ */
+struct base64_result {
+  size_t written{0}; /**< Bytes written to the output buffer. */
+  base64_error error{base64_error::V::ok};
+
+  explicit operator bool() const noexcept {
+    return error == base64_error::V::ok;
+  }
+};
+
+/**
+ * Encoded size of len bytes.
+ */
+inline size_t base64_encoded_size(size_t len, base64_flags flags = {}) {
+  if (flags.is_clear(base64_flag::V::no_padding)) {
+    return (len + 2) / 3 * 4;
+  }
+  return len / 3 * 4 + (len % 3 == 0 ? 0 : len % 3 + 1);
+}
+
+/**
+ * Upper bound of the decoded size of len characters.
+ */
+constexpr size_t base64_decoded_max_size(size_t len) {
+  return (len + 3) / 4 * 3;
+}
+
+/**
+ * Encode the leading whole 3 byte groups of [src, src + len).
+ *
+ * Writes 4 characters to dst for every 3 bytes consumed and returns the
+ * number of bytes consumed, len / 3 * 3.  Only base64_flag::V::url is
+ * relevant.
+ */
+template <typename Arch>
+size_t base64_encode_blocks(char *dst, uint8_t const *src, size_t len,
+                            base64_flags flags = {});
+
+template <>
+size_t base64_encode_blocks<hwarch>(char *dst, uint8_t const *src,
+                                    size_t len, base64_flags flags);
+
+template <>
+size_t base64_encode_blocks<ssse3_hwarch>(char *dst, uint8_t const *src,
+                                          size_t len, base64_flags flags);
+
+template <>
+size_t base64_encode_blocks<avx2_hwarch>(char *dst, uint8_t const *src,
+                                         size_t len, base64_flags flags);
+
+size_t base64_encode_blocks(char *dst, uint8_t const *src, size_t len,
+                            base64_flags flags = {});
+
+/**
+ * Decode the leading whole 4 character groups of [src, src + len).
+ *
+ * Writes 3 bytes to dst for every 4 characters consumed and returns the
+ * number of characters consumed.  Decoding stops before the first group
+ * holding padding or an invalid character.  dst must hold len / 4 * 3
+ * bytes, less any padding; vector implementations may scribble past the
+ * decoded output within that range.
+ */
+template <typename Arch>
+size_t base64_decode_blocks(uint8_t *dst, char const *src, size_t len,
+                            base64_flags flags = {});
+
+template <>
+size_t base64_decode_blocks<hwarch>(uint8_t *dst, char const *src,
+                                    size_t len, base64_flags flags);
+
+template <>
+size_t base64_decode_blocks<ssse3_hwarch>(uint8_t *dst, char const *src,
+                                          size_t len, base64_flags flags);
+
+template <>
+size_t base64_decode_blocks<avx2_hwarch>(uint8_t *dst, char const *src,
+                                         size_t len, base64_flags flags);
+
+size_t base64_decode_blocks(uint8_t *dst, char const *src, size_t len,
+                            base64_flags flags = {});
+
+/**
+ * Incremental base64 encoder.
+ *
+ * Input is encoded as it arrives; up to 2 trailing bytes are held until
+ * the next update() or finalize().
+ *
+ * \code{.cpp}
+ * base64_encoder enc;
+ * char buf[base64_encoder::max_update_size(4096) + 4];
+ * while (auto len = read(fd, data, 4096)) {
+ *   send(buf, enc.update(buf, sizeof(buf), data, len).written);
+ * }
+ * send(buf, enc.finalize(buf, sizeof(buf)).written);
+ * \endcode{}
+ */
+class base64_encoder {
+ public:
+  explicit base64_encoder(base64_flags flags = {}) : flags_(flags) {}
+
+  /**
+   * Characters update() may write for len bytes.
+   */
+  static constexpr size_t max_update_size(size_t len) {
+    return (len + 2) / 3 * 4;
+  }
+
+  /**
+   * Encode len bytes into dst.
+   *
+   * max_update_size(len) characters are always enough; with less room for
+   * the output update() fails with buffer_too_small, consuming nothing.
+   */
+  base64_result update(char *dst, size_t dst_size, void const *src,
+                       size_t len);
+
+  /**
+   * Encode the held bytes and any padding (at most 4 characters) and
+   * start a new stream.
+   */
+  base64_result finalize(char *dst, size_t dst_size);
+
+  void reset() { pending_size_ = 0; }
+
+ private:
+  base64_flags flags_;
+  uint8_t pending_[3]{};
+  size_t pending_size_{0};
+};
+
+/**
+ * Incremental base64 decoder.
+ *
+ * Input may be split at any character; up to 3 trailing characters are
+ * held until the next update() or finalize().  After an error the decoder
+ * must be reset().
+ */
+class base64_decoder {
+ public:
+  explicit base64_decoder(base64_flags flags = {}) : flags_(flags) {}
+
+  /**
+   * Decode src into dst.
+   *
+   * base64_decoded_max_size(src.size()) bytes are always enough; with less
+   * room for the output update() fails with buffer_too_small, consuming
+   * nothing.
+   */
+  base64_result update(void *dst, size_t dst_size, std::string_view src);
+
+  /**
+   * Decode any held unpadded group (at most 2 bytes) and start a new
+   * stream.
+   */
+  base64_result finalize(void *dst, size_t dst_size);
+
+  void reset() {
+    pending_size_ = 0;
+    done_ = false;
+  }
+
+ private:
+  base64_flags flags_;
+  char pending_[4]{};
+  size_t pending_size_{0};
+  bool done_{false};  // Seen padding
+};
+
+/**
+ * Encode [src, src + len) into dst without allocating.
+ *
+ * dst must hold base64_encoded_size(len, flags) characters.
+ */
+base64_result base64_encode(char *dst, size_t dst_size, void const *src,
+                            size_t len, base64_flags flags = {});
+
+/**
+ * Decode src into dst without allocating.
+ *
+ * dst must hold the decoded size; base64_decoded_max_size(src.size()) is
+ * always enough.
+ */
+base64_result base64_decode(void *dst, size_t dst_size, std::string_view src,
+                            base64_flags flags = {});
+
 /**
  * Decode a base64 string (with padding).
  *
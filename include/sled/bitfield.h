@@ -5,13 +5,261 @@
  */
 #pragma once
 
+#include "sled/arch.h"
 #include "sled/exception.h"
 #include "sled/numeric.h"
+#include <iterator>
+#include <type_traits>
 
 namespace sled {
 
+/**
+ * Gather the bits of v selected by mask into the low bits (pext).
+ *
+ * The hwarch version takes one step per run of set bits, so it stays
+ * cheap for bitfield masks.  The bmi2 version must be inlined into code
+ * built for bmi2 (-mbmi2 or __attribute__((target("bmi2")))).
+ */
+template <typename Arch>
+uint64_t bits_extract(uint64_t v, uint64_t mask);
+
+/**
+ * Scatter the low bits of v to the bits selected by mask (pdep).
+ */
+template <typename Arch>
+uint64_t bits_deposit(uint64_t v, uint64_t mask);
+
+template <>
+a_forceinline uint64_t bits_extract<hwarch>(uint64_t v, uint64_t mask) {
+  uint64_t r = 0;
+  int shift = 0;
+  while (mask != 0) {
+    int low = __builtin_ctzll(mask);
+    uint64_t run = mask & ~(mask + (mask & (~mask + 1)));
+    r |= (v & run) >> (low - shift);
+    shift += __builtin_popcountll(run);
+    mask &= ~run;
+  }
+  return r;
+}
+
+template <>
+a_forceinline uint64_t bits_deposit<hwarch>(uint64_t v, uint64_t mask) {
+  uint64_t r = 0;
+  int shift = 0;
+  while (mask != 0) {
+    int low = __builtin_ctzll(mask);
+    uint64_t run = mask & ~(mask + (mask & (~mask + 1)));
+    r |= (v << (low - shift)) & run;
+    shift += __builtin_popcountll(run);
+    mask &= ~run;
+  }
+  return r;
+}
+
+#if SLED_X86_64
+template <>
+__attribute__((target("bmi2"))) a_forceinline uint64_t
+bits_extract<bmi2_hwarch>(uint64_t v, uint64_t mask) {
+  return _pext_u64(v, mask);
+}
+
+template <>
+__attribute__((target("bmi2"))) a_forceinline uint64_t
+bits_deposit<bmi2_hwarch>(uint64_t v, uint64_t mask) {
+  return _pdep_u64(v, mask);
+}
+#else
+template <>
+a_forceinline uint64_t bits_extract<bmi2_hwarch>(uint64_t v, uint64_t mask) {
+  return bits_extract<hwarch>(v, mask);
+}
+
+template <>
+a_forceinline uint64_t bits_deposit<bmi2_hwarch>(uint64_t v, uint64_t mask) {
+  return bits_deposit<hwarch>(v, mask);
+}
+#endif
+
+/**
+ * bits_extract() with a constant mask, one shift and and per run of bits.
+ */
+template <uint64_t Mask>
+constexpr uint64_t bits_extract(uint64_t v) {
+  if constexpr (Mask == 0) {
+    return 0;
+  } else {
+    constexpr uint64_t run = Mask & ~(Mask + (Mask & (~Mask + 1)));
+    constexpr int low = __builtin_ctzll(Mask);
+    if constexpr ((Mask & ~run) == 0) {
+      return (v & run) >> low;
+    } else {
+      return ((v & run) >> low) |
+             (bits_extract<Mask & ~run>(v) << __builtin_popcountll(run));
+    }
+  }
+}
+
+/**
+ * bits_deposit() with a constant mask.
+ */
+template <uint64_t Mask>
+constexpr uint64_t bits_deposit(uint64_t v) {
+  if constexpr (Mask == 0) {
+    return 0;
+  } else {
+    constexpr uint64_t run = Mask & ~(Mask + (Mask & (~Mask + 1)));
+    constexpr int low = __builtin_ctzll(Mask);
+    if constexpr ((Mask & ~run) == 0) {
+      return (v << low) & run;
+    } else {
+      return ((v << low) & run) |
+             bits_deposit<Mask & ~run>(v >> __builtin_popcountll(run));
+    }
+  }
+}
+
+/**
+ * bits_extract() over count values.
+ */
+template <typename Arch>
+void bits_extract_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask);
+
+template <>
+void bits_extract_array<hwarch>(uint64_t *dst, uint64_t const *src,
+                                size_t count, uint64_t mask);
+
+template <>
+void bits_extract_array<bmi2_hwarch>(uint64_t *dst, uint64_t const *src,
+                                     size_t count, uint64_t mask);
+
+void bits_extract_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask);
+
+/**
+ * bits_deposit() over count values.
+ */
+template <typename Arch>
+void bits_deposit_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask);
+
+template <>
+void bits_deposit_array<hwarch>(uint64_t *dst, uint64_t const *src,
+                                size_t count, uint64_t mask);
+
+template <>
+void bits_deposit_array<bmi2_hwarch>(uint64_t *dst, uint64_t const *src,
+                                     size_t count, uint64_t mask);
+
+void bits_deposit_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask);
+
+/**
+ * Multi-field access shared by struct_bitfield and flags_bitfield.
+ *
+ * Fields are named by an enumerator of Tag's choosing, given to
+ * make_field() in Tag::fields, so the accessors read reg.get<Reg::mode>()
+ * and keep their meaning if the table is reordered.  A plain integer
+ * still names a field by its position in Tag::fields.  gather() packs the
+ * selected fields, lowest bit position first, into the low bits of the
+ * result; scatter() is the inverse.  Without an Arch they compile to
+ * shifts and masks (or pext/pdep when built with -mbmi2); the bmi2_hwarch
+ * versions must be called from code built for bmi2.
+ */
+template <typename Tag, typename Ta>
+struct bitfield_access {
+  /**
+   * Position in Tag::fields of field F.
+   */
+  template <auto F>
+  static constexpr size_t index() {
+    if constexpr (std::is_enum_v<decltype(F)>) {
+      constexpr size_t i = find_field(static_cast<int>(F));
+      static_assert(i < std::size(Tag::fields), "no field with this id");
+      return i;
+    } else {
+      static_assert(F >= 0 && static_cast<size_t>(F) < std::size(Tag::fields),
+                    "field index out of range");
+      return static_cast<size_t>(F);
+    }
+  }
+
+  /**
+   * Bits covered by fields F...
+   */
+  template <auto... F>
+  static constexpr uint64_t mask() {
+    return (Tag::field_mask(Tag::fields[index<F>()]) | ... | uint64_t{0});
+  }
+
+  template <auto... F>
+  Ta gather() const {
+#ifdef __BMI2__
+    return static_cast<Ta>(_pext_u64(bits(), mask<F...>()));
+#else
+    return static_cast<Ta>(bits_extract<mask<F...>()>(bits()));
+#endif
+  }
+
+  template <typename Arch, auto... F,
+            class = std::enable_if_t<!std::is_same_v<Arch, bmi2_hwarch>>>
+  a_forceinline Ta gather() const {
+    return static_cast<Ta>(bits_extract<Arch>(bits(), mask<F...>()));
+  }
+
+  template <typename Arch, auto... F,
+            class = std::enable_if_t<std::is_same_v<Arch, bmi2_hwarch>>,
+            class = void>
+  __attribute__((target("bmi2"))) a_forceinline Ta gather() const {
+    return static_cast<Ta>(bits_extract<Arch>(bits(), mask<F...>()));
+  }
+
+  template <auto... F>
+  void scatter(uint64_t packed) {
+#ifdef __BMI2__
+    store(_pdep_u64(packed, mask<F...>()), mask<F...>());
+#else
+    store(bits_deposit<mask<F...>()>(packed), mask<F...>());
+#endif
+  }
+
+  template <typename Arch, auto... F,
+            class = std::enable_if_t<!std::is_same_v<Arch, bmi2_hwarch>>>
+  a_forceinline void scatter(uint64_t packed) {
+    store(bits_deposit<Arch>(packed, mask<F...>()), mask<F...>());
+  }
+
+  template <typename Arch, auto... F,
+            class = std::enable_if_t<std::is_same_v<Arch, bmi2_hwarch>>,
+            class = void>
+  __attribute__((target("bmi2"))) a_forceinline void scatter(
+      uint64_t packed) {
+    store(bits_deposit<Arch>(packed, mask<F...>()), mask<F...>());
+  }
+
+ protected:
+  static constexpr size_t find_field(int id) {
+    size_t i = 0;
+    while (i < std::size(Tag::fields) && Tag::fields[i].id != id) {
+      i++;
+    }
+    return i;
+  }
+
+  a_forceinline uint64_t bits() const {
+    return static_cast<std::make_unsigned_t<Ta>>(
+        static_cast<Tag const &>(*this).v);
+  }
+
+  a_forceinline void store(uint64_t value, uint64_t m) {
+    auto &t = static_cast<Tag &>(*this);
+    t.v = static_cast<Ta>((bits() & ~m) | (value & m));
+  }
+};
+
 template <typename Ta, typename Tb, typename Tag>
-struct struct_bitfield {
+struct struct_bitfield : bitfield_access<Tag, Ta> {
   static_assert(std::is_integral_v<Ta>);
   static_assert(sizeof(Ta) == sizeof(Tb));
 
@@ -27,12 +275,13 @@ struct struct_bitfield {
   constexpr struct_bitfield(Tb const &v) : b(b) {}
 
   struct field_description {
-    constexpr field_description(int l, int h, char const *label)
-        : l(l), h(h), label(label) {}
+    constexpr field_description(int l, int h, char const *label, int id = -1)
+        : l(l), h(h), label(label), id(id) {}
 
     int l;
     int h;
     const char *label;
+    int id;
   };
 
   static constexpr field_description make_field(int l, int h,
@@ -40,6 +289,38 @@ struct struct_bitfield {
     return field_description(l, h, label);
   }
 
+  /**
+   * Field bits [l, h] that get<id>()/set<id>() can name.
+   */
+  template <typename E, class = std::enable_if_t<std::is_enum_v<E>>>
+  static constexpr field_description make_field(E id, int l, int h,
+                                                char const *label) {
+    return field_description(l, h, label, static_cast<int>(id));
+  }
+
+  static constexpr uint64_t field_mask(field_description const &f) {
+    return ((uint64_t{2} << (f.h - f.l)) - 1) << f.l;
+  }
+
+  /**
+   * Value of field F.
+   */
+  template <auto F>
+  constexpr Ta get() const {
+    constexpr auto &f = Tag::fields[this->template index<F>()];
+    constexpr auto m = field_mask(f);
+    return static_cast<Ta>((this->bits() & m) >> f.l);
+  }
+
+  /**
+   * Replace field F, extra high bits of x are dropped.
+   */
+  template <auto F>
+  void set(Ta x) {
+    constexpr auto &f = Tag::fields[this->template index<F>()];
+    this->store(static_cast<uint64_t>(x) << f.l, field_mask(f));
+  }
+
   Tag &operator=(Ta const &rhs) {
     v = rhs;
     return *this;
@@ -74,7 +355,7 @@ struct struct_bitfield {
 };
 
 template <typename Ta, typename Tb, typename Tag>
-struct flags_bitfield {
+struct flags_bitfield : bitfield_access<Tag, Ta> {
   static_assert(std::is_integral_v<Ta>);
   static_assert(sizeof(Ta) == sizeof(Tb));
 
@@ -90,17 +371,46 @@ struct flags_bitfield {
   flags_bitfield(Tb const &v) : b(b) {}
 
   struct field_description {
-    constexpr field_description(int b, char const *label)
-        : b(b), label(label) {}
+    constexpr field_description(int b, char const *label, int id = -1)
+        : b(b), label(label), id(id) {}
 
     int b;
     const char *label;
+    int id;
   };
 
   static constexpr field_description make_field(int b, char const *label) {
     return field_description(b, label);
   }
 
+  /**
+   * Flag bit b that get<id>()/set<id>() can name.
+   */
+  template <typename E, class = std::enable_if_t<std::is_enum_v<E>>>
+  static constexpr field_description make_field(E id, int b,
+                                                char const *label) {
+    return field_description(b, label, static_cast<int>(id));
+  }
+
+  static constexpr uint64_t field_mask(field_description const &f) {
+    return uint64_t{1} << f.b;
+  }
+
+  /**
+   * True if flag F is set.
+   */
+  template <auto F>
+  constexpr bool get() const {
+    constexpr auto m = field_mask(Tag::fields[this->template index<F>()]);
+    return (this->bits() & m) != 0;
+  }
+
+  template <auto F>
+  void set(bool x) {
+    constexpr auto m = field_mask(Tag::fields[this->template index<F>()]);
+    this->store(x ? m : 0, m);
+  }
+
   Tag &operator=(Ta const &rhs) {
     v = rhs;
     return *this;
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "sled/bytestream.h"
+#include "sled/platform.h"
+
+namespace sled {
+
+/**
+ * Bit packing order within a byte.
+ *
+ * msb_first matches bytestream::bits_read(): the first bit is the highest
+ * bit of the first byte (MPEG, JPEG, most instruction encodings).
+ * lsb_first starts with the lowest bit (DEFLATE, LZ-style ROM compressors).
+ */
+enum class bit_order { msb_first, lsb_first };
+
+/**
+ * Word at a time bit reader.
+ *
+ * Keeps up to 64 bits in a buffer refilled with one unaligned 8 byte load;
+ * the bounds check happens once per refill rather than once per field.
+ * After refill() at least 56 bits can be peeked and consumed without
+ * further checks, so fields can be pulled with straight-line code:
+ *
+ * \code{.cpp}
+ * bit_reader<bit_order::msb_first> br(data, data + len);
+ * br.refill();
+ * auto op = br.read_unchecked(4);
+ * auto reg = br.read_unchecked(3);
+ * \endcode{}
+ *
+ * Reads past the end return zero bits and set overflow().
+ */
+template <bit_order Order>
+class bit_reader {
+ public:
+  static constexpr int max_bits = 56; /**< Bits available after refill. */
+
+  bit_reader(std::byte const *begin, std::byte const *end)
+      : data_(begin), size_(static_cast<size_t>(end - begin)) {}
+  explicit bit_reader(bytestream &bs)
+      : bit_reader(bs.data(), bs.data() + bs.size()) {}
+
+  /**
+   * Top up the buffer to at least max_bits bits.
+   */
+  a_forceinline void refill() {
+    if (likely(pos_ + 8 <= size_)) {
+      uint64_t word;
+      memcpy(&word, data_ + pos_, sizeof(word));
+      if constexpr (Order == bit_order::msb_first) {
+        buf_ |= be64toh(word) >> count_;
+      } else {
+        buf_ |= le64toh(word) << count_;
+      }
+      pos_ += (63 - count_) >> 3;
+      count_ |= 56;
+    } else {
+      refill_tail();
+    }
+  }
+
+  /**
+   * Next num_bits (0 to max_bits) bits, requires refill().
+   */
+  a_forceinline uint64_t peek(int num_bits) const {
+    debug_assert(num_bits >= 0 && num_bits <= max_bits && num_bits <= count_);
+    if constexpr (Order == bit_order::msb_first) {
+      return (buf_ >> 1) >> (63 - num_bits);
+    } else {
+      return buf_ & ((uint64_t{1} << num_bits) - 1);
+    }
+  }
+
+  /**
+   * Drop num_bits bits, requires refill().
+   */
+  a_forceinline void consume(int num_bits) {
+    debug_assert(num_bits >= 0 && num_bits < 64 && num_bits <= count_);
+    if constexpr (Order == bit_order::msb_first) {
+      buf_ <<= num_bits;
+    } else {
+      buf_ >>= num_bits;
+    }
+    count_ -= num_bits;
+  }
+
+  /**
+   * peek() and consume(), requires refill().
+   */
+  a_forceinline uint64_t read_unchecked(int num_bits) {
+    auto v = peek(num_bits);
+    consume(num_bits);
+    return v;
+  }
+
+  /**
+   * Refill and read num_bits (0 to max_bits) bits.
+   */
+  a_forceinline uint64_t read(int num_bits) {
+    refill();
+    return read_unchecked(num_bits);
+  }
+
+  /**
+   * Skip any number of bits.
+   */
+  void skip(size_t num_bits) {
+    if (num_bits >= static_cast<size_t>(count_)) {
+      num_bits -= count_;
+      buf_ = 0;
+      count_ = 0;
+      pos_ += num_bits / 8;
+      num_bits %= 8;
+    }
+    refill();
+    consume(static_cast<int>(num_bits));
+  }
+
+  /**
+   * Skip to the next byte boundary.
+   */
+  void align() {
+    refill();
+    consume(count_ & 7);
+  }
+
+  /**
+   * Bits consumed so far.
+   */
+  size_t position() const { return pos_ * 8 - count_; }
+
+  /**
+   * True if more bits were consumed than the buffer holds.
+   */
+  bool overflow() const { return position() > size_ * 8; }
+
+ private:
+  void refill_tail() {
+    while (count_ <= 56) {
+      uint64_t byte = 0;
+      if (pos_ < size_) {
+        byte = std::to_integer<uint64_t>(data_[pos_]);
+      }
+      if constexpr (Order == bit_order::msb_first) {
+        buf_ |= byte << (56 - count_);
+      } else {
+        buf_ |= byte << count_;
+      }
+      pos_++;
+      count_ += 8;
+    }
+  }
+
+  std::byte const *data_;
+  size_t size_;
+  size_t pos_{0};   // Next byte to load
+  uint64_t buf_{0}; // Valid bits are at the top (msb) or bottom (lsb)
+  int count_{0};    // Valid bits in buf_
+};
+
+/**
+ * Word at a time bit writer.
+ *
+ * Bits are gathered in a 64-bit buffer and complete bytes are stored with
+ * one unaligned 8 byte store per write(); bytes past position() within the
+ * buffer may be overwritten with scratch.  Writes past the end are dropped
+ * and set overflow().
+ */
+template <bit_order Order>
+class bit_writer {
+ public:
+  static constexpr int max_bits = 56; /**< Largest single write. */
+
+  bit_writer(std::byte *begin, std::byte *end)
+      : data_(begin), size_(static_cast<size_t>(end - begin)) {}
+  explicit bit_writer(bytestream &bs)
+      : bit_writer(bs.data(), bs.data() + bs.size()) {}
+
+  /**
+   * Append the low num_bits (1 to max_bits) bits of value.
+   */
+  a_forceinline void write(uint64_t value, int num_bits) {
+    debug_assert(num_bits > 0 && num_bits <= max_bits);
+    value &= (uint64_t{1} << num_bits) - 1;
+    if constexpr (Order == bit_order::msb_first) {
+      buf_ |= value << (64 - count_ - num_bits);
+    } else {
+      buf_ |= value << count_;
+    }
+    count_ += num_bits;
+    if (likely(pos_ + 8 <= size_)) {
+      uint64_t word;
+      if constexpr (Order == bit_order::msb_first) {
+        word = htobe64(buf_);
+      } else {
+        word = htole64(buf_);
+      }
+      memcpy(data_ + pos_, &word, sizeof(word));
+      int bytes = count_ >> 3;
+      pos_ += bytes;
+      count_ &= 7;
+      if constexpr (Order == bit_order::msb_first) {
+        buf_ <<= bytes * 8;
+      } else {
+        buf_ >>= bytes * 8;
+      }
+    } else {
+      drain(false);
+    }
+  }
+
+  /**
+   * Write out any partial byte, padded with zero bits.
+   *
+   * Returns the number of bytes written.
+   */
+  size_t flush() {
+    drain(true);
+    return std::min(pos_, size_);
+  }
+
+  /**
+   * Bits written so far.
+   */
+  size_t position() const { return pos_ * 8 + count_; }
+
+  /**
+   * True if bits were dropped at the end of the buffer.
+   */
+  bool overflow() const { return overflow_; }
+
+ private:
+  /**
+   * Byte at a time store near the end of the buffer.
+   */
+  void drain(bool partial) {
+    while (count_ >= 8 || (partial && count_ > 0)) {
+      uint8_t byte;
+      if constexpr (Order == bit_order::msb_first) {
+        byte = static_cast<uint8_t>(buf_ >> 56);
+        buf_ <<= 8;
+      } else {
+        byte = static_cast<uint8_t>(buf_);
+        buf_ >>= 8;
+      }
+      if (pos_ < size_) {
+        data_[pos_] = std::byte{byte};
+      } else {
+        overflow_ = true;
+      }
+      pos_++;
+      count_ = count_ > 8 ? count_ - 8 : 0;
+    }
+  }
+
+  std::byte *data_;
+  size_t size_;
+  size_t pos_{0};    // Next byte to store
+  uint64_t buf_{0};  // Pending bits at the top (msb) or bottom (lsb)
+  int count_{0};     // Pending bits in buf_
+  bool overflow_{false};
+};
+
+}  // namespace sled
@@ -5,10 +5,16 @@
  */
 #pragma once
 
+#include "sled/endian.h"
 #include "sled/numeric.h"
 #include "sled/platform.h"
+#include "sled/varint.h"
 
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
 
 namespace sled {
 
@@ -39,6 +45,211 @@ struct variable_bits {
   int w{0};
 };
 
+/**
+ * Load a T stored in big or little endian order at p.
+ */
+template <bool BigEndian, typename T>
+a_forceinline T load_endian(std::byte const *p) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  T v;
+  memcpy(&v, p, sizeof(v));
+  if constexpr (BigEndian == host_is_little_endian &&
+                (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+    v = byteswap(v);
+  }
+  return v;
+}
+
+/**
+ * Store v at p in big or little endian order.
+ */
+template <bool BigEndian, typename T>
+a_forceinline void store_endian(std::byte *p, T v) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if constexpr (BigEndian == host_is_little_endian &&
+                (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+    v = byteswap(v);
+  }
+  memcpy(p, &v, sizeof(v));
+}
+
+/**
+ * Non-owning view of a byte range with a 64-bit size.
+ *
+ * Stands in for std::span<std::byte> until the tree moves past C++17.
+ * Byte is std::byte, or std::byte const for read-only data (const_byte_span);
+ * a byte_span converts to a const_byte_span.
+ */
+template <typename Byte>
+class basic_byte_span {
+  static_assert(std::is_same_v<std::remove_const_t<Byte>, std::byte>);
+
+ public:
+  constexpr basic_byte_span() = default;
+  constexpr basic_byte_span(Byte *data, size_t size)
+      : data_(data), size_(size) {}
+  // Only for real pointers, so (p, 0) picks the size overload.
+  template <typename End, typename = std::enable_if_t<
+                              std::is_pointer_v<End> &&
+                              std::is_convertible_v<End, Byte *>>>
+  basic_byte_span(Byte *begin, End end)
+      : data_(begin), size_(static_cast<size_t>(end - begin)) {}
+  template <size_t SIZE>
+  constexpr basic_byte_span(std::array<std::byte, SIZE> &a)  // NOLINT
+      : data_(a.data()), size_(SIZE) {}
+  template <size_t SIZE, typename B = Byte,
+            typename = std::enable_if_t<std::is_const_v<B>>>
+  constexpr basic_byte_span(std::array<std::byte, SIZE> const &a)  // NOLINT
+      : data_(a.data()), size_(SIZE) {}
+  template <typename B = Byte,
+            typename = std::enable_if_t<std::is_const_v<B>>>
+  constexpr basic_byte_span(basic_byte_span<std::byte> s)  // NOLINT
+      : data_(s.data()), size_(s.size()) {}
+
+  constexpr Byte *data() const { return data_; }
+  constexpr size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+  constexpr Byte *begin() const { return data_; }
+  constexpr Byte *end() const { return data_ + size_; }
+
+  Byte &operator[](size_t i) const {
+    debug_assert(i < size_);
+    return data_[i];
+  }
+
+  /**
+   * count bytes starting at offset.
+   */
+  basic_byte_span subspan(size_t offset, size_t count) const {
+    debug_assert(offset <= size_ && count <= size_ - offset);
+    return basic_byte_span(data_ + offset, count);
+  }
+
+  /**
+   * Everything from offset to the end.
+   */
+  basic_byte_span subspan(size_t offset) const {
+    debug_assert(offset <= size_);
+    return basic_byte_span(data_ + offset, size_ - offset);
+  }
+
+  basic_byte_span first(size_t count) const { return subspan(0, count); }
+
+ private:
+  Byte *data_{nullptr};
+  size_t size_{0};
+};
+
+using byte_span = basic_byte_span<std::byte>;
+using const_byte_span = basic_byte_span<std::byte const>;
+
+/**
+ * Read-only array of T stored in a fixed byte order.
+ *
+ * Elements are converted on access; nothing is copied up front.  copy_to()
+ * converts a whole range with the bulk (pshufb) byte swap.
+ */
+template <typename T, bool BigEndian>
+class endian_view {
+  static_assert(std::is_trivially_copyable_v<T>);
+  static constexpr bool swap = BigEndian == host_is_little_endian;
+
+ public:
+  using value_type = T;
+
+  class iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = T;
+
+    iterator() = default;
+    iterator(endian_view const *view, size_t i) : view_(view), i_(i) {}
+
+    T operator*() const { return (*view_)[i_]; }
+    T operator[](difference_type n) const { return (*view_)[i_ + n]; }
+    iterator &operator++() {
+      i_++;
+      return *this;
+    }
+    iterator operator++(int) { return iterator(view_, i_++); }
+    iterator &operator--() {
+      i_--;
+      return *this;
+    }
+    iterator operator--(int) { return iterator(view_, i_--); }
+    iterator &operator+=(difference_type n) {
+      i_ += n;
+      return *this;
+    }
+    iterator &operator-=(difference_type n) {
+      i_ -= n;
+      return *this;
+    }
+    iterator operator+(difference_type n) const {
+      return iterator(view_, i_ + n);
+    }
+    friend iterator operator+(difference_type n, iterator const &it) {
+      return it + n;
+    }
+    iterator operator-(difference_type n) const {
+      return iterator(view_, i_ - n);
+    }
+    difference_type operator-(iterator const &rhs) const {
+      return static_cast<difference_type>(i_ - rhs.i_);
+    }
+    bool operator==(iterator const &rhs) const { return i_ == rhs.i_; }
+    bool operator!=(iterator const &rhs) const { return i_ != rhs.i_; }
+    bool operator<(iterator const &rhs) const { return i_ < rhs.i_; }
+    bool operator>(iterator const &rhs) const { return i_ > rhs.i_; }
+    bool operator<=(iterator const &rhs) const { return i_ <= rhs.i_; }
+    bool operator>=(iterator const &rhs) const { return i_ >= rhs.i_; }
+
+   private:
+    endian_view const *view_{nullptr};
+    size_t i_{0};
+  };
+
+  endian_view(std::byte const *data, size_t count)
+      : data_(data), count_(count) {}
+
+  size_t size() const { return count_; }
+
+  T operator[](size_t i) const {
+    T v;
+    memcpy(&v, data_ + i * sizeof(T), sizeof(T));
+    if constexpr (swap) {
+      v = byteswap(v);
+    }
+    return v;
+  }
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, count_); }
+
+  /**
+   * Convert count elements starting at first into dst.
+   */
+  void copy_to(T *dst, size_t first, size_t count) const {
+    debug_assert(first + count <= count_);
+    endian_copy_array<swap, T>(dst, data_ + first * sizeof(T), count);
+  }
+
+  void copy_to(T *dst) const { copy_to(dst, 0, count_); }
+
+ private:
+  std::byte const *data_;
+  size_t count_;
+};
+
+template <typename T>
+using be_view = endian_view<T, true>;
+
+template <typename T>
+using le_view = endian_view<T, false>;
+
 /**
  * Byte stream interface
  */
@@ -49,6 +260,10 @@ class bytestream {
 
   int size() { return static_cast<int>(end_ - begin_); }
 
+  std::byte *data() { return begin_; }
+
+  byte_span span() { return byte_span(begin_, end_); }
+
   void write(int offset, std::byte value) {
     assert(end_ - begin_ > offset);
     memcpy(begin_ + offset, &value, sizeof(value));
@@ -76,17 +291,17 @@ class bytestream {
   void le_pwrite(T v, int offset) {
     if constexpr (sizeof(T) == 2) {
       uint16_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htole16(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 4) {
       uint32_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htole32(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 8) {
       uint64_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htole64(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else {
@@ -99,17 +314,17 @@ class bytestream {
   void be_pwrite(T v, int offset) {
     if constexpr (sizeof(T) == 2) {
       uint16_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe16(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 4) {
       uint32_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe32(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 8) {
       uint64_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe64(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else {
@@ -183,17 +398,17 @@ class bytestream {
   void be_write(T v, int offset) {
     if constexpr (sizeof(T) == 2) {
       uint16_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe16(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 4) {
       uint32_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe32(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else if constexpr (sizeof(T) == 8) {
       uint64_t t;
-      mempcy(&t, &v, sizeof(t));
+      memcpy(&t, &v, sizeof(t));
       t = htobe64(t);
       memcpy(begin_ + offset, &t, sizeof(t));
     } else {
@@ -201,6 +416,54 @@ class bytestream {
     }
   }
 
+  /**
+   * Read count big endian values at offset.
+   */
+  template <typename T>
+  void be_pread(T *values, size_t count, int offset) {
+    be_to_host_array(values, begin_ + offset, count);
+  }
+
+  /**
+   * Read count little endian values at offset.
+   */
+  template <typename T>
+  void le_pread(T *values, size_t count, int offset) {
+    le_to_host_array(values, begin_ + offset, count);
+  }
+
+  /**
+   * Write count values in big endian order at offset.
+   */
+  template <typename T>
+  void be_pwrite(T const *values, size_t count, int offset) {
+    host_to_be_array(begin_ + offset, values, count);
+  }
+
+  /**
+   * Write count values in little endian order at offset.
+   */
+  template <typename T>
+  void le_pwrite(T const *values, size_t count, int offset) {
+    host_to_le_array(begin_ + offset, values, count);
+  }
+
+  /**
+   * View count big endian values at offset.
+   */
+  template <typename T>
+  sled::be_view<T> be_array(size_t count, int offset) {
+    return sled::be_view<T>(begin_ + offset, count);
+  }
+
+  /**
+   * View count little endian values at offset.
+   */
+  template <typename T>
+  sled::le_view<T> le_array(size_t count, int offset) {
+    return sled::le_view<T>(begin_ + offset, count);
+  }
+
   /**
    * Return a fixed number of bits at the specifid bit offset.
    *
@@ -287,8 +550,247 @@ class bytestream {
   bool overflow_{false};
 };
 
+/**
+ * Sequential reader/writer over a byte_span with 64-bit positions.
+ *
+ * The *_unchecked() accessors skip all bounds checks; a successful
+ * reserve(n) makes the next n bytes safe to access that way, so a record
+ * costs one compare however many fields it holds:
+ *
+ * \code{.cpp}
+ * byte_cursor c(bs.span());
+ * while (c.reserve(6)) {
+ *   auto tag = c.be_read_unchecked<uint16_t>();
+ *   auto len = c.be_read_unchecked<uint32_t>();
+ *   ...
+ * }
+ * \endcode{}
+ *
+ * The checked accessors reserve() for themselves.  Failed reserves leave
+ * the position alone and set overflow(); failed reads return zero.
+ *
+ * const_byte_cursor reads read-only data; its write accessors don't compile.
+ */
+template <typename Byte>
+class basic_byte_cursor {
+  static constexpr bool writable = !std::is_const_v<Byte>;
+
+ public:
+  using span_type = basic_byte_span<Byte>;
+
+  basic_byte_cursor() = default;
+  explicit basic_byte_cursor(span_type span)
+      : data_(span.data()), size_(span.size()) {}
+  basic_byte_cursor(Byte *begin, Byte *end)
+      : basic_byte_cursor(span_type(begin, end)) {}
+
+  size_t size() const { return size_; }
+  size_t position() const { return pos_; }
+  size_t remaining() const { return size_ - pos_; }
+  span_type span() const { return span_type(data_, size_); }
+
+  /**
+   * True if a reserve() or checked access ran off the end.
+   */
+  bool overflow() const { return overflow_; }
+
+  /**
+   * Check that num_bytes bytes remain.
+   */
+  a_forceinline bool reserve(size_t num_bytes) {
+    if (likely(num_bytes <= size_ - pos_)) {
+      return true;
+    }
+    overflow_ = true;
+    return false;
+  }
+
+  /**
+   * Move to an absolute position (at most size()).
+   */
+  bool seek(size_t pos) {
+    if (unlikely(pos > size_)) {
+      overflow_ = true;
+      return false;
+    }
+    pos_ = pos;
+    return true;
+  }
+
+  template <typename T>
+  a_forceinline T be_read_unchecked() {
+    return read_unchecked<true, T>();
+  }
+
+  template <typename T>
+  a_forceinline T le_read_unchecked() {
+    return read_unchecked<false, T>();
+  }
+
+  template <typename T>
+  a_forceinline void be_write_unchecked(T v) {
+    static_assert(writable, "write to a const_byte_cursor");
+    write_unchecked<true, T>(v);
+  }
+
+  template <typename T>
+  a_forceinline void le_write_unchecked(T v) {
+    static_assert(writable, "write to a const_byte_cursor");
+    write_unchecked<false, T>(v);
+  }
+
+  a_forceinline void read_unchecked(void *dst, size_t num_bytes) {
+    debug_assert(num_bytes <= size_ - pos_);
+    memcpy(dst, data_ + pos_, num_bytes);
+    pos_ += num_bytes;
+  }
+
+  a_forceinline void write_unchecked(void const *src, size_t num_bytes) {
+    static_assert(writable, "write to a const_byte_cursor");
+    debug_assert(num_bytes <= size_ - pos_);
+    memcpy(data_ + pos_, src, num_bytes);
+    pos_ += num_bytes;
+  }
+
+  a_forceinline void skip_unchecked(size_t num_bytes) {
+    debug_assert(num_bytes <= size_ - pos_);
+    pos_ += num_bytes;
+  }
+
+  template <typename T>
+  T be_read() {
+    return reserve(sizeof(T)) ? be_read_unchecked<T>() : T{};
+  }
+
+  template <typename T>
+  T le_read() {
+    return reserve(sizeof(T)) ? le_read_unchecked<T>() : T{};
+  }
+
+  template <typename T>
+  bool be_write(T v) {
+    if (!reserve(sizeof(T))) {
+      return false;
+    }
+    be_write_unchecked(v);
+    return true;
+  }
+
+  template <typename T>
+  bool le_write(T v) {
+    if (!reserve(sizeof(T))) {
+      return false;
+    }
+    le_write_unchecked(v);
+    return true;
+  }
+
+  bool read(void *dst, size_t num_bytes) {
+    if (!reserve(num_bytes)) {
+      return false;
+    }
+    read_unchecked(dst, num_bytes);
+    return true;
+  }
+
+  bool write(void const *src, size_t num_bytes) {
+    if (!reserve(num_bytes)) {
+      return false;
+    }
+    write_unchecked(src, num_bytes);
+    return true;
+  }
+
+  bool skip(size_t num_bytes) {
+    if (!reserve(num_bytes)) {
+      return false;
+    }
+    skip_unchecked(num_bytes);
+    return true;
+  }
+
+  /**
+   * Append v LEB128 encoded.
+   */
+  bool write_varint(uint64_t v) {
+    static_assert(writable, "write to a const_byte_cursor");
+    if (likely(size_ - pos_ >= varint_max_size)) {
+      pos_ += varint_encode(reinterpret_cast<uint8_t *>(data_ + pos_), v);
+      return true;
+    }
+    uint8_t buf[varint_max_size];
+    return write(buf, varint_encode(buf, v));
+  }
+
+  /**
+   * Append v zig-zag and LEB128 encoded.
+   */
+  bool write_svarint(int64_t v) { return write_varint(zigzag_encode(v)); }
+
+  /**
+   * Read a LEB128 value, truncated or malformed input sets overflow().
+   */
+  uint64_t read_varint() {
+    uint64_t v = 0;
+    size_t n = varint_decode(
+        v, reinterpret_cast<uint8_t const *>(data_ + pos_), size_ - pos_);
+    if (unlikely(n == 0)) {
+      overflow_ = true;
+      return 0;
+    }
+    pos_ += n;
+    return v;
+  }
+
+  int64_t read_svarint() { return zigzag_decode(read_varint()); }
+
+  /**
+   * Batch decode up to count 32-bit LEB128 values.
+   *
+   * Returns the number decoded; fewer than count sets overflow().
+   */
+  size_t read_varints(uint32_t *dst, size_t count) {
+    auto r = varint_decode_array(
+        dst, count, reinterpret_cast<uint8_t const *>(data_ + pos_),
+        size_ - pos_);
+    pos_ += r.consumed;
+    if (r.count < count) {
+      overflow_ = true;
+    }
+    return r.count;
+  }
+
+ private:
+  template <bool BigEndian, typename T>
+  a_forceinline T read_unchecked() {
+    debug_assert(sizeof(T) <= size_ - pos_);
+    T v = load_endian<BigEndian, T>(data_ + pos_);
+    pos_ += sizeof(T);
+    return v;
+  }
+
+  template <bool BigEndian, typename T>
+  a_forceinline void write_unchecked(T v) {
+    debug_assert(sizeof(T) <= size_ - pos_);
+    store_endian<BigEndian, T>(data_ + pos_, v);
+    pos_ += sizeof(T);
+  }
+
+  Byte *data_{nullptr};
+  size_t size_{0};
+  size_t pos_{0};
+  bool overflow_{false};
+};
+
+using byte_cursor = basic_byte_cursor<std::byte>;
+using const_byte_cursor = basic_byte_cursor<std::byte const>;
+
 /**
  * Fixed length bytestream interface
+ *
+ * The overloads taking the offset as a template argument are bounds
+ * checked at compile time and address the buffer directly, so a run of
+ * them compiles to straight-line loads and stores.
  */
 template <size_t SIZE>
 class fixed_bytestream {
@@ -298,6 +800,8 @@ class fixed_bytestream {
 
   bytestream &bs() { return bs_; }
 
+  byte_span span() { return byte_span(data_); }
+
   int size() { return bs_.size(); }
 
   void write(int offset, std::byte value) { bs_.write(offset, value); }
@@ -305,7 +809,7 @@ class fixed_bytestream {
   template <int offset>
   void write(std::byte value) {
     static_assert(offset + sizeof(std::byte) <= SIZE);
-    bs_.write(offset, value);
+    data_[offset] = value;
   }
 
   void pwrite(std::byte *value, int length, int offset) {
@@ -314,16 +818,23 @@ class fixed_bytestream {
 
   template <int offset>
   void pwrite(std::byte *value, int length) {
-    static_assert(offset + length <= SIZE);
+    static_assert(offset <= SIZE);
+    debug_assert(offset + length <= SIZE);
     bs_.pwrite(value, length, offset);
   }
 
+  template <int offset, int length>
+  void pwrite(std::byte const *value) {
+    static_assert(offset + length <= SIZE);
+    memcpy(data_.data() + offset, value, length);
+  }
+
   std::byte read(int offset) { return bs_.read(offset); }
 
   template <int offset>
   std::byte read() {
     static_assert(offset + sizeof(std::byte) <= SIZE);
-    return bs_.read(offset);
+    return data_[offset];
   }
 
   void pread(std::byte *value, int length, int offset) {
@@ -332,9 +843,17 @@ class fixed_bytestream {
 
   template <int offset>
   void pread(std::byte *value, int length) {
+    static_assert(offset <= SIZE);
+    debug_assert(offset + length <= SIZE);
     bs_.pread(value, length, offset);
   }
 
+  template <int offset, int length>
+  void pread(std::byte *value) {
+    static_assert(offset + length <= SIZE);
+    memcpy(value, data_.data() + offset, length);
+  }
+
   template <typename T,
             class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
   void le_pwrite(T value, int offset) {
@@ -367,28 +886,64 @@ class fixed_bytestream {
             class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
   void le_pwrite(T value) {
     static_assert(offset + sizeof(T) <= SIZE);
-    bs_.le_pwrite<T>(value, offset);
+    store_endian<false, T>(data_.data() + offset, value);
   }
 
   template <int offset, typename T,
             class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
   void be_pwrite(T value) {
     static_assert(offset + sizeof(T) <= SIZE);
-    bs_.be_pwrite<offset, T>(value, offset);
+    store_endian<true, T>(data_.data() + offset, value);
   }
 
   template <int offset, typename T,
             class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
   T be_pread() {
     static_assert(offset + sizeof(T) <= SIZE);
-    return bs_.be_pread<T>(offset);
+    return load_endian<true, T>(data_.data() + offset);
   }
 
   template <int offset, typename T,
             class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
   T le_pread() {
     static_assert(offset + sizeof(T) <= SIZE);
-    return bs_.le_pread<T>(offset);
+    return load_endian<false, T>(data_.data() + offset);
+  }
+
+  /**
+   * Big endian unsigned value of num_bytes (1 to 8) bytes at offset.
+   *
+   * Uses a single 8 byte load when the buffer extends far enough.
+   */
+  template <int offset, int num_bytes>
+  uint64_t be_pread() {
+    static_assert(num_bytes > 0 && num_bytes <= 8);
+    static_assert(offset + num_bytes <= SIZE);
+    if constexpr (offset + 8 <= SIZE) {
+      auto v = load_endian<true, uint64_t>(data_.data() + offset);
+      return v >> (64 - num_bytes * 8);
+    } else {
+      std::array<std::byte, 8> buf{};
+      memcpy(buf.data() + 8 - num_bytes, data_.data() + offset, num_bytes);
+      return load_endian<true, uint64_t>(buf.data());
+    }
+  }
+
+  /**
+   * WIDTH bits at bit offset, see bytestream::be_bits_pread().
+   */
+  template <int offset, int WIDTH>
+  fixed_bits<WIDTH> be_bits_pread() {
+    constexpr int shift = offset % 8;
+    constexpr int num_bytes = (shift + WIDTH + 7) / 8;
+    static_assert(WIDTH > 0 && num_bytes <= 8,
+                  "field must fit in 8 bytes");
+    auto v = be_pread<offset / 8, num_bytes>();
+    v >>= num_bytes * 8 - shift - WIDTH;
+    if constexpr (WIDTH < 64) {
+      v &= (uint64_t{1} << WIDTH) - 1;
+    }
+    return fixed_bits<WIDTH>(v);
   }
 
   std::array<std::byte, SIZE> &buf() { return data_; };
@@ -136,6 +136,8 @@ struct option_inst {
       inst.value_ = tok.opt.value();
     } else if constexpr (std::is_integral<opt_type>()) {
       inst.value_ = std::stoi(tok.opt.value());
+    } else if constexpr (std::is_floating_point<opt_type>()) {
+      inst.value_ = std::stod(tok.opt.value());
     } else if constexpr (std::is_same<opt_type, bool>()) {
       auto tmp = sled::str_tolower_copy(tok.opt.value());
       if (tmp == "true" || tmp == "y" || tmp == "yes") {
@@ -33,6 +33,7 @@ class CoTask : public task_type_t<Fn> {
     // Ran in the context of CoThreadTask, potentially entered multiple times.
     debug_assert(this == executor_t::cur_task());
     debug_assert(this->flags_.is_set(TaskFlag::Queued));
+    sled::log::task_scope scope(sled::log::task_id_t{this->id().id});
     // Resume/start our fiber if we're not finished.
     // Due to races, it's possible the task will be queued while running.
     // If the task exits, it will run one more time.
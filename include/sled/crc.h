@@ -5,10 +5,15 @@
  */
 #pragma once
 
+#include "sled/arch.h"
 #include "sled/platform.h"
 #include "sled/strong_int.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <deque>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -18,27 +23,38 @@ struct crc32c : public StrongInt<uint32_t, crc32c> {
   using StrongInt<uint32_t, crc32c>::StrongInt;
 };
 
+/**
+ * Update @a crc with @a len bytes using the Arch specific algorithm.
+ *
+ * hwarch issues crc32 instructions serially.  pclmul_hwarch runs three
+ * independent streams to hide the latency of the crc32 instruction and
+ * merges them with carry-less multiplies.
+ */
+template <typename Arch>
+crc32c crc32c_update(crc32c crc, uint8_t const *data, size_t len);
+
+template <>
+crc32c crc32c_update<hwarch>(crc32c crc, uint8_t const *data, size_t len);
+
+template <>
+crc32c crc32c_update<pclmul_hwarch>(crc32c crc, uint8_t const *data,
+                                    size_t len);
+
+/**
+ * Update @a crc with @a len bytes using the fastest available algorithm.
+ */
+crc32c crc32c_update(crc32c crc, uint8_t const *data, size_t len);
+
 /**
  * Compute the CRC32C value for the vector
  */
 template <typename T, class = typename std::enable_if_t<std::is_integral_v<T>>>
 static inline crc32c calculate_crc32c(std::vector<T> const &data,
                                       crc32c initial = crc32c{0}) {
-  auto crc{initial.get()};
-  for (auto &b : data) {
-    if constexpr (sizeof(T) == 1) {
-      crc = _mm_crc32_u8(crc, static_cast<uint8_t>(b));
-    } else if constexpr (sizeof(T) == 2) {
-      crc = _mm_crc32_u16(crc, static_cast<uint16_t>(b));
-    } else if constexpr (sizeof(T) == 4) {
-      crc = _mm_crc32_u32(crc, static_cast<uint32_t>(b));
-    } else if constexpr (sizeof(T) == 8) {
-      crc = static_cast<int32_t>(_mm_crc32_u64(crc, static_cast<uint64_t>(b)));
-    } else {
-      throw std::invalid_argument("unsupported underlying type");
-    }
-  }
-  return crc32c{crc};
+  // crc32 consumes wider operands least significant byte first, which is
+  // the in-memory order on x86.
+  return crc32c_update(initial, reinterpret_cast<uint8_t const *>(data.data()),
+                       data.size() * sizeof(T));
 }
 
 /**
@@ -48,42 +64,13 @@ template <typename T, size_t SIZE,
           class = typename std::enable_if_t<std::is_integral<T>::value>>
 static inline crc32c calculate_crc32c(std::array<T, SIZE> const &data,
                                       crc32c initial = crc32c{0}) {
-  auto crc{initial.get()};
-  for (auto &b : data) {
-    if constexpr (sizeof(T) == 1) {
-      crc = _mm_crc32_u8(crc, static_cast<uint8_t>(b));
-    } else if constexpr (sizeof(T) == 2) {
-      crc = _mm_crc32_u16(crc, static_cast<uint16_t>(b));
-    } else if constexpr (sizeof(T) == 4) {
-      crc = _mm_crc32_u32(crc, static_cast<uint32_t>(b));
-    } else if constexpr (sizeof(T) == 8) {
-      crc = static_cast<int32_t>(_mm_crc32_u64(crc, static_cast<uint64_t>(b)));
-    } else {
-      throw std::invalid_argument("unsupported underlying type");
-    }
-  }
-  return crc32c{crc};
+  return crc32c_update(initial, reinterpret_cast<uint8_t const *>(data.data()),
+                       data.size() * sizeof(T));
 }
 
 static inline crc32c calculate_crc32c(uint8_t const *begin, uint8_t const *end,
                                       crc32c initial = crc32c{0}) {
-  // XXX: _u8 is int (int, char), _u64 is int64_t (int64_t, int64_t) making
-  // conversions strange.
-  auto crc{initial.get()};
-  while ((reinterpret_cast<intptr_t>(begin) % 8) && begin < end) {
-    crc = _mm_crc32_u8(crc, *begin);
-    begin++;
-  }
-  while (begin < end - 8) {
-    crc = static_cast<int32_t>(
-        _mm_crc32_u64(crc, *reinterpret_cast<const uint64_t *>(begin)));
-    begin += 8;
-  }
-  while (begin < end) {
-    crc = _mm_crc32_u8(crc, *begin);
-    begin++;
-  }
-  return crc32c{crc};
+  return crc32c_update(initial, begin, static_cast<size_t>(end - begin));
 }
 
 template<typename T>
@@ -94,11 +81,392 @@ static inline crc32c calculate_crc32c(T const *cbegin, T const *cend,
   return calculate_crc32c(begin, end, initial);
 }
 
-static inline crc32c calculate_crc32c(std::string val,
+static inline crc32c calculate_crc32c(std::string_view val,
                                       crc32c initial = crc32c{0}) {
-  auto begin = reinterpret_cast<const uint8_t *>(&val.front());
-  auto end = reinterpret_cast<const uint8_t *>(&val.back() + 1);
-  return calculate_crc32c(begin, end, initial);
+  return crc32c_update(initial, reinterpret_cast<uint8_t const *>(val.data()),
+                       val.size());
+}
+
+/**
+ * Combine the crcs of two adjacent buffers.
+ *
+ * @a crc_b must have been computed with a zero initial value.  The result
+ * is the crc of both buffers, as if computed in one pass starting from the
+ * initial value of @a crc_a.
+ */
+crc32c crc32c_combine(crc32c crc_a, crc32c crc_b, uint64_t len_b);
+
+/**
+ * Incremental CRC32C.
+ *
+ * crc32c_stream crc;
+ * while (auto n = read(fd, buf, sizeof(buf))) {
+ *   crc.update(buf, n);
+ * }
+ * auto result = crc.finalize();
+ */
+class crc32c_stream {
+ public:
+  explicit crc32c_stream(crc32c initial = crc32c{0}) : crc_(initial) {}
+
+  void update(uint8_t const *data, size_t len) {
+    crc_ = crc32c_update(crc_, data, len);
+    size_ += len;
+  }
+
+  template <typename T>
+  void update(T const *begin, T const *end) {
+    update(reinterpret_cast<uint8_t const *>(begin),
+           static_cast<size_t>(end - begin) * sizeof(T));
+  }
+
+  void update(std::string_view val) {
+    update(reinterpret_cast<uint8_t const *>(val.data()), val.size());
+  }
+
+  /**
+   * CRC of everything passed to update().
+   */
+  crc32c finalize() const { return crc_; }
+
+  /**
+   * Bytes passed to update().
+   */
+  uint64_t size() const { return size_; }
+
+  void reset(crc32c initial = crc32c{0}) {
+    crc_ = initial;
+    size_ = 0;
+  }
+
+ private:
+  crc32c crc_;
+  uint64_t size_{0};
+};
+
+/**
+ * Compute the CRC32C of a large buffer using tasks on @a exec.
+ *
+ * The buffer, e.g. a memory mapped disk image, is split into chunk_size
+ * pieces that are checksummed concurrently and merged with crc32c_combine.
+ * The calling thread must be adopted by @a exec and other threads must be
+ * running it.
+ */
+template <typename Exec>
+crc32c calculate_crc32c_parallel(Exec &exec, uint8_t const *data, size_t len,
+                                 crc32c initial = crc32c{0},
+                                 size_t chunk_size = 64 * 1024 * 1024) {
+  auto part = [](uint8_t const *p, size_t n) {
+    return [p, n]() { return crc32c_update(crc32c{0}, p, n); };
+  };
+  using task_t = typename Exec::template task_t<decltype(part(nullptr, 0))>;
+  // Tasks must not move once queued.
+  std::deque<task_t> tasks;
+  std::vector<typename task_t::future_t *> futures;
+  chunk_size = std::max<size_t>(chunk_size, 1);
+  for (size_t offset = 0; offset < len; offset += chunk_size) {
+    auto n = std::min(chunk_size, len - offset);
+    tasks.emplace_back(&exec, part(data + offset, n));
+    futures.push_back(tasks.back().queue_start());
+  }
+  auto crc = initial;
+  for (size_t i = 0; i < futures.size(); i++) {
+    auto n = std::min(chunk_size, len - i * chunk_size);
+    crc = crc32c_combine(crc, futures[i]->wait(), n);
+  }
+  return crc;
 }
 
+/**
+ * Table driven CRC described by the Rocksoft model parameters.
+ *
+ * Poly is the generator polynomial without the x^Width term.  Reflect
+ * processes each byte least significant bit first (RefIn and RefOut), Init
+ * is the initial register and XorOut is applied to the result.  Lookup
+ * tables are generated at compile time.
+ *
+ * Device models can feed one byte at a time with update(uint8_t); buffers
+ * are consumed 16 or 8 bytes per step (slicing-by-16/8).  Reflected CRCs
+ * fold large buffers with carry-less multiplies on pclmul_hwarch.
+ *
+ * crc16_ccitt crc;
+ * crc.update(0xa1);
+ * crc.update(sector.data(), sector.size());
+ * auto value = crc.value();
+ */
+template <unsigned Width, uint64_t Poly, bool Reflect, uint64_t Init,
+          uint64_t XorOut>
+class basic_crc {
+  static_assert(Width > 0 && Width <= 64, "unsupported CRC width");
+
+  /** Register type, non-reflected CRCs are kept in the top bits. */
+  using reg_t = std::conditional_t<(Width <= 32), uint32_t, uint64_t>;
+  static constexpr unsigned reg_bits = sizeof(reg_t) * 8;
+  static constexpr unsigned shift = Reflect ? 0 : reg_bits - Width;
+
+ public:
+  using value_type = std::conditional_t<
+      (Width <= 8), uint8_t,
+      std::conditional_t<(Width <= 16), uint16_t,
+                         std::conditional_t<(Width <= 32), uint32_t,
+                                            uint64_t>>>;
+
+  constexpr basic_crc() = default;
+
+  /**
+   * Update with a single byte.
+   */
+  constexpr void update(uint8_t byte) {
+    if constexpr (Reflect) {
+      reg_ = tables[0][(reg_ ^ byte) & 0xff] ^ (reg_ >> 8);
+    } else {
+      reg_ = tables[0][((reg_ >> (reg_bits - 8)) ^ byte) & 0xff] ^
+             static_cast<reg_t>(reg_ << 8);
+    }
+  }
+
+  /**
+   * Update with a buffer.
+   */
+  void update(uint8_t const *data, size_t len) {
+    if constexpr (Reflect) {
+      static bool const pclmul = pclmul_hwarch::available();
+      if (pclmul && len >= 128) {
+        reg_ = fold(reg_, data, len);
+      }
+    }
+    while (len >= 16) {
+      reg_ = slice16(reg_, data);
+      data += 16;
+      len -= 16;
+    }
+    if (len >= 8) {
+      reg_ = slice8(reg_, data);
+      data += 8;
+      len -= 8;
+    }
+    while (len > 0) {
+      update(*data++);
+      len--;
+    }
+  }
+
+  void update(std::string_view val) {
+    update(reinterpret_cast<uint8_t const *>(val.data()), val.size());
+  }
+
+  /**
+   * The CRC of the bytes seen so far, with XorOut applied.
+   */
+  constexpr value_type value() const {
+    return static_cast<value_type>(((reg_ >> shift) ^ XorOut) & mask);
+  }
+
+  constexpr void reset() { reg_ = init_reg; }
+
+  /**
+   * Compute the CRC of a buffer.
+   */
+  static value_type compute(uint8_t const *data, size_t len) {
+    basic_crc crc;
+    crc.update(data, len);
+    return crc.value();
+  }
+
+  /**
+   * Compute the CRC of a string, usable in constant expressions.
+   */
+  static constexpr value_type checksum(std::string_view val) {
+    basic_crc crc;
+    for (auto c : val) {
+      crc.update(static_cast<uint8_t>(c));
+    }
+    return crc.value();
+  }
+
+ private:
+  static constexpr uint64_t mask =
+      Width == 64 ? ~uint64_t{0} : (uint64_t{1} << Width) - 1;
+
+  static constexpr uint64_t reflect(uint64_t v, unsigned bits) {
+    uint64_t r = 0;
+    for (unsigned i = 0; i < bits; i++) {
+      r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+  }
+
+  static constexpr reg_t poly_reg = static_cast<reg_t>(
+      Reflect ? reflect(Poly, Width) : (Poly & mask) << shift);
+  static constexpr reg_t init_reg = static_cast<reg_t>(
+      Reflect ? reflect(Init, Width) : (Init & mask) << shift);
+
+  static constexpr auto make_tables() {
+    std::array<std::array<reg_t, 256>, 16> t{};
+    for (unsigned i = 0; i < 256; i++) {
+      reg_t crc = 0;
+      if constexpr (Reflect) {
+        crc = static_cast<reg_t>(i);
+        for (int k = 0; k < 8; k++) {
+          crc = (crc & 1) != 0 ? (crc >> 1) ^ poly_reg : crc >> 1;
+        }
+      } else {
+        crc = static_cast<reg_t>(static_cast<reg_t>(i) << (reg_bits - 8));
+        for (int k = 0; k < 8; k++) {
+          bool top = (crc >> (reg_bits - 1)) != 0;
+          crc = static_cast<reg_t>(crc << 1);
+          crc = top ? crc ^ poly_reg : crc;
+        }
+      }
+      t[0][i] = crc;
+    }
+    // t[s][i] is the register after byte i followed by s zero bytes.
+    for (unsigned s = 1; s < 16; s++) {
+      for (unsigned i = 0; i < 256; i++) {
+        reg_t prev = t[s - 1][i];
+        if constexpr (Reflect) {
+          t[s][i] = (prev >> 8) ^ t[0][prev & 0xff];
+        } else {
+          t[s][i] = static_cast<reg_t>(prev << 8) ^
+                    t[0][prev >> (reg_bits - 8)];
+        }
+      }
+    }
+    return t;
+  }
+
+  static constexpr auto tables = make_tables();
+
+  static a_forceinline uint64_t load64(uint8_t const *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return Reflect ? v : __builtin_bswap64(v);
+  }
+
+  /**
+   * Look up the 8 bytes of @a x using tables [first - 7, first].
+   */
+  static a_forceinline reg_t lookup8(uint64_t x, unsigned first) {
+    if constexpr (Reflect) {
+      return tables[first][x & 0xff] ^ tables[first - 1][(x >> 8) & 0xff] ^
+             tables[first - 2][(x >> 16) & 0xff] ^
+             tables[first - 3][(x >> 24) & 0xff] ^
+             tables[first - 4][(x >> 32) & 0xff] ^
+             tables[first - 5][(x >> 40) & 0xff] ^
+             tables[first - 6][(x >> 48) & 0xff] ^
+             tables[first - 7][x >> 56];
+    } else {
+      return tables[first][x >> 56] ^ tables[first - 1][(x >> 48) & 0xff] ^
+             tables[first - 2][(x >> 40) & 0xff] ^
+             tables[first - 3][(x >> 32) & 0xff] ^
+             tables[first - 4][(x >> 24) & 0xff] ^
+             tables[first - 5][(x >> 16) & 0xff] ^
+             tables[first - 6][(x >> 8) & 0xff] ^ tables[first - 7][x & 0xff];
+    }
+  }
+
+  static a_forceinline uint64_t reg_word(reg_t reg) {
+    return Reflect ? uint64_t{reg} : uint64_t{reg} << (64 - reg_bits);
+  }
+
+  static a_forceinline reg_t slice8(reg_t reg, uint8_t const *p) {
+    return lookup8(load64(p) ^ reg_word(reg), 7);
+  }
+
+  static a_forceinline reg_t slice16(reg_t reg, uint8_t const *p) {
+    return lookup8(load64(p) ^ reg_word(reg), 15) ^ lookup8(load64(p + 8), 7);
+  }
+
+  /**
+   * x^n modulo the polynomial, reflected and aligned for pclmulqdq.
+   */
+  static constexpr uint64_t fold_constant(unsigned n) {
+    uint64_t v = uint64_t{1} << (Width - 1);  // x^0
+    uint64_t rpoly = reflect(Poly, Width);
+    for (unsigned i = 0; i < n; i++) {
+      v = (v & 1) != 0 ? (v >> 1) ^ rpoly : v >> 1;
+    }
+    return v << (64 - Width);
+  }
+
+  // Folding constants, forced to compile time.
+  static constexpr uint64_t k127 = fold_constant(127);
+  static constexpr uint64_t k191 = fold_constant(191);
+  static constexpr uint64_t k511 = fold_constant(511);
+  static constexpr uint64_t k575 = fold_constant(575);
+
+  /**
+   * Fold 128-bit lanes forward by @a k (x^(d + 63), x^(d - 1)).
+   *
+   * A lane holds H * x^64 + L, moving it d bits forward multiplies H by
+   * x^(d + 64) and L by x^d.  pclmulqdq of reflected operands gains one
+   * extra factor of x, which the constants absorb.
+   */
+  __attribute__((target("sse4.1,pclmul"))) static a_forceinline __m128i
+  fold_lane(__m128i x, __m128i k) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                         _mm_clmulepi64_si128(x, k, 0x11));
+  }
+
+  /**
+   * Fold whole 16 byte blocks into one lane, then reduce it with the
+   * tables.  Requires len >= 64.
+   */
+  __attribute__((target("sse4.1,pclmul"))) static reg_t fold(
+      reg_t reg, uint8_t const *&data, size_t &len) {
+    auto const k512 = _mm_set_epi64x(static_cast<int64_t>(k511),
+                                     static_cast<int64_t>(k575));
+    auto const k128 = _mm_set_epi64x(static_cast<int64_t>(k127),
+                                     static_cast<int64_t>(k191));
+    auto load = [](uint8_t const *p) {
+      return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+    };
+    auto x0 = _mm_xor_si128(load(data),
+                            _mm_cvtsi64_si128(static_cast<int64_t>(reg)));
+    auto x1 = load(data + 16);
+    auto x2 = load(data + 32);
+    auto x3 = load(data + 48);
+    data += 64;
+    len -= 64;
+    while (len >= 64) {
+      x0 = _mm_xor_si128(fold_lane(x0, k512), load(data));
+      x1 = _mm_xor_si128(fold_lane(x1, k512), load(data + 16));
+      x2 = _mm_xor_si128(fold_lane(x2, k512), load(data + 32));
+      x3 = _mm_xor_si128(fold_lane(x3, k512), load(data + 48));
+      data += 64;
+      len -= 64;
+    }
+    auto x = _mm_xor_si128(fold_lane(x0, k128), x1);
+    x = _mm_xor_si128(fold_lane(x, k128), x2);
+    x = _mm_xor_si128(fold_lane(x, k128), x3);
+    while (len >= 16) {
+      x = _mm_xor_si128(fold_lane(x, k128), load(data));
+      data += 16;
+      len -= 16;
+    }
+    // The lane is now a 16 byte message equivalent to everything folded.
+    alignas(16) uint8_t lane[16];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lane), x);
+    return slice16(0, lane);
+  }
+
+  reg_t reg_{init_reg};
+};
+
+/** CRC-16/IBM-3740 (CCITT-FALSE), floppy disk controllers. */
+using crc16_ccitt = basic_crc<16, 0x1021, false, 0xffff, 0>;
+
+/** CRC-16/XMODEM, SD card data blocks. */
+using crc16_xmodem = basic_crc<16, 0x1021, false, 0, 0>;
+
+/** CRC-32/ISO-HDLC, Ethernet and zip. */
+using crc32_ieee = basic_crc<32, 0x04c11db7, true, 0xffffffff, 0xffffffff>;
+
+/** CRC-7/MMC, SD card commands. */
+using crc7_mmc = basic_crc<7, 0x09, false, 0, 0>;
+
+/** CRC-64/XZ */
+using crc64_xz = basic_crc<64, 0x42f0e1eba9ea3693, true, ~uint64_t{0},
+                           ~uint64_t{0}>;
+
 };  // namespace sled
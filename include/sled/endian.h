@@ -38,3 +38,111 @@ uint64_t le64toh(uint64_t little_endian_64bits) {
 #else
 #include <endian.h>
 #endif
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "sled/arch.h"
+
+namespace sled {
+
+/**
+ * Reverse the bytes of a 1, 2, 4 or 8 byte value.
+ */
+template <typename T,
+          class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+a_forceinline T byteswap(T v) {
+  static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                sizeof(T) == 8);
+  if constexpr (sizeof(T) == 2) {
+    uint16_t t;
+    memcpy(&t, &v, sizeof(t));
+    t = __builtin_bswap16(t);
+    memcpy(&v, &t, sizeof(t));
+  } else if constexpr (sizeof(T) == 4) {
+    uint32_t t;
+    memcpy(&t, &v, sizeof(t));
+    t = __builtin_bswap32(t);
+    memcpy(&v, &t, sizeof(t));
+  } else if constexpr (sizeof(T) == 8) {
+    uint64_t t;
+    memcpy(&t, &v, sizeof(t));
+    t = __builtin_bswap64(t);
+    memcpy(&v, &t, sizeof(t));
+  }
+  return v;
+}
+
+/**
+ * Byte swap count values of width (2, 4 or 8) bytes from src to dst.
+ *
+ * dst and src may be the same buffer but must not otherwise overlap.  The
+ * vector versions swap 16 or 32 bytes per pshufb.
+ */
+template <typename Arch>
+void byteswap_array(void *dst, void const *src, size_t count, size_t width);
+
+template <>
+void byteswap_array<hwarch>(void *dst, void const *src, size_t count,
+                            size_t width);
+
+template <>
+void byteswap_array<ssse3_hwarch>(void *dst, void const *src, size_t count,
+                                  size_t width);
+
+template <>
+void byteswap_array<avx2_hwarch>(void *dst, void const *src, size_t count,
+                                 size_t width);
+
+void byteswap_array(void *dst, void const *src, size_t count, size_t width);
+
+/**
+ * Copy count values, swapping if the host order differs.
+ */
+template <bool Swap, typename T>
+void endian_copy_array(void *dst, void const *src, size_t count) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if constexpr (Swap && sizeof(T) > 1) {
+    byteswap_array(dst, src, count, sizeof(T));
+  } else if (dst != src) {
+    memcpy(dst, src, count * sizeof(T));
+  }
+}
+
+constexpr bool host_is_little_endian =
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+/**
+ * Convert count big endian values at src to host order.
+ */
+template <typename T>
+void be_to_host_array(T *dst, void const *src, size_t count) {
+  endian_copy_array<host_is_little_endian, T>(dst, src, count);
+}
+
+/**
+ * Convert count host order values to big endian at dst.
+ */
+template <typename T>
+void host_to_be_array(void *dst, T const *src, size_t count) {
+  endian_copy_array<host_is_little_endian, T>(dst, src, count);
+}
+
+/**
+ * Convert count little endian values at src to host order.
+ */
+template <typename T>
+void le_to_host_array(T *dst, void const *src, size_t count) {
+  endian_copy_array<!host_is_little_endian, T>(dst, src, count);
+}
+
+/**
+ * Convert count host order values to little endian at dst.
+ */
+template <typename T>
+void host_to_le_array(void *dst, T const *src, size_t count) {
+  endian_copy_array<!host_is_little_endian, T>(dst, src, count);
+}
+
+}  // namespace sled
@@ -7,12 +7,20 @@
 
 #include "sled/platform.h"
 
+#include <array>
+#include <cctype>
+#include <charconv>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace sled {
 
@@ -103,4 +111,405 @@ void format_os(std::ostream &os, const sled::fmt_obj &p, T const &... t) {
   sled::format_os(os, t...);
 }
 
+/**
+ * Output of the allocation-free formatter, a caller-provided character
+ * range.
+ *
+ * Output past the end is dropped but still counted, so size() is the
+ * length the complete result needs, as with snprintf().
+ */
+class fmt_writer {
+ public:
+  fmt_writer(char *begin, char *end) : begin_(begin), pos_(begin), end_(end) {}
+  fmt_writer(char *begin, size_t size) : fmt_writer(begin, begin + size) {}
+
+  a_forceinline void append(char const *s, size_t n) {
+    if (likely(n <= static_cast<size_t>(end_ - pos_))) {
+      memcpy(pos_, s, n);
+      pos_ += n;
+    } else {
+      auto room = static_cast<size_t>(end_ - pos_);
+      memcpy(pos_, s, room);
+      pos_ = end_;
+      dropped_ += n - room;
+    }
+  }
+
+  a_forceinline void append(std::string_view s) { append(s.data(), s.size()); }
+
+  a_forceinline void append(char c) {
+    if (likely(pos_ != end_)) {
+      *pos_++ = c;
+    } else {
+      dropped_++;
+    }
+  }
+
+  /**
+   * Append n copies of c.
+   */
+  void fill(char c, size_t n) {
+    auto room = static_cast<size_t>(end_ - pos_);
+    auto k = n < room ? n : room;
+    memset(pos_, c, k);
+    pos_ += k;
+    dropped_ += n - k;
+  }
+
+  /**
+   * Length of the complete output, including anything dropped.
+   */
+  size_t size() const { return static_cast<size_t>(pos_ - begin_) + dropped_; }
+
+  bool truncated() const { return dropped_ != 0; }
+
+  std::string_view view() const {
+    return {begin_, static_cast<size_t>(pos_ - begin_)};
+  }
+
+  std::string str() const { return std::string(view()); }
+
+ private:
+  char *begin_;
+  char *pos_;
+  char *end_;
+  size_t dropped_{0};
+};
+
+/**
+ * fmt_writer over N bytes of its own, usually on the stack.
+ *
+ * One byte is kept back for the c_str() terminator.
+ */
+template <size_t N>
+class fmt_buffer : public fmt_writer {
+ public:
+  static_assert(N > 0);
+
+  fmt_buffer() : fmt_writer(data_, data_ + N - 1) {}
+  fmt_buffer(const fmt_buffer &) = delete;
+  fmt_buffer &operator=(const fmt_buffer &) = delete;
+
+  char const *c_str() {
+    data_[view().size()] = '\0';
+    return data_;
+  }
+
+ private:
+  char data_[N];
+};
+
+/**
+ * Replacement field options, "{:[0][width][type]}".
+ *
+ * type is d, x or X for integers and s for anything.  Numbers are right
+ * aligned in width, everything else is left aligned.
+ */
+struct fmt_spec {
+  char type{0};
+  char fill{' '};
+  uint8_t width{0};
+};
+
+/**
+ * Write an integer, without allocating.
+ */
+template <typename T>
+void fmt_write_int(fmt_writer &w, T v, fmt_spec spec = fmt_spec{}) {
+  static_assert(std::is_integral_v<T>);
+  char buf[24];
+  int base = spec.type == 'x' || spec.type == 'X' ? 16 : 10;
+  auto r = std::to_chars(buf, buf + sizeof(buf), v, base);
+  auto n = static_cast<size_t>(r.ptr - buf);
+  if (spec.type == 'X') {
+    for (size_t i = 0; i < n; i++) {
+      buf[i] = static_cast<char>(toupper(buf[i]));
+    }
+  }
+  if (likely(n >= spec.width)) {
+    w.append(buf, n);
+  } else if (spec.fill == '0' && buf[0] == '-') {
+    w.append('-');
+    w.fill('0', spec.width - n);
+    w.append(buf + 1, n - 1);
+  } else {
+    w.fill(spec.fill, spec.width - n);
+    w.append(buf, n);
+  }
+}
+
+/**
+ * fmt_write(x) into a std::string, for types that implement fmt_string() on
+ * top of fmt_write().
+ */
+template <typename T>
+std::string fmt_write_string(T const &x) {
+  fmt_buffer<64> buf;
+  fmt_write(buf, x);
+  if (likely(!buf.truncated())) {
+    return buf.str();
+  }
+  std::string r(buf.size(), '\0');
+  fmt_writer w(r.data(), r.size());
+  fmt_write(w, x);
+  return r;
+}
+
+/**
+ * Stream fmt_write(x), for types that implement operator<< on top of
+ * fmt_write().
+ */
+template <typename T>
+std::ostream &fmt_write_ostream(std::ostream &os, T const &x) {
+  fmt_buffer<64> buf;
+  fmt_write(buf, x);
+  if (unlikely(buf.truncated())) {
+    return os << fmt_write_string(x);
+  }
+  return os << buf.view();
+}
+
+namespace detail {
+
+template <typename T, typename = void>
+struct has_fmt_write : std::false_type {};
+
+/**
+ * Types opt in to allocation-free formatting with an ADL-visible
+ * void fmt_write(fmt_writer &, const T &).
+ */
+template <typename T>
+struct has_fmt_write<T, std::void_t<decltype(fmt_write(
+                            std::declval<fmt_writer &>(),
+                            std::declval<T const &>()))>> : std::true_type {};
+
+a_forceinline void fmt_write_str(fmt_writer &w, std::string_view s,
+                                 fmt_spec spec) {
+  w.append(s);
+  if (unlikely(s.size() < spec.width)) {
+    w.fill(spec.fill, spec.width - s.size());
+  }
+}
+
+template <typename T>
+a_forceinline void fmt_write_arg(fmt_writer &w, T const &x, fmt_spec spec) {
+  if constexpr (std::is_same_v<T, bool>) {
+    fmt_write_str(w, x ? "true" : "false", spec);
+  } else if constexpr (std::is_same_v<T, char>) {
+    fmt_write_str(w, std::string_view(&x, 1), spec);
+  } else if constexpr (std::is_integral_v<T>) {
+    fmt_write_int(w, x, spec);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    char buf[32];
+#if defined(__cpp_lib_to_chars)
+    auto n = static_cast<size_t>(
+        std::to_chars(buf, buf + sizeof(buf), x).ptr - buf);
+#else
+    auto n = static_cast<size_t>(
+        snprintf(buf, sizeof(buf), "%g", static_cast<double>(x)));
+#endif
+    if (n < spec.width) {
+      w.fill(spec.fill, spec.width - n);
+    }
+    w.append(buf, n);
+  } else if constexpr (std::is_convertible_v<T const &, std::string_view>) {
+    fmt_write_str(w, std::string_view(x), spec);
+  } else if constexpr (has_fmt_write<T>::value) {
+    size_t start = w.size();
+    fmt_write(w, x);
+    if (unlikely(w.size() - start < spec.width)) {
+      w.fill(spec.fill, spec.width - (w.size() - start));
+    }
+  } else {
+    // Types with only the fmt_string() customization point.
+    fmt_write_str(w, fmt_string(x), spec);
+  }
+}
+
+/**
+ * A run of literal text, or the replacement field for argument arg.
+ */
+struct fmt_segment {
+  size_t offset{0};
+  size_t length{0};
+  int arg{-1};
+  fmt_spec spec{};
+};
+
+// Not constexpr, so reaching one while parsing a format string at compile
+// time is an error naming the problem.
+inline void fmt_error_unmatched_brace() {}
+inline void fmt_error_bad_spec() {}
+
+/**
+ * Split s into segments, or only count them if out is null.
+ */
+constexpr size_t fmt_parse(std::string_view s, fmt_segment *out) {
+  size_t n = 0;
+  int arg = 0;
+  size_t lit = 0;
+  size_t i = 0;
+  auto literal = [&](size_t end) {
+    if (end > lit) {
+      if (out != nullptr) {
+        out[n] = fmt_segment{lit, end - lit, -1, fmt_spec{}};
+      }
+      n++;
+    }
+  };
+  while (i < s.size()) {
+    char c = s[i];
+    if (c != '{' && c != '}') {
+      i++;
+      continue;
+    }
+    if (i + 1 < s.size() && s[i + 1] == c) {
+      // "{{" or "}}", keep one.
+      literal(i + 1);
+      i += 2;
+      lit = i;
+      continue;
+    }
+    if (c == '}') {
+      fmt_error_unmatched_brace();
+    }
+    literal(i);
+    fmt_spec spec{};
+    size_t j = i + 1;
+    if (j < s.size() && s[j] == ':') {
+      j++;
+      if (j < s.size() && s[j] == '0') {
+        spec.fill = '0';
+        j++;
+      }
+      int width = 0;
+      for (; j < s.size() && s[j] >= '0' && s[j] <= '9'; j++) {
+        width = width * 10 + (s[j] - '0');
+      }
+      if (width > 255) {
+        fmt_error_bad_spec();
+      }
+      spec.width = static_cast<uint8_t>(width);
+      if (j < s.size() && s[j] != '}') {
+        spec.type = s[j++];
+        if (spec.type != 'd' && spec.type != 'x' && spec.type != 'X' &&
+            spec.type != 's') {
+          fmt_error_bad_spec();
+        }
+      }
+    }
+    if (j >= s.size() || s[j] != '}') {
+      fmt_error_unmatched_brace();
+    }
+    if (out != nullptr) {
+      out[n] = fmt_segment{0, 0, arg, spec};
+    }
+    n++;
+    arg++;
+    i = j + 1;
+    lit = i;
+  }
+  literal(s.size());
+  return n;
+}
+
+/**
+ * Format string S split at compile time.
+ */
+template <typename S>
+struct fmt_parsed {
+  static constexpr std::string_view text = S::value();
+  static constexpr size_t size = fmt_parse(text, nullptr);
+  static constexpr auto segments = [] {
+    std::array<fmt_segment, size + 1> r{};
+    fmt_parse(text, r.data());
+    return r;
+  }();
+  static constexpr size_t args = [] {
+    size_t r = 0;
+    for (size_t i = 0; i < size; i++) {
+      r += segments[i].arg >= 0 ? 1 : 0;
+    }
+    return r;
+  }();
+};
+
+template <typename S, size_t I, typename... T>
+a_forceinline void fmt_emit_segment(fmt_writer &w, T const &... args) {
+  constexpr fmt_segment seg = fmt_parsed<S>::segments[I];
+  if constexpr (seg.arg < 0) {
+    w.append(fmt_parsed<S>::text.data() + seg.offset, seg.length);
+  } else {
+    constexpr auto arg = static_cast<size_t>(seg.arg);
+    fmt_write_arg(w, std::get<arg>(std::forward_as_tuple(args...)), seg.spec);
+  }
+}
+
+template <typename S, size_t... I, typename... T>
+a_forceinline void fmt_emit(fmt_writer &w, std::index_sequence<I...>,
+                            T const &... args) {
+  (fmt_emit_segment<S, I>(w, args...), ...);
+}
+
+}  // namespace detail
+
+/**
+ * Base of the format string types made by SLED_FMT().
+ */
+struct fmt_literal {};
+
+template <typename S>
+constexpr bool is_fmt_literal_v = std::is_base_of_v<fmt_literal, S>;
+
+/**
+ * Compile-time format string, "{}" fields are replaced by the arguments in
+ * order and "{{" and "}}" are literal braces.  Malformed strings fail to
+ * compile.
+ *
+ * \code
+ * sled::fmt_buffer<64> buf;
+ * sled::format_to(buf, SLED_FMT("pc={:04X} a={}"), pc, a);
+ * \endcode
+ */
+#define SLED_FMT(s)                                           \
+  ([] {                                                       \
+    struct sled_fmt_string : sled::fmt_literal {              \
+      static constexpr std::string_view value() { return s; } \
+    };                                                        \
+    return sled_fmt_string{};                                 \
+  }())
+
+/**
+ * Format args into w without allocating.
+ *
+ * Arguments are taken by reference; integers, floats, strings and types
+ * with fmt_write() are written in place, types with only fmt_string() go
+ * through one temporary string.
+ */
+template <typename S, typename... T,
+          class = std::enable_if_t<is_fmt_literal_v<S>>>
+a_forceinline void format_to(fmt_writer &w, S /*fmt*/, T const &... args) {
+  using parsed = detail::fmt_parsed<S>;
+  static_assert(parsed::args == sizeof...(T),
+                "format string and argument count differ");
+  detail::fmt_emit<S>(w, std::make_index_sequence<parsed::size>{}, args...);
+}
+
+/**
+ * Format into a std::string, the only allocation is the result.
+ */
+template <typename S, typename... T,
+          class = std::enable_if_t<is_fmt_literal_v<S>>>
+std::string format(S fmt, T const &... args) {
+  fmt_buffer<256> buf;
+  format_to(buf, fmt, args...);
+  if (likely(!buf.truncated())) {
+    return buf.str();
+  }
+  std::string r(buf.size(), '\0');
+  fmt_writer w(r.data(), r.size());
+  format_to(w, fmt, args...);
+  return r;
+}
+
 };  // namespace sled
@@ -5,9 +5,116 @@
  */
 #pragma once
 
+#include <string_view>
+
+#include "sled/arch.h"
 #include "sled/platform.h"
 
 namespace sled {
+
+/**
+ * 128-bit hash value.
+ */
+struct hash128 {
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(hash128 const &rhs) const {
+    return low == rhs.low && high == rhs.high;
+  }
+  bool operator!=(hash128 const &rhs) const { return !(*this == rhs); }
+};
+
+/**
+ * Fast non-cryptographic hash.
+ *
+ * Short inputs (up to 240 bytes) use wyhash style multiply-mix rounds.
+ * Longer inputs are split into 64 byte stripes feeding eight independent
+ * 64-bit accumulators, processed with AVX2 on avx2_hwarch.  Results are
+ * identical on all paths, in one shot or streamed, and stable across
+ * releases; fast_hash128(...).low equals fast_hash64(...).
+ *
+ * Not suitable where an attacker controls the input and can benefit from
+ * collisions.
+ */
+template <typename Arch>
+uint64_t fast_hash64(void const *data, size_t len, uint64_t seed = 0);
+
+template <>
+uint64_t fast_hash64<hwarch>(void const *data, size_t len, uint64_t seed);
+
+template <>
+uint64_t fast_hash64<avx2_hwarch>(void const *data, size_t len,
+                                  uint64_t seed);
+
+uint64_t fast_hash64(void const *data, size_t len, uint64_t seed = 0);
+
+hash128 fast_hash128(void const *data, size_t len, uint64_t seed = 0);
+
+inline uint64_t fast_hash64(std::string_view val, uint64_t seed = 0) {
+  return fast_hash64(val.data(), val.size(), seed);
+}
+
+inline hash128 fast_hash128(std::string_view val, uint64_t seed = 0) {
+  return fast_hash128(val.data(), val.size(), seed);
+}
+
+/**
+ * Hash a single integer, e.g. a StrongInt key.
+ */
+constexpr uint64_t hash_mix64(uint64_t v, uint64_t seed = 0) {
+  // 128-bit multiply folded to 64 bits, as used by the short input path.
+  auto product = static_cast<unsigned __int128>(v ^ 0xa0761d6478bd642full) *
+                 (seed ^ 0xe7037ed1a0b428dbull);
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+/**
+ * Incremental fast_hash64/fast_hash128.
+ */
+class fast_hasher {
+ public:
+  explicit fast_hasher(uint64_t seed = 0) { reset(seed); }
+
+  void reset(uint64_t seed = 0);
+
+  void update(void const *data, size_t len);
+
+  void update(std::string_view val) { update(val.data(), val.size()); }
+
+  /**
+   * Hash of everything passed to update(), the hasher can continue.
+   */
+  uint64_t digest() const;
+
+  hash128 digest128() const;
+
+  static constexpr size_t block_size = 1024;
+
+ private:
+  void consume_block(uint8_t const *block);
+
+  alignas(32) uint64_t acc_[8];
+  uint8_t secret_[192];
+  uint8_t buf_[block_size];
+  uint8_t last_[64];  // Tail of the last consumed block
+  size_t buf_len_;
+  uint64_t size_;
+  uint64_t seed_;
+};
+
+/**
+ * std::string/std::string_view hasher for unordered containers.
+ *
+ * std::unordered_map<std::string, T, sled::string_hash> m;
+ */
+struct string_hash {
+  using is_transparent = void;
+
+  size_t operator()(std::string_view val) const {
+    return static_cast<size_t>(fast_hash64(val));
+  }
+};
 /**
  * SHA1 hash value.
  *
@@ -22,9 +129,53 @@ struct sha1 {
     return memcmp(v.data(), zero_sha1, sizeof(zero_sha1)) != 0;
   }
 
+  bool operator==(sha1 const &rhs) const { return v == rhs.v; }
+  bool operator!=(sha1 const &rhs) const { return v != rhs.v; }
+
+  /**
+   * Lowercase hex digest.
+   */
+  std::string hex() const {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string result(2 * v.size(), '0');
+    for (size_t i = 0; i < v.size(); i++) {
+      auto b = static_cast<uint8_t>(v[i]);
+      result[2 * i] = digits[b >> 4];
+      result[2 * i + 1] = digits[b & 0xf];
+    }
+    return result;
+  }
+
+  /**
+   * Parse a 40 character hex digest.
+   */
+  static std::optional<sha1> from_hex(std::string_view str) {
+    auto nibble = [](char c) -> int {
+      if (c >= '0' && c <= '9') {
+        return c - '0';
+      }
+      c = static_cast<char>(std::tolower(c));
+      return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+    };
+    sha1 result{};
+    if (str.size() != 2 * result.v.size()) {
+      return std::nullopt;
+    }
+    for (size_t i = 0; i < result.v.size(); i++) {
+      int hi = nibble(str[2 * i]);
+      int lo = nibble(str[2 * i + 1]);
+      if (hi < 0 || lo < 0) {
+        return std::nullopt;
+      }
+      result.v[i] = static_cast<std::byte>(hi << 4 | lo);
+    }
+    return result;
+  }
+
+  friend std::string fmt_string(sha1 const &h) { return h.hex(); }
+
   friend std::ostream &operator<<(std::ostream &os, sha1 const &h) {
-    os << "NYI" << std::endl;
-    return os;
+    return os << h.hex();
   }
 };
 }  // namespace sled
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "sled/platform.h"
+#include "sled/statistics.h"
+#include "sled/time.h"
+
+namespace sled {
+
+/**
+ * Log-linear (HDR style) histogram of unsigned 64-bit values.
+ *
+ * Values below 2^precision are counted exactly.  Above that every power of
+ * two range is split into 2^(precision - 1) linear buckets, bounding the
+ * relative error of any reported value to 2^-(precision - 1).  The default
+ * precision of 8 covers the full 64-bit range in 7424 buckets with < 1%
+ * error.
+ *
+ * record() is constant time.  Histograms are not thread safe; keep one per
+ * thread and merge() them for reporting.
+ */
+class Histogram {
+ public:
+  static constexpr int default_precision = 8;
+
+  explicit Histogram(int precision = default_precision);
+
+  /**
+   * Record @a count occurrences of @a value.
+   */
+  a_forceinline void record(uint64_t value, uint64_t count = 1) {
+    counts_[index(value)] += count;
+    count_ += count;
+    sum_ += value * count;
+    sum_sq_ += static_cast<double>(value) * static_cast<double>(value) *
+               static_cast<double>(count);
+    if (value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  /**
+   * Record a duration in nanoseconds, negative durations count as 0.
+   */
+  a_forceinline void record(sled::time t) {
+    record(t.v < 0 ? 0 : static_cast<uint64_t>(t.v));
+  }
+
+  /**
+   * Add the contents of @a rhs, which must have the same precision.
+   */
+  void merge(Histogram const &rhs);
+
+  void reset();
+
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ == 0 ? 0 : min_; }
+  uint64_t max() const { return max_; }
+  double mean() const;
+  double stddev() const;
+
+  /**
+   * Value at or below which @a pct percent of the recorded values fall.
+   *
+   * Reported as the upper bound of the matching bucket, clamped to max().
+   */
+  uint64_t percentile(double pct) const;
+
+  /**
+   * Report count, min, max, mean, stddev and common percentiles as
+   * "<prefix>.count", "<prefix>.p99" etc.
+   */
+  void report(StatisticsReporter &reporter, std::string const &prefix) const;
+
+  // NOLINTNEXTLINE
+  operator StatisticImpl() const { return StatisticImpl{mean()}; }
+
+  /**
+   * Bucket holding @a value.
+   */
+  a_forceinline size_t index(uint64_t value) const {
+    if (value < linear_) {
+      return static_cast<size_t>(value);
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - precision_ + 1;
+    uint64_t mantissa = value >> shift;
+    return static_cast<size_t>(linear_ + (shift - 1) * half_ +
+                               (mantissa - half_));
+  }
+
+  /**
+   * Lowest value counted in bucket @a idx.
+   */
+  uint64_t lowest(size_t idx) const;
+
+  /**
+   * Highest value counted in bucket @a idx.
+   */
+  uint64_t highest(size_t idx) const;
+
+ private:
+  int precision_;
+  uint64_t linear_;
+  uint64_t half_;
+  std::vector<uint64_t> counts_;
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  double sum_sq_{0};
+  uint64_t min_{std::numeric_limits<uint64_t>::max()};
+  uint64_t max_{0};
+};
+
+/**
+ * Record the lifetime of the scope in a histogram.
+ *
+ * {
+ *   ScopedTimer timer(frame_time);
+ *   render_frame();
+ * }
+ */
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram &histogram) : histogram_(histogram) {}
+  ~ScopedTimer() { histogram_.record(watch_.current()); }
+  ScopedTimer(ScopedTimer const &) = delete;
+  ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+ private:
+  Histogram &histogram_;
+  stopwatch watch_;
+};
+
+/**
+ * Record the time between successive calls in a histogram, e.g. frame to
+ * frame latency.
+ */
+class SplitTimer {
+ public:
+  explicit SplitTimer(Histogram &histogram) : histogram_(histogram) {}
+
+  void split() { histogram_.record(watch_.split()); }
+
+ private:
+  Histogram &histogram_;
+  stopwatch watch_;
+};
+
+}  // namespace sled
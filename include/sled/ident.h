@@ -6,8 +6,11 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <string>
 
+#include "sled/hash.h"
+
 namespace sled {
 
 /**
@@ -28,9 +31,23 @@ class ident {
    */
   uint64_t id() const { return id_; }
 
+  bool operator==(ident const& rhs) const {
+    return id_ == rhs.id_ && name_ == rhs.name_;
+  }
+  bool operator!=(ident const& rhs) const { return !(*this == rhs); }
+
  private:
   std::string name_;
   uint64_t id_;
 };
 
 }  // namespace sled
+
+namespace std {
+template <>
+struct hash<sled::ident> {
+  size_t operator()(sled::ident const& x) const {
+    return static_cast<size_t>(sled::fast_hash64(x.name(), x.id()));
+  }
+};
+}  // namespace std
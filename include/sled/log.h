@@ -5,16 +5,22 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "sled/enum.h"
 #include "sled/strong_int.h"
+#include "sled/time.h"
 
 namespace sled::log {
 
@@ -78,22 +84,64 @@ struct Facility::V {
   static constexpr Facility User3{7};
 };
 
-struct tsc_t : StrongInt<uint64_t, tsc_t> {
-  using StrongInt<uint64_t, tsc_t>::StrongInt;
-
-  static constexpr tsc_t now() { return tsc_t{0}; }
-};
+using sled::tsc_calibration;
+using sled::tsc_t;
 
+/**
+ * Thread identifier.
+ *
+ * The OS thread id where available, cached per thread.
+ */
 struct thr_id_t : StrongInt<uint64_t, thr_id_t> {
   using StrongInt<uint64_t, thr_id_t>::StrongInt;
 
-  static thr_id_t self() { return thr_id_t{0}; }
+  static a_forceinline thr_id_t self() {
+    if (unlikely(cached_ == 0)) {
+      cached_ = lookup();
+    }
+    return thr_id_t{cached_};
+  }
+
+ private:
+  static uint64_t lookup();
+
+  thread_local static uint64_t cached_;
 };
 
+/**
+ * Executor task identifier.
+ *
+ * The id of the task currently running on this thread, or 0 outside of a
+ * task.  Maintained by the executors through task_scope.
+ */
 struct task_id_t : StrongInt<uint64_t, task_id_t> {
   using StrongInt<uint64_t, task_id_t>::StrongInt;
 
-  static task_id_t self() { return task_id_t{0}; }
+  static a_forceinline task_id_t self() { return task_id_t{current_}; }
+
+  static a_forceinline void set_self(task_id_t id) { current_ = id.v; }
+
+ private:
+  thread_local static uint64_t current_;
+};
+
+/**
+ * Task scope RAII
+ *
+ * Marks @a id as the running task for the lifetime of the scope, restoring
+ * the previous task id afterwards.
+ */
+class task_scope {
+ public:
+  explicit task_scope(task_id_t id) : prev_(task_id_t::self()) {
+    task_id_t::set_self(id);
+  }
+  ~task_scope() { task_id_t::set_self(prev_); }
+  task_scope(task_scope const &) = delete;
+  task_scope &operator=(task_scope const &) = delete;
+
+ private:
+  task_id_t prev_;
 };
 
 /**
@@ -140,7 +188,11 @@ struct stream_message final : public message {
   using message::message;
 
   std::ostream &msg() { return msg_; }
-  std::streambuf *format() override { return msg_.rdbuf(); }
+  std::streambuf *format() override {
+    // Rewind so each sink sees the full message.
+    msg_.seekg(0);
+    return msg_.rdbuf();
+  }
   std::string what() override { return msg_.str(); }
 
   void build() {}
@@ -149,9 +201,9 @@ struct stream_message final : public message {
    * Build a message using variable template expansion.
    */
   template <typename... Args, typename T>
-  void build(T &&arg, Args... args) {
+  void build(T &&arg, Args &&... args) {
     msg_ << std::forward<T>(arg);
-    build(args...);
+    build(std::forward<Args>(args)...);
   }
 
  private:
@@ -165,6 +217,58 @@ struct stream_message final : public message {
  */
 void sink_msg(std::ostream &sink, message &msg);
 
+/**
+ * Sink formatting flag.
+ */
+struct SinkFlag final : enum_struct<uint32_t, SinkFlag> {
+  static constexpr std::array<name_type, 4> names{
+      std::make_pair(0x01, "RelativeTime"), std::make_pair(0x02, "WallTime"),
+      std::make_pair(0x04, "ThreadId"), std::make_pair(0x08, "TaskId")};
+
+  using enum_struct::enum_struct;
+
+  struct V;
+};
+
+struct SinkFlag::V {
+  static constexpr SinkFlag RelativeTime{0x01};
+  static constexpr SinkFlag WallTime{0x02};
+  static constexpr SinkFlag ThreadId{0x04};
+  static constexpr SinkFlag TaskId{0x08};
+};
+
+/**
+ * Sink formatting flags.
+ */
+struct SinkFlags : public sled::flags_struct<SinkFlag, SinkFlags> {
+  using flags_struct::flags_struct;
+};
+
+/**
+ * std::ostream log sink with an optional message prefix.
+ *
+ * Example:
+ * ostream_sink out(std::cerr, {SinkFlag::V::RelativeTime});
+ * LoggingManager logman(out);
+ *
+ * Produces "[    1.234567] message", the time being relative to the TSC
+ * calibration point.
+ */
+struct ostream_sink {
+  explicit ostream_sink(std::ostream &os, SinkFlags flags = {})
+      : os(os), flags(flags) {}
+
+  std::ostream &os;
+  SinkFlags flags;
+};
+
+void sink_msg(ostream_sink &sink, message &msg);
+
+/**
+ * Write the message prefix selected by @a flags.
+ */
+void format_prefix(std::ostream &os, message const &msg, SinkFlags flags);
+
 /**
  * A log sink.
  *
@@ -184,7 +288,9 @@ class Sink {
   }
   Sink &operator=(Sink &&) noexcept = default;
 
-  friend void sink_msg(Sink &x, message &msg) { x.sink_->sink_msg_(msg); }
+  friend void sink_msg(Sink const &x, message &msg) {
+    x.sink_->sink_msg_(msg);
+  }
 
  private:
   struct Sinkable {
@@ -204,45 +310,376 @@ class Sink {
   std::unique_ptr<Sinkable> sink_;
 };
 
+/**
+ * Sink identifier, returned by LoggingManager::add_sink().
+ */
+struct sink_id : StrongInt<uint32_t, sink_id> {
+  using StrongInt<uint32_t, sink_id>::StrongInt;
+};
+
+/**
+ * Return true if messages of @a sev are compiled in.
+ *
+ * Messages below SLED_LOG_MIN_SEVERITY are removed at compile time by the
+ * SLED_LOG macros.
+ */
+constexpr bool compiled_in(Severity sev) {
+  return sev.v >= SLED_LOG_MIN_SEVERITY;
+}
+
 /**
  * Logging Manager.
  *
  * The logging manager is a global singleton that manages the various sinks and
  * logging.
+ *
+ * Each facility has its own threshold.  A facility threshold of
+ * Severity::V::Inherited follows the global threshold.
+ *
+ * Messages fan out to the default sink and any added sinks.  Every sink has
+ * its own severity threshold.  Filtered sinks additionally honor the facility
+ * thresholds while unfiltered sinks (e.g. a flight recorder) see everything
+ * at or above their own threshold.
  */
 class LoggingManager {
  public:
+  static constexpr uint32_t max_facilities = 64;
+
   explicit LoggingManager(Sink default_sink);
   ~LoggingManager();
 
   void set_threshold(Severity sev);
+  void set_threshold(Facility facility, Severity sev);
   void set_default_severity(Severity sev);
   void set_default_sink(Sink sink);
 
   void increase_threshold();
   void decrease_threshold();
 
-  Severity threshold() { return threshold_sev_; }
+  Severity threshold() const {
+    return Severity{threshold_sev_.load(std::memory_order_relaxed)};
+  }
+  Severity threshold(Facility facility) const;
+
+  /**
+   * Add a sink receiving messages at or above @a threshold.
+   *
+   * The sink must outlive its registration.  An @a unfiltered sink ignores
+   * the facility thresholds.
+   */
+  sink_id add_sink(Sink sink, Severity threshold = Severity::V::Trace,
+                   bool unfiltered = false);
+
+  /**
+   * Remove a sink.  No messages are delivered to it once this returns,
+   * except that called from a sink, the message being dispatched may still
+   * reach it.
+   */
+  void remove_sink(sink_id id);
+
+  /**
+   * Register a named facility.
+   *
+   * Throws sled::Exception once max_facilities have been registered.
+   */
   Facility add_facility(std::string const &facility);
 
-  a_forceinline bool enabled(Severity sev) { return threshold_sev_ <= sev; }
+  /**
+   * Find a facility by name, including registered facilities.
+   */
+  Facility find_facility(std::string const &facility);
+
+  /**
+   * Configure thresholds from a string.
+   *
+   * The spec is a comma separated list of "severity" (global) or
+   * "facility=severity" entries, e.g. "Warning,Exec=Debug,Perf=Inherited".
+   * Intended for command line options and scripting.
+   */
+  void configure(std::string const &spec);
+
+  a_forceinline bool enabled(Severity sev) const { return threshold() <= sev; }
 
-  /*
-   * TODO(dan): Add multiple sink support
-   * add_sink(Sink sin)
-   * remove_sink(Sink sink)
+  /**
+   * Return true if @a sev messages on @a facility should be logged.
+   *
+   * A single relaxed load.
+   */
+  a_forceinline bool enabled(Facility facility, Severity sev) const {
+    debug_assert(facility.v < max_facilities);
+    return effective_sev_[facility.v].load(std::memory_order_relaxed) <= sev.v;
+  }
+
+  /**
+   * Log a message regardless of the global and facility thresholds.
+   *
+   * Every sink still applies its own severity threshold.
    */
   template <typename... Args>
-  void log_always(Facility facility, Severity severity, Args... args) {
+  void log_always(Facility facility, Severity severity, Args &&... args) {
     stream_message msg(facility, severity);
-    msg.build(args...);
-    sink_msg(default_sink_, msg);
+    msg.build(std::forward<Args>(args)...);
+    deliver(msg, false);
   }
 
+  /**
+   * Log a message already checked with enabled(), used by the SLED_LOG
+   * macros.
+   *
+   * enabled() also passes messages wanted only by unfiltered sinks, so
+   * filtered sinks drop messages below the facility threshold here.
+   */
+  template <typename... Args>
+  void log_filtered(Facility facility, Severity severity, Args &&... args) {
+    stream_message msg(facility, severity);
+    msg.build(std::forward<Args>(args)...);
+    deliver(msg, true);
+  }
+
+  /**
+   * Deliver a message to all interested sinks, as log_filtered().
+   *
+   * Sinks are called without holding any manager lock, so a sink may log,
+   * add sinks or remove sinks.
+   */
+  void dispatch(message &msg) { deliver(msg, true); }
+
  private:
-  Severity threshold_sev_;
+  struct sink_entry {
+    sink_id id;
+    Sink sink;
+    Severity threshold;
+    bool unfiltered;
+  };
+  using sink_list = std::vector<sink_entry>;
+
+  void update_effective(uint32_t facility);
+  void deliver(message &msg, bool filter);
+
+  /**
+   * Replace the sink list, returning the old one.  Must hold mtx_.
+   */
+  std::shared_ptr<sink_list const> publish_sinks(
+      std::shared_ptr<sink_list const> sinks);
+
+  /**
+   * Wait for dispatches on other threads still using @a old.  Must not hold
+   * mtx_, a sink on another thread may be waiting for it.
+   */
+  static void retire_sinks(std::shared_ptr<sink_list const> old);
+
+  std::atomic<uint32_t> threshold_sev_;
   Severity default_sev_;
-  Sink default_sink_;
   std::atomic<uint32_t> last_facility_;
+  std::mutex mtx_;
+  std::array<Severity, max_facilities> facility_sev_{};
+  std::array<std::atomic<uint32_t>, max_facilities> filter_sev_{};
+  std::array<std::atomic<uint32_t>, max_facilities> effective_sev_{};
+  std::array<std::string, max_facilities> facility_names_{};
+  std::shared_ptr<sink_list const> sinks_;  // std::atomic_load/store only
+  uint32_t unfiltered_sev_{Severity::V::Inherited.v};
+  uint32_t last_sink_{0};
+};
+
+/**
+ * Per call site "log once" state.
+ *
+ * Lives in static storage next to the call site, see SLED_LOG_ONCE.
+ */
+class log_once_site {
+ public:
+  constexpr log_once_site() = default;
+
+  /**
+   * Return true the first time only.  A single relaxed load once fired.
+   */
+  a_forceinline bool first() noexcept {
+    if (likely(done_.load(std::memory_order_relaxed))) {
+      return false;
+    }
+    return !done_.exchange(true, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<bool> done_{false};
+};
+
+/**
+ * Per call site 1-in-N sampling state, see SLED_LOG_EVERY_N.
+ *
+ * The counter is updated with a relaxed load and store rather than a locked
+ * increment; concurrent callers may occasionally share a sample.
+ */
+class log_sample_site {
+ public:
+  constexpr log_sample_site() = default;
+
+  a_forceinline bool sample(uint64_t n) noexcept {
+    debug_assert(n > 0);
+    auto count = count_.load(std::memory_order_relaxed);
+    count_.store(count + 1, std::memory_order_relaxed);
+    return count % n == 0;
+  }
+
+ private:
+  std::atomic<uint64_t> count_{0};
 };
-};  // namespace sled::log
+
+/**
+ * Per call site token bucket, see SLED_LOG_RATE_LIMITED.
+ *
+ * Allows @a per_sec messages per second on average with bursts of up to
+ * @a burst messages.  Implemented as a generic cell rate algorithm: the
+ * bucket is the earliest TSC tick the next message may go out, so a
+ * suppressed message costs a TSC read, one relaxed load and a suppressed
+ * count increment.  The TSC calibration is only consulted when a message
+ * is let through.  A zero @a per_sec or @a burst is treated as one.
+ */
+class log_rate_site {
+ public:
+  constexpr log_rate_site(uint32_t per_sec, uint32_t burst)
+      : interval_ns_(sec::NSECS / std::max<int64_t>(per_sec, 1)),
+        burst_ns_(interval_ns_ * (std::max<int64_t>(burst, 1) - 1)) {}
+
+  /**
+   * Try to take a token.
+   *
+   * On success @a suppressed is set to the number of messages dropped since
+   * the previous success.
+   */
+  a_forceinline bool acquire(uint64_t &suppressed) noexcept {
+    auto now = static_cast<int64_t>(tsc_t::now().v);
+    auto allow = allow_.load(std::memory_order_relaxed);
+    if (likely(now < allow)) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return acquire_slow(now, allow, suppressed);
+  }
+
+ private:
+  bool acquire_slow(int64_t now, int64_t allow, uint64_t &suppressed) noexcept {
+    auto const &cal = tsc_calibration::get();
+    auto interval = static_cast<int64_t>(cal.to_ticks(interval_ns_));
+    auto burst = static_cast<int64_t>(cal.to_ticks(burst_ns_));
+    // The theoretical arrival time is allow + burst.
+    do {
+      if (now < allow) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!allow_.compare_exchange_weak(
+        allow, std::max(allow, now - burst) + interval,
+        std::memory_order_relaxed));
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  int64_t interval_ns_;
+  int64_t burst_ns_;
+  std::atomic<int64_t> allow_{std::numeric_limits<int64_t>::min()};
+  std::atomic<uint64_t> suppressed_{0};
+};
+
+}  // namespace sled::log
+
+/**
+ * Log a message if enabled for the facility.
+ *
+ * Severities below SLED_LOG_MIN_SEVERITY are compiled out and arguments are
+ * only evaluated when the message will be logged.  @a severity must be a
+ * constant expression.
+ *
+ * SLED_LOG(logman, Facility::V::Exec, Severity::V::Debug, "x=", x);
+ */
+#define SLED_LOG(logman, facility, severity, ...)                   \
+  do {                                                              \
+    if constexpr (::sled::log::compiled_in(severity)) {             \
+      if ((logman).enabled((facility), (severity))) {               \
+        (logman).log_filtered((facility), (severity), __VA_ARGS__); \
+      }                                                             \
+    }                                                               \
+  } while (0)
+
+#define SLED_TRACE(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Trace, __VA_ARGS__)
+#define SLED_DEBUG(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Debug, __VA_ARGS__)
+#define SLED_INFO(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Info, __VA_ARGS__)
+#define SLED_NOTICE(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Notice, __VA_ARGS__)
+#define SLED_WARNING(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Warning, __VA_ARGS__)
+#define SLED_ERROR(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Error, __VA_ARGS__)
+#define SLED_CRITICAL(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Critical, __VA_ARGS__)
+#define SLED_FATAL(logman, facility, ...) \
+  SLED_LOG(logman, facility, ::sled::log::Severity::V::Fatal, __VA_ARGS__)
+
+/**
+ * Log a message the first time this call site is reached with the message
+ * enabled.
+ */
+#define SLED_LOG_ONCE(logman, facility, severity, ...)                \
+  do {                                                                \
+    if constexpr (::sled::log::compiled_in(severity)) {               \
+      if ((logman).enabled((facility), (severity))) {                 \
+        static ::sled::log::log_once_site sled_log_site_;             \
+        if (sled_log_site_.first()) {                                 \
+          (logman).log_filtered((facility), (severity), __VA_ARGS__); \
+        }                                                             \
+      }                                                               \
+    }                                                                 \
+  } while (0)
+
+/**
+ * Log one in every @a n enabled messages from this call site, starting with
+ * the first.  @a n must be a positive constant expression.
+ */
+#define SLED_LOG_EVERY_N(logman, facility, severity, n, ...)          \
+  do {                                                                \
+    static_assert((n) > 0, "SLED_LOG_EVERY_N requires n > 0");        \
+    if constexpr (::sled::log::compiled_in(severity)) {               \
+      if ((logman).enabled((facility), (severity))) {                 \
+        static ::sled::log::log_sample_site sled_log_site_;           \
+        if (sled_log_site_.sample(n)) {                               \
+          (logman).log_filtered((facility), (severity), __VA_ARGS__); \
+        }                                                             \
+      }                                                               \
+    }                                                                 \
+  } while (0)
+
+/**
+ * Log at most @a per_sec messages per second (bursts of @a burst) from this
+ * call site.  The first message after suppression notes how many were
+ * dropped.  @a per_sec and @a burst must be positive constant expressions.
+ *
+ * SLED_LOG_RATE_LIMITED(logman, Facility::V::Exec, Severity::V::Warning,
+ *                       10, 5, "Bad register write ", HexFmt(reg));
+ */
+#define SLED_LOG_RATE_LIMITED(logman, facility, severity, per_sec, burst, \
+                              ...)                                        \
+  do {                                                                    \
+    static_assert((per_sec) > 0,                                          \
+                  "SLED_LOG_RATE_LIMITED requires per_sec > 0");          \
+    static_assert((burst) > 0,                                            \
+                  "SLED_LOG_RATE_LIMITED requires burst > 0");            \
+    if constexpr (::sled::log::compiled_in(severity)) {                   \
+      if ((logman).enabled((facility), (severity))) {                     \
+        static ::sled::log::log_rate_site sled_log_site_((per_sec),       \
+                                                         (burst));        \
+        uint64_t sled_log_suppressed_ = 0;                                \
+        if (sled_log_site_.acquire(sled_log_suppressed_)) {               \
+          if (sled_log_suppressed_ != 0) {                                \
+            (logman).log_filtered((facility), (severity), __VA_ARGS__,    \
+                                  " [", sled_log_suppressed_,             \
+                                  " suppressed]");                        \
+          } else {                                                        \
+            (logman).log_filtered((facility), (severity), __VA_ARGS__);   \
+          }                                                               \
+        }                                                                 \
+      }                                                                   \
+    }                                                                     \
+  } while (0)
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sled/log.h"
+#include "sled/spinlock.h"
+
+namespace sled::log {
+
+/**
+ * Rotating file sink options.
+ */
+struct rotating_file_options {
+  size_t max_bytes{64 * 1024 * 1024}; /**< Rotate once a file exceeds. */
+  sled::time max_age{};               /**< Rotate after (0 disables). */
+  int max_files{5};                   /**< Rotated files to keep. */
+  size_t buffer_size{1024 * 1024};    /**< Write buffer size. */
+  Severity flush_severity{Severity::V::Error}; /**< Flush immediately at. */
+  SinkFlags flags{SinkFlag::V::WallTime};      /**< Line prefix. */
+};
+
+/**
+ * Rotating file sink.
+ *
+ * Messages are buffered and written with large write(2) calls.  The file is
+ * rotated once it grows past max_bytes or is older than max_age; "path"
+ * becomes "path.1", "path.1" becomes "path.2" and so on up to max_files.
+ */
+class rotating_file_sink {
+ public:
+  explicit rotating_file_sink(std::string path,
+                              rotating_file_options opts = {});
+  ~rotating_file_sink();
+  rotating_file_sink(rotating_file_sink const &) = delete;
+  rotating_file_sink &operator=(rotating_file_sink const &) = delete;
+
+  /**
+   * Write any buffered messages.
+   */
+  void flush();
+
+  /**
+   * Rotate the current file immediately.
+   */
+  void rotate();
+
+  friend void sink_msg(rotating_file_sink &sink, message &msg) {
+    sink.append(msg);
+  }
+
+ private:
+  void append(message &msg);
+  void open_file();
+  void flush_locked();
+  void rotate_locked();
+
+  std::string path_;
+  rotating_file_options opts_;
+  std::mutex mtx_;  // Held across write(2) and rename(2)
+  std::vector<char> buf_;
+  int fd_{-1};
+  size_t file_bytes_{0};
+  sled::time opened_{};
+};
+
+/**
+ * Memory mapped append-only file sink.
+ *
+ * Messages are copied directly into a shared file mapping, growing the file
+ * chunk_size bytes at a time.  The file is truncated to the written size on
+ * destruction.
+ */
+class mmap_file_sink {
+ public:
+  explicit mmap_file_sink(std::string const &path,
+                          size_t chunk_size = 16 * 1024 * 1024,
+                          SinkFlags flags = {SinkFlag::V::WallTime});
+  ~mmap_file_sink();
+  mmap_file_sink(mmap_file_sink const &) = delete;
+  mmap_file_sink &operator=(mmap_file_sink const &) = delete;
+
+  /**
+   * Bytes written to the file.
+   */
+  size_t size() const { return size_; }
+
+  /**
+   * Schedule write-back of the mapping (msync).
+   */
+  void sync();
+
+  friend void sink_msg(mmap_file_sink &sink, message &msg) {
+    sink.append(msg);
+  }
+
+ private:
+  void append(message &msg);
+  void grow(size_t min_size);
+
+  size_t chunk_size_;
+  SinkFlags flags_;
+  std::mutex mtx_;  // Held across ftruncate(2) and mmap(2)
+  int fd_{-1};
+  std::byte *map_{nullptr};
+  size_t mapped_{0};
+  size_t size_{0};
+};
+
+/**
+ * In-memory flight recorder sink.
+ *
+ * Keeps the most recent capacity bytes of formatted messages in a circular
+ * buffer.  Nothing is written until a message at or above the trigger
+ * severity arrives, or the process crashes with install_crash_handler()
+ * active, at which point the history is written to dump_fd.
+ *
+ * Usually added as an unfiltered Trace sink:
+ * flight_recorder_sink recorder(4 * 1024 * 1024);
+ * logman.add_sink(recorder, Severity::V::Trace, true);
+ */
+class flight_recorder_sink {
+ public:
+  explicit flight_recorder_sink(
+      size_t capacity, Severity trigger = Severity::V::Error, int dump_fd = 2,
+      SinkFlags flags = {SinkFlag::V::RelativeTime, SinkFlag::V::ThreadId,
+                         SinkFlag::V::TaskId});
+  ~flight_recorder_sink();
+  flight_recorder_sink(flight_recorder_sink const &) = delete;
+  flight_recorder_sink &operator=(flight_recorder_sink const &) = delete;
+
+  /**
+   * Write the recorded history, oldest first, and clear it.
+   */
+  void dump();
+
+  /**
+   * Return the recorded history, oldest first.
+   */
+  std::string contents();
+
+  /**
+   * Dump this recorder from SIGSEGV/SIGBUS/SIGILL/SIGFPE/SIGABRT.
+   *
+   * Only one recorder can be installed at a time.
+   */
+  void install_crash_handler();
+
+  friend void sink_msg(flight_recorder_sink &sink, message &msg) {
+    sink.record(msg);
+  }
+
+ private:
+  void record(message &msg);
+  static void crash_handler(int sig);
+
+  /**
+   * Offset of the oldest complete line.
+   */
+  uint64_t first_line() const;
+
+  /**
+   * Async-signal-safe write of the history.
+   */
+  void dump_raw();
+
+  std::vector<char> buf_;
+  Severity trigger_;
+  int dump_fd_;
+  SinkFlags flags_;
+  sled::sync::SpinLock lock_;
+  uint64_t head_{0};  // Total bytes ever written
+  uint64_t tail_{0};  // Oldest byte still valid
+  bool truncated_{false};
+};
+
+}  // namespace sled::log
@@ -11,6 +11,7 @@
 #include <type_traits>
 
 #include "sled/enum.h"
+#include "sled/fmt.h"
 
 namespace sled {
 
@@ -87,43 +88,42 @@ class IntFmt {
   Flags flags{};
 
   friend inline std::ostream &operator<<(std::ostream &os, IntFmt const &obj) {
-    auto f = os.flags();
+    return fmt_write_ostream(os, obj);
+  }
+
+  static inline IntFmt from_string(std::string const &obj) {
+    // XXX: Pick the correct width.
+    return IntFmt(stoull(obj, nullptr, 0));
+  }
+
+  friend a_forceinline std::string fmt_string(IntFmt const &obj) {
+    return fmt_write_string(obj);
+  }
+
+  friend inline void fmt_write(fmt_writer &out, IntFmt const &obj) {
     if (obj.flags.is_set(IntegerFormat::KiB)) {
       static constexpr uint64_t KiB_size = 1024;
       int64_t quot = obj.v / KiB_size;
       int32_t rem = std::abs(static_cast<int32_t>(obj.v % KiB_size));
-      os << std::dec << quot;
+      fmt_write_int(out, quot);
       if (rem) {
-        rem = (10 * rem) / KiB_size;
-        os << "." << rem;
+        out.append('.');
+        fmt_write_int(out, (10 * rem) / KiB_size);
       }
-      os << "KiB";
+      out.append("KiB");
     } else if (obj.flags.is_set(IntegerFormat::MiB)) {
       static constexpr uint64_t MiB_size = 1024 * 1024;
       int64_t quot = obj.v / MiB_size;
       int64_t rem = std::abs(static_cast<int64_t>(obj.v % MiB_size));
-      os << std::dec << quot;
+      fmt_write_int(out, quot);
       if (rem) {
-        rem = (10 * rem) / MiB_size;
-        os << "." << rem;
+        out.append('.');
+        fmt_write_int(out, (10 * rem) / MiB_size);
       }
-      os << "MiB";
+      out.append("MiB");
     } else {
-      os << std::dec << obj.v;
+      fmt_write_int(out, obj.v);
     }
-    os.flags(f);
-    return os;
-  }
-
-  static inline IntFmt from_string(std::string const &obj) {
-    // XXX: Pick the correct width.
-    return IntFmt(stoull(obj, nullptr, 0));
-  }
-
-  friend a_forceinline std::string fmt_string(IntFmt const &obj) {
-    std::stringstream os;
-    os << obj;
-    return os.str();
   }
 };
 
@@ -181,22 +181,7 @@ class HexFmt {
   constexpr bool operator!=(HexFmt const &rhs) { return v == rhs.v; }
 
   friend inline std::ostream &operator<<(std::ostream &os, HexFmt const &obj) {
-    auto f = os.flags();
-    if (obj.flags.is_clear(HexFormat::NoPrefix)) {
-      if (obj.flags.is_clear(HexFormat::AltPrefix)) {
-        os << "0x";
-      } else {
-        os << "$";
-      }
-    }
-    if (obj.flags.is_clear(HexFormat::NoPadding)) {
-      os << std::setfill('0');
-      os << std::right;
-      os << std::setw(obj.w);
-    }
-    os << std::hex << std::uppercase << std::right << obj.v;
-    os.flags(f);
-    return os;
+    return fmt_write_ostream(os, obj);
   }
 
   friend inline bool operator==(const HexFmt &lhs, const HexFmt &rhs) {
@@ -209,9 +194,18 @@ class HexFmt {
   }
 
   friend a_forceinline std::string fmt_string(HexFmt const &obj) {
-    std::stringstream os;
-    os << obj;
-    return os.str();
+    return fmt_write_string(obj);
+  }
+
+  friend inline void fmt_write(fmt_writer &out, HexFmt const &obj) {
+    if (obj.flags.is_clear(HexFormat::NoPrefix)) {
+      out.append(obj.flags.is_clear(HexFormat::AltPrefix) ? "0x" : "$");
+    }
+    fmt_spec spec{'X', '0', 0};
+    if (obj.flags.is_clear(HexFormat::NoPadding)) {
+      spec.width = static_cast<uint8_t>(obj.w);
+    }
+    fmt_write_int(out, obj.v, spec);
   }
 };
 
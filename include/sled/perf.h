@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "sled/enum.h"
+#include "sled/platform.h"
+#include "sled/statistics.h"
+
+namespace sled::perf {
+
+/**
+ * Hardware event counted by an event_group.
+ */
+struct Event final : enum_struct<uint32_t, Event> {
+  static constexpr std::array<name_type, 5> names{
+      std::make_pair(0, "cycles"), std::make_pair(1, "instructions"),
+      std::make_pair(2, "l1d_misses"), std::make_pair(3, "llc_misses"),
+      std::make_pair(4, "branch_misses")};
+
+  using enum_struct::enum_struct;
+
+  struct V;
+};
+
+struct Event::V {
+  static constexpr Event Cycles{0};
+  static constexpr Event Instructions{1};
+  static constexpr Event L1DMisses{2};
+  static constexpr Event LLCMisses{3};
+  static constexpr Event BranchMisses{4};
+};
+
+static constexpr size_t num_events = Event::names.size();
+
+/**
+ * Snapshot of an event_group's counters.
+ */
+struct counters {
+  std::array<uint64_t, num_events> v{};
+
+  uint64_t operator[](Event e) const { return v[e.v]; }
+
+  friend counters operator-(counters const &lhs, counters const &rhs) {
+    counters result;
+    for (size_t i = 0; i < num_events; i++) {
+      result.v[i] = lhs.v[i] - rhs.v[i];
+    }
+    return result;
+  }
+};
+
+/**
+ * Per-thread group of hardware counters.
+ *
+ * The counters only count user space execution of the opening thread.  When
+ * the kernel allows it (perf_event_paranoid, cap_user_rdpmc) counters are
+ * read with rdpmc without entering the kernel, otherwise with read(2).
+ *
+ * Opening never fails: events the kernel refuses (containers, VMs without a
+ * virtual PMU, restrictive perf_event_paranoid) simply read as 0 and
+ * available() reports what was opened.
+ */
+class event_group {
+ public:
+  event_group();
+  ~event_group();
+  event_group(event_group const &) = delete;
+  event_group &operator=(event_group const &) = delete;
+
+  /**
+   * The calling thread's group, opened on first use.
+   */
+  static event_group &current();
+
+  /**
+   * True if any counter could be opened.
+   */
+  bool available() const { return available_; }
+
+  /**
+   * True if @a event could be opened.
+   */
+  bool available(Event event) const { return fds_[event.v] != -1; }
+
+  /**
+   * True if counters are read with rdpmc.
+   */
+  bool rdpmc() const { return rdpmc_; }
+
+  counters read() const;
+
+ private:
+  uint64_t read_rdpmc(size_t idx) const;
+
+  std::array<int, num_events> fds_;
+  std::array<void *, num_events> pages_{};
+  bool available_{false};
+  bool rdpmc_{false};
+};
+
+/**
+ * Accumulated counters for a named code region.
+ *
+ * Reports "<name>.calls", one entry per event and "<name>.ipc".  Safe to
+ * update from multiple threads.
+ */
+class region_stats final : public StatsImpl {
+ public:
+  explicit region_stats(std::string name);
+
+  void add(counters const &delta);
+
+  uint64_t calls() const { return calls_.load(std::memory_order_relaxed); }
+  uint64_t total(Event e) const {
+    return totals_[e.v].load(std::memory_order_relaxed);
+  }
+
+  void report_stats(StatisticsReporter &reporter) override;
+
+ private:
+  std::string name_;
+  std::atomic<uint64_t> calls_{0};
+  std::array<std::atomic<uint64_t>, num_events> totals_{};
+};
+
+/**
+ * Count hardware events for the lifetime of the scope.
+ *
+ * static sled::perf::region_stats decode_stats("cpu.decode");
+ * {
+ *   sled::perf::perf_region region(decode_stats);
+ *   decode();
+ * }
+ */
+class perf_region {
+ public:
+  explicit perf_region(region_stats &stats)
+      : group_(event_group::current()), stats_(stats), start_(group_.read()) {}
+  ~perf_region() { stats_.add(group_.read() - start_); }
+  perf_region(perf_region const &) = delete;
+  perf_region &operator=(perf_region const &) = delete;
+
+ private:
+  event_group &group_;
+  region_stats &stats_;
+  counters start_;
+};
+
+}  // namespace sled::perf
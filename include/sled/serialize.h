@@ -0,0 +1,602 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "sled/bytestream.h"
+#include "sled/platform.h"
+#include "sled/varint.h"
+
+namespace sled {
+
+/**
+ * Wire encoding of a serialized field.
+ *
+ * be and le store the value in its full size; arrays are stored element by
+ * element.  varint and zigzag use LEB128, zigzag mapping signed values
+ * first.  bits packs the low bits of an integer msb first together with
+ * neighbouring bits fields; a run of them is padded to a whole byte.
+ */
+enum class serial_encoding { be, le, varint, zigzag, bits };
+
+/**
+ * Entry in a serializable fields table.
+ *
+ * T may be std::optional<U>, stored as a presence byte and the value.
+ * Fields only exist in versions [min_version, end_version).
+ */
+template <typename Tag, typename T, serial_encoding E>
+struct serial_field {
+  static constexpr serial_encoding encoding = E;
+  using value_type = T;
+
+  constexpr serial_field(T Tag::*member, int bits, char const *label)
+      : member(member), bits(bits), label(label) {}
+
+  /**
+   * Field added in version.
+   */
+  constexpr serial_field since(uint32_t version) const {
+    auto f = *this;
+    f.min_version = version;
+    return f;
+  }
+
+  /**
+   * Field removed in version.
+   */
+  constexpr serial_field until(uint32_t version) const {
+    auto f = *this;
+    f.end_version = version;
+    return f;
+  }
+
+  constexpr bool active(uint32_t version) const {
+    return version >= min_version && version < end_version;
+  }
+
+  T Tag::*member;
+  int bits;
+  char const *label;
+  uint32_t min_version{0};
+  uint32_t end_version{std::numeric_limits<uint32_t>::max()};
+};
+
+namespace detail {
+
+template <typename T>
+struct serial_optional : std::false_type {
+  using type = T;
+};
+
+template <typename U>
+struct serial_optional<std::optional<U>> : std::true_type {
+  using type = U;
+};
+
+template <typename T>
+struct serial_array : std::false_type {};
+
+template <typename U, size_t N>
+struct serial_array<std::array<U, N>> : std::true_type {
+  using type = U;
+};
+
+template <typename Tag, typename = void>
+struct serial_version {
+  static constexpr uint32_t value = 0;
+};
+
+template <typename Tag>
+struct serial_version<Tag, std::void_t<decltype(Tag::version)>> {
+  static constexpr uint32_t value = Tag::version;
+};
+
+/**
+ * Integer, enum or bool as raw unsigned bits.
+ */
+template <typename U>
+constexpr uint64_t serial_to_wire(U v) {
+  if constexpr (std::is_enum_v<U>) {
+    return serial_to_wire(static_cast<std::underlying_type_t<U>>(v));
+  } else if constexpr (std::is_same_v<U, bool>) {
+    return v ? 1 : 0;
+  } else {
+    static_assert(std::is_integral_v<U>);
+    return static_cast<std::make_unsigned_t<U>>(v);
+  }
+}
+
+/**
+ * Inverse of serial_to_wire(), false if v does not fit in U.
+ */
+template <typename U>
+constexpr bool serial_from_wire(U &out, uint64_t v) {
+  if constexpr (std::is_enum_v<U>) {
+    std::underlying_type_t<U> u{};
+    bool ok = serial_from_wire(u, v);
+    out = static_cast<U>(u);
+    return ok;
+  } else if constexpr (std::is_same_v<U, bool>) {
+    out = v != 0;
+    return v <= 1;
+  } else {
+    static_assert(std::is_integral_v<U>);
+    using unsigned_type = std::make_unsigned_t<U>;
+    out = static_cast<U>(static_cast<unsigned_type>(v));
+    return v <= std::numeric_limits<unsigned_type>::max();
+  }
+}
+
+template <typename U>
+constexpr size_t serial_max_size(serial_encoding e) {
+  if (e == serial_encoding::varint || e == serial_encoding::zigzag) {
+    return (sizeof(U) * 8 + 6) / 7;
+  }
+  return sizeof(U);
+}
+
+/**
+ * Writes fields to [p, end).
+ *
+ * The unchecked writer runs after one size check for the whole record.
+ */
+template <bool Checked>
+struct serial_writer {
+  std::byte *p;
+  std::byte *end;
+  bool ok{true};
+  uint64_t acc{0};
+  int nbits{0};
+
+  a_forceinline bool room(size_t len) {
+    if constexpr (Checked) {
+      if (unlikely(static_cast<size_t>(end - p) < len)) {
+        ok = false;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <bool BigEndian, typename T>
+  a_forceinline void put(T v) {
+    if (room(sizeof(T))) {
+      store_endian<BigEndian, T>(p, v);
+      p += sizeof(T);
+    }
+  }
+
+  a_forceinline void put_bytes(void const *src, size_t len) {
+    if (room(len)) {
+      memcpy(p, src, len);
+      p += len;
+    }
+  }
+
+  a_forceinline void put_varint(uint64_t v) {
+    if constexpr (Checked) {
+      uint8_t buf[varint_max_size];
+      put_bytes(buf, varint_encode(buf, v));
+    } else {
+      p += varint_encode(reinterpret_cast<uint8_t *>(p), v);
+    }
+  }
+
+  a_forceinline void put_bits(uint64_t v, int width) {
+    acc = acc << width | v;
+    nbits += width;
+    while (nbits >= 8) {
+      nbits -= 8;
+      put<true>(static_cast<uint8_t>(acc >> nbits));
+    }
+  }
+
+  a_forceinline void end_bits() {
+    if (nbits > 0) {
+      put<true>(static_cast<uint8_t>(acc << (8 - nbits)));
+      nbits = 0;
+    }
+  }
+
+  template <serial_encoding E, typename U>
+  a_forceinline void value(U const &v, int width) {
+    if constexpr (E == serial_encoding::be || E == serial_encoding::le) {
+      constexpr bool be = E == serial_encoding::be;
+      if constexpr (serial_array<U>::value) {
+        if constexpr (sizeof(typename serial_array<U>::type) == 1) {
+          put_bytes(v.data(), v.size());
+        } else {
+          for (auto const &e : v) {
+            put<be>(e);
+          }
+        }
+      } else {
+        put<be>(v);
+      }
+    } else if constexpr (E == serial_encoding::varint) {
+      put_varint(serial_to_wire(v));
+    } else if constexpr (E == serial_encoding::zigzag) {
+      static_assert(std::is_signed_v<U>);
+      put_varint(zigzag_encode(static_cast<int64_t>(v)));
+    } else {
+      put_bits(serial_to_wire(v) & ((uint64_t{1} << width) - 1), width);
+    }
+  }
+
+  template <typename Tag, typename T, serial_encoding E>
+  a_forceinline void field(serial_field<Tag, T, E> const &f, Tag const &obj,
+                           uint32_t version) {
+    if (!f.active(version)) {
+      return;
+    }
+    if constexpr (E != serial_encoding::bits) {
+      end_bits();
+    }
+    auto const &m = obj.*f.member;
+    if constexpr (serial_optional<T>::value) {
+      put<true>(static_cast<uint8_t>(m.has_value()));
+      if (m) {
+        value<E>(*m, f.bits);
+      }
+    } else {
+      value<E>(m, f.bits);
+    }
+  }
+};
+
+/**
+ * Reads fields from [p, end), see serial_writer.
+ */
+template <bool Checked>
+struct serial_reader {
+  std::byte const *p;
+  std::byte const *end;
+  bool ok{true};
+  uint64_t acc{0};
+  int nbits{0};
+
+  a_forceinline bool room(size_t len) {
+    if constexpr (Checked) {
+      if (unlikely(static_cast<size_t>(end - p) < len)) {
+        ok = false;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <bool BigEndian, typename T>
+  a_forceinline T get() {
+    if (!room(sizeof(T))) {
+      return T{};
+    }
+    auto v = load_endian<BigEndian, T>(p);
+    p += sizeof(T);
+    return v;
+  }
+
+  a_forceinline void get_bytes(void *dst, size_t len) {
+    if (room(len)) {
+      memcpy(dst, p, len);
+      p += len;
+    }
+  }
+
+  a_forceinline uint64_t get_varint() {
+    uint64_t v = 0;
+    size_t n = varint_decode(v, reinterpret_cast<uint8_t const *>(p),
+                             static_cast<size_t>(end - p));
+    if (unlikely(n == 0)) {
+      ok = false;
+    }
+    p += n;
+    return v;
+  }
+
+  a_forceinline uint64_t get_bits(int width) {
+    while (nbits < width) {
+      acc = acc << 8 | get<true, uint8_t>();
+      nbits += 8;
+    }
+    nbits -= width;
+    return (acc >> nbits) & ((uint64_t{1} << width) - 1);
+  }
+
+  a_forceinline void end_bits() { nbits = 0; }
+
+  /**
+   * A be/le value, bools are validated rather than copied.
+   */
+  template <bool BigEndian, typename U>
+  a_forceinline void get_fixed(U &v) {
+    if constexpr (std::is_same_v<U, bool>) {
+      ok &= serial_from_wire(v, get<BigEndian, uint8_t>());
+    } else {
+      v = get<BigEndian, U>();
+    }
+  }
+
+  template <serial_encoding E, typename U>
+  a_forceinline void value(U &v, int width) {
+    if constexpr (E == serial_encoding::be || E == serial_encoding::le) {
+      constexpr bool be = E == serial_encoding::be;
+      if constexpr (serial_array<U>::value) {
+        using element = typename serial_array<U>::type;
+        if constexpr (sizeof(element) == 1 && !std::is_same_v<element, bool>) {
+          get_bytes(v.data(), v.size());
+        } else {
+          for (auto &e : v) {
+            get_fixed<be>(e);
+          }
+        }
+      } else {
+        get_fixed<be>(v);
+      }
+    } else if constexpr (E == serial_encoding::varint) {
+      ok &= serial_from_wire(v, get_varint());
+    } else if constexpr (E == serial_encoding::zigzag) {
+      static_assert(std::is_signed_v<U>);
+      auto s = zigzag_decode(get_varint());
+      v = static_cast<U>(s);
+      ok &= s >= std::numeric_limits<U>::min() &&
+            s <= std::numeric_limits<U>::max();
+    } else {
+      uint64_t raw = get_bits(width);
+      if constexpr (std::is_signed_v<U>) {
+        // Sign extend from width bits.
+        raw = static_cast<uint64_t>(static_cast<int64_t>(raw << (64 - width)) >>
+                                    (64 - width));
+      }
+      serial_from_wire(v, raw);
+    }
+  }
+
+  template <typename Tag, typename T, serial_encoding E>
+  a_forceinline void field(serial_field<Tag, T, E> const &f, Tag &obj,
+                           uint32_t version) {
+    if (!f.active(version)) {
+      return;
+    }
+    if constexpr (E != serial_encoding::bits) {
+      end_bits();
+    }
+    auto &m = obj.*f.member;
+    if constexpr (serial_optional<T>::value) {
+      auto present = get<true, uint8_t>();
+      if (present == 1) {
+        typename serial_optional<T>::type v{};
+        value<E>(v, f.bits);
+        m = v;
+      } else {
+        m.reset();
+        ok &= present == 0;
+      }
+    } else {
+      value<E>(m, f.bits);
+    }
+  }
+};
+
+template <typename F>
+constexpr void serial_add_max_size(F const &f, uint32_t version,
+                                   size_t &bytes, int &bits) {
+  if (!f.active(version)) {
+    return;
+  }
+  if (F::encoding == serial_encoding::bits) {
+    debug_assert(f.bits > 0 && f.bits <= 56);
+    bits += f.bits;
+    return;
+  }
+  bytes += static_cast<size_t>(bits + 7) / 8;
+  bits = 0;
+  using T = typename F::value_type;
+  using U = typename serial_optional<T>::type;
+  bytes += serial_optional<T>::value ? 1 : 0;
+  bytes += serial_max_size<U>(F::encoding);
+}
+
+}  // namespace detail
+
+/**
+ * Declarative binary serialization.
+ *
+ * A struct lists its fields, their wire encoding and the versions they
+ * exist in, much like struct_bitfield::fields.  encode() and decode() are
+ * generated from the table at compile time: every field is inlined and a
+ * record that fits in the cursor is bounds checked once.
+ *
+ * \code{.cpp}
+ * struct cpu_state : sled::serializable<cpu_state> {
+ *   static constexpr uint32_t version = 2;
+ *
+ *   uint16_t pc{0};
+ *   uint8_t flags{0};
+ *   uint8_t irq_level{0};
+ *   uint64_t cycles{0};
+ *   std::optional<uint16_t> breakpoint;
+ *
+ *   static constexpr auto fields = std::make_tuple(
+ *       make_be_field(&cpu_state::pc, "pc"),
+ *       make_bits_field(&cpu_state::flags, 5, "flags"),
+ *       make_bits_field(&cpu_state::irq_level, 3, "irq_level"),
+ *       make_varint_field(&cpu_state::cycles, "cycles"),
+ *       make_le_field(&cpu_state::breakpoint, "breakpoint").since(2));
+ * };
+ * \endcode{}
+ *
+ * Fields outside the version being decoded keep their current values.
+ */
+template <typename Tag>
+struct serializable {
+  /**
+   * Tag::version if declared, otherwise 0.
+   */
+  static constexpr uint32_t current_version() {
+    return detail::serial_version<Tag>::value;
+  }
+
+  template <typename T>
+  static constexpr serial_field<Tag, T, serial_encoding::be> make_be_field(
+      T Tag::*member, char const *label) {
+    return {member, 0, label};
+  }
+
+  template <typename T>
+  static constexpr serial_field<Tag, T, serial_encoding::le> make_le_field(
+      T Tag::*member, char const *label) {
+    return {member, 0, label};
+  }
+
+  template <typename T>
+  static constexpr serial_field<Tag, T, serial_encoding::varint>
+  make_varint_field(T Tag::*member, char const *label) {
+    return {member, 0, label};
+  }
+
+  template <typename T>
+  static constexpr serial_field<Tag, T, serial_encoding::zigzag>
+  make_zigzag_field(T Tag::*member, char const *label) {
+    return {member, 0, label};
+  }
+
+  /**
+   * Field packed into width (1 to 56) bits.
+   */
+  template <typename T>
+  static constexpr serial_field<Tag, T, serial_encoding::bits> make_bits_field(
+      T Tag::*member, int width, char const *label) {
+    static_assert(!detail::serial_optional<T>::value,
+                  "bits fields can not be optional");
+    // Wider fields overflow the 64-bit bit accumulator.
+    debug_assert(width > 0 && width <= 56);
+    return {member, width, label};
+  }
+
+  /**
+   * Largest encoding of the fields in version.
+   */
+  static constexpr size_t max_encoded_size(
+      uint32_t version = current_version()) {
+    size_t bytes = 0;
+    int bits = 0;
+    std::apply(
+        [&](auto const &... f) {
+          (detail::serial_add_max_size(f, version, bytes, bits), ...);
+        },
+        Tag::fields);
+    return bytes + static_cast<size_t>(bits + 7) / 8;
+  }
+
+  /**
+   * Write the fields present in version.
+   *
+   * On failure (not enough room) the cursor is left where it was.
+   */
+  bool encode(byte_cursor &c, uint32_t version = current_version()) const {
+    if (likely(c.remaining() >= required_size(version))) {
+      return encode_fields<false>(c, version, field_indices());
+    }
+    return encode_fields<true>(c, version, field_indices());
+  }
+
+  /**
+   * Read the fields present in version.
+   *
+   * On failure (truncated or malformed input) the cursor is left where it
+   * was and the fields are unspecified.  Reads from byte_cursor or
+   * const_byte_cursor.
+   */
+  template <typename Byte>
+  bool decode(basic_byte_cursor<Byte> &c,
+              uint32_t version = current_version()) {
+    if (likely(c.remaining() >= required_size(version))) {
+      return decode_fields<false>(c, version, field_indices());
+    }
+    return decode_fields<true>(c, version, field_indices());
+  }
+
+  /**
+   * encode() preceded by current_version() as a varint.
+   */
+  bool serialize(byte_cursor &c) const {
+    size_t pos = c.position();
+    if (!c.write_varint(current_version()) || !encode(c)) {
+      c.seek(pos);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Read a version and decode(); versions newer than current_version()
+   * are rejected.
+   */
+  template <typename Byte>
+  bool deserialize(basic_byte_cursor<Byte> &c) {
+    auto *begin = c.span().data() + c.position();
+    detail::serial_reader<true> r{begin, c.span().end()};
+    uint64_t version = r.get_varint();
+    if (!r.ok || version > current_version()) {
+      return false;
+    }
+    c.skip_unchecked(static_cast<size_t>(r.p - begin));
+    if (!decode(c, static_cast<uint32_t>(version))) {
+      c.seek(static_cast<size_t>(begin - c.span().data()));
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  static constexpr auto field_indices() {
+    return std::make_index_sequence<
+        std::tuple_size_v<std::decay_t<decltype(Tag::fields)>>>{};
+  }
+
+  static a_forceinline size_t required_size(uint32_t version) {
+    constexpr size_t current = max_encoded_size(current_version());
+    return version == current_version() ? current : max_encoded_size(version);
+  }
+
+  template <bool Checked, size_t... I>
+  a_forceinline bool encode_fields(byte_cursor &c, uint32_t version,
+                                   std::index_sequence<I...>) const {
+    auto const &obj = static_cast<Tag const &>(*this);
+    auto *begin = c.span().data() + c.position();
+    detail::serial_writer<Checked> w{begin, c.span().end()};
+    (w.field(std::get<I>(Tag::fields), obj, version), ...);
+    w.end_bits();
+    if (likely(w.ok)) {
+      c.skip_unchecked(static_cast<size_t>(w.p - begin));
+    }
+    return w.ok;
+  }
+
+  template <bool Checked, typename Byte, size_t... I>
+  a_forceinline bool decode_fields(basic_byte_cursor<Byte> &c,
+                                   uint32_t version,
+                                   std::index_sequence<I...>) {
+    auto &obj = static_cast<Tag &>(*this);
+    auto *begin = c.span().data() + c.position();
+    detail::serial_reader<Checked> r{begin, c.span().end()};
+    (r.field(std::get<I>(Tag::fields), obj, version), ...);
+    if (likely(r.ok)) {
+      c.skip_unchecked(static_cast<size_t>(r.p - begin));
+    }
+    return r.ok;
+  }
+};
+
+}  // namespace sled
@@ -5,13 +5,99 @@
  */
 #pragma once
 
+#include <string_view>
+
+#include "sled/arch.h"
+#include "sled/hash.h"
 #include "sled/platform.h"
 
 namespace sled {
+
+/**
+ * Apply the SHA1 compression function to @a count 64 byte blocks.
+ *
+ * hwarch is portable, sha_hwarch uses the SHA extensions.
+ */
+template <typename Arch>
+void sha1_compress(uint32_t state[5], uint8_t const *blocks, size_t count);
+
+template <>
+void sha1_compress<hwarch>(uint32_t state[5], uint8_t const *blocks,
+                           size_t count);
+
+template <>
+void sha1_compress<sha_hwarch>(uint32_t state[5], uint8_t const *blocks,
+                               size_t count);
+
+/**
+ * Compress using the fastest available implementation.
+ */
+void sha1_compress(uint32_t state[5], uint8_t const *blocks, size_t count);
+
+/**
+ * SHA1 hash function.
+ *
+ * Only use with legacy code, e.g. identifying ROM images.
+ *
+ * sha1_hash h;
+ * h.update(header, sizeof(header));
+ * h.update(body, body_len);
+ * std::cout << h.finalize();
+ */
+class sha1_hash {
+ public:
+  sha1_hash() { reset(); }
+
+  void update(void const *data, size_t len);
+
+  void update(std::string_view val) { update(val.data(), val.size()); }
+
+  /**
+   * Pad the message and return its hash.  Call reset() before reuse.
+   */
+  sha1 finalize();
+
+  void reset();
+
+  /**
+   * Hash a single buffer.
+   */
+  static sha1 compute(void const *data, size_t len) {
+    sha1_hash h;
+    h.update(data, len);
+    return h.finalize();
+  }
+
+ private:
+  uint32_t state_[5];
+  uint64_t size_;
+  uint8_t buf_[64];
+};
+
 /**
- * SHA1 hash value.
+ * Hash @a count independent buffers.
  *
- * Only use with legacy code.
+ * avx2_hwarch hashes eight buffers in lockstep, one per 32-bit lane, which
+ * pays off when many similarly sized inputs are hashed, e.g. scanning a ROM
+ * database.  Lanes that finish early idle until the longest buffer in the
+ * group is done.
  */
-struct sha1_hash {};
+template <typename Arch>
+void sha1_hash_many(void const *const *data, size_t const *len, sha1 *out,
+                    size_t count);
+
+template <>
+void sha1_hash_many<hwarch>(void const *const *data, size_t const *len,
+                            sha1 *out, size_t count);
+
+template <>
+void sha1_hash_many<avx2_hwarch>(void const *const *data, size_t const *len,
+                                 sha1 *out, size_t count);
+
+/**
+ * Hash many buffers using the fastest available implementation.
+ */
+void sha1_hash_many(void const *const *data, size_t const *len, sha1 *out,
+                    size_t count);
+
 }  // namespace sled
@@ -5,9 +5,19 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
+#include "sled/enum.h"
+#include "sled/hash.h"
 #include "sled/platform.h"
+#include "sled/strong_int.h"
 
 namespace sled {
 
@@ -87,7 +97,8 @@ class StatisticsReport : public StatisticsReporter {
   StatisticImpl get(const std::string &name) override;
 
  private:
-  std::unordered_map<std::string, StatisticImpl> m_statistics;
+  std::unordered_map<std::string, StatisticImpl, sled::string_hash>
+      m_statistics;
 };
 
 /**
@@ -97,4 +108,209 @@ struct StatsImpl {
   virtual void report_stats(StatisticsReporter &reporter) = 0;
 };
 
+/**
+ * Kind of a registered metric.
+ */
+struct MetricKind final : enum_struct<uint32_t, MetricKind> {
+  static constexpr std::array<name_type, 2> names{
+      std::make_pair(0, "Counter"), std::make_pair(1, "Aggregate")};
+
+  using enum_struct::enum_struct;
+
+  struct V;
+};
+
+struct MetricKind::V {
+  static constexpr MetricKind Counter{0};
+  static constexpr MetricKind Aggregate{1};
+};
+
+/**
+ * Metric identifier, returned by StatsRegistry registration.
+ */
+struct MetricId : StrongInt<uint32_t, MetricId> {
+  using StrongInt<uint32_t, MetricId>::StrongInt;
+};
+
+/**
+ * Value of a metric summed over all threads.
+ */
+struct MetricValue {
+  std::string name;
+  MetricKind kind{MetricKind::V::Counter};
+  int64_t sum{0};
+  int64_t count{0};
+
+  // NOLINTNEXTLINE
+  operator StatisticImpl() const {
+    if (kind == MetricKind::V::Aggregate) {
+      return StatisticImpl{count == 0 ? 0.0
+                                      : static_cast<double>(sum) / count};
+    }
+    return StatisticImpl{static_cast<double>(sum)};
+  }
+};
+
+/**
+ * Thread safe statistics registry.
+ *
+ * Metrics are registered once by name and updated by id.  Every thread
+ * updates its own cache line aligned shard without locked instructions;
+ * readers sum the shards.  Each shard is guarded by a sequence counter so a
+ * snapshot sees every thread's updates either entirely or not at all (e.g.
+ * an aggregate's sum and count always match).
+ *
+ * Example:
+ * StatsRegistry stats;
+ * auto tasks = stats.add_counter("tasks");
+ * stats.add(tasks);
+ */
+class StatsRegistry final : public StatsImpl {
+ public:
+  static constexpr size_t default_capacity = 1024;
+
+  /**
+   * Create a registry holding up to @a capacity slots.  Counters use one
+   * slot and aggregates two.
+   */
+  explicit StatsRegistry(size_t capacity = default_capacity);
+  ~StatsRegistry();
+  StatsRegistry(StatsRegistry const &) = delete;
+  StatsRegistry &operator=(StatsRegistry const &) = delete;
+
+  /**
+   * Register a counter, or return the existing id for @a name.
+   *
+   * Throws sled::Exception once the registry is full or if @a name is
+   * registered with a different kind.
+   */
+  MetricId add_counter(std::string const &name);
+
+  /**
+   * Register an aggregate (mean of recorded values).
+   */
+  MetricId add_aggregate(std::string const &name);
+
+  /**
+   * Find a registered metric, throws sled::Exception if unknown.
+   */
+  MetricId find(std::string const &name) const;
+
+  /**
+   * Add @a n to counter @a id.
+   */
+  a_forceinline void add(MetricId id, int64_t n = 1) {
+    auto &shard = local_shard();
+    shard.begin_update();
+    shard.bump(id.v, n);
+    shard.end_update();
+  }
+
+  /**
+   * Record @a value in aggregate @a id.
+   */
+  a_forceinline void record(MetricId id, int64_t value) {
+    auto &shard = local_shard();
+    shard.begin_update();
+    shard.bump(id.v, value);
+    shard.bump(id.v + 1, 1);
+    shard.end_update();
+  }
+
+  /**
+   * Current value of a single metric.
+   */
+  MetricValue get(MetricId id) const;
+
+  /**
+   * Values of all registered metrics, in registration order.
+   */
+  std::vector<MetricValue> snapshot() const;
+
+  void report_stats(StatisticsReporter &reporter) override;
+
+ private:
+  struct alignas(64) Line {
+    std::atomic<int64_t> v[8]{};
+  };
+
+  /**
+   * Per-thread counters, written only by the owning thread.
+   */
+  struct alignas(64) Shard {
+    explicit Shard(size_t capacity) : lines((capacity + 7) / 8) {}
+
+    a_forceinline std::atomic<int64_t> &slot(uint32_t i) {
+      return lines[i / 8].v[i % 8];
+    }
+
+    a_forceinline void begin_update() {
+      seq.store(seq.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    a_forceinline void end_update() {
+      seq.store(seq.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    }
+
+    a_forceinline void bump(uint32_t i, int64_t n) {
+      auto &s = slot(i);
+      s.store(s.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+    }
+
+    /**
+     * Add a consistent copy of the first @a count slots to @a totals.
+     */
+    void read(std::vector<int64_t> &totals, size_t count);
+
+    std::atomic<uint64_t> seq{0};
+    std::vector<Line> lines;
+  };
+
+  struct Metric {
+    std::string name;
+    MetricKind kind;
+    uint32_t slot;
+  };
+
+  /**
+   * Shard used by this thread for a registry.
+   */
+  struct ShardCache {
+    uint64_t serial;
+    Shard *shard;
+  };
+
+  /**
+   * Per-thread cache entries, direct mapped by registry serial.  Serials are
+   * never reused so a stale entry can't match.
+   */
+  static constexpr size_t cache_entries = 8;
+
+  a_forceinline Shard &local_shard() {
+    auto &entry = cache_[serial_ % cache_entries];
+    if (likely(entry.serial == serial_)) {
+      return *entry.shard;
+    }
+    return register_thread();
+  }
+
+  Shard &register_thread();
+  MetricId add_metric(std::string const &name, MetricKind kind);
+  std::vector<int64_t> totals() const;
+
+  static thread_local std::array<ShardCache, cache_entries> cache_;
+
+  uint64_t serial_;
+  size_t capacity_;
+  mutable std::mutex mtx_;
+  std::vector<Metric> metrics_;
+  uint32_t used_{0};
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::unordered_map<std::thread::id, Shard *> thread_shards_;
+};
+
 }  // namespace sled
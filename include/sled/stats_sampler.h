@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sled/statistics.h"
+#include "sled/time.h"
+
+namespace sled {
+
+/**
+ * StatsSampler options.
+ */
+struct StatsSamplerOptions {
+  sled::time interval{sec(1)}; /**< Time between samples. */
+  size_t history{3600};        /**< Samples kept in memory. */
+  std::string prometheus_path; /**< Rewritten after every sample. */
+  std::string csv_path;        /**< One row appended per sample. */
+  std::string socket_path;     /**< Unix socket serving Prometheus text. */
+};
+
+/**
+ * Periodic statistics sampler.
+ *
+ * Snapshots every registered StatsImpl provider at a fixed interval into a
+ * bounded in-memory time series.  Series marked with track_rate() also
+ * export their per-second rate of change, e.g. "frames" becomes
+ * "frames_rate".
+ *
+ * Each sample can be exported as a Prometheus text file (suitable for the
+ * node exporter textfile collector), appended to a CSV file, and served to
+ * anything connecting to a Unix socket:
+ *
+ * StatsSamplerOptions opts;
+ * opts.socket_path = "/tmp/emu.stats";
+ * StatsSampler sampler(opts);
+ * sampler.add_provider(executor_stats, "exec.");
+ * sampler.start();
+ * ...
+ * $ socat - UNIX-CONNECT:/tmp/emu.stats
+ */
+class StatsSampler {
+ public:
+  explicit StatsSampler(StatsSamplerOptions opts = {});
+  ~StatsSampler();
+  StatsSampler(StatsSampler const &) = delete;
+  StatsSampler &operator=(StatsSampler const &) = delete;
+
+  /**
+   * Sample @a provider, prefixing its statistic names with @a prefix.
+   *
+   * The provider must outlive the sampler or be removed first.
+   */
+  void add_provider(StatsImpl &provider, std::string prefix = "");
+  void remove_provider(StatsImpl &provider);
+
+  /**
+   * Export the per-second rate of change of series @a name.  Rates are
+   * opt-in, since only the caller knows which series are counters.
+   */
+  void track_rate(std::string const &name);
+
+  /**
+   * Start the background sampling thread.  Throws sled::Exception if the
+   * Unix socket cannot be created.
+   */
+  void start();
+
+  /**
+   * Stop the background thread, if running.
+   */
+  void stop();
+
+  /**
+   * Take a sample immediately and export it.
+   */
+  void sample();
+
+  /**
+   * Take a sample stamped @a when, relative to the sampler's creation, for
+   * callers that drive their own clock.
+   */
+  void sample(sled::time when);
+
+  /**
+   * Names of all series seen so far.
+   */
+  std::vector<std::string> series() const;
+
+  /**
+   * Recorded (time, value) pairs of series @a name, oldest first.
+   */
+  std::vector<std::pair<sled::time, double>> history(
+      std::string const &name) const;
+
+  /**
+   * Most recent value of series @a name, 0 if unknown.
+   */
+  double latest(std::string const &name) const;
+
+  /**
+   * Per-second rate of change of series @a name over the last two samples.
+   */
+  double rate(std::string const &name) const;
+
+  /**
+   * Write the most recent sample in Prometheus text exposition format.
+   */
+  void write_prometheus(std::ostream &os) const;
+
+  /**
+   * Write the whole history as CSV, one row per sample.
+   */
+  void write_csv(std::ostream &os) const;
+
+ private:
+  struct Sample {
+    sled::time when;
+    std::vector<double> values;  // Indexed like names_
+  };
+
+  void run();
+  void serve_client();
+  void export_sample();
+  double value(Sample const &sample, size_t idx) const;
+  double rate_locked(size_t idx) const;
+  void write_prometheus_locked(std::ostream &os) const;
+
+  StatsSamplerOptions opts_;
+  mutable std::mutex mtx_;
+  std::vector<std::pair<StatsImpl *, std::string>> providers_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, size_t, sled::string_hash> index_;
+  std::set<std::string> rates_;
+  std::deque<Sample> samples_;
+  sled::time start_;
+  size_t csv_columns_{0};
+  std::thread thread_;
+  int wake_fd_[2]{-1, -1};
+  int listen_fd_{-1};
+  bool bound_{false};  // socket_path was created by this instance
+};
+
+}  // namespace sled
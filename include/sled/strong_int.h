@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "sled/hash.h"
 #include "sled/numeric.h"
 #include "sled/platform.h"
 
@@ -142,6 +143,19 @@ template <typename T, typename Tag>
 struct __is_wrapped_integer_helper<StrongInt<T, Tag>> : public std::true_type {
 };
 
+/**
+ * Hasher for StrongInt and types derived from it.
+ *
+ * std::hash is only specialized for StrongInt itself, derived tags need:
+ * std::unordered_map<crc32c, T, sled::strong_int_hash> m;
+ */
+struct strong_int_hash {
+  template <typename T, typename Tag>
+  size_t operator()(StrongInt<T, Tag> const &x) const {
+    return static_cast<size_t>(hash_mix64(static_cast<uint64_t>(x.v)));
+  }
+};
+
 };  // namespace sled
 
 namespace std {
@@ -149,7 +163,7 @@ template <class T, typename Tag>
 class hash<sled::StrongInt<T, Tag>> {
  public:
   size_t operator()(sled::StrongInt<T, Tag> const &x) const {
-    return std::hash<T>()(x.v);
+    return sled::strong_int_hash()(x);
   }
 };
 }  // namespace std
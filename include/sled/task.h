@@ -11,6 +11,7 @@
 #include "sled/future.h"
 #include "sled/ident.h"
 #include "sled/lock.h"
+#include "sled/log.h"
 #include "sled/type_traits.h"
 
 #include <functional>
@@ -56,7 +57,7 @@ class Task {
  public:
   using task_fn = func::function<void() noexcept>;
 
-  Task() : flags_(), ident_() {}
+  Task() : flags_(), id_(TaskId::next()) {}
 
   virtual ~Task() = default;
   Task(const Task &task) = delete;
@@ -64,16 +65,17 @@ class Task {
   /**
    * Identity
    *
-   * Returns the detailed task identity for logging and debugging.
+   * Returns the detailed task identity for logging and debugging.  Built on
+   * demand so tasks only carry their id.
    */
-  sled::ident const &ident() const { return ident_; }
+  sled::ident ident() const { return sled::ident("", id_.id); }
 
   /**
    * Id.
    *
    * @returns task id.
    */
-  TaskId id() const { return {ident_.id()}; }
+  TaskId id() const { return id_; }
 
   /**
    * Execute the actual task.  This call is done within the exec_ctx.
@@ -116,7 +118,7 @@ class Task {
   // XXX: void log(LogLevel level, const std::string &fmt);
 
   TaskFlags flags_;
-  sled::ident ident_;
+  TaskId id_;
 };
 
 /**
@@ -156,6 +158,7 @@ class ExecTask : public task_type_t<Fn> {
   ExecTask(ExecTask &&rhs) = default;
 
   void run() final {
+    sled::log::task_scope scope(sled::log::task_id_t{this->id().id});
     if constexpr (std::is_same<void, result_t>::value) {
       closure_();
       future_.set_result();
@@ -4,6 +4,8 @@
  */
 #pragma once
 
+#include <atomic>
+
 #include "sled/platform.h"
 #include "sled/strong_int.h"
 
@@ -36,7 +38,7 @@ struct sec final : public StrongInt<int64_t, nsec> {
 
 struct time final : public StrongInt<int64_t, time> {
   // NOLINTNEXTLINE
-  constexpr time() = default;
+  constexpr time() : StrongInt<int64_t, time>(0) {}
   constexpr time(int64_t t) : StrongInt<int64_t, time>(t) {}
   template <typename T>
   constexpr time(T t) : StrongInt<int64_t, time>(t.v * T::NSECS) {}
@@ -262,4 +264,150 @@ class stopwatch {
 };
 #endif
 
+/**
+ * Time stamp counter value.
+ *
+ * Raw TSC ticks. Use tsc_calibration to convert to relative or wall time.
+ */
+struct tsc_t : StrongInt<uint64_t, tsc_t> {
+  using StrongInt<uint64_t, tsc_t>::StrongInt;
+
+  /**
+   * Read the TSC.
+   *
+   * The read isn't ordered with respect to surrounding instructions.
+   */
+  static a_forceinline tsc_t now() { return tsc_t{__rdtsc()}; }
+
+  /**
+   * Read the TSC after all previous instructions have executed (rdtscp).
+   */
+  static a_forceinline tsc_t now_ordered() {
+    unsigned int aux;
+    return tsc_t{__rdtscp(&aux)};
+  }
+};
+
+/**
+ * TSC calibration.
+ *
+ * Relates the TSC to the monotonic and wall clocks.  Calibration happens once
+ * on first use and takes a few milliseconds.  Conversion is a multiply and
+ * shift.
+ */
+struct tsc_calibration {
+  tsc_t base_tsc{0};        /**< TSC at calibration. */
+  sled::time base_mono{};   /**< Monotonic time at base_tsc. */
+  sled::time base_wall{};   /**< Wall clock (since epoch) at base_tsc. */
+  uint64_t mult{0};         /**< Nanoseconds per tick, scaled by 2^shift. */
+  bool invariant{false};    /**< CPU reports an invariant TSC. */
+  static constexpr int shift = 32;
+
+  /**
+   * Return the process wide calibration, calibrating if required.
+   */
+  static tsc_calibration const &get();
+
+  /**
+   * Convert a number of ticks to nanoseconds.
+   */
+  constexpr int64_t to_nsec(uint64_t ticks) const noexcept {
+    // Split the multiply to avoid overflowing 64 bits.
+    uint64_t hi = (ticks >> shift) * mult;
+    uint64_t lo = ((ticks & ((1ull << shift) - 1)) * mult) >> shift;
+    return static_cast<int64_t>(hi + lo);
+  }
+
+  /**
+   * Convert nanoseconds to a number of ticks.
+   */
+  constexpr uint64_t to_ticks(int64_t ns) const noexcept {
+    if (mult == 0 || ns <= 0) {
+      return 0;
+    }
+    return static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(ns) << shift) / mult);
+  }
+
+  /**
+   * Time of @a tsc relative to calibration.
+   */
+  constexpr sled::time relative(tsc_t tsc) const noexcept {
+    if (tsc.v >= base_tsc.v) {
+      return sled::time{to_nsec(tsc.v - base_tsc.v)};
+    }
+    return sled::time{-to_nsec(base_tsc.v - tsc.v)};
+  }
+
+  /**
+   * Monotonic clock time of @a tsc.
+   */
+  constexpr sled::time monotonic(tsc_t tsc) const noexcept {
+    return base_mono + relative(tsc);
+  }
+
+  /**
+   * Wall clock time (since the epoch) of @a tsc.
+   */
+  constexpr sled::time wall(tsc_t tsc) const noexcept {
+    return base_wall + relative(tsc);
+  }
+};
+
+/**
+ * Monotonic clock read from the TSC.
+ *
+ * Much cheaper than clock_gettime(), at the cost of drifting slowly from
+ * CLOCK_MONOTONIC.  Only trustworthy across cores and power states when
+ * invariant() is true.
+ */
+struct tsc_clock {
+  static a_forceinline time now() {
+    return tsc_calibration::get().monotonic(tsc_t::now());
+  }
+
+  /**
+   * Ordered read, see tsc_t::now_ordered().
+   */
+  static a_forceinline time now_ordered() {
+    return tsc_calibration::get().monotonic(tsc_t::now_ordered());
+  }
+
+  /**
+   * True if the CPU reports an invariant TSC (CPUID 0x80000007 EDX[8]).
+   */
+  static bool invariant() { return tsc_calibration::get().invariant; }
+};
+
+/**
+ * Low resolution monotonic clock.
+ *
+ * now() is a single relaxed load of a time updated by a background thread
+ * every resolution.  Until start() is called now() falls back to
+ * stopwatch::now().
+ */
+class coarse_clock {
+ public:
+  static a_forceinline time now() {
+    auto t = now_.load(std::memory_order_relaxed);
+    if (unlikely(t == 0)) {
+      return stopwatch::now();
+    }
+    return time{t};
+  }
+
+  /**
+   * Start the background tick, does nothing if already running.
+   */
+  static void start(time resolution = msec(1));
+
+  /**
+   * Stop the background tick.  now() falls back to stopwatch::now().
+   */
+  static void stop();
+
+ private:
+  static std::atomic<int64_t> now_;
+};
+
 }  // namespace sled
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "sled/arch.h"
+#include "sled/platform.h"
+
+namespace sled {
+
+/**
+ * Largest LEB128 encoding of a 64-bit value.
+ */
+constexpr size_t varint_max_size = 10;
+
+/**
+ * Largest LEB128 encoding of a 32-bit value.
+ */
+constexpr size_t varint32_max_size = 5;
+
+/**
+ * Map signed values to unsigned so small magnitudes encode small.
+ *
+ * 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+ */
+constexpr uint64_t zigzag_encode(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+constexpr uint32_t zigzag_encode(int32_t v) {
+  return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+constexpr int64_t zigzag_decode(uint64_t v) {
+  return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+constexpr int32_t zigzag_decode(uint32_t v) {
+  return static_cast<int32_t>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+/**
+ * Encoded size of v.
+ */
+inline size_t varint_size(uint64_t v) {
+  return static_cast<size_t>(70 - __builtin_clzll(v | 1)) / 7;
+}
+
+/**
+ * LEB128 encode v into dst (at least varint_size(v) bytes).
+ *
+ * Returns the number of bytes written.
+ */
+a_forceinline size_t varint_encode(uint8_t *dst, uint64_t v) {
+  if (likely(v < 0x80)) {
+    dst[0] = static_cast<uint8_t>(v);
+    return 1;
+  }
+  if (likely(v < 0x4000)) {
+    dst[0] = static_cast<uint8_t>(v | 0x80);
+    dst[1] = static_cast<uint8_t>(v >> 7);
+    return 2;
+  }
+  size_t n = 0;
+  for (; v >= 0x80; v >>= 7) {
+    dst[n++] = static_cast<uint8_t>(v | 0x80);
+  }
+  dst[n++] = static_cast<uint8_t>(v);
+  return n;
+}
+
+/**
+ * Decode a value of more than 2 bytes, see varint_decode().
+ */
+size_t varint_decode_slow(uint64_t &v, uint8_t const *src, size_t len,
+                          int max_bits);
+
+/**
+ * LEB128 decode a uint32_t or uint64_t from [src, src + len).
+ *
+ * Returns the number of bytes consumed, or 0 if the input is truncated,
+ * longer than the type allows or overflows it.  1 and 2 byte values are
+ * decoded inline.
+ */
+template <typename T>
+a_forceinline size_t varint_decode(T &v, uint8_t const *src, size_t len) {
+  static_assert(std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>);
+  if (likely(len >= 2)) {
+    if (likely(src[0] < 0x80)) {
+      v = src[0];
+      return 1;
+    }
+    if (likely(src[1] < 0x80)) {
+      v = static_cast<T>((src[0] & 0x7f) | (src[1] << 7));
+      return 2;
+    }
+  }
+  uint64_t r = 0;
+  size_t n = varint_decode_slow(r, src, len, sizeof(T) * 8);
+  v = static_cast<T>(r);
+  return n;
+}
+
+/**
+ * Result of a batch decode.
+ */
+struct varint_decode_result {
+  size_t count{0};    /**< Values written to dst. */
+  size_t consumed{0}; /**< Bytes of input used. */
+};
+
+/**
+ * Decode up to count uint32_t values from [src, src + len).
+ *
+ * Stops after count values, at the end of the input or before a malformed
+ * value.  The ssse3 version is the Masked-VByte decoder: the continuation
+ * bits of 12 bytes index a table of pshufb patterns that gather up to 6
+ * values at once.
+ */
+template <typename Arch>
+varint_decode_result varint_decode_array(uint32_t *dst, size_t count,
+                                         uint8_t const *src, size_t len);
+
+template <>
+varint_decode_result varint_decode_array<hwarch>(uint32_t *dst, size_t count,
+                                                 uint8_t const *src,
+                                                 size_t len);
+
+template <>
+varint_decode_result varint_decode_array<ssse3_hwarch>(uint32_t *dst,
+                                                       size_t count,
+                                                       uint8_t const *src,
+                                                       size_t len);
+
+varint_decode_result varint_decode_array(uint32_t *dst, size_t count,
+                                         uint8_t const *src, size_t len);
+
+/**
+ * Encode count values into dst (at least count * varint32_max_size bytes).
+ *
+ * Returns the number of bytes written.
+ */
+size_t varint_encode_array(uint8_t *dst, uint32_t const *src, size_t count);
+
+}  // namespace sled
@@ -196,7 +196,30 @@ struct CPUID7_EBX_FEATURES
                            CPUID7_EBX_FEATURES>::flags_struct;
 };
 
-template <int arg, typename EAX_RETURN = uint32_t,
+struct CPUID80000007_EDX_FEATURE final
+    : sled::enum_struct<uint32_t, CPUID80000007_EDX_FEATURE> {
+ public:
+  static constexpr std::array<name_type, 1> names{
+      std::make_pair(1 << 8, "INVARIANT_TSC"),
+  };
+
+  using sled::enum_struct<uint32_t, CPUID80000007_EDX_FEATURE>::enum_struct;
+
+  struct V;
+};
+
+struct CPUID80000007_EDX_FEATURE::V {
+  static constexpr CPUID80000007_EDX_FEATURE INVARIANT_TSC{1 << 8};
+};
+
+struct CPUID80000007_EDX_FEATURES
+    : public sled::flags_struct<CPUID80000007_EDX_FEATURE,
+                                CPUID80000007_EDX_FEATURES> {
+  using sled::flags_struct<CPUID80000007_EDX_FEATURE,
+                           CPUID80000007_EDX_FEATURES>::flags_struct;
+};
+
+template <uint32_t arg, typename EAX_RETURN = uint32_t,
           typename EBX_RETURN = uint32_t, typename ECX_RETURN = uint32_t,
           typename EDX_RETURN = uint32_t>
 class cpuid_call {
@@ -224,5 +247,8 @@ class cpuid_call {
 using CPUID1 =
     cpuid_call<1, uint32_t, uint32_t, CPUID1_ECX_FEATURES, CPUID1_EDX_FEATURES>;
 using CPUID7 = cpuid_call<7, uint32_t, CPUID7_EBX_FEATURES, uint32_t, uint32_t>;
+using CPUID80000000 = cpuid_call<0x80000000>;
+using CPUID80000007 = cpuid_call<0x80000007, uint32_t, uint32_t, uint32_t,
+                                 CPUID80000007_EDX_FEATURES>;
 
 }  // namespace sled::x86
@@ -63,3 +63,18 @@ TEST_F(MockedTaskTest, create_strand) {
   auto strand = exec_ctx.create_strand();
 }
 #endif
+
+TEST_F(MockedTaskTest, task_id) {
+  uint64_t inner_id = 0;
+  auto task1 = exec_ctx.create_task([&]() {
+    inner_id = sled::log::task_id_t::self().v;
+  });
+  auto task2 = exec_ctx.create_task([]() { return 2; });
+  EXPECT_NE(task1.id().id, task2.id().id);
+  EXPECT_EQ(task1.id().id, task1.ident().id());
+  auto f1 = task1.queue_start();
+  exec_ctx.resume();
+  f1->wait();
+  EXPECT_EQ(task1.id().id, inner_id);
+  EXPECT_EQ(0u, sled::log::task_id_t::self().v);
+}
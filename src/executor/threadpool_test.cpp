@@ -4,6 +4,7 @@
  * Licensed under BSD-2-Clause license.
  */
 #include "sled/threadpool.h"
+#include "sled/crc.h"
 
 #include "gtest/gtest.h"
 
@@ -96,3 +97,22 @@ TEST_F(TpExecutorTest, multiple_threads) {
     thr->join();
   }
 }
+
+TEST_F(TpExecutorTest, parallel_crc32c) {
+  std::vector<uint8_t> data(1024 * 1024 + 123);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * 31 + (i >> 8));
+  }
+  std::vector<std::unique_ptr<std::thread>> threads;
+  for (int i = 0; i < 3; i++) {
+    threads.push_back(std::make_unique<std::thread>(thread_fn, &exec_ctx));
+  }
+  sled::crc32c initial{0xffffffff};
+  auto crc = sled::calculate_crc32c_parallel(exec_ctx, data.data(),
+                                             data.size(), initial, 64 * 1024);
+  EXPECT_EQ(sled::calculate_crc32c(data, initial), crc);
+  exec_ctx.shutdown();
+  for (auto &thr : threads) {
+    thr->join();
+  }
+}
@@ -4,109 +4,658 @@
  * Licensed under BSD-2-Clause license.
  */
 #include "sled/base64.h"
+
+#include <algorithm>
+#include <cstring>
+
 #include "sled/platform.h"
 
 namespace sled {
 
-static constexpr char base64_encode_lookup[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-static_assert(sizeof(base64_encode_lookup) == 65);
-
-static constexpr inline char base64_encode_byte(std::byte b) {
-  int v = std::to_integer<int>(b);
-  debug_assert(v >= 0 && v <= 63);
-  return base64_encode_lookup[v];
-}
-
-static constexpr std::array<uint8_t, 128> base64_decode_lookup{
-    /* 0x00 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x08 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x10 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x18 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x20 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x28 */ 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
-    /* 0x30 */ 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B,
-    /* 0x38 */ 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x40 */ 0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-    /* 0x48 */ 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
-    /* 0x50 */ 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-    /* 0x58 */ 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    /* 0x60 */ 0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,
-    /* 0x68 */ 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
-    /* 0x70 */ 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30,
-    /* 0x78 */ 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-
-static constexpr inline std::byte base64_decode_char(int c) {
-  if (c < 0 || base64_decode_lookup[c] == 0xFF) {
-    throw std::invalid_argument("Invalid character during base64_decode");
+namespace {
+
+/**
+ * Character to 6-bit value, 0xFF for characters outside the alphabet.
+ */
+constexpr std::array<uint8_t, 256> make_decode_lookup(char const *alphabet) {
+  std::array<uint8_t, 256> lookup{};
+  for (auto &v : lookup) {
+    v = 0xFF;
   }
-  return std::byte{base64_decode_lookup[c]};
+  for (uint8_t i = 0; i < 64; i++) {
+    lookup[static_cast<uint8_t>(alphabet[i])] = i;
+  }
+  return lookup;
 }
 
-std::vector<std::byte> base64_decode(const std::string &input) {
-  std::vector<std::byte> result;
-  size_t input_size = input.size();
+/*
+ * Alphabets.
+ *
+ * The vector decoder classifies each character by its nibbles: it is
+ * valid when the low and high nibble classes share no bit.  The high
+ * nibble also selects the offset (roll) mapping it to its value, with one
+ * character of value 62 or 63 sharing a high nibble with another range
+ * and fixed up separately.
+ */
+
+struct standard_alphabet {
+  static constexpr char encode[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  static constexpr char lut_lo[16] = {0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                      0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                      0x1B, 0x1B, 0x1B, 0x1A};
+  static constexpr char lut_hi[16] = {0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                      0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                      0x10, 0x10, 0x10, 0x10};
+  static constexpr char lut_roll[16] = {0, 0,   19,  4, -65, -65, -71, -71,
+                                        0, 0,   0,   0, 0,   0,   0,   0};
+  static constexpr char fix = '/';
+  static constexpr char fix_roll = -3;
+};
 
-  /* The base64 encoding of zero bytes is an empty string. */
-  if (input_size == 0) {
-    return result;
+struct url_alphabet {
+  static constexpr char encode[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  static constexpr char lut_lo[16] = {0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                      0x11, 0x11, 0x11, 0x11, 0x13, 0x3B,
+                                      0x3B, 0x3A, 0x3B, 0x33};
+  static constexpr char lut_hi[16] = {0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                      0x04, 0x20, 0x10, 0x10, 0x10, 0x10,
+                                      0x10, 0x10, 0x10, 0x10};
+  static constexpr char lut_roll[16] = {0, 0,   17,  4, -65, -65, -71, -71,
+                                        0, 0,   0,   0, 0,   0,   0,   0};
+  static constexpr char fix = '_';
+  static constexpr char fix_roll = 33;
+};
+
+static_assert(sizeof(standard_alphabet::encode) == 65);
+static_assert(sizeof(url_alphabet::encode) == 65);
+
+template <typename Alphabet>
+constexpr std::array<uint8_t, 256> decode_lookup =
+    make_decode_lookup(Alphabet::encode);
+
+static_assert(decode_lookup<standard_alphabet>['+'] == 0x3E);
+static_assert(decode_lookup<url_alphabet>['_'] == 0x3F);
+static_assert(decode_lookup<standard_alphabet>['='] == 0xFF);
+
+bool is_url(base64_flags flags) { return flags.is_set(base64_flag::V::url); }
+
+bool is_padded(base64_flags flags) {
+  return flags.is_clear(base64_flag::V::no_padding);
+}
+
+//
+// Scalar
+//
+
+template <typename Alphabet>
+size_t encode_scalar(char *dst, uint8_t const *src, size_t len) {
+  size_t i = 0;
+  for (; len - i >= 3; i += 3, dst += 4) {
+    uint32_t v = (uint32_t{src[i]} << 16) | (uint32_t{src[i + 1]} << 8) |
+                 uint32_t{src[i + 2]};
+    dst[0] = Alphabet::encode[(v >> 18) & 0x3F];
+    dst[1] = Alphabet::encode[(v >> 12) & 0x3F];
+    dst[2] = Alphabet::encode[(v >> 6) & 0x3F];
+    dst[3] = Alphabet::encode[v & 0x3F];
   }
+  return i;
+}
 
-  /*
-   * A base64 string is always a multiple of 4 characters due to padding.
-   */
-  if (input_size % 4 != 0) {
-    throw std::invalid_argument("invalid length");
+template <typename Alphabet>
+size_t decode_scalar(uint8_t *dst, char const *src, size_t len) {
+  auto const &lookup = decode_lookup<Alphabet>;
+  size_t i = 0;
+  for (; len - i >= 4; i += 4, dst += 3) {
+    uint32_t e0 = lookup[static_cast<uint8_t>(src[i + 0])];
+    uint32_t e1 = lookup[static_cast<uint8_t>(src[i + 1])];
+    uint32_t e2 = lookup[static_cast<uint8_t>(src[i + 2])];
+    uint32_t e3 = lookup[static_cast<uint8_t>(src[i + 3])];
+    if (unlikely(((e0 | e1 | e2 | e3) & 0x80) != 0)) {
+      break;
+    }
+    uint32_t v = (e0 << 18) | (e1 << 12) | (e2 << 6) | e3;
+    dst[0] = static_cast<uint8_t>(v >> 16);
+    dst[1] = static_cast<uint8_t>(v >> 8);
+    dst[2] = static_cast<uint8_t>(v);
   }
+  return i;
+}
 
-  /* result_size will be adjusted later for padding. */
-  size_t result_size = input_size / 4 * 3;
-  result.resize(result_size);
+/**
+ * Encode the final 1 or 2 bytes, with padding if requested.
+ */
+size_t encode_tail(char *dst, uint8_t const *src, size_t len,
+                   base64_flags flags) {
+  char const *alphabet =
+      is_url(flags) ? url_alphabet::encode : standard_alphabet::encode;
+  uint32_t v = uint32_t{src[0]} << 16;
+  if (len == 2) {
+    v |= uint32_t{src[1]} << 8;
+  }
+  dst[0] = alphabet[(v >> 18) & 0x3F];
+  dst[1] = alphabet[(v >> 12) & 0x3F];
+  if (len == 2) {
+    dst[2] = alphabet[(v >> 6) & 0x3F];
+  }
+  if (!is_padded(flags)) {
+    return len + 1;
+  }
+  if (len == 1) {
+    dst[2] = '=';
+  }
+  dst[3] = '=';
+  return 4;
+}
 
-  size_t j = 0;
-  size_t i = 0;
-  for (; i < input_size - 4; i += 4, j += 3) {
-    auto e0{base64_decode_char(input[i + 0])};
-    auto e1{base64_decode_char(input[i + 1])};
-    auto e2{base64_decode_char(input[i + 2])};
-    auto e3{base64_decode_char(input[i + 3])};
-    result[j + 0] =
-        ((e0 & std::byte{0x3F}) << 2) | ((e1 & std::byte{0x30}) >> 4);
-    result[j + 1] =
-        ((e1 & std::byte{0x0F}) << 4) | ((e2 & std::byte{0x3C}) >> 2);
-    result[j + 2] =
-        ((e2 & std::byte{0x03}) << 6) | ((e3 & std::byte{0x3F}) >> 0);
-  }
-
-  if (input[i + 2] == '=' && input[i + 3] == '=') {
-    auto e0{base64_decode_char(input[i + 0])};
-    auto e1{base64_decode_char(input[i + 1])};
-    result[j + 0] =
-        ((e0 & std::byte{0x3F}) << 2) | ((e1 & std::byte{0x30}) >> 4);
-    result.resize(j + 1);
-  } else if (input[i + 3] == '=') {
-    auto e0{base64_decode_char(input[i + 0])};
-    auto e1{base64_decode_char(input[i + 1])};
-    auto e2{base64_decode_char(input[i + 2])};
-    result[j + 0] =
-        ((e0 & std::byte{0x3F}) << 2) | ((e1 & std::byte{0x30}) >> 4);
-    result[j + 1] =
-        ((e1 & std::byte{0x0F}) << 4) | ((e2 & std::byte{0x3C}) >> 2);
-    result.resize(j + 2);
+/**
+ * Decode one group of 4 characters, which may end with padding.
+ */
+base64_result decode_group(uint8_t *dst, char const *src,
+                           base64_flags flags) {
+  auto const &lookup = is_url(flags) ? decode_lookup<url_alphabet>
+                                     : decode_lookup<standard_alphabet>;
+  uint32_t e0 = lookup[static_cast<uint8_t>(src[0])];
+  uint32_t e1 = lookup[static_cast<uint8_t>(src[1])];
+  uint32_t e2 = 0;
+  uint32_t e3 = 0;
+  size_t len = 3;
+  if (src[3] == '=') {
+    len = src[2] == '=' ? 1 : 2;
   } else {
-    auto e0{base64_decode_char(input[i + 0])};
-    auto e1{base64_decode_char(input[i + 1])};
-    auto e2{base64_decode_char(input[i + 2])};
-    auto e3{base64_decode_char(input[i + 3])};
-    result[j + 0] =
-        ((e0 & std::byte{0x3F}) << 2) | ((e1 & std::byte{0x30}) >> 4);
-    result[j + 1] =
-        ((e1 & std::byte{0x0F}) << 4) | ((e2 & std::byte{0x3C}) >> 2);
-    result[j + 2] =
-        ((e2 & std::byte{0x03}) << 6) | ((e3 & std::byte{0x3F}) >> 0);
-    assert(result.size() == j + 3);
+    e3 = lookup[static_cast<uint8_t>(src[3])];
+  }
+  if (len > 1) {
+    e2 = lookup[static_cast<uint8_t>(src[2])];
+  }
+  if (((e0 | e1 | e2 | e3) & 0x80) != 0) {
+    return {0, base64_error::V::invalid_character};
+  }
+  uint32_t v = (e0 << 18) | (e1 << 12) | (e2 << 6) | e3;
+  dst[0] = static_cast<uint8_t>(v >> 16);
+  if (len > 1) {
+    dst[1] = static_cast<uint8_t>(v >> 8);
+  }
+  if (len > 2) {
+    dst[2] = static_cast<uint8_t>(v);
+  }
+  return {len, base64_error::V::ok};
+}
+
+//
+// SSSE3 / AVX2
+//
+// The vector codecs follow Wojciech Muła's pshufb based algorithms.  Each
+// 128-bit lane encodes 12 bytes into 16 characters, or decodes 16
+// characters into 12 bytes.  The AVX2 versions run two lanes at a time and
+// finish with the SSSE3 loop and then the scalar loop.
+//
+
+/**
+ * Spread 12 bytes into 16 6-bit indices, one per byte.
+ */
+__attribute__((target("ssse3"))) a_forceinline __m128i
+encode_unpack(__m128i in) {
+  in = _mm_shuffle_epi8(
+      in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  auto t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  auto t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  auto t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  auto t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+/**
+ * Offsets from index to character.
+ *
+ * Index ranges are reduced to a slot: 0 for 'a'-'z', 1-10 for the digits,
+ * 11 and 12 for the two symbols and 13 for 'A'-'Z'.
+ */
+template <typename Alphabet>
+__attribute__((target("ssse3"))) a_forceinline __m128i encode_offsets() {
+  return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, Alphabet::encode[62] - 62,
+                       Alphabet::encode[63] - 63, 'A', 0, 0);
+}
+
+/**
+ * Translate 6-bit indices into the alphabet.
+ */
+template <typename Alphabet>
+__attribute__((target("ssse3"))) a_forceinline __m128i
+encode_translate(__m128i idx) {
+  auto slot = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+  auto upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+  slot = _mm_or_si128(slot, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  return _mm_add_epi8(_mm_shuffle_epi8(encode_offsets<Alphabet>(), slot),
+                      idx);
+}
+
+__attribute__((target("avx2"))) a_forceinline __m256i
+encode_unpack(__m256i in) {
+  auto shuffle = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  in = _mm256_shuffle_epi8(in, shuffle);
+  auto t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+  auto t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  auto t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+  auto t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(t1, t3);
+}
+
+template <typename Alphabet>
+__attribute__((target("avx2"))) a_forceinline __m256i
+encode_translate(__m256i idx) {
+  auto offsets = _mm256_broadcastsi128_si256(encode_offsets<Alphabet>());
+  auto slot = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+  auto upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+  slot = _mm256_or_si256(slot, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+  return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, slot), idx);
+}
+
+/**
+ * Encode 12 bytes at a time; reads 16.
+ */
+template <typename Alphabet>
+__attribute__((target("ssse3"))) a_forceinline size_t
+encode_ssse3(char *dst, uint8_t const *src, size_t len) {
+  size_t i = 0;
+  for (; len - i >= 16; i += 12, dst += 16) {
+    auto in = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+    auto out = encode_translate<Alphabet>(encode_unpack(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), out);
+  }
+  return i;
+}
+
+/**
+ * Encode 24 bytes at a time; reads 28.
+ */
+template <typename Alphabet>
+__attribute__((target("avx2"))) a_forceinline size_t
+encode_avx2(char *dst, uint8_t const *src, size_t len) {
+  size_t i = 0;
+  for (; len - i >= 32; i += 24, dst += 32) {
+    auto lo = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+    auto hi =
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i + 12));
+    auto in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    auto out = encode_translate<Alphabet>(encode_unpack(in));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), out);
+  }
+  return i;
+}
+
+__attribute__((target("ssse3"))) a_forceinline __m128i load_lut(
+    char const *lut) {
+  return _mm_loadu_si128(reinterpret_cast<__m128i const *>(lut));
+}
+
+/**
+ * Decode 16 characters into 12 bytes (in the low 12 bytes).
+ *
+ * Returns false if any character is outside the alphabet.
+ */
+template <typename Alphabet>
+__attribute__((target("ssse3"))) a_forceinline bool decode_lane(
+    __m128i in, __m128i &out) {
+  auto hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0F));
+  auto lo_nibbles = _mm_and_si128(in, _mm_set1_epi8(0x0F));
+  auto lo = _mm_shuffle_epi8(load_lut(Alphabet::lut_lo), lo_nibbles);
+  auto hi = _mm_shuffle_epi8(load_lut(Alphabet::lut_hi), hi_nibbles);
+  auto valid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+  if (_mm_movemask_epi8(valid) != 0xFFFF) {
+    return false;
   }
+  auto roll = _mm_shuffle_epi8(load_lut(Alphabet::lut_roll), hi_nibbles);
+  auto fix = _mm_cmpeq_epi8(in, _mm_set1_epi8(Alphabet::fix));
+  roll = _mm_add_epi8(roll,
+                      _mm_and_si128(fix, _mm_set1_epi8(Alphabet::fix_roll)));
+  auto values = _mm_add_epi8(in, roll);
+  auto merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  auto packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  out = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+                                               13, 12, -1, -1, -1, -1));
+  return true;
+}
+
+template <typename Alphabet>
+__attribute__((target("avx2"))) a_forceinline bool decode_lane(
+    __m256i in, __m256i &out) {
+  auto hi_nibbles =
+      _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0F));
+  auto lo_nibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0F));
+  auto lo = _mm256_shuffle_epi8(
+      _mm256_broadcastsi128_si256(load_lut(Alphabet::lut_lo)), lo_nibbles);
+  auto hi = _mm256_shuffle_epi8(
+      _mm256_broadcastsi128_si256(load_lut(Alphabet::lut_hi)), hi_nibbles);
+  if (!_mm256_testz_si256(lo, hi)) {
+    return false;
+  }
+  auto roll = _mm256_shuffle_epi8(
+      _mm256_broadcastsi128_si256(load_lut(Alphabet::lut_roll)), hi_nibbles);
+  auto fix = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(Alphabet::fix));
+  roll = _mm256_add_epi8(
+      roll, _mm256_and_si256(fix, _mm256_set1_epi8(Alphabet::fix_roll)));
+  auto values = _mm256_add_epi8(in, roll);
+  auto merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+  auto packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+  auto shuffle = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  packed = _mm256_shuffle_epi8(packed, shuffle);
+  // Pack the two 12 byte lanes together.
+  out = _mm256_permutevar8x32_epi32(packed,
+                                    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+  return true;
+}
+
+/**
+ * Decode 16 characters at a time; writes 16 bytes for every 12.
+ *
+ * At least 24 characters must remain so the extra bytes land inside the
+ * output of later groups, even if the last one is padded.
+ */
+template <typename Alphabet>
+__attribute__((target("ssse3"))) a_forceinline size_t
+decode_ssse3(uint8_t *dst, char const *src, size_t len) {
+  size_t i = 0;
+  for (; len - i >= 24; i += 16, dst += 12) {
+    __m128i out;
+    auto in = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+    if (!decode_lane<Alphabet>(in, out)) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), out);
+  }
+  return i;
+}
+
+/**
+ * Decode 32 characters at a time; writes 32 bytes for every 24.
+ */
+template <typename Alphabet>
+__attribute__((target("avx2"))) a_forceinline size_t
+decode_avx2(uint8_t *dst, char const *src, size_t len) {
+  size_t i = 0;
+  for (; len - i >= 48; i += 32, dst += 24) {
+    __m256i out;
+    auto in = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+    if (!decode_lane<Alphabet>(in, out)) {
+      break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), out);
+  }
+  return i;
+}
+
+template <typename Alphabet>
+__attribute__((target("ssse3"))) size_t encode_blocks_ssse3(
+    char *dst, uint8_t const *src, size_t len) {
+  size_t i = encode_ssse3<Alphabet>(dst, src, len);
+  return i + encode_scalar<Alphabet>(dst + i / 3 * 4, src + i, len - i);
+}
+
+template <typename Alphabet>
+__attribute__((target("avx2"))) size_t encode_blocks_avx2(
+    char *dst, uint8_t const *src, size_t len) {
+  size_t i = encode_avx2<Alphabet>(dst, src, len);
+  i += encode_ssse3<Alphabet>(dst + i / 3 * 4, src + i, len - i);
+  return i + encode_scalar<Alphabet>(dst + i / 3 * 4, src + i, len - i);
+}
+
+template <typename Alphabet>
+__attribute__((target("ssse3"))) size_t decode_blocks_ssse3(
+    uint8_t *dst, char const *src, size_t len) {
+  size_t i = decode_ssse3<Alphabet>(dst, src, len);
+  return i + decode_scalar<Alphabet>(dst + i / 4 * 3, src + i, len - i);
+}
+
+template <typename Alphabet>
+__attribute__((target("avx2"))) size_t decode_blocks_avx2(
+    uint8_t *dst, char const *src, size_t len) {
+  size_t i = decode_avx2<Alphabet>(dst, src, len);
+  i += decode_ssse3<Alphabet>(dst + i / 4 * 3, src + i, len - i);
+  return i + decode_scalar<Alphabet>(dst + i / 4 * 3, src + i, len - i);
+}
+
+}  // namespace
+
+template <>
+size_t base64_encode_blocks<hwarch>(char *dst, uint8_t const *src,
+                                    size_t len, base64_flags flags) {
+  return is_url(flags) ? encode_scalar<url_alphabet>(dst, src, len)
+                       : encode_scalar<standard_alphabet>(dst, src, len);
+}
+
+template <>
+size_t base64_encode_blocks<ssse3_hwarch>(char *dst, uint8_t const *src,
+                                          size_t len, base64_flags flags) {
+  return is_url(flags) ? encode_blocks_ssse3<url_alphabet>(dst, src, len)
+                       : encode_blocks_ssse3<standard_alphabet>(dst, src, len);
+}
+
+template <>
+size_t base64_encode_blocks<avx2_hwarch>(char *dst, uint8_t const *src,
+                                         size_t len, base64_flags flags) {
+  return is_url(flags) ? encode_blocks_avx2<url_alphabet>(dst, src, len)
+                       : encode_blocks_avx2<standard_alphabet>(dst, src, len);
+}
+
+template <>
+size_t base64_decode_blocks<hwarch>(uint8_t *dst, char const *src,
+                                    size_t len, base64_flags flags) {
+  return is_url(flags) ? decode_scalar<url_alphabet>(dst, src, len)
+                       : decode_scalar<standard_alphabet>(dst, src, len);
+}
+
+template <>
+size_t base64_decode_blocks<ssse3_hwarch>(uint8_t *dst, char const *src,
+                                          size_t len, base64_flags flags) {
+  return is_url(flags) ? decode_blocks_ssse3<url_alphabet>(dst, src, len)
+                       : decode_blocks_ssse3<standard_alphabet>(dst, src, len);
+}
+
+template <>
+size_t base64_decode_blocks<avx2_hwarch>(uint8_t *dst, char const *src,
+                                         size_t len, base64_flags flags) {
+  return is_url(flags) ? decode_blocks_avx2<url_alphabet>(dst, src, len)
+                       : decode_blocks_avx2<standard_alphabet>(dst, src, len);
+}
+
+size_t base64_encode_blocks(char *dst, uint8_t const *src, size_t len,
+                            base64_flags flags) {
+  using encode_fn = size_t (*)(char *, uint8_t const *, size_t, base64_flags);
+  static encode_fn const encode =
+      avx2_hwarch::available()    ? &base64_encode_blocks<avx2_hwarch>
+      : ssse3_hwarch::available() ? &base64_encode_blocks<ssse3_hwarch>
+                                  : &base64_encode_blocks<hwarch>;
+  return encode(dst, src, len, flags);
+}
+
+size_t base64_decode_blocks(uint8_t *dst, char const *src, size_t len,
+                            base64_flags flags) {
+  using decode_fn = size_t (*)(uint8_t *, char const *, size_t, base64_flags);
+  static decode_fn const decode =
+      avx2_hwarch::available()    ? &base64_decode_blocks<avx2_hwarch>
+      : ssse3_hwarch::available() ? &base64_decode_blocks<ssse3_hwarch>
+                                  : &base64_decode_blocks<hwarch>;
+  return decode(dst, src, len, flags);
+}
+
+//
+// base64_encoder
+//
+
+base64_result base64_encoder::update(char *dst, size_t dst_size,
+                                     void const *src, size_t len) {
+  auto const *data = static_cast<uint8_t const *>(src);
+  if (dst_size < (pending_size_ + len) / 3 * 4) {
+    return {0, base64_error::V::buffer_too_small};
+  }
+  if (len == 0) {
+    return {0, base64_error::V::ok};
+  }
+  size_t written = 0;
+  if (pending_size_ > 0) {
+    size_t take = std::min(3 - pending_size_, len);
+    memcpy(pending_ + pending_size_, data, take);
+    pending_size_ += take;
+    data += take;
+    len -= take;
+    if (pending_size_ < 3) {
+      return {0, base64_error::V::ok};
+    }
+    written = base64_encode_blocks(dst, pending_, 3, flags_) / 3 * 4;
+    pending_size_ = 0;
+  }
+  size_t consumed = base64_encode_blocks(dst + written, data, len, flags_);
+  written += consumed / 3 * 4;
+  pending_size_ = len - consumed;
+  memcpy(pending_, data + consumed, pending_size_);
+  return {written, base64_error::V::ok};
+}
+
+base64_result base64_encoder::finalize(char *dst, size_t dst_size) {
+  if (pending_size_ == 0) {
+    return {0, base64_error::V::ok};
+  }
+  if (dst_size < (is_padded(flags_) ? 4 : pending_size_ + 1)) {
+    return {0, base64_error::V::buffer_too_small};
+  }
+  size_t written = encode_tail(dst, pending_, pending_size_, flags_);
+  pending_size_ = 0;
+  return {written, base64_error::V::ok};
+}
+
+//
+// base64_decoder
+//
+
+base64_result base64_decoder::update(void *dst, size_t dst_size,
+                                     std::string_view src) {
+  auto *out = static_cast<uint8_t *>(dst);
+  size_t len = src.size();
+  if (done_ && len != 0) {
+    // Nothing may follow padding.
+    return {0, base64_error::V::invalid_character};
+  }
+
+  size_t needed = (pending_size_ + len) / 4 * 3;
+  if ((pending_size_ + len) % 4 == 0) {
+    for (size_t i = len; i > 0 && len - i < 2 && src[i - 1] == '='; i--) {
+      needed--;
+    }
+  }
+  if (dst_size < needed) {
+    return {0, base64_error::V::buffer_too_small};
+  }
+
+  size_t written = 0;
+  size_t i = 0;
+  if (pending_size_ > 0) {
+    while (pending_size_ < 4 && i < len) {
+      pending_[pending_size_++] = src[i++];
+    }
+    if (pending_size_ < 4) {
+      return {0, base64_error::V::ok};
+    }
+    pending_size_ = 0;
+    auto r = decode_group(out, pending_, flags_);
+    if (!r) {
+      return r;
+    }
+    written = r.written;
+    done_ = r.written < 3;
+  }
+
+  while (!done_ && len - i >= 4) {
+    size_t whole = (len - i) / 4 * 4;
+    size_t consumed =
+        base64_decode_blocks(out + written, src.data() + i, whole, flags_);
+    i += consumed;
+    written += consumed / 4 * 3;
+    if (consumed == whole) {
+      break;
+    }
+    // Stopped at padding or an invalid character.
+    auto r = decode_group(out + written, src.data() + i, flags_);
+    if (!r) {
+      return {written, r.error};
+    }
+    i += 4;
+    written += r.written;
+    done_ = r.written < 3;
+  }
+
+  if (done_ && i != len) {
+    return {written, base64_error::V::invalid_character};
+  }
+  pending_size_ = len - i;
+  memcpy(pending_, src.data() + i, pending_size_);
+  return {written, base64_error::V::ok};
+}
+
+base64_result base64_decoder::finalize(void *dst, size_t dst_size) {
+  size_t pending = pending_size_;
+  reset();
+  if (pending == 0) {
+    return {0, base64_error::V::ok};
+  }
+  if (is_padded(flags_) || pending == 1) {
+    return {0, base64_error::V::invalid_length};
+  }
+  if (dst_size < pending - 1) {
+    return {0, base64_error::V::buffer_too_small};
+  }
+  char group[4] = {pending_[0], pending_[1], pending_[2], '='};
+  if (pending == 2) {
+    group[2] = '=';
+  }
+  uint8_t tmp[3];
+  auto r = decode_group(tmp, group, flags_);
+  memcpy(dst, tmp, r.written);
+  return r;
+}
+
+//
+// One shot
+//
+
+base64_result base64_encode(char *dst, size_t dst_size, void const *src,
+                            size_t len, base64_flags flags) {
+  if (dst_size < base64_encoded_size(len, flags)) {
+    return {0, base64_error::V::buffer_too_small};
+  }
+  base64_encoder encoder(flags);
+  auto r = encoder.update(dst, dst_size, src, len);
+  auto f = encoder.finalize(dst + r.written, dst_size - r.written);
+  return {r.written + f.written, f.error};
+}
+
+base64_result base64_decode(void *dst, size_t dst_size, std::string_view src,
+                            base64_flags flags) {
+  base64_decoder decoder(flags);
+  auto r = decoder.update(dst, dst_size, src);
+  if (!r) {
+    return r;
+  }
+  auto f = decoder.finalize(static_cast<uint8_t *>(dst) + r.written,
+                            dst_size - r.written);
+  return {r.written + f.written, f.error};
+}
+
+std::vector<std::byte> base64_decode(const std::string &input) {
+  std::vector<std::byte> result(base64_decoded_max_size(input.size()));
+  auto r = base64_decode(result.data(), result.size(), input);
+  if (r.error == base64_error::V::invalid_length) {
+    throw std::invalid_argument("invalid length");
+  }
+  if (!r) {
+    throw std::invalid_argument("Invalid character during base64_decode");
+  }
+  result.resize(r.written);
   return result;
 }
 
@@ -122,66 +671,9 @@ std::vector<std::byte> base64_decode(const std::string &input,
 }
 
 std::string base64_encode(const std::byte *begin, const std::byte *end) {
-  std::string result;
-  std::ptrdiff_t input_size = end - begin;
-  const std::byte *input = begin;
-
-  if (input_size == 0) {
-    /* An empty vector is encoded as "" */
-    return result;
-  }
-
-  /* Result always include padding, so round up */
-  std::size_t result_size = (input_size + 2) / 3 * 4;
-  result.resize(result_size);
-
-  std::ptrdiff_t i{0};
-  std::ptrdiff_t j{0};
-  for (; i < input_size - 3; i += 3, j += 4) {
-    auto e0{((input[i + 0] & std::byte{0xFC}) >> 2)};
-    auto e1{((input[i + 0] & std::byte{0x03}) << 4) |
-            ((input[i + 1] & std::byte{0xF0}) >> 4)};
-    auto e2{((input[i + 1] & std::byte{0x0F}) << 2) |
-            ((input[i + 2] & std::byte{0xC0}) >> 6)};
-    auto e3{((input[i + 2] & std::byte{0x3F}) >> 0)};
-    result[j + 0] = base64_encode_byte(e0);
-    result[j + 1] = base64_encode_byte(e1);
-    result[j + 2] = base64_encode_byte(e2);
-    result[j + 3] = base64_encode_byte(e3);
-  }
-
-  if (input_size % 3 == 2) {
-    /* 1 padding character */
-    auto e0{((input[i + 0] & std::byte{0xFC}) >> 2)};
-    auto e1{(((input[i + 0] & std::byte{0x03}) << 4) |
-             ((input[i + 1] & std::byte{0xF0}) >> 4))};
-    auto e2{((input[i + 1] & std::byte{0x0F}) << 2)};
-    result[j + 0] = base64_encode_byte(e0);
-    result[j + 1] = base64_encode_byte(e1);
-    result[j + 2] = base64_encode_byte(e2);
-    result[j + 3] = '=';
-  } else if (input_size % 3 == 1) {
-    /* 2 padding characters */
-    auto e0{((input[i + 0] & std::byte{0xFC}) >> 2)};
-    auto e1{((input[i + 0] & std::byte{0x03}) << 4)};
-    result[j + 0] = base64_encode_byte(e0);
-    result[j + 1] = base64_encode_byte(e1);
-    result[j + 2] = '=';
-    result[j + 3] = '=';
-  } else {
-    /* No padding */
-    auto e0{((input[i + 0] & std::byte{0xFC}) >> 2)};
-    auto e1{(((input[i + 0] & std::byte{0x03}) << 4) |
-             ((input[i + 1] & std::byte{0xF0}) >> 4))};
-    auto e2{(((input[i + 1] & std::byte{0x0F}) << 2) |
-             ((input[i + 2] & std::byte{0xC0}) >> 6))};
-    auto e3{((input[i + 2] & std::byte{0x3F}) >> 0)};
-    result[j + 0] = base64_encode_byte(e0);
-    result[j + 1] = base64_encode_byte(e1);
-    result[j + 2] = base64_encode_byte(e2);
-    result[j + 3] = base64_encode_byte(e3);
-  }
-
+  std::string result(base64_encoded_size(end - begin), '\0');
+  base64_encode(result.data(), result.size(), begin, end - begin);
   return result;
 }
+
 };  // namespace sled
@@ -4,9 +4,13 @@
  * Licensed under BSD-2-Clause license.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include "gtest/gtest.h"
 
 #include "sled/base64.h"
+#include "test_data.h"
 
 namespace sled {
 using bvec = std::vector<std::byte>;
@@ -46,4 +50,218 @@ TEST(Base64Test, first_char) {
   }
 }
 
+TEST(Base64Test, round_trip) {
+  for (size_t len = 0; len < 200; len++) {
+    auto data = test_bytes(len);
+    bvec expected(len);
+    memcpy(expected.data(), data.data(), len);
+    EXPECT_EQ(expected, base64_decode(base64_encode(data), len));
+  }
+}
+
+TEST(Base64Test, invalid_character) {
+  auto encoded = base64_encode(test_bytes(150));
+  for (size_t i = 0; i < encoded.size(); i++) {
+    for (char c : {'=', '*', '\0', '\x80'}) {
+      if (c == '=' && i == encoded.size() - 1) {
+        continue;
+      }
+      auto bad = encoded;
+      bad[i] = c;
+      EXPECT_THROW(base64_decode(bad), std::invalid_argument) << i;
+    }
+  }
+}
+
+template <typename Arch>
+static void expect_matches_scalar(base64_flags flags) {
+  auto data = test_bytes(300);
+  std::string encoded(base64_encoded_size(data.size()), '\0');
+  base64_encode(encoded.data(), encoded.size(), data.data(), data.size(),
+                flags);
+  for (size_t len = 0; len < data.size(); len++) {
+    std::string expected(len / 3 * 4, '\0');
+    std::string actual(len / 3 * 4, '\0');
+    EXPECT_EQ(base64_encode_blocks<hwarch>(expected.data(), data.data(), len,
+                                           flags),
+              base64_encode_blocks<Arch>(actual.data(), data.data(), len,
+                                         flags));
+    EXPECT_EQ(expected, actual) << len;
+  }
+  for (size_t len = 0; len < encoded.size(); len++) {
+    std::vector<uint8_t> expected(len / 4 * 3);
+    std::vector<uint8_t> actual(len / 4 * 3);
+    EXPECT_EQ(base64_decode_blocks<hwarch>(expected.data(), encoded.data(),
+                                           len, flags),
+              base64_decode_blocks<Arch>(actual.data(), encoded.data(), len,
+                                         flags));
+    EXPECT_EQ(expected, actual) << len;
+  }
+  // Every character value in every lane position.
+  for (int c = 0; c < 256; c++) {
+    for (size_t i = 0; i < 64; i++) {
+      auto bad = encoded;
+      bad[i] = static_cast<char>(c);
+      std::vector<uint8_t> expected(bad.size() / 4 * 3);
+      std::vector<uint8_t> actual(bad.size() / 4 * 3);
+      size_t n = base64_decode_blocks<hwarch>(expected.data(), bad.data(),
+                                              bad.size(), flags);
+      ASSERT_EQ(n, base64_decode_blocks<Arch>(actual.data(), bad.data(),
+                                              bad.size(), flags))
+          << c << " at " << i;
+      EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + n / 4 * 3,
+                             actual.begin()));
+    }
+  }
+}
+
+TEST(Base64Test, ssse3_matches_scalar) {
+  if (!ssse3_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  expect_matches_scalar<ssse3_hwarch>({});
+  expect_matches_scalar<ssse3_hwarch>({base64_flag::V::url});
+}
+
+TEST(Base64Test, avx2_matches_scalar) {
+  if (!avx2_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  expect_matches_scalar<avx2_hwarch>({});
+  expect_matches_scalar<avx2_hwarch>({base64_flag::V::url});
+}
+
+/**
+ * Encode into a caller buffer, returning the string.
+ */
+static std::string encode(std::string_view data, base64_flags flags = {}) {
+  std::string out(base64_encoded_size(data.size(), flags), '\0');
+  auto r = base64_encode(out.data(), out.size(), data.data(), data.size(),
+                         flags);
+  EXPECT_TRUE(r);
+  EXPECT_EQ(out.size(), r.written);
+  return out;
+}
+
+static std::string decode(std::string_view data, base64_flags flags = {}) {
+  std::string out(base64_decoded_max_size(data.size()), '\0');
+  auto r = base64_decode(out.data(), out.size(), data, flags);
+  EXPECT_TRUE(r) << r.error;
+  out.resize(r.written);
+  return out;
+}
+
+TEST(Base64Test, rfc4648_vectors) {
+  base64_flags no_padding{base64_flag::V::no_padding};
+  std::pair<char const *, char const *> vectors[] = {
+      {"", ""},          {"f", "Zg=="},         {"fo", "Zm8="},
+      {"foo", "Zm9v"},   {"foob", "Zm9vYg=="},  {"fooba", "Zm9vYmE="},
+      {"foobar", "Zm9vYmFy"}};
+  for (auto [plain, encoded] : vectors) {
+    EXPECT_EQ(encoded, encode(plain));
+    EXPECT_EQ(plain, decode(encoded));
+    std::string unpadded(encoded);
+    unpadded.erase(unpadded.find_last_not_of('=') + 1);
+    EXPECT_EQ(unpadded, encode(plain, no_padding));
+    EXPECT_EQ(plain, decode(unpadded, no_padding));
+  }
+}
+
+TEST(Base64Test, url_alphabet) {
+  base64_flags url{base64_flag::V::url};
+  std::string data("\xfb\xff\xbf\xfe", 4);
+  EXPECT_EQ("+/+//g==", encode(data));
+  EXPECT_EQ("-_-__g==", encode(data, url));
+  EXPECT_EQ("-_-__g", encode(data, url | base64_flag::V::no_padding));
+  EXPECT_EQ(data, decode("-_-__g==", url));
+
+  char out[6];
+  EXPECT_EQ(base64_error::V::invalid_character,
+            base64_decode(out, sizeof(out), "+/+//g==", url).error);
+  EXPECT_EQ(base64_error::V::invalid_character,
+            base64_decode(out, sizeof(out), "-_-__g==").error);
+}
+
+TEST(Base64Test, errors) {
+  char out[16];
+  EXPECT_EQ(base64_error::V::invalid_length,
+            base64_decode(out, sizeof(out), "Zm9vY").error);
+  EXPECT_EQ(base64_error::V::invalid_length,
+            base64_decode(out, sizeof(out), "Zm9vYg").error);
+  EXPECT_EQ(base64_error::V::invalid_length,
+            base64_decode(out, sizeof(out), "Zm9vY",
+                          base64_flags{base64_flag::V::no_padding})
+                .error);
+  EXPECT_EQ(base64_error::V::invalid_character,
+            base64_decode(out, sizeof(out), "Zm9v*mFy").error);
+  EXPECT_EQ(base64_error::V::invalid_character,
+            base64_decode(out, sizeof(out), "Zg==Zg==").error);
+  EXPECT_EQ(base64_error::V::invalid_character,
+            base64_decode(out, sizeof(out), "Zg=v").error);
+
+  // Exactly sized buffers are enough, one less is not.
+  EXPECT_TRUE(base64_decode(out, 4, "Zm9vYg=="));
+  EXPECT_EQ(base64_error::V::buffer_too_small,
+            base64_decode(out, 3, "Zm9vYg==").error);
+  EXPECT_TRUE(base64_encode(out, 8, "fooba", 5));
+  EXPECT_EQ(base64_error::V::buffer_too_small,
+            base64_encode(out, 7, "fooba", 5).error);
+}
+
+TEST(Base64Test, streaming) {
+  auto data = test_bytes(1000);
+  base64_flags url_no_padding{base64_flag::V::url,
+                              base64_flag::V::no_padding};
+  for (auto flags : {base64_flags{}, url_no_padding}) {
+    std::string expected(base64_encoded_size(data.size(), flags), '\0');
+    base64_encode(expected.data(), expected.size(), data.data(), data.size(),
+                  flags);
+    for (size_t chunk : {1, 2, 3, 5, 64, 100, 999}) {
+      std::string encoded;
+      base64_encoder encoder(flags);
+      char buf[base64_encoder::max_update_size(999) + 4];
+      for (size_t i = 0; i < data.size(); i += chunk) {
+        size_t len = std::min(chunk, data.size() - i);
+        auto r = encoder.update(buf, sizeof(buf), data.data() + i, len);
+        ASSERT_TRUE(r);
+        encoded.append(buf, r.written);
+      }
+      auto r = encoder.finalize(buf, sizeof(buf));
+      ASSERT_TRUE(r);
+      encoded.append(buf, r.written);
+      EXPECT_EQ(expected, encoded) << chunk;
+
+      std::vector<uint8_t> decoded;
+      base64_decoder decoder(flags);
+      uint8_t out[base64_decoded_max_size(999)];
+      for (size_t i = 0; i < encoded.size(); i += chunk) {
+        size_t len = std::min(chunk, encoded.size() - i);
+        auto r = decoder.update(out, sizeof(out), {encoded.data() + i, len});
+        ASSERT_TRUE(r);
+        decoded.insert(decoded.end(), out, out + r.written);
+      }
+      r = decoder.finalize(out, sizeof(out));
+      ASSERT_TRUE(r);
+      decoded.insert(decoded.end(), out, out + r.written);
+      EXPECT_EQ(data, decoded) << chunk;
+    }
+  }
+}
+
+TEST(Base64Test, streaming_buffer_too_small) {
+  base64_encoder encoder;
+  char buf[8];
+  EXPECT_TRUE(encoder.update(buf, sizeof(buf), "fo", 2));
+  EXPECT_EQ(base64_error::V::buffer_too_small,
+            encoder.update(buf, 4, "obar", 4).error);
+  auto r = encoder.update(buf, sizeof(buf), "obar", 4);
+  EXPECT_EQ("Zm9vYmFy", std::string(buf, r.written));
+
+  base64_decoder decoder;
+  EXPECT_EQ(base64_error::V::buffer_too_small,
+            decoder.update(buf, 5, "Zm9vYmFy").error);
+  r = decoder.update(buf, 6, "Zm9vYmFy");
+  EXPECT_EQ("foobar", std::string(buf, r.written));
+}
+
 }
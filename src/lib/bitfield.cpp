@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/bitfield.h"
+
+namespace sled {
+
+namespace {
+
+/**
+ * mask split into runs of set bits, computed once per array.
+ */
+struct bit_runs {
+  uint64_t run[32];
+  int shift[32];
+  int count{0};
+
+  explicit bit_runs(uint64_t mask) {
+    int packed = 0;
+    while (mask != 0) {
+      int low = __builtin_ctzll(mask);
+      uint64_t r = mask & ~(mask + (mask & (~mask + 1)));
+      run[count] = r;
+      shift[count] = low - packed;
+      count++;
+      packed += __builtin_popcountll(r);
+      mask &= ~r;
+    }
+  }
+};
+
+}  // namespace
+
+template <>
+void bits_extract_array<hwarch>(uint64_t *dst, uint64_t const *src,
+                                size_t count, uint64_t mask) {
+  bit_runs const runs(mask);
+  for (size_t i = 0; i < count; i++) {
+    uint64_t r = 0;
+    for (int j = 0; j < runs.count; j++) {
+      r |= (src[i] & runs.run[j]) >> runs.shift[j];
+    }
+    dst[i] = r;
+  }
+}
+
+template <>
+void bits_deposit_array<hwarch>(uint64_t *dst, uint64_t const *src,
+                                size_t count, uint64_t mask) {
+  bit_runs const runs(mask);
+  for (size_t i = 0; i < count; i++) {
+    uint64_t r = 0;
+    for (int j = 0; j < runs.count; j++) {
+      r |= (src[i] << runs.shift[j]) & runs.run[j];
+    }
+    dst[i] = r;
+  }
+}
+
+template <>
+__attribute__((target("bmi2"))) void bits_extract_array<bmi2_hwarch>(
+    uint64_t *dst, uint64_t const *src, size_t count, uint64_t mask) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = bits_extract<bmi2_hwarch>(src[i], mask);
+  }
+}
+
+template <>
+__attribute__((target("bmi2"))) void bits_deposit_array<bmi2_hwarch>(
+    uint64_t *dst, uint64_t const *src, size_t count, uint64_t mask) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = bits_deposit<bmi2_hwarch>(src[i], mask);
+  }
+}
+
+void bits_extract_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask) {
+  using bits_fn = void (*)(uint64_t *, uint64_t const *, size_t, uint64_t);
+  static bits_fn const extract = bmi2_hwarch::available()
+                                     ? &bits_extract_array<bmi2_hwarch>
+                                     : &bits_extract_array<hwarch>;
+  extract(dst, src, count, mask);
+}
+
+void bits_deposit_array(uint64_t *dst, uint64_t const *src, size_t count,
+                        uint64_t mask) {
+  using bits_fn = void (*)(uint64_t *, uint64_t const *, size_t, uint64_t);
+  static bits_fn const deposit = bmi2_hwarch::available()
+                                     ? &bits_deposit_array<bmi2_hwarch>
+                                     : &bits_deposit_array<hwarch>;
+  deposit(dst, src, count, mask);
+}
+
+}  // namespace sled
@@ -24,11 +24,13 @@ struct hidden_struct {
 struct TestBitfield final
     : sled::struct_bitfield<uint16_t, hidden_struct, TestBitfield> {
  public:
+  enum field { f1, f2, f3, f4 };
+
   static constexpr std::array<field_description, 4> fields{
-      make_field(0, 2, "f1"),
-      make_field(3, 6, "f2"),
-      make_field(7, 8, "f3"),
-      make_field(9, 15, "f4"),
+      make_field(f1, 0, 2, "f1"),
+      make_field(f2, 3, 6, "f2"),
+      make_field(f3, 7, 8, "f3"),
+      make_field(f4, 9, 15, "f4"),
   };
 
   using sled::struct_bitfield<uint16_t, hidden_struct,
@@ -61,9 +63,11 @@ struct TestFlags {
 struct TestFlagsBitfield final
     : sled::flags_bitfield<uint8_t, TestFlags, TestFlagsBitfield> {
  public:
+  enum flag { C, Z, I, D, V, N };
+
   static constexpr std::array<field_description, 6> fields{
-      make_field(0, "C"), make_field(1, "Z"), make_field(2, "I"),
-      make_field(3, "D"), make_field(6, "V"), make_field(7, "N"),
+      make_field(C, 0, "C"), make_field(Z, 1, "Z"), make_field(I, 2, "I"),
+      make_field(D, 3, "D"), make_field(V, 6, "V"), make_field(N, 7, "N"),
   };
 
   using sled::flags_bitfield<uint8_t, TestFlags,
@@ -82,3 +86,151 @@ TEST_F(BitfieldTest, assignment) {
   f = 0x0A;
   EXPECT_EQ("Z,D", format(f));
 }
+
+TEST_F(BitfieldTest, field_get_set) {
+  TestBitfield f;
+  f.b.f2 = 5;
+  f.b.f4 = 0x41;
+  EXPECT_EQ(0, f.get<TestBitfield::f1>());
+  EXPECT_EQ(5, f.get<TestBitfield::f2>());
+  EXPECT_EQ(0x41, f.get<TestBitfield::f4>());
+  EXPECT_EQ(0x41, f.get<3>());
+
+  f.set<TestBitfield::f3>(3);
+  f.set<TestBitfield::f2>(0x1f);
+  EXPECT_EQ(3, f.b.f3);
+  EXPECT_EQ(0xf, f.b.f2);
+  EXPECT_EQ(0x41, f.b.f4);
+  EXPECT_EQ(0x01f8,
+            (TestBitfield::mask<TestBitfield::f2, TestBitfield::f3>()));
+}
+
+struct ReorderedBitfield final
+    : sled::struct_bitfield<uint16_t, hidden_struct, ReorderedBitfield> {
+ public:
+  enum field { f1, f2, f3, f4 };
+
+  static constexpr std::array<field_description, 4> fields{
+      make_field(f4, 9, 15, "f4"),
+      make_field(f3, 7, 8, "f3"),
+      make_field(f2, 3, 6, "f2"),
+      make_field(f1, 0, 2, "f1"),
+  };
+
+  using sled::struct_bitfield<uint16_t, hidden_struct,
+                              ReorderedBitfield>::struct_bitfield;
+};
+
+TEST_F(BitfieldTest, field_order) {
+  ReorderedBitfield f;
+  f.b.f2 = 5;
+  f.b.f4 = 0x41;
+  EXPECT_EQ(5, f.get<ReorderedBitfield::f2>());
+  EXPECT_EQ(0x41, f.get<ReorderedBitfield::f4>());
+  EXPECT_EQ(0x41, f.get<0>());
+  f.set<ReorderedBitfield::f1>(6);
+  EXPECT_EQ(6, f.b.f1);
+  EXPECT_EQ(6 | 5 << 3,
+            (f.gather<ReorderedBitfield::f2, ReorderedBitfield::f1>()));
+}
+
+__attribute__((target("bmi2"))) static uint16_t gather_bmi2(
+    TestBitfield const &f) {
+  return f.gather<sled::bmi2_hwarch, TestBitfield::f1, TestBitfield::f3,
+                  TestBitfield::f4>();
+}
+
+__attribute__((target("bmi2"))) static void scatter_bmi2(TestBitfield &f,
+                                                         uint16_t v) {
+  f.scatter<sled::bmi2_hwarch, TestBitfield::f1, TestBitfield::f3,
+            TestBitfield::f4>(v);
+}
+
+TEST_F(BitfieldTest, gather_scatter) {
+  TestBitfield f;
+  f.b.f1 = 5;
+  f.b.f2 = 9;
+  f.b.f3 = 2;
+  f.b.f4 = 0x55;
+
+  // f1 in bits 0-2, f3 in 3-4, f4 in 5-11.
+  uint16_t expected = 5 | 2 << 3 | 0x55 << 5;
+  EXPECT_EQ(expected, (f.gather<TestBitfield::f1, TestBitfield::f3,
+                                TestBitfield::f4>()));
+  EXPECT_EQ(expected, (f.gather<sled::hwarch, TestBitfield::f1,
+                                TestBitfield::f3, TestBitfield::f4>()));
+
+  TestBitfield g;
+  g.b.f2 = 9;
+  g.scatter<TestBitfield::f1, TestBitfield::f3, TestBitfield::f4>(
+      expected);
+  EXPECT_EQ(f.v, g.v);
+  g.v = 0;
+  g.scatter<sled::hwarch, TestBitfield::f3>(0xff);
+  EXPECT_EQ(0x0180, g.v);
+
+  if (sled::bmi2_hwarch::available()) {
+    EXPECT_EQ(expected, gather_bmi2(f));
+    TestBitfield h;
+    h.b.f2 = 9;
+    scatter_bmi2(h, expected);
+    EXPECT_EQ(f.v, h.v);
+  }
+}
+
+TEST_F(BitfieldTest, flags_get_set) {
+  TestFlagsBitfield f;
+  f.set<TestFlagsBitfield::Z>(true);
+  f.set<TestFlagsBitfield::N>(true);
+  EXPECT_TRUE(f.get<TestFlagsBitfield::Z>());
+  EXPECT_FALSE(f.get<TestFlagsBitfield::C>());
+  EXPECT_EQ("Z,N", format(f));
+  f.set<TestFlagsBitfield::Z>(false);
+  EXPECT_EQ(0x80, f.v);
+
+  // C, Z, V and N as a nibble.
+  f = 0xC3;
+  using F = TestFlagsBitfield;
+  EXPECT_EQ(0xf, (f.gather<F::C, F::Z, F::V, F::N>()));
+  f.scatter<sled::hwarch, F::C, F::Z, F::V, F::N>(0x5);
+  EXPECT_EQ("C,V", format(f));
+}
+
+TEST_F(BitfieldTest, bits_extract_deposit) {
+  uint64_t masks[] = {0, 1, 0x8000000000000000, 0xff00ff00ff00ff00,
+                      0x0123456789abcdef, ~uint64_t{0}, 0x3c};
+  uint64_t x = 0x9e3779b97f4a7c15;
+  for (auto m : masks) {
+    uint64_t e = 0;
+    uint64_t d = 0;
+    for (int i = 0, k = 0; i < 64; i++) {
+      if ((m >> i) & 1) {
+        e |= ((x >> i) & 1) << k;
+        d |= ((x >> k) & 1) << i;
+        k++;
+      }
+    }
+    EXPECT_EQ(e, sled::bits_extract<sled::hwarch>(x, m));
+    EXPECT_EQ(d, sled::bits_deposit<sled::hwarch>(x, m));
+
+    uint64_t src[5] = {x, ~x, 0, x >> 3, x << 7};
+    uint64_t ref[5];
+    uint64_t out[5];
+    for (int i = 0; i < 5; i++) {
+      ref[i] = sled::bits_extract<sled::hwarch>(src[i], m);
+    }
+    sled::bits_extract_array<sled::hwarch>(out, src, 5, m);
+    EXPECT_EQ(0, memcmp(ref, out, sizeof(ref)));
+    sled::bits_extract_array(out, src, 5, m);
+    EXPECT_EQ(0, memcmp(ref, out, sizeof(ref)));
+    for (int i = 0; i < 5; i++) {
+      ref[i] = sled::bits_deposit<sled::hwarch>(src[i], m);
+    }
+    sled::bits_deposit_array<sled::hwarch>(out, src, 5, m);
+    EXPECT_EQ(0, memcmp(ref, out, sizeof(ref)));
+    sled::bits_deposit_array(out, src, 5, m);
+    EXPECT_EQ(0, memcmp(ref, out, sizeof(ref)));
+  }
+  EXPECT_EQ(0x2d, sled::bits_extract<0xff00ff00ff00ff00>(0x2d00));
+  EXPECT_EQ(0x0f000f00, sled::bits_deposit<0xff00ff00>(0xf0f));
+}
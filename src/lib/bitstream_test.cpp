@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/bitstream.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test_data.h"
+
+using sled::bit_order;
+
+class BitstreamTest : public ::testing::Test {
+ protected:
+  void SetUp() override { data = test_bytes<std::byte>(1000); }
+
+  /**
+   * Deterministic field widths from 1 to max_bits.
+   */
+  static int width(size_t i) { return static_cast<int>(i * 7 % 56) + 1; }
+
+  std::vector<std::byte> data;
+};
+
+TEST_F(BitstreamTest, msb_matches_bytestream) {
+  sled::bytestream bs(data.data(), data.data() + data.size());
+  sled::bit_reader<bit_order::msb_first> br(bs);
+  for (size_t i = 0; !bs.overflow(); i++) {
+    // bits_read returns an int, stay within 31 bits.
+    int w = width(i) % 31 + 1;
+    auto expected = static_cast<uint64_t>(bs.bits_read(w));
+    if (bs.overflow()) {
+      break;
+    }
+    EXPECT_EQ(expected, br.read(w)) << i;
+    EXPECT_FALSE(br.overflow());
+  }
+}
+
+TEST_F(BitstreamTest, lsb_order) {
+  std::byte buf[] = {std::byte{0xB1}, std::byte{0x5A}};
+  sled::bit_reader<bit_order::lsb_first> br(buf, buf + sizeof(buf));
+  EXPECT_EQ(0x1, br.read(1));
+  EXPECT_EQ(0x0, br.read(3));
+  EXPECT_EQ(0xB, br.read(4));
+  EXPECT_EQ(0x5A, br.read(8));
+  EXPECT_FALSE(br.overflow());
+  EXPECT_EQ(0, br.read(1));
+  EXPECT_TRUE(br.overflow());
+}
+
+template <bit_order Order>
+static void round_trip(std::vector<std::byte> &buf) {
+  std::vector<uint64_t> values;
+  uint64_t x = 7;
+  sled::bit_writer<Order> bw(buf.data(), buf.data() + buf.size());
+  size_t bits = 0;
+  for (size_t i = 0; bits + 56 <= buf.size() * 8; i++) {
+    int w = static_cast<int>(i * 7 % 56) + 1;
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+    values.push_back(x & ((uint64_t{1} << w) - 1));
+    bw.write(x, w);
+    bits += w;
+  }
+  EXPECT_EQ(bits, bw.position());
+  EXPECT_EQ((bits + 7) / 8, bw.flush());
+  EXPECT_FALSE(bw.overflow());
+
+  sled::bit_reader<Order> br(buf.data(), buf.data() + buf.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    int w = static_cast<int>(i * 7 % 56) + 1;
+    ASSERT_EQ(values[i], br.read(w)) << i;
+  }
+  EXPECT_EQ(bits, br.position());
+}
+
+TEST_F(BitstreamTest, round_trip) {
+  for (size_t size : {1, 7, 8, 9, 64, 1000}) {
+    std::vector<std::byte> buf(size);
+    round_trip<bit_order::msb_first>(buf);
+    round_trip<bit_order::lsb_first>(buf);
+  }
+}
+
+TEST_F(BitstreamTest, unchecked_fields) {
+  sled::bit_reader<bit_order::msb_first> br(data.data(),
+                                            data.data() + data.size());
+  sled::bytestream bs(data.data(), data.data() + data.size());
+  br.refill();
+  EXPECT_EQ(bs.bits_read(4), br.read_unchecked(4));
+  EXPECT_EQ(bs.bits_read(20), br.read_unchecked(20));
+  EXPECT_EQ(bs.bits_read(30), br.read_unchecked(30));
+  EXPECT_EQ(bs.bits_peek(2), br.peek(2));
+}
+
+TEST_F(BitstreamTest, skip_and_align) {
+  sled::bit_reader<bit_order::msb_first> br(data.data(),
+                                            data.data() + data.size());
+  br.read(3);
+  br.align();
+  EXPECT_EQ(8, br.position());
+  br.skip(5);
+  br.skip(8 * 100 + 3);
+  EXPECT_EQ(8 * 102, br.position());
+  EXPECT_EQ(std::to_integer<uint64_t>(data[102]), br.read(8));
+  br.skip(8 * 1000);
+  EXPECT_TRUE(br.overflow());
+}
+
+TEST_F(BitstreamTest, writer_overflow) {
+  std::vector<std::byte> buf(3);
+  sled::bit_writer<bit_order::msb_first> bw(buf.data(),
+                                            buf.data() + buf.size());
+  bw.write(0xABCD, 16);
+  bw.write(0x1, 4);
+  EXPECT_FALSE(bw.overflow());
+  bw.write(0xFFF, 12);
+  EXPECT_TRUE(bw.overflow());
+  EXPECT_EQ(3, bw.flush());
+  EXPECT_EQ(std::byte{0xAB}, buf[0]);
+  EXPECT_EQ(std::byte{0xCD}, buf[1]);
+  EXPECT_EQ(std::byte{0x1F}, buf[2]);
+}
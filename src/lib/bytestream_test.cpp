@@ -6,6 +6,9 @@
 
 #include "sled/bytestream.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "gtest/gtest.h"
 
 class BytestreamTest : public ::testing::Test {
@@ -92,3 +95,190 @@ TEST_F(BytestreamTest, fixed_bits_read) {
   EXPECT_EQ(9, v.width());
   EXPECT_EQ(0x20, v.v);
 }
+
+TEST_F(BytestreamTest, write) {
+  sled::fixed_bytestream<64> bs;
+  bs.be_pwrite<uint32_t>(0x01020304, 0);
+  bs.le_pwrite<uint16_t>(0x0506, 4);
+  bs.be_pwrite<8, uint64_t>(0x1122334455667788);
+  bs.le_pwrite<16, uint32_t>(0xAABBCCDD);
+  EXPECT_EQ(0x01020304, bs.be_pread<uint32_t>(0));
+  EXPECT_EQ(std::byte{0x06}, bs.read(4));
+  EXPECT_EQ(0x1122334455667788, bs.be_pread<uint64_t>(8));
+  EXPECT_EQ(0xAABBCCDD, bs.le_pread<uint32_t>(16));
+  EXPECT_EQ(std::byte{0xDD}, bs.read(16));
+}
+
+TEST_F(BytestreamTest, array_read_write) {
+  sled::bytestream bs(buffer_.begin(), buffer_.end());
+  uint16_t be16[5];
+  bs.be_pread(be16, 5, 1);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(bs.be_pread<uint16_t>(1 + i * 2), be16[i]);
+  }
+  uint32_t le32[15];
+  bs.le_pread(le32, 15, 3);
+  for (int i = 0; i < 15; i++) {
+    EXPECT_EQ(bs.le_pread<uint32_t>(3 + i * 4), le32[i]);
+  }
+
+  std::array<std::byte, 64> out{};
+  sled::bytestream obs(out.begin(), out.end());
+  obs.be_pwrite(le32, 15, 3);
+  for (int i = 0; i < 15; i++) {
+    EXPECT_EQ(le32[i], obs.be_pread<uint32_t>(3 + i * 4));
+  }
+}
+
+TEST_F(BytestreamTest, views) {
+  sled::bytestream bs(buffer_.begin(), buffer_.end());
+  auto be = bs.be_array<uint32_t>(8, 4);
+  auto le = bs.le_array<uint32_t>(8, 4);
+  EXPECT_EQ(8, be.size());
+  EXPECT_EQ(0x04050607, be[0]);
+  EXPECT_EQ(0x07060504, le[0]);
+  EXPECT_EQ(0x20212223, be[7]);
+
+  std::vector<uint32_t> copy(be.begin(), be.end());
+  ASSERT_EQ(8, copy.size());
+  std::vector<uint32_t> bulk(8);
+  be.copy_to(bulk.data());
+  EXPECT_EQ(copy, bulk);
+  EXPECT_EQ(8, be.end() - be.begin());
+
+  // Random access, as used by generic algorithms.
+  auto last = std::prev(be.end(), 1);
+  EXPECT_EQ(0x20212223, *last);
+  EXPECT_EQ(be[5], *(be.end() - 3));
+  EXPECT_EQ(be[2], *(2 + be.begin()));
+  auto it = be.end();
+  it -= 8;
+  EXPECT_TRUE(it == be.begin());
+  EXPECT_TRUE(be.end() > it && it <= be.begin() && be.end() >= it);
+  EXPECT_EQ(7, std::distance(be.begin(), std::prev(be.end())));
+  EXPECT_TRUE(std::is_sorted(be.begin(), be.end()));
+
+  sled::be_view<int16_t> signed_view(buffer_.data() + 0x3e, 1);
+  EXPECT_EQ(0x3e3f, signed_view[0]);
+}
+
+TEST_F(BytestreamTest, span) {
+  sled::byte_span s(buffer_);
+  EXPECT_EQ(64, s.size());
+  EXPECT_EQ(std::byte{0x10}, s[0x10]);
+  auto sub = s.subspan(8, 4);
+  EXPECT_EQ(4, sub.size());
+  EXPECT_EQ(std::byte{0x08}, *sub.begin());
+  EXPECT_EQ(56, s.subspan(8).size());
+  EXPECT_TRUE(s.subspan(64).empty());
+
+  // Sizes beyond 2GiB are representable, nothing is dereferenced.
+  sled::byte_span big(buffer_.data(), size_t{3} << 30);
+  sled::byte_cursor c(big);
+  EXPECT_TRUE(c.seek(size_t{5} << 29));
+  EXPECT_EQ(size_t{1} << 29, c.remaining());
+  EXPECT_FALSE(c.reserve(size_t{1} << 30));
+  EXPECT_TRUE(c.overflow());
+}
+
+TEST_F(BytestreamTest, const_span) {
+  std::array<std::byte, 64> const &rom = buffer_;
+  sled::const_byte_span s(rom);
+  static_assert(std::is_same_v<std::byte const *, decltype(s.data())>);
+  EXPECT_EQ(64, s.size());
+  EXPECT_EQ(std::byte{0x3f}, s[0x3f]);
+
+  // byte_span converts, the reverse does not.
+  sled::const_byte_span from_mutable = sled::byte_span(buffer_).first(8);
+  EXPECT_EQ(8, from_mutable.size());
+  static_assert(!std::is_convertible_v<sled::const_byte_span, sled::byte_span>);
+
+  sled::const_byte_span range(rom.data(), rom.data() + 4);
+  EXPECT_EQ(4, range.size());
+  // A literal 0 is a size, not an end pointer.
+  sled::byte_span empty(buffer_.data(), 0);
+  EXPECT_TRUE(empty.empty());
+}
+
+TEST_F(BytestreamTest, const_cursor_read) {
+  std::byte const *rom = buffer_.data();
+  sled::const_byte_cursor c(rom, rom + buffer_.size());
+  EXPECT_EQ(0x00010203, c.be_read<uint32_t>());
+  EXPECT_EQ(0x07060504, c.le_read<uint32_t>());
+  std::byte raw[2];
+  EXPECT_TRUE(c.read(raw, sizeof(raw)));
+  EXPECT_EQ(std::byte{0x09}, raw[1]);
+  EXPECT_EQ(10, c.position());
+  EXPECT_TRUE(c.seek(62));
+  EXPECT_EQ(0, c.be_read<uint32_t>());
+  EXPECT_TRUE(c.overflow());
+}
+
+TEST_F(BytestreamTest, cursor_read) {
+  sled::bytestream bs(buffer_.begin(), buffer_.end());
+  sled::byte_cursor c(bs.span());
+  ASSERT_TRUE(c.reserve(15));
+  EXPECT_EQ(0x00, c.be_read_unchecked<uint8_t>());
+  EXPECT_EQ(0x0102, c.be_read_unchecked<uint16_t>());
+  EXPECT_EQ(0x06050403, c.le_read_unchecked<uint32_t>());
+  EXPECT_EQ(0x0708090a0b0c0d0e, c.be_read_unchecked<uint64_t>());
+  EXPECT_EQ(15, c.position());
+
+  std::byte raw[4];
+  EXPECT_TRUE(c.read(raw, sizeof(raw)));
+  EXPECT_EQ(std::byte{0x12}, raw[3]);
+  EXPECT_TRUE(c.skip(41));
+  EXPECT_EQ(0x3c3d3e3f, c.be_read<uint32_t>());
+  EXPECT_FALSE(c.overflow());
+  EXPECT_EQ(0, c.remaining());
+}
+
+TEST_F(BytestreamTest, cursor_overflow) {
+  sled::byte_cursor c(buffer_.begin(), buffer_.end());
+  EXPECT_TRUE(c.seek(60));
+  EXPECT_EQ(0, c.be_read<uint64_t>());
+  EXPECT_TRUE(c.overflow());
+  EXPECT_EQ(60, c.position());
+  EXPECT_EQ(0x3c3d3e3f, c.be_read<uint32_t>());
+  EXPECT_FALSE(c.skip(1));
+  EXPECT_FALSE(c.seek(65));
+  EXPECT_EQ(64, c.position());
+}
+
+TEST_F(BytestreamTest, cursor_write) {
+  std::array<std::byte, 16> out{};
+  sled::byte_cursor c(out);
+  ASSERT_TRUE(c.reserve(14));
+  c.be_write_unchecked<uint16_t>(0x0102);
+  c.le_write_unchecked<uint32_t>(0x06050403);
+  c.be_write_unchecked<uint64_t>(0x0708090a0b0c0d0e);
+  EXPECT_TRUE(c.le_write<uint16_t>(0x100f));
+  EXPECT_FALSE(c.be_write<uint32_t>(0));
+  EXPECT_TRUE(c.overflow());
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(std::byte(i + 1), out[i]) << i;
+  }
+}
+
+TEST_F(BytestreamTest, fixed_static_offsets) {
+  sled::fixed_bytestream<64> bs;
+  fill(bs.buf());
+  EXPECT_EQ(std::byte{0x21}, bs.read<0x21>());
+  EXPECT_EQ((bs.be_pread(3, 5)), (bs.be_pread<5, 3>()));
+  EXPECT_EQ((bs.be_pread(8, 56)), (bs.be_pread<56, 8>()));
+  EXPECT_EQ((bs.be_pread(2, 62)), (bs.be_pread<62, 2>()));
+  EXPECT_EQ((bs.bs().be_bits_pread<9>(16 * 8).v),
+            (bs.be_bits_pread<16 * 8, 9>().v));
+  EXPECT_EQ((bs.bs().be_bits_pread<13>(61 * 8 + 3).v),
+            (bs.be_bits_pread<61 * 8 + 3, 13>().v));
+  EXPECT_EQ((bs.bs().be_bits_pread<1>(15).v), (bs.be_bits_pread<15, 1>().v));
+
+  std::byte raw[3] = {std::byte{0xAA}, std::byte{0xBB}, std::byte{0xCC}};
+  bs.pwrite<10, 3>(raw);
+  std::byte back[3];
+  bs.pread<9, 3>(back);
+  EXPECT_EQ(std::byte{0x09}, back[0]);
+  EXPECT_EQ(std::byte{0xBB}, back[2]);
+  bs.write<63>(std::byte{0x77});
+  EXPECT_EQ(std::byte{0x77}, bs.read(63));
+}
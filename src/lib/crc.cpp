@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/crc.h"
+
+#include <cstring>
+
+namespace sled {
+
+namespace {
+
+/** Reflected CRC32C polynomial, without the x^32 term. */
+constexpr uint32_t crc32c_poly = 0x82f63b78;
+
+/** Stream length of the 3-way loop for large buffers. */
+constexpr size_t long_block = 8192;
+
+/** Stream length of the 3-way loop for the remainder. */
+constexpr size_t short_block = 256;
+
+/**
+ * Multiply two reflected polynomials modulo the CRC32C polynomial.
+ */
+constexpr uint32_t gf2_multiply(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (int i = 0; i < 32; i++) {
+    if ((a & 0x80000000u) != 0) {
+      product ^= b;
+    }
+    a <<= 1;
+    b = (b >> 1) ^ ((b & 1) != 0 ? crc32c_poly : 0);
+  }
+  return product;
+}
+
+/**
+ * Compute x^n modulo the CRC32C polynomial, reflected.
+ */
+constexpr uint32_t x_pow(uint64_t n) {
+  uint32_t result = 0x80000000u;  // x^0
+  uint32_t square = 0x40000000u;  // x^1
+  while (n != 0) {
+    if ((n & 1) != 0) {
+      result = gf2_multiply(result, square);
+    }
+    square = gf2_multiply(square, square);
+    n >>= 1;
+  }
+  return result;
+}
+
+/*
+ * Shifting a crc over len zero bytes multiplies it by x^(8 * len).  The
+ * carry-less product of the crc and k = x^(8 * len - 33) is 64 bits wide
+ * and reflected by one extra bit; crc32 over that word multiplies by the
+ * remaining x^32 and reduces it.
+ */
+constexpr uint32_t long_shift = x_pow(8 * long_block - 33);
+constexpr uint32_t short_shift = x_pow(8 * short_block - 33);
+
+a_forceinline uint64_t load64(uint8_t const *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+a_forceinline uint32_t crc_serial(uint32_t crc, uint8_t const *data,
+                                  size_t len) {
+  uint64_t crc64 = crc;
+  while (len >= 8) {
+    crc64 = _mm_crc32_u64(crc64, load64(data));
+    data += 8;
+    len -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (len > 0) {
+    crc = _mm_crc32_u8(crc, *data);
+    data++;
+    len--;
+  }
+  return crc;
+}
+
+__attribute__((target("sse4.2,pclmul"))) a_forceinline uint32_t
+crc_shift(uint32_t crc, uint32_t k) {
+  auto product = _mm_clmulepi64_si128(
+      _mm_cvtsi32_si128(static_cast<int>(crc)),
+      _mm_cvtsi32_si128(static_cast<int>(k)), 0);
+  return static_cast<uint32_t>(
+      _mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+}
+
+/**
+ * Run three streams of @a block bytes while the buffer is large enough.
+ */
+template <size_t block>
+__attribute__((target("sse4.2,pclmul"))) a_forceinline uint32_t
+crc_3way(uint32_t crc, uint8_t const *&data, size_t &len, uint32_t k) {
+  while (len >= 3 * block) {
+    uint64_t crc0 = crc;
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    uint8_t const *end = data + block;
+    do {
+      crc0 = _mm_crc32_u64(crc0, load64(data));
+      crc1 = _mm_crc32_u64(crc1, load64(data + block));
+      crc2 = _mm_crc32_u64(crc2, load64(data + 2 * block));
+      data += 8;
+    } while (data < end);
+    crc = crc_shift(static_cast<uint32_t>(crc0), k) ^
+          static_cast<uint32_t>(crc1);
+    crc = crc_shift(crc, k) ^ static_cast<uint32_t>(crc2);
+    data += 2 * block;
+    len -= 3 * block;
+  }
+  return crc;
+}
+
+}  // namespace
+
+template <>
+crc32c crc32c_update<hwarch>(crc32c crc, uint8_t const *data, size_t len) {
+  return crc32c{crc_serial(crc.get(), data, len)};
+}
+
+template <>
+__attribute__((target("sse4.2,pclmul"))) crc32c
+crc32c_update<pclmul_hwarch>(crc32c crc, uint8_t const *data, size_t len) {
+  auto value = crc.get();
+  value = crc_3way<long_block>(value, data, len, long_shift);
+  value = crc_3way<short_block>(value, data, len, short_shift);
+  return crc32c{crc_serial(value, data, len)};
+}
+
+crc32c crc32c_combine(crc32c crc_a, crc32c crc_b, uint64_t len_b) {
+  return crc32c{gf2_multiply(crc_a.get(), x_pow(8 * len_b)) ^ crc_b.get()};
+}
+
+crc32c crc32c_update(crc32c crc, uint8_t const *data, size_t len) {
+  using update_fn = crc32c (*)(crc32c, uint8_t const *, size_t);
+  static update_fn const update = pclmul_hwarch::available()
+                                      ? &crc32c_update<pclmul_hwarch>
+                                      : &crc32c_update<hwarch>;
+  if (len < 3 * short_block) {
+    // Not worth the indirect call.
+    return crc32c{crc_serial(crc.get(), data, len)};
+  }
+  return update(crc, data, len);
+}
+
+}  // namespace sled
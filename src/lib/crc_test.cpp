@@ -7,6 +7,7 @@
 #include "sled/crc.h"
 
 #include "gtest/gtest.h"
+#include "test_data.h"
 
 class Crc32cTest : public ::testing::Test {
  protected:
@@ -39,3 +40,123 @@ TEST_F(Crc32cTest, calculate_vector) {
   EXPECT_FALSE(zero == sled::calculate_crc32c(tv_u64));
   EXPECT_FALSE(zero == sled::calculate_crc32c(tv_u64, nonzero));
 }
+
+TEST_F(Crc32cTest, check_value) {
+  std::string check = "123456789";
+  auto *begin = reinterpret_cast<uint8_t const *>(check.data());
+  auto crc = sled::calculate_crc32c(begin, begin + check.size(),
+                                    sled::crc32c{0xffffffff});
+  EXPECT_EQ(0xe3069283, crc.get() ^ 0xffffffff);
+}
+
+TEST_F(Crc32cTest, element_width) {
+  // Wider elements are consumed in memory order.
+  auto expected = sled::calculate_crc32c(
+      reinterpret_cast<uint8_t const *>(tv_u32.data()),
+      reinterpret_cast<uint8_t const *>(tv_u32.data() + tv_u32.size()));
+  EXPECT_EQ(expected, sled::calculate_crc32c(tv_u32));
+}
+
+TEST_F(Crc32cTest, pclmul_matches_serial) {
+  if (!sled::pclmul_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  auto data = test_bytes(3 * 8192 * 2 + 3 * 256 * 3 + 37);
+  sled::crc32c initial{0x1234};
+  for (size_t offset : {0, 1, 7}) {
+    for (size_t len : {0ul, 1ul, 767ul, 768ul, 1000ul, 24576ul,
+                       data.size() - offset}) {
+      auto *p = data.data() + offset;
+      EXPECT_EQ(sled::crc32c_update<sled::hwarch>(initial, p, len),
+                sled::crc32c_update<sled::pclmul_hwarch>(initial, p, len))
+          << "offset " << offset << " len " << len;
+    }
+  }
+}
+
+TEST_F(Crc32cTest, string) {
+  std::string empty;
+  sled::crc32c initial{17};
+  EXPECT_EQ(initial, sled::calculate_crc32c(empty, initial));
+  EXPECT_EQ(sled::calculate_crc32c(tv_u8),
+            sled::calculate_crc32c(std::string_view(
+                reinterpret_cast<char const *>(tv_u8.data()), tv_u8.size())));
+}
+
+TEST_F(Crc32cTest, combine) {
+  std::string a = "The quick brown fox ";
+  std::string b = "jumps over the lazy dog";
+  sled::crc32c initial{0xffffffff};
+  auto crc_a = sled::calculate_crc32c(a, initial);
+  auto crc_b = sled::calculate_crc32c(b);
+  EXPECT_EQ(sled::calculate_crc32c(a + b, initial),
+            sled::crc32c_combine(crc_a, crc_b, b.size()));
+  EXPECT_EQ(crc_a, sled::crc32c_combine(crc_a, sled::crc32c{0}, 0));
+}
+
+TEST_F(Crc32cTest, stream) {
+  std::vector<uint8_t> data(5000);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * 7);
+  }
+  sled::crc32c_stream stream{sled::crc32c{0xffffffff}};
+  size_t offset = 0;
+  for (size_t n : {1, 7, 100, 1000, 3892}) {
+    stream.update(data.data() + offset, n);
+    offset += n;
+  }
+  EXPECT_EQ(data.size(), stream.size());
+  EXPECT_EQ(sled::calculate_crc32c(data, sled::crc32c{0xffffffff}),
+            stream.finalize());
+  stream.reset();
+  stream.update("123456789");
+  EXPECT_EQ(sled::calculate_crc32c("123456789"), stream.finalize());
+}
+
+static_assert(sled::crc32_ieee::checksum("123456789") == 0xcbf43926);
+
+TEST(CrcModelTest, check_values) {
+  std::string check = "123456789";
+  auto *p = reinterpret_cast<uint8_t const *>(check.data());
+  EXPECT_EQ(0x29b1, sled::crc16_ccitt::compute(p, check.size()));
+  EXPECT_EQ(0x31c3, sled::crc16_xmodem::compute(p, check.size()));
+  EXPECT_EQ(0xcbf43926, sled::crc32_ieee::compute(p, check.size()));
+  EXPECT_EQ(0x75, sled::crc7_mmc::compute(p, check.size()));
+  EXPECT_EQ(0x995dc9bbdf1939fa, sled::crc64_xz::compute(p, check.size()));
+  EXPECT_EQ(0x29b1, sled::crc16_ccitt::checksum(check));
+  EXPECT_EQ(0x75, sled::crc7_mmc::checksum(check));
+}
+
+template <typename Crc>
+static void expect_bulk_matches_bytes(std::vector<uint8_t> const &data) {
+  for (size_t len : {0, 1, 8, 15, 16, 17, 63, 64, 127, 128, 129, 200, 1000,
+                     4096}) {
+    for (size_t offset : {0, 3}) {
+      Crc bytes;
+      for (size_t i = 0; i < len; i++) {
+        bytes.update(data[offset + i]);
+      }
+      EXPECT_EQ(bytes.value(), Crc::compute(data.data() + offset, len))
+          << "len " << len << " offset " << offset;
+    }
+  }
+}
+
+TEST(CrcModelTest, bulk_matches_bytes) {
+  auto data = test_bytes(4100, 7);
+  expect_bulk_matches_bytes<sled::crc16_ccitt>(data);
+  expect_bulk_matches_bytes<sled::crc32_ieee>(data);
+  expect_bulk_matches_bytes<sled::crc7_mmc>(data);
+  expect_bulk_matches_bytes<sled::crc64_xz>(data);
+  expect_bulk_matches_bytes<sled::basic_crc<16, 0x8005, true, 0, 0>>(data);
+}
+
+TEST(CrcModelTest, incremental) {
+  sled::crc32_ieee crc;
+  crc.update("1234");
+  crc.update(static_cast<uint8_t>('5'));
+  crc.update("6789");
+  EXPECT_EQ(0xcbf43926, crc.value());
+  crc.reset();
+  EXPECT_EQ(0, crc.value());
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/endian.h"
+
+namespace sled {
+
+namespace {
+
+template <typename T>
+void swap_scalar(uint8_t *dst, uint8_t const *src, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    T v;
+    memcpy(&v, src + i * sizeof(T), sizeof(T));
+    v = byteswap(v);
+    memcpy(dst + i * sizeof(T), &v, sizeof(T));
+  }
+}
+
+void swap_tail(uint8_t *dst, uint8_t const *src, size_t count,
+               size_t width) {
+  switch (width) {
+    case 2:
+      swap_scalar<uint16_t>(dst, src, count);
+      break;
+    case 4:
+      swap_scalar<uint32_t>(dst, src, count);
+      break;
+    case 8:
+      swap_scalar<uint64_t>(dst, src, count);
+      break;
+    default:
+      debug_assert(false);
+  }
+}
+
+/**
+ * pshufb control reversing each width byte element.
+ */
+__attribute__((target("ssse3"))) a_forceinline __m128i
+swap_mask(size_t width) {
+  switch (width) {
+    case 2:
+      return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15,
+                           14);
+    case 4:
+      return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13,
+                           12);
+    default:
+      return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9,
+                           8);
+  }
+}
+
+/**
+ * Swap 16 bytes at a time, returns bytes done.
+ */
+__attribute__((target("ssse3"))) a_forceinline size_t
+swap_ssse3(uint8_t *dst, uint8_t const *src, size_t len, __m128i mask) {
+  size_t i = 0;
+  for (; len - i >= 16; i += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_shuffle_epi8(v, mask));
+  }
+  return i;
+}
+
+}  // namespace
+
+template <>
+void byteswap_array<hwarch>(void *dst, void const *src, size_t count,
+                            size_t width) {
+  swap_tail(static_cast<uint8_t *>(dst), static_cast<uint8_t const *>(src),
+            count, width);
+}
+
+template <>
+__attribute__((target("ssse3"))) void byteswap_array<ssse3_hwarch>(
+    void *dst, void const *src, size_t count, size_t width) {
+  auto *out = static_cast<uint8_t *>(dst);
+  auto const *in = static_cast<uint8_t const *>(src);
+  size_t len = count * width;
+  size_t i = swap_ssse3(out, in, len, swap_mask(width));
+  swap_tail(out + i, in + i, (len - i) / width, width);
+}
+
+template <>
+__attribute__((target("avx2"))) void byteswap_array<avx2_hwarch>(
+    void *dst, void const *src, size_t count, size_t width) {
+  auto *out = static_cast<uint8_t *>(dst);
+  auto const *in = static_cast<uint8_t const *>(src);
+  size_t len = count * width;
+  auto mask = swap_mask(width);
+  auto mask256 = _mm256_broadcastsi128_si256(mask);
+  size_t i = 0;
+  for (; len - i >= 64; i += 64) {
+    auto *p = reinterpret_cast<__m256i const *>(in + i);
+    auto *q = reinterpret_cast<__m256i *>(out + i);
+    auto v0 = _mm256_loadu_si256(p);
+    auto v1 = _mm256_loadu_si256(p + 1);
+    _mm256_storeu_si256(q, _mm256_shuffle_epi8(v0, mask256));
+    _mm256_storeu_si256(q + 1, _mm256_shuffle_epi8(v1, mask256));
+  }
+  i += swap_ssse3(out + i, in + i, len - i, mask);
+  swap_tail(out + i, in + i, (len - i) / width, width);
+}
+
+void byteswap_array(void *dst, void const *src, size_t count, size_t width) {
+  using swap_fn = void (*)(void *, void const *, size_t, size_t);
+  static swap_fn const swap =
+      avx2_hwarch::available()    ? &byteswap_array<avx2_hwarch>
+      : ssse3_hwarch::available() ? &byteswap_array<ssse3_hwarch>
+                                  : &byteswap_array<hwarch>;
+  swap(dst, src, count, width);
+}
+
+}  // namespace sled
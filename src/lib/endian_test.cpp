@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/endian.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(EndianTest, byteswap) {
+  EXPECT_EQ(0x3412, sled::byteswap(uint16_t{0x1234}));
+  EXPECT_EQ(0x78563412u, sled::byteswap(uint32_t{0x12345678}));
+  EXPECT_EQ(0x0807060504030201ull,
+            sled::byteswap(uint64_t{0x0102030405060708}));
+  EXPECT_EQ(int8_t{-2}, sled::byteswap(int8_t{-2}));
+}
+
+template <typename Arch>
+static void expect_matches_scalar() {
+  std::vector<uint8_t> src(300);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint8_t>(i * 7);
+  }
+  for (size_t width : {2, 4, 8}) {
+    for (size_t count = 0; count <= src.size() / width; count++) {
+      std::vector<uint8_t> expected(src.size());
+      std::vector<uint8_t> actual(src.size());
+      sled::byteswap_array<sled::hwarch>(expected.data(), src.data(), count,
+                                         width);
+      sled::byteswap_array<Arch>(actual.data(), src.data(), count, width);
+      ASSERT_EQ(expected, actual) << width << " " << count;
+
+      // In place
+      auto in_place = src;
+      sled::byteswap_array<Arch>(in_place.data(), in_place.data(), count,
+                                 width);
+      EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + count * width,
+                             in_place.begin()));
+    }
+  }
+}
+
+TEST(EndianTest, ssse3_matches_scalar) {
+  if (!sled::ssse3_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  expect_matches_scalar<sled::ssse3_hwarch>();
+}
+
+TEST(EndianTest, avx2_matches_scalar) {
+  if (!sled::avx2_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  expect_matches_scalar<sled::avx2_hwarch>();
+}
+
+TEST(EndianTest, arrays) {
+  uint8_t be[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0};
+  uint32_t host[2];
+  sled::be_to_host_array(host, be, 2);
+  EXPECT_EQ(0x12345678u, host[0]);
+  EXPECT_EQ(0x9abcdef0u, host[1]);
+  sled::le_to_host_array(host, be, 2);
+  EXPECT_EQ(0x78563412u, host[0]);
+
+  uint8_t out[8];
+  uint64_t v = 0x0102030405060708;
+  sled::host_to_be_array(out, &v, 1);
+  EXPECT_EQ(0x01, out[0]);
+  EXPECT_EQ(0x08, out[7]);
+  sled::host_to_le_array(out, &v, 1);
+  EXPECT_EQ(0x08, out[0]);
+}
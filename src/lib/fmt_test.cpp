@@ -5,6 +5,7 @@
  */
 
 #include "sled/fmt.h"
+#include "sled/numeric.h"
 
 #include "gtest/gtest.h"
 
@@ -73,9 +74,88 @@ TEST_F(FmtTest, format_os) {
   EXPECT_EQ("Hello, world C-137.", ss.str());
 }
 
+struct TestWriteFmt {
+  int v_{0};
+
+  friend void fmt_write(sled::fmt_writer &w, const TestWriteFmt &x) {
+    w.append('<');
+    sled::fmt_write_int(w, x.v_);
+    w.append('>');
+  }
+};
+
+TEST_F(FmtTest, compiled_format) {
+  EXPECT_EQ("a=1 b=x c=true d=q",
+            sled::format(SLED_FMT("a={} b={} c={} d={}"), 1, "x", true, 'q'));
+  EXPECT_EQ("{1}", sled::format(SLED_FMT("{{{}}}"), 1));
+  EXPECT_EQ("none", sled::format(SLED_FMT("none")));
+  EXPECT_EQ("1.5 -3", sled::format(SLED_FMT("{} {}"), 1.5, int64_t{-3}));
+  EXPECT_EQ("C-137.", sled::format(SLED_FMT("C{}."), TestIntFmt(-137)));
+  EXPECT_EQ("<5>", sled::format(SLED_FMT("{}"), TestWriteFmt{5}));
+  EXPECT_EQ("hi", sled::format(SLED_FMT("{}"), sled::fmt_obj("hi")));
+  EXPECT_EQ("str", sled::format(SLED_FMT("{}"), std::string("str")));
+}
+
+TEST_F(FmtTest, compiled_spec) {
+  EXPECT_EQ("00ff", sled::format(SLED_FMT("{:04x}"), 255));
+  EXPECT_EQ("BEEF", sled::format(SLED_FMT("{:X}"), 0xbeef));
+  EXPECT_EQ("   42", sled::format(SLED_FMT("{:5}"), 42));
+  EXPECT_EQ("-0042", sled::format(SLED_FMT("{:05d}"), -42));
+  EXPECT_EQ("ab  |", sled::format(SLED_FMT("{:4s}|"), "ab"));
+  EXPECT_EQ("<1>  |", sled::format(SLED_FMT("{:5}|"), TestWriteFmt{1}));
+}
+
+TEST_F(FmtTest, compiled_numeric) {
+  sled::HexFmt hex[] = {
+      sled::HexFmt(uint16_t{0x1f}),
+      sled::HexFmt(uint32_t{0xbeef}, {sled::HexFormat::AltPrefix}),
+      sled::HexFmt(uint64_t{0xa}, {sled::HexFormat::NoPadding}),
+      sled::HexFmt(uint8_t{0xc}, {sled::HexFormat::NoPrefix}),
+  };
+  for (auto const &h : hex) {
+    EXPECT_EQ(fmt_string(h), sled::format(SLED_FMT("{}"), h));
+  }
+  sled::IntFmt ints[] = {
+      sled::IntFmt(uint32_t{1234}),
+      sled::IntFmt(uint32_t{1536}, {sled::IntegerFormat::KiB}),
+      sled::IntFmt(uint32_t{2048}, {sled::IntegerFormat::KiB}),
+      sled::IntFmt(uint64_t{3u << 20}, {sled::IntegerFormat::MiB}),
+      sled::IntFmt(uint64_t{(5u << 20) + (1u << 19)},
+                   {sled::IntegerFormat::MiB}),
+  };
+  for (auto const &i : ints) {
+    EXPECT_EQ(fmt_string(i), sled::format(SLED_FMT("{}"), i));
+  }
+}
+
+TEST_F(FmtTest, compiled_buffers) {
+  sled::fmt_buffer<8> buf;
+  sled::format_to(buf, SLED_FMT("{}-{}"), "abcd", 12345);
+  EXPECT_TRUE(buf.truncated());
+  EXPECT_EQ(10, buf.size());
+  EXPECT_EQ("abcd-12", buf.view());
+  EXPECT_STREQ("abcd-12", buf.c_str());
+
+  char out[16];
+  sled::fmt_writer w(out, sizeof(out));
+  sled::format_to(w, SLED_FMT("x={:02x}"), 7);
+  sled::format_to(w, SLED_FMT(" y={}"), 8);
+  EXPECT_FALSE(w.truncated());
+  EXPECT_EQ("x=07 y=8", w.view());
+
+  std::string big(300, 'z');
+  EXPECT_EQ(big + "!", sled::format(SLED_FMT("{}!"), big));
+}
+
 #ifdef COMPILE_ERROR
 TEST_F(FmtTest, format_compile_error) {
   // No conversion between int and sled::fmt
   EXPECT_EQ("1234", sled::format(1234));
 }
+
+TEST_F(FmtTest, compiled_format_errors) {
+  // Argument count mismatch and unmatched brace.
+  sled::format(SLED_FMT("{} {}"), 1);
+  sled::format(SLED_FMT("{"), 1);
+}
 #endif
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/hash.h"
+
+#include <algorithm>
+
+namespace sled {
+
+namespace {
+
+//
+// Constants
+//
+
+/** wyhash mixing constants. */
+constexpr uint64_t s0 = 0xa0761d6478bd642full;
+constexpr uint64_t s1 = 0xe7037ed1a0b428dbull;
+constexpr uint64_t s2 = 0x8ebc6af09c88c6e3ull;
+constexpr uint64_t s3 = 0x589965cc75374cc3ull;
+
+constexpr uint64_t prime32_1 = 0x9e3779b1ull;
+constexpr uint64_t prime64_1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t prime64_2 = 0xc2b2ae3d27d4eb4full;
+
+constexpr size_t short_max = 240;
+constexpr size_t stripe_len = 64;
+constexpr size_t secret_len = 192;
+constexpr size_t block_stripes = (secret_len - stripe_len) / 8;
+static_assert(block_stripes * stripe_len == fast_hasher::block_size);
+
+/** Offset of the key for the final, overlapping stripe. */
+constexpr size_t last_stripe_key = secret_len - stripe_len - 7;
+
+constexpr uint64_t acc_init[8] = {
+    0x00000000c2b2ae3dull, 0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full,
+    0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull, 0x0000000085ebca77ull,
+    0x27d4eb2f165667c5ull, 0x000000009e3779b1ull};
+
+constexpr std::array<uint8_t, secret_len> make_secret() {
+  std::array<uint8_t, secret_len> secret{};
+  // splitmix64
+  uint64_t x = 0x736c6564ull;
+  for (size_t i = 0; i < secret_len; i += 8) {
+    x += 0x9e3779b97f4a7c15ull;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    for (size_t j = 0; j < 8; j++) {
+      secret[i + j] = static_cast<uint8_t>(z >> (8 * j));
+    }
+  }
+  return secret;
+}
+
+constexpr auto default_secret = make_secret();
+
+//
+// Helpers
+//
+
+a_forceinline uint64_t read64(uint8_t const *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+a_forceinline uint64_t read32(uint8_t const *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+a_forceinline void write64(uint8_t *p, uint64_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+a_forceinline uint64_t mix(uint64_t a, uint64_t b) {
+  auto product = static_cast<unsigned __int128>(a) * b;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+a_forceinline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9ull;
+  return h ^ (h >> 32);
+}
+
+/**
+ * Derive the key material for @a seed.
+ */
+void seed_secret(uint64_t seed, uint8_t secret[secret_len]) {
+  for (size_t i = 0; i < secret_len; i += 16) {
+    write64(secret + i, read64(default_secret.data() + i) + seed);
+    write64(secret + i + 8, read64(default_secret.data() + i + 8) - seed);
+  }
+}
+
+//
+// Short inputs
+//
+
+hash128 hash_short(uint8_t const *p, size_t len, uint64_t seed) {
+  seed ^= mix(seed ^ s0, s1);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (len <= 16) {
+    if (len >= 4) {
+      size_t mid = (len >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + mid);
+      b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+    } else if (len > 0) {
+      a = (uint64_t{p[0]} << 16) | (uint64_t{p[len >> 1]} << 8) | p[len - 1];
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed;
+      uint64_t see2 = seed;
+      do {
+        seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+        see1 = mix(read64(p + 16) ^ s2, read64(p + 24) ^ see1);
+        see2 = mix(read64(p + 32) ^ s3, read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+  auto product = static_cast<unsigned __int128>(a ^ s1) * (b ^ seed);
+  a = static_cast<uint64_t>(product);
+  b = static_cast<uint64_t>(product >> 64);
+  return hash128{mix(a ^ s0 ^ len, b ^ s1), mix(a ^ s2 ^ len, b ^ s3)};
+}
+
+//
+// Long inputs
+//
+
+/**
+ * Accumulate @a count stripes, stripe n keyed at secret + 8n.
+ */
+template <typename Arch>
+void accumulate(uint64_t acc[8], uint8_t const *p, size_t count,
+                uint8_t const *secret);
+
+/**
+ * Scramble the accumulators at the end of a block.
+ */
+template <typename Arch>
+void scramble(uint64_t acc[8], uint8_t const *secret);
+
+template <>
+void accumulate<hwarch>(uint64_t acc[8], uint8_t const *p, size_t count,
+                        uint8_t const *secret) {
+  for (size_t n = 0; n < count; n++, p += stripe_len, secret += 8) {
+    for (size_t i = 0; i < 8; i++) {
+      uint64_t d = read64(p + 8 * i);
+      uint64_t k = d ^ read64(secret + 8 * i);
+      acc[i ^ 1] += d;
+      acc[i] += (k & 0xffffffff) * (k >> 32);
+    }
+  }
+}
+
+template <>
+void scramble<hwarch>(uint64_t acc[8], uint8_t const *secret) {
+  for (size_t i = 0; i < 8; i++) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= read64(secret + 8 * i);
+    acc[i] = a * prime32_1;
+  }
+}
+
+template <>
+__attribute__((target("avx2"))) void accumulate<avx2_hwarch>(
+    uint64_t acc[8], uint8_t const *p, size_t count, uint8_t const *secret) {
+  auto *acc_v = reinterpret_cast<__m256i *>(acc);
+  auto a0 = _mm256_load_si256(acc_v);
+  auto a1 = _mm256_load_si256(acc_v + 1);
+  for (size_t n = 0; n < count; n++, p += stripe_len, secret += 8) {
+    auto d0 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+    auto d1 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + 32));
+    auto k0 = _mm256_xor_si256(
+        d0, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(secret)));
+    auto k1 = _mm256_xor_si256(
+        d1,
+        _mm256_loadu_si256(reinterpret_cast<__m256i const *>(secret + 32)));
+    // acc[i ^ 1] += d
+    a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, 0x4e));
+    a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, 0x4e));
+    // acc[i] += low32(k) * high32(k)
+    a0 = _mm256_add_epi64(a0,
+                          _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+    a1 = _mm256_add_epi64(a1,
+                          _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+  }
+  _mm256_store_si256(acc_v, a0);
+  _mm256_store_si256(acc_v + 1, a1);
+}
+
+template <>
+__attribute__((target("avx2"))) void scramble<avx2_hwarch>(
+    uint64_t acc[8], uint8_t const *secret) {
+  auto *acc_v = reinterpret_cast<__m256i *>(acc);
+  auto prime = _mm256_set1_epi64x(static_cast<int64_t>(prime32_1));
+  for (int i = 0; i < 2; i++) {
+    auto a = _mm256_load_si256(acc_v + i);
+    a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+    a = _mm256_xor_si256(
+        a, _mm256_loadu_si256(
+               reinterpret_cast<__m256i const *>(secret + 32 * i)));
+    auto lo = _mm256_mul_epu32(a, prime);
+    auto hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+    _mm256_store_si256(acc_v + i,
+                       _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+  }
+}
+
+using accumulate_fn = void (*)(uint64_t *, uint8_t const *, size_t,
+                               uint8_t const *);
+using scramble_fn = void (*)(uint64_t *, uint8_t const *);
+
+struct long_ops {
+  accumulate_fn accumulate;
+  scramble_fn scramble;
+};
+
+template <typename Arch>
+constexpr long_ops ops_for{&accumulate<Arch>, &scramble<Arch>};
+
+long_ops const &best_ops() {
+  static long_ops const ops =
+      avx2_hwarch::available() ? ops_for<avx2_hwarch> : ops_for<hwarch>;
+  return ops;
+}
+
+void consume(long_ops const &ops, uint64_t acc[8], uint8_t const *block,
+             uint8_t const *secret) {
+  ops.accumulate(acc, block, block_stripes, secret);
+  ops.scramble(acc, secret + secret_len - stripe_len);
+}
+
+uint64_t merge(uint64_t const acc[8], uint8_t const *secret, uint64_t start) {
+  uint64_t result = start;
+  for (size_t i = 0; i < 4; i++) {
+    result += mix(acc[2 * i] ^ read64(secret + 16 * i),
+                  acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+  }
+  return avalanche(result);
+}
+
+/**
+ * Finish a long hash.  @a tail holds the 1 to block_size bytes after the
+ * last consumed block, @a last the final 64 bytes of the input.
+ */
+hash128 finish_long(long_ops const &ops, uint64_t acc[8], uint8_t const *tail,
+                    size_t tail_len, uint8_t const *last, uint64_t len,
+                    uint8_t const *secret) {
+  ops.accumulate(acc, tail, (tail_len - 1) / stripe_len, secret);
+  ops.accumulate(acc, last, 1, secret + last_stripe_key);
+  return hash128{merge(acc, secret + 11, len * prime64_1),
+                 merge(acc, secret + secret_len - stripe_len - 11,
+                       ~(len * prime64_2))};
+}
+
+hash128 hash_long(long_ops const &ops, uint8_t const *p, size_t len,
+                  uint64_t seed) {
+  uint8_t seeded[secret_len];
+  uint8_t const *secret = default_secret.data();
+  if (seed != 0) {
+    seed_secret(seed, seeded);
+    secret = seeded;
+  }
+  alignas(32) uint64_t acc[8];
+  std::copy(std::begin(acc_init), std::end(acc_init), acc);
+  size_t blocks = (len - 1) / fast_hasher::block_size;
+  for (size_t i = 0; i < blocks; i++) {
+    consume(ops, acc, p + i * fast_hasher::block_size, secret);
+  }
+  size_t done = blocks * fast_hasher::block_size;
+  return finish_long(ops, acc, p + done, len - done, p + len - stripe_len,
+                     len, secret);
+}
+
+}  // namespace
+
+//
+// One shot
+//
+
+template <>
+uint64_t fast_hash64<hwarch>(void const *data, size_t len, uint64_t seed) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  if (len <= short_max) {
+    return hash_short(p, len, seed).low;
+  }
+  return hash_long(ops_for<hwarch>, p, len, seed).low;
+}
+
+template <>
+uint64_t fast_hash64<avx2_hwarch>(void const *data, size_t len,
+                                  uint64_t seed) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  if (len <= short_max) {
+    return hash_short(p, len, seed).low;
+  }
+  return hash_long(ops_for<avx2_hwarch>, p, len, seed).low;
+}
+
+uint64_t fast_hash64(void const *data, size_t len, uint64_t seed) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  if (len <= short_max) {
+    return hash_short(p, len, seed).low;
+  }
+  return hash_long(best_ops(), p, len, seed).low;
+}
+
+hash128 fast_hash128(void const *data, size_t len, uint64_t seed) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  if (len <= short_max) {
+    return hash_short(p, len, seed);
+  }
+  return hash_long(best_ops(), p, len, seed);
+}
+
+//
+// fast_hasher
+//
+
+void fast_hasher::reset(uint64_t seed) {
+  seed_ = seed;
+  seed_secret(seed, secret_);
+  std::copy(std::begin(acc_init), std::end(acc_init), acc_);
+  buf_len_ = 0;
+  size_ = 0;
+}
+
+void fast_hasher::consume_block(uint8_t const *block) {
+  consume(best_ops(), acc_, block, secret_);
+  memcpy(last_, block + block_size - stripe_len, stripe_len);
+}
+
+void fast_hasher::update(void const *data, size_t len) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  size_ += len;
+  // A block is only consumed once more input follows it, the final block
+  // is handled by finish().
+  if (buf_len_ + len <= block_size) {
+    memcpy(buf_ + buf_len_, p, len);
+    buf_len_ += len;
+    return;
+  }
+  if (buf_len_ != 0) {
+    size_t n = block_size - buf_len_;
+    memcpy(buf_ + buf_len_, p, n);
+    p += n;
+    len -= n;
+    consume_block(buf_);
+    buf_len_ = 0;
+  }
+  while (len > block_size) {
+    consume_block(p);
+    p += block_size;
+    len -= block_size;
+  }
+  memcpy(buf_, p, len);
+  buf_len_ = len;
+}
+
+hash128 fast_hasher::digest128() const {
+  if (size_ <= short_max) {
+    return hash_short(buf_, buf_len_, seed_);
+  }
+  alignas(32) uint64_t acc[8];
+  std::copy(std::begin(acc_), std::end(acc_), acc);
+  uint8_t last[stripe_len];
+  if (buf_len_ >= stripe_len) {
+    memcpy(last, buf_ + buf_len_ - stripe_len, stripe_len);
+  } else {
+    size_t carried = stripe_len - buf_len_;
+    memcpy(last, last_ + stripe_len - carried, carried);
+    memcpy(last + carried, buf_, buf_len_);
+  }
+  return finish_long(best_ops(), acc, buf_, buf_len_, last, size_, secret_);
+}
+
+uint64_t fast_hasher::digest() const { return digest128().low; }
+
+}  // namespace sled
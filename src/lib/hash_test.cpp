@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/hash.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "gtest/gtest.h"
+#include "sled/ident.h"
+#include "sled/strong_int.h"
+#include "test_data.h"
+
+class FastHashTest : public ::testing::Test {
+ protected:
+  void SetUp() override { data = test_bytes(5000); }
+
+  std::vector<uint8_t> data;
+};
+
+TEST_F(FastHashTest, deterministic) {
+  for (size_t len : {0, 1, 3, 4, 16, 17, 48, 49, 240, 241, 1024, 1025,
+                     5000}) {
+    EXPECT_EQ(sled::fast_hash64(data.data(), len),
+              sled::fast_hash64(data.data(), len));
+    EXPECT_EQ(sled::fast_hash64(data.data(), len),
+              sled::fast_hash128(data.data(), len).low);
+    EXPECT_NE(sled::fast_hash64(data.data(), len),
+              sled::fast_hash64(data.data(), len, 1));
+  }
+  EXPECT_NE(sled::fast_hash64("a"), sled::fast_hash64("b"));
+  EXPECT_NE(sled::fast_hash64(""), sled::fast_hash64(std::string(1, '\0')));
+}
+
+TEST_F(FastHashTest, avx2_matches_scalar) {
+  if (!sled::avx2_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  for (size_t len : {241, 300, 1023, 1024, 1025, 2048, 4999}) {
+    for (uint64_t seed : {0, 42}) {
+      EXPECT_EQ(sled::fast_hash64<sled::hwarch>(data.data(), len, seed),
+                sled::fast_hash64<sled::avx2_hwarch>(data.data(), len, seed))
+          << "len " << len;
+    }
+  }
+}
+
+TEST_F(FastHashTest, streaming) {
+  for (size_t len : {0, 10, 240, 241, 1024, 1025, 1100, 2049, 5000}) {
+    for (size_t chunk : {1, 7, 64, 1000, 1024, 4096}) {
+      sled::fast_hasher h(7);
+      for (size_t offset = 0; offset < len; offset += chunk) {
+        h.update(data.data() + offset, std::min(chunk, len - offset));
+      }
+      EXPECT_EQ(sled::fast_hash128(data.data(), len, 7), h.digest128())
+          << "len " << len << " chunk " << chunk;
+    }
+  }
+}
+
+TEST_F(FastHashTest, avalanche) {
+  // Flipping one input bit should flip about half of the output bits.
+  for (size_t len : {8, 100, 2000}) {
+    auto base = sled::fast_hash64(data.data(), len);
+    int total = 0;
+    for (size_t bit = 0; bit < 64; bit++) {
+      auto copy = data;
+      copy[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+      total += __builtin_popcountll(base ^ sled::fast_hash64(copy.data(), len));
+    }
+    EXPECT_GT(total / 64, 24) << "len " << len;
+    EXPECT_LT(total / 64, 40) << "len " << len;
+  }
+}
+
+struct HashInt : sled::StrongInt<uint32_t, HashInt> {
+  using sled::StrongInt<uint32_t, HashInt>::StrongInt;
+};
+
+TEST_F(FastHashTest, keys) {
+  std::unordered_set<uint64_t> seen;
+  sled::strong_int_hash int_hash;
+  for (uint32_t i = 0; i < 1000; i++) {
+    seen.insert(int_hash(HashInt{i}));
+  }
+  EXPECT_EQ(1000, seen.size());
+  using RawInt = sled::StrongInt<uint32_t, HashInt>;
+  EXPECT_EQ(int_hash(HashInt{5}), std::hash<RawInt>()(RawInt{5}));
+
+  std::unordered_map<std::string, int, sled::string_hash> m;
+  m["one"] = 1;
+  m["two"] = 2;
+  EXPECT_EQ(2, m["two"]);
+
+  std::hash<sled::ident> ident_hash;
+  EXPECT_NE(ident_hash(sled::ident{"task", 1}),
+            ident_hash(sled::ident{"task", 2}));
+}
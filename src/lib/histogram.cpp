@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "sled/exception.h"
+
+namespace sled {
+
+/**
+ * Validate @a precision before it is used as a shift count.
+ */
+static int checked_precision(int precision) {
+  if (precision < 2 || precision > 16) {
+    throw sled::Exception("Invalid histogram precision: ", precision);
+  }
+  return precision;
+}
+
+Histogram::Histogram(int precision)
+    : precision_(checked_precision(precision)),
+      linear_(uint64_t{1} << precision_),
+      half_(uint64_t{1} << (precision_ - 1)) {
+  counts_.resize(linear_ + (64 - precision_) * half_);
+}
+
+uint64_t Histogram::lowest(size_t idx) const {
+  if (idx < linear_) {
+    return idx;
+  }
+  uint64_t k = idx - linear_;
+  uint64_t shift = k / half_ + 1;
+  uint64_t mantissa = k % half_ + half_;
+  return mantissa << shift;
+}
+
+uint64_t Histogram::highest(size_t idx) const {
+  if (idx < linear_) {
+    return idx;
+  }
+  uint64_t shift = (idx - linear_) / half_ + 1;
+  return lowest(idx) + ((uint64_t{1} << shift) - 1);
+}
+
+void Histogram::merge(Histogram const &rhs) {
+  if (rhs.precision_ != precision_) {
+    throw sled::Exception("Histogram precision mismatch: ", precision_,
+                          " != ", rhs.precision_);
+  }
+  for (size_t i = 0; i < counts_.size(); i++) {
+    counts_[i] += rhs.counts_[i];
+  }
+  count_ += rhs.count_;
+  sum_ += rhs.sum_;
+  sum_sq_ += rhs.sum_sq_;
+  min_ = std::min(min_, rhs.min_);
+  max_ = std::max(max_, rhs.max_);
+}
+
+void Histogram::reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  sum_sq_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+double Histogram::mean() const {
+  if (count_ == 0) {
+    return 0;
+  }
+  return static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+double Histogram::stddev() const {
+  if (count_ == 0) {
+    return 0;
+  }
+  double m = mean();
+  double variance = sum_sq_ / static_cast<double>(count_) - m * m;
+  return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+uint64_t Histogram::percentile(double pct) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  pct = std::clamp(pct, 0.0, 100.0);
+  auto target = static_cast<uint64_t>(
+      std::ceil(pct / 100.0 * static_cast<double>(count_)));
+  if (target == 0) {
+    return min();
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(highest(i), max_);
+    }
+  }
+  return max_;
+}
+
+void Histogram::report(StatisticsReporter &reporter,
+                       std::string const &prefix) const {
+  reporter.add(prefix + ".count", StatisticImpl{static_cast<double>(count_)});
+  reporter.add(prefix + ".min", StatisticImpl{static_cast<double>(min())});
+  reporter.add(prefix + ".max", StatisticImpl{static_cast<double>(max())});
+  reporter.add(prefix + ".mean", StatisticImpl{mean()});
+  reporter.add(prefix + ".stddev", StatisticImpl{stddev()});
+  for (auto const &[name, pct] :
+       {std::make_pair(".p50", 50.0), std::make_pair(".p90", 90.0),
+        std::make_pair(".p99", 99.0), std::make_pair(".p999", 99.9)}) {
+    reporter.add(prefix + name,
+                 StatisticImpl{static_cast<double>(percentile(pct))});
+  }
+}
+
+}  // namespace sled
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/histogram.h"
+
+#include <cmath>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+TEST(HistogramTest, empty) {
+  sled::Histogram h;
+  EXPECT_EQ(0, h.count());
+  EXPECT_EQ(0, h.min());
+  EXPECT_EQ(0, h.max());
+  EXPECT_EQ(0, h.percentile(99));
+  EXPECT_EQ(0.0, h.mean());
+}
+
+TEST(HistogramTest, buckets) {
+  sled::Histogram h;
+  for (uint64_t v : {uint64_t{0}, uint64_t{1}, uint64_t{255}, uint64_t{256},
+                     uint64_t{1000}, uint64_t{123456789},
+                     std::numeric_limits<uint64_t>::max()}) {
+    auto idx = h.index(v);
+    EXPECT_LE(h.lowest(idx), v);
+    EXPECT_GE(h.highest(idx), v);
+    // Bounded relative error.
+    EXPECT_LE(h.highest(idx) - h.lowest(idx), v / 128);
+  }
+}
+
+TEST(HistogramTest, percentiles) {
+  sled::Histogram h;
+  for (uint64_t v = 1; v <= 10000; v++) {
+    h.record(v);
+  }
+  EXPECT_EQ(10000, h.count());
+  EXPECT_EQ(1, h.min());
+  EXPECT_EQ(10000, h.max());
+  EXPECT_DOUBLE_EQ(5000.5, h.mean());
+  EXPECT_NEAR(2886.75, h.stddev(), 0.01);
+  EXPECT_NEAR(5000, h.percentile(50), 5000 / 128);
+  EXPECT_NEAR(9900, h.percentile(99), 9900 / 128);
+  EXPECT_EQ(10000, h.percentile(100));
+  EXPECT_EQ(1, h.percentile(0));
+}
+
+TEST(HistogramTest, merge) {
+  sled::Histogram a;
+  sled::Histogram b;
+  std::thread ta([&]() {
+    for (uint64_t v = 0; v < 1000; v++) {
+      a.record(v);
+    }
+  });
+  std::thread tb([&]() {
+    for (uint64_t v = 1000; v < 2000; v++) {
+      b.record(v);
+    }
+  });
+  ta.join();
+  tb.join();
+  a.merge(b);
+  EXPECT_EQ(2000, a.count());
+  EXPECT_EQ(0, a.min());
+  EXPECT_EQ(1999, a.max());
+  EXPECT_NEAR(1000, a.percentile(50), 1000 / 128);
+
+  sled::Histogram c(4);
+  EXPECT_THROW(a.merge(c), sled::Exception);
+}
+
+TEST(HistogramTest, invalid_precision) {
+  EXPECT_THROW(sled::Histogram(0), sled::Exception);
+  EXPECT_THROW(sled::Histogram(1), sled::Exception);
+  EXPECT_THROW(sled::Histogram(17), sled::Exception);
+  EXPECT_THROW(sled::Histogram(64), sled::Exception);
+}
+
+TEST(HistogramTest, report) {
+  sled::Histogram h;
+  h.record(10, 3);
+  h.record(20);
+
+  sled::StatisticsReport report;
+  h.report(report, "latency");
+  EXPECT_EQ(4, report.get("latency.count"));
+  EXPECT_EQ(10, report.get("latency.min"));
+  EXPECT_EQ(20, report.get("latency.max"));
+  EXPECT_EQ(12.5, report.get("latency.mean"));
+  EXPECT_EQ(10, report.get("latency.p50"));
+  EXPECT_EQ(20, report.get("latency.p99"));
+
+  report.add("latency", h);
+  EXPECT_EQ(12.5, report.get("latency"));
+}
+
+TEST(HistogramTest, scoped_timer) {
+  sled::Histogram h;
+  {
+    sled::ScopedTimer timer(h);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(1, h.count());
+  EXPECT_GE(h.max(), 2'000'000);
+
+  sled::SplitTimer split(h);
+  split.split();
+  split.split();
+  EXPECT_EQ(3, h.count());
+}
@@ -6,81 +6,321 @@
 
 #include "sled/log.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace sled::log {
 
+//
+// thr_id_t/task_id_t
+//
+
+thread_local uint64_t thr_id_t::cached_{0};
+thread_local uint64_t task_id_t::current_{0};
+
+uint64_t thr_id_t::lookup() {
+#ifdef __linux__
+  return static_cast<uint64_t>(::syscall(SYS_gettid));
+#else
+  static std::atomic<uint64_t> next_id{1};
+  return next_id++;
+#endif
+}
+
+//
+// Sinks
+//
+
+/**
+ * Serializes writes to ostream sinks.
+ *
+ * Sinks are called concurrently; the stream itself is not thread safe.
+ */
+static std::mutex ostream_mtx;
+
 void sink_msg(std::ostream &sink, message &msg) {
-  sink << msg.format();
-  sink << std::endl;
+  std::stringstream line;
+  line << msg.format() << '\n';
+  std::lock_guard<std::mutex> lock(ostream_mtx);
+  sink << line.rdbuf();
   sink.flush();
 }
 
+void format_prefix(std::ostream &os, message const &msg, SinkFlags flags) {
+  if (flags.empty()) {
+    return;
+  }
+  auto &cal = tsc_calibration::get();
+  char buf[64];
+  if (flags.is_set(SinkFlag::V::RelativeTime)) {
+    auto rel = cal.relative(msg.tsc);
+    int64_t ns = rel.v;
+    char sign = ' ';
+    if (ns < 0) {
+      sign = '-';
+      ns = -ns;
+    }
+    snprintf(buf, sizeof(buf), "[%c%5lld.%06lld] ", sign,
+             static_cast<long long>(ns / sec::NSECS),
+             static_cast<long long>((ns % sec::NSECS) / usec::NSECS));
+    os << buf;
+  }
+  if (flags.is_set(SinkFlag::V::WallTime)) {
+    auto wall = cal.wall(msg.tsc);
+    time_t secs = static_cast<time_t>(wall.v / sec::NSECS);
+    struct tm tm {};
+#ifdef WIN32
+    gmtime_s(&tm, &secs);
+#else
+    gmtime_r(&secs, &tm);
+#endif
+    size_t len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + len, sizeof(buf) - len, ".%06lldZ ",
+             static_cast<long long>((wall.v % sec::NSECS) / usec::NSECS));
+    os << buf;
+  }
+  if (flags.is_set(SinkFlag::V::ThreadId)) {
+    os << "tid:" << msg.thr_id.v << " ";
+  }
+  if (flags.is_set(SinkFlag::V::TaskId)) {
+    os << "task:" << msg.task_id.v << " ";
+  }
+}
+
+void sink_msg(ostream_sink &sink, message &msg) {
+  std::stringstream line;
+  format_prefix(line, msg, sink.flags);
+  line << msg.format() << '\n';
+  std::lock_guard<std::mutex> lock(ostream_mtx);
+  sink.os << line.rdbuf();
+  sink.os.flush();
+}
+
 LoggingManager::LoggingManager(Sink default_sink)
-    : threshold_sev_(Severity::V::Notice),
+    : threshold_sev_(Severity::V::Notice.v),
       default_sev_(Severity::V::Notice),
-      default_sink_(default_sink),
-      last_facility_(Facility::V::User3.v) {}
+      last_facility_(Facility::V::User3.v) {
+  auto sinks = std::make_shared<sink_list>();
+  sinks->push_back(sink_entry{sink_id{0}, std::move(default_sink),
+                              Severity::V::Trace, false});
+  sinks_ = std::move(sinks);
+  for (uint32_t i = 0; i < max_facilities; i++) {
+    facility_sev_[i] = Severity::V::Inherited;
+    filter_sev_[i] = threshold_sev_.load();
+    effective_sev_[i] = threshold_sev_.load();
+  }
+  for (auto &name : Facility::names) {
+    facility_names_[name.first] = name.second;
+  }
+}
 
 LoggingManager::~LoggingManager() = default;
 
-void LoggingManager::set_threshold(Severity sev) { threshold_sev_ = sev; }
+void LoggingManager::update_effective(uint32_t facility) {
+  auto sev = facility_sev_[facility];
+  if (sev == Severity::V::Inherited) {
+    sev = threshold();
+  }
+  filter_sev_[facility].store(sev.v, std::memory_order_relaxed);
+  effective_sev_[facility].store(std::min(sev.v, unfiltered_sev_),
+                                 std::memory_order_relaxed);
+}
+
+void LoggingManager::set_threshold(Severity sev) {
+  if (sev == Severity::V::Inherited) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  threshold_sev_.store(sev.v, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < max_facilities; i++) {
+    update_effective(i);
+  }
+}
+
+void LoggingManager::set_threshold(Facility facility, Severity sev) {
+  if (facility.v >= max_facilities) {
+    throw sled::Exception("Invalid facility: ", facility.v);
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  facility_sev_[facility.v] = sev;
+  update_effective(facility.v);
+}
+
+Severity LoggingManager::threshold(Facility facility) const {
+  debug_assert(facility.v < max_facilities);
+  return Severity{filter_sev_[facility.v].load(std::memory_order_relaxed)};
+}
 
 void LoggingManager::set_default_severity(Severity sev) { default_sev_ = sev; }
 
-void LoggingManager::set_default_sink(Sink sink) { default_sink_ = sink; }
+/**
+ * Sink list held by a dispatch, linked per thread innermost first.
+ */
+struct dispatch_frame {
+  explicit dispatch_frame(void const *sinks) : sinks(sinks), prev(top) {
+    top = this;
+  }
+  ~dispatch_frame() { top = prev; }
+  dispatch_frame(dispatch_frame const &) = delete;
+  dispatch_frame &operator=(dispatch_frame const &) = delete;
+
+  void const *sinks;
+  dispatch_frame const *prev;
+
+  static thread_local dispatch_frame const *top;
+};
+
+thread_local dispatch_frame const *dispatch_frame::top = nullptr;
+
+std::shared_ptr<LoggingManager::sink_list const> LoggingManager::publish_sinks(
+    std::shared_ptr<sink_list const> sinks) {
+  return std::atomic_exchange_explicit(&sinks_, std::move(sinks),
+                                       std::memory_order_acq_rel);
+}
+
+void LoggingManager::retire_sinks(std::shared_ptr<sink_list const> old) {
+  // Sinks refer to caller owned objects; don't return until no dispatch can
+  // still call one that was just removed.  Dispatches further up this
+  // thread's stack (a sink changing the sinks) can't finish first, so
+  // they're not waited for.
+  long own = 1;
+  for (auto *f = dispatch_frame::top; f != nullptr; f = f->prev) {
+    own += f->sinks == old.get() ? 1 : 0;
+  }
+  while (old.use_count() > own) {
+    std::this_thread::yield();
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void LoggingManager::set_default_sink(Sink sink) {
+  std::shared_ptr<sink_list const> old;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto sinks = std::make_shared<sink_list>(*sinks_);
+    (*sinks)[0].sink = std::move(sink);
+    old = publish_sinks(std::move(sinks));
+  }
+  retire_sinks(std::move(old));
+}
+
+sink_id LoggingManager::add_sink(Sink sink, Severity threshold,
+                                 bool unfiltered) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  sink_id id{++last_sink_};
+  auto sinks = std::make_shared<sink_list>(*sinks_);
+  sinks->push_back(sink_entry{id, std::move(sink), threshold, unfiltered});
+  // Nothing was removed, so there is nothing to wait for.
+  publish_sinks(std::move(sinks));
+  if (unfiltered) {
+    unfiltered_sev_ = std::min(unfiltered_sev_, threshold.v);
+    for (uint32_t i = 0; i < max_facilities; i++) {
+      update_effective(i);
+    }
+  }
+  return id;
+}
+
+void LoggingManager::remove_sink(sink_id id) {
+  std::shared_ptr<sink_list const> old;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto sinks = std::make_shared<sink_list>(*sinks_);
+    sinks->erase(std::remove_if(sinks->begin() + 1, sinks->end(),
+                                [&](auto &entry) { return entry.id == id; }),
+                 sinks->end());
+    unfiltered_sev_ = Severity::V::Inherited.v;
+    for (auto &entry : *sinks) {
+      if (entry.unfiltered) {
+        unfiltered_sev_ = std::min(unfiltered_sev_, entry.threshold.v);
+      }
+    }
+    old = publish_sinks(std::move(sinks));
+    for (uint32_t i = 0; i < max_facilities; i++) {
+      update_effective(i);
+    }
+  }
+  retire_sinks(std::move(old));
+}
+
+void LoggingManager::deliver(message &msg, bool filter) {
+  debug_assert(msg.facility.v < max_facilities);
+  bool passes_facility =
+      !filter || filter_sev_[msg.facility.v].load(std::memory_order_relaxed) <=
+                     msg.severity.v;
+  auto sinks = std::atomic_load_explicit(&sinks_, std::memory_order_acquire);
+  dispatch_frame frame(sinks.get());
+  for (auto const &entry : *sinks) {
+    if (msg.severity < entry.threshold) {
+      continue;
+    }
+    if (!entry.unfiltered && !passes_facility) {
+      continue;
+    }
+    sink_msg(entry.sink, msg);
+  }
+}
 
 void LoggingManager::increase_threshold() {
-  switch (threshold_sev_) {
+  switch (threshold()) {
     case sled::log::Severity::V::Inherited:
     case sled::log::Severity::V::Trace:
       break;
     case sled::log::Severity::V::Debug:
-      threshold_sev_ = sled::log::Severity::V::Trace;
+      set_threshold(sled::log::Severity::V::Trace);
       break;
     case sled::log::Severity::V::Info:
-      threshold_sev_ = sled::log::Severity::V::Debug;
+      set_threshold(sled::log::Severity::V::Debug);
       break;
     case sled::log::Severity::V::Notice:
-      threshold_sev_ = sled::log::Severity::V::Info;
+      set_threshold(sled::log::Severity::V::Info);
       break;
     case sled::log::Severity::V::Warning:
-      threshold_sev_ = sled::log::Severity::V::Notice;
+      set_threshold(sled::log::Severity::V::Notice);
       break;
     case sled::log::Severity::V::Error:
-      threshold_sev_ = sled::log::Severity::V::Warning;
+      set_threshold(sled::log::Severity::V::Warning);
       break;
     case sled::log::Severity::V::Critical:
-      threshold_sev_ = sled::log::Severity::V::Error;
+      set_threshold(sled::log::Severity::V::Error);
       break;
     case sled::log::Severity::V::Fatal:
-      threshold_sev_ = sled::log::Severity::V::Critical;
+      set_threshold(sled::log::Severity::V::Critical);
       break;
   }
 }
 
 void LoggingManager::decrease_threshold() {
-  switch (threshold_sev_) {
+  switch (threshold()) {
     case sled::log::Severity::V::Inherited:
       break;
     case sled::log::Severity::V::Trace:
-      threshold_sev_ = sled::log::Severity::V::Debug;
+      set_threshold(sled::log::Severity::V::Debug);
       break;
     case sled::log::Severity::V::Debug:
-      threshold_sev_ = sled::log::Severity::V::Info;
+      set_threshold(sled::log::Severity::V::Info);
       break;
     case sled::log::Severity::V::Info:
-      threshold_sev_ = sled::log::Severity::V::Notice;
+      set_threshold(sled::log::Severity::V::Notice);
       break;
     case sled::log::Severity::V::Notice:
-      threshold_sev_ = sled::log::Severity::V::Warning;
+      set_threshold(sled::log::Severity::V::Warning);
       break;
     case sled::log::Severity::V::Warning:
-      threshold_sev_ = sled::log::Severity::V::Error;
+      set_threshold(sled::log::Severity::V::Error);
       break;
     case sled::log::Severity::V::Error:
-      threshold_sev_ = sled::log::Severity::V::Critical;
+      set_threshold(sled::log::Severity::V::Critical);
       break;
     case sled::log::Severity::V::Critical:
-      threshold_sev_ = sled::log::Severity::V::Fatal;
+      set_threshold(sled::log::Severity::V::Fatal);
       break;
     case sled::log::Severity::V::Fatal:
       break;
@@ -88,6 +328,43 @@ void LoggingManager::decrease_threshold() {
 }
 
 Facility LoggingManager::add_facility(std::string const &facility) {
-  return Facility{++last_facility_};
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (last_facility_ + 1 >= max_facilities) {
+    throw sled::Exception("Too many facilities: ", facility);
+  }
+  auto id = ++last_facility_;
+  facility_names_[id] = facility;
+  return Facility{id};
+}
+
+Facility LoggingManager::find_facility(std::string const &facility) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (uint32_t i = 0; i <= last_facility_; i++) {
+    if (sled::str_iequal(facility_names_[i], facility)) {
+      return Facility{i};
+    }
+  }
+  throw sled::ConversionError("facility", facility);
+}
+
+void LoggingManager::configure(std::string const &spec) {
+  std::stringstream ss(spec);
+  std::string entry;
+  while (std::getline(ss, entry, ',')) {
+    sled::trim(entry);
+    if (entry.empty()) {
+      continue;
+    }
+    auto eq = entry.find('=');
+    if (eq == std::string::npos) {
+      set_threshold(Severity::from_string(entry));
+    } else {
+      auto name = entry.substr(0, eq);
+      auto sev = entry.substr(eq + 1);
+      sled::trim(name);
+      sled::trim(sev);
+      set_threshold(find_facility(name), Severity::from_string(sev));
+    }
+  }
 }
 }  // namespace sled::log
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/log_sink.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "sled/exception.h"
+
+namespace sled::log {
+
+/**
+ * Format @a msg as a single line with the requested prefix.
+ */
+static std::string format_line(message &msg, SinkFlags flags) {
+  std::stringstream ss;
+  format_prefix(ss, msg, flags);
+  ss << msg.format() << '\n';
+  return ss.str();
+}
+
+/**
+ * write(2) the entire buffer, retrying on short writes.
+ */
+static bool write_all(int fd, char const *data, size_t len) {
+  while (len > 0) {
+    ssize_t r = ::write(fd, data, len);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += r;
+    len -= static_cast<size_t>(r);
+  }
+  return true;
+}
+
+//
+// rotating_file_sink
+//
+
+rotating_file_sink::rotating_file_sink(std::string path,
+                                       rotating_file_options opts)
+    : path_(std::move(path)), opts_(opts) {
+  buf_.reserve(opts_.buffer_size);
+  open_file();
+}
+
+rotating_file_sink::~rotating_file_sink() {
+  flush_locked();
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void rotating_file_sink::open_file() {
+  fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    throw sled::Exception("Unable to open log file ", path_, ": ",
+                          strerror(errno));
+  }
+  struct stat st {};
+  file_bytes_ = (::fstat(fd_, &st) == 0) ? static_cast<size_t>(st.st_size) : 0;
+  opened_ = sled::stopwatch::now();
+}
+
+void rotating_file_sink::flush_locked() {
+  if (!buf_.empty() && fd_ != -1) {
+    write_all(fd_, buf_.data(), buf_.size());
+    file_bytes_ += buf_.size();
+  }
+  buf_.clear();
+}
+
+void rotating_file_sink::flush() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  flush_locked();
+}
+
+void rotating_file_sink::rotate_locked() {
+  flush_locked();
+  ::close(fd_);
+  fd_ = -1;
+  for (int i = opts_.max_files - 1; i > 0; i--) {
+    auto from = path_ + "." + std::to_string(i);
+    auto to = path_ + "." + std::to_string(i + 1);
+    ::rename(from.c_str(), to.c_str());
+  }
+  if (opts_.max_files > 0) {
+    ::rename(path_.c_str(), (path_ + ".1").c_str());
+  } else {
+    ::unlink(path_.c_str());
+  }
+  open_file();
+}
+
+void rotating_file_sink::rotate() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  rotate_locked();
+}
+
+void rotating_file_sink::append(message &msg) {
+  auto line = format_line(msg, opts_.flags);
+  std::lock_guard<std::mutex> lock(mtx_);
+  size_t pending = file_bytes_ + buf_.size();
+  if (pending != 0) {
+    bool expired = false;
+    if (opts_.max_age.v != 0) {
+      auto now = tsc_calibration::get().monotonic(msg.tsc);
+      expired = now - opened_ >= opts_.max_age;
+    }
+    if (expired || pending + line.size() > opts_.max_bytes) {
+      rotate_locked();
+    }
+  }
+  if (buf_.size() + line.size() > opts_.buffer_size) {
+    flush_locked();
+  }
+  if (line.size() > opts_.buffer_size) {
+    write_all(fd_, line.data(), line.size());
+    file_bytes_ += line.size();
+  } else {
+    buf_.insert(buf_.end(), line.begin(), line.end());
+  }
+  if (msg.severity >= opts_.flush_severity) {
+    flush_locked();
+  }
+}
+
+//
+// mmap_file_sink
+//
+
+mmap_file_sink::mmap_file_sink(std::string const &path, size_t chunk_size,
+                               SinkFlags flags)
+    : chunk_size_(chunk_size), flags_(flags) {
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    throw sled::Exception("Unable to open log file ", path, ": ",
+                          strerror(errno));
+  }
+  struct stat st {};
+  if (::fstat(fd_, &st) == 0) {
+    size_ = static_cast<size_t>(st.st_size);
+  }
+  grow(size_ + 1);
+}
+
+mmap_file_sink::~mmap_file_sink() {
+  if (map_ != nullptr) {
+    ::munmap(map_, mapped_);
+  }
+  if (fd_ != -1) {
+    // Drop the unused tail of the last chunk.
+    if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+      // Nothing useful to do during destruction.
+    }
+    ::close(fd_);
+  }
+}
+
+void mmap_file_sink::grow(size_t min_size) {
+  size_t new_size = mapped_;
+  while (new_size < min_size) {
+    new_size += chunk_size_;
+  }
+  if (::ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+    throw sled::Exception("Unable to extend log file: ", strerror(errno));
+  }
+  if (map_ != nullptr) {
+    ::munmap(map_, mapped_);
+    map_ = nullptr;
+  }
+  void *p = ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                   0);
+  if (p == MAP_FAILED) {
+    mapped_ = 0;
+    throw sled::Exception("Unable to map log file: ", strerror(errno));
+  }
+  map_ = static_cast<std::byte *>(p);
+  mapped_ = new_size;
+}
+
+void mmap_file_sink::append(message &msg) {
+  auto line = format_line(msg, flags_);
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (size_ + line.size() > mapped_) {
+    grow(size_ + line.size());
+  }
+  memcpy(map_ + size_, line.data(), line.size());
+  size_ += line.size();
+}
+
+void mmap_file_sink::sync() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (map_ != nullptr) {
+    ::msync(map_, size_, MS_ASYNC);
+  }
+}
+
+//
+// flight_recorder_sink
+//
+
+static std::atomic<flight_recorder_sink *> crash_recorder{nullptr};
+
+flight_recorder_sink::flight_recorder_sink(size_t capacity, Severity trigger,
+                                           int dump_fd, SinkFlags flags)
+    : buf_(capacity), trigger_(trigger), dump_fd_(dump_fd), flags_(flags) {
+  debug_assert(capacity > 0);
+}
+
+flight_recorder_sink::~flight_recorder_sink() {
+  flight_recorder_sink *self = this;
+  crash_recorder.compare_exchange_strong(self, nullptr);
+}
+
+void flight_recorder_sink::record(message &msg) {
+  auto line = format_line(msg, flags_);
+  {
+    sled::sync::SpinLock::lock_guard lock(lock_);
+    char const *data = line.data();
+    size_t len = line.size();
+    size_t cap = buf_.size();
+    if (len > cap) {
+      // Keep the tail of an oversized message.
+      data += len - cap;
+      len = cap;
+    }
+    size_t pos = head_ % cap;
+    size_t first = std::min(len, cap - pos);
+    memcpy(&buf_[pos], data, first);
+    memcpy(&buf_[0], data + first, len - first);
+    head_ += len;
+    if (head_ - tail_ > cap) {
+      tail_ = head_ - cap;
+      truncated_ = true;
+    }
+  }
+  if (msg.severity >= trigger_) {
+    dump();
+  }
+}
+
+uint64_t flight_recorder_sink::first_line() const {
+  uint64_t start = tail_;
+  if (truncated_) {
+    // The oldest line was partially overwritten, skip to the next one.
+    size_t cap = buf_.size();
+    while (start < head_ && buf_[start % cap] != '\n') {
+      start++;
+    }
+    start++;
+  }
+  return start;
+}
+
+std::string flight_recorder_sink::contents() {
+  sled::sync::SpinLock::lock_guard lock(lock_);
+  std::string result;
+  size_t cap = buf_.size();
+  uint64_t start = first_line();
+  if (start >= head_) {
+    return result;
+  }
+  result.reserve(head_ - start);
+  for (uint64_t i = start; i < head_; i++) {
+    result.push_back(buf_[i % cap]);
+  }
+  return result;
+}
+
+void flight_recorder_sink::dump() {
+  auto history = contents();
+  write_all(dump_fd_, history.data(), history.size());
+  sled::sync::SpinLock::lock_guard lock(lock_);
+  tail_ = head_;
+  truncated_ = false;
+}
+
+void flight_recorder_sink::dump_raw() {
+  // Avoid locks and allocation, the process is already in trouble.
+  size_t cap = buf_.size();
+  uint64_t start = first_line();
+  if (start >= head_) {
+    return;
+  }
+  size_t pos = start % cap;
+  size_t len = head_ - start;
+  size_t first = std::min(len, cap - pos);
+  write_all(dump_fd_, &buf_[pos], first);
+  write_all(dump_fd_, &buf_[0], len - first);
+}
+
+void flight_recorder_sink::crash_handler(int sig) {
+  if (auto *recorder = crash_recorder.exchange(nullptr); recorder != nullptr) {
+    recorder->dump_raw();
+  }
+  // SA_RESETHAND restored the default action.
+  ::raise(sig);
+}
+
+void flight_recorder_sink::install_crash_handler() {
+  crash_recorder = this;
+  struct sigaction sa {};
+  sa.sa_handler = &flight_recorder_sink::crash_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+  for (int sig : {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT}) {
+    ::sigaction(sig, &sa, nullptr);
+  }
+}
+
+}  // namespace sled::log
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/log_sink.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+using severity = sled::log::Severity;
+using facility = sled::log::Facility;
+
+/**
+ * Temporary directory removed (with contents) on destruction.
+ */
+class TempDir {
+ public:
+  TempDir() {
+    char tmpl[] = "/tmp/sled-log-XXXXXX";
+    path = mkdtemp(tmpl);
+  }
+  ~TempDir() {
+    std::string cmd = "rm -rf " + path;
+    EXPECT_EQ(0, system(cmd.c_str()));
+  }
+
+  std::string file(std::string const &name) const { return path + "/" + name; }
+
+  std::string path;
+};
+
+static std::string read_file(std::string const &path) {
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+class LogSinkTest : public ::testing::Test {
+ protected:
+  LogSinkTest() : sink(logstream), logman(sink) {}
+
+  std::stringstream logstream;
+  sled::log::Sink sink;
+  sled::log::LoggingManager logman;
+};
+
+TEST_F(LogSinkTest, fan_out) {
+  std::stringstream errors;
+  sled::log::Sink error_sink(errors);
+  logman.add_sink(error_sink, severity::V::Error);
+
+  logman.log_always(facility::V::Exec, severity::V::Warning, "Warning");
+  logman.log_always(facility::V::Exec, severity::V::Error, "Error");
+
+  EXPECT_EQ("Warning\nError\n", logstream.str());
+  EXPECT_EQ("Error\n", errors.str());
+}
+
+TEST_F(LogSinkTest, remove_sink) {
+  std::stringstream other;
+  sled::log::Sink other_sink(other);
+  auto id = logman.add_sink(other_sink);
+
+  logman.log_always(facility::V::Exec, severity::V::Error, "One");
+  logman.remove_sink(id);
+  logman.log_always(facility::V::Exec, severity::V::Error, "Two");
+
+  EXPECT_EQ("One\nTwo\n", logstream.str());
+  EXPECT_EQ("One\n", other.str());
+}
+
+TEST_F(LogSinkTest, unfiltered_sink) {
+  std::stringstream all;
+  sled::log::Sink all_sink(all);
+  logman.set_threshold(severity::V::Warning);
+  logman.add_sink(all_sink, severity::V::Trace, true);
+
+  EXPECT_TRUE(logman.enabled(facility::V::Exec, severity::V::Trace));
+  logman.log_filtered(facility::V::Exec, severity::V::Trace, "Trace");
+  logman.log_filtered(facility::V::Exec, severity::V::Warning, "Warning");
+
+  EXPECT_EQ("Warning\n", logstream.str());
+  EXPECT_EQ("Trace\nWarning\n", all.str());
+}
+
+TEST_F(LogSinkTest, log_always_ignores_thresholds) {
+  std::stringstream errors;
+  sled::log::Sink error_sink(errors);
+  logman.add_sink(error_sink, severity::V::Error);
+  logman.set_threshold(severity::V::Warning);
+
+  // Sink thresholds still apply.
+  logman.log_always(facility::V::Exec, severity::V::Trace, "Trace");
+  EXPECT_EQ("Trace\n", logstream.str());
+  EXPECT_EQ("", errors.str());
+}
+
+TEST_F(LogSinkTest, log_filtered_facility_threshold) {
+  logman.set_threshold(severity::V::Warning);
+
+  logman.log_filtered(facility::V::Exec, severity::V::Trace, "Trace");
+  EXPECT_EQ("", logstream.str());
+
+  logman.set_threshold(facility::V::Exec, severity::V::Trace);
+  logman.log_filtered(facility::V::Exec, severity::V::Trace, "Trace");
+  EXPECT_EQ("Trace\n", logstream.str());
+}
+
+/**
+ * Sink that logs a follow up message from inside dispatch.
+ */
+struct echo_sink {
+  sled::log::LoggingManager *logman;
+
+  friend void sink_msg(echo_sink &sink, sled::log::message &msg) {
+    sink.logman->log_always(facility::V::Exec, severity::V::Warning, "Echo");
+  }
+};
+
+TEST_F(LogSinkTest, sink_logs) {
+  echo_sink echo{&logman};
+  sled::log::Sink echo_sink(echo);
+  logman.add_sink(echo_sink, severity::V::Error);
+
+  logman.log_always(facility::V::Exec, severity::V::Error, "Error");
+
+  EXPECT_EQ("Error\nEcho\n", logstream.str());
+}
+
+/**
+ * Sink that replaces itself with another sink on its first message.
+ */
+struct handoff_sink {
+  sled::log::LoggingManager *logman;
+  sled::log::Sink *next;
+  sled::log::sink_id id{};
+  int calls{0};
+
+  friend void sink_msg(handoff_sink &sink, sled::log::message &msg) {
+    if (sink.calls++ == 0) {
+      sink.logman->add_sink(*sink.next);
+      sink.logman->remove_sink(sink.id);
+    }
+  }
+};
+
+TEST_F(LogSinkTest, sink_changes_sinks) {
+  std::stringstream other;
+  sled::log::Sink other_sink(other);
+  handoff_sink handoff{&logman, &other_sink};
+  sled::log::Sink handoff_sink(handoff);
+  handoff.id = logman.add_sink(handoff_sink);
+
+  logman.log_always(facility::V::Exec, severity::V::Error, "One");
+  logman.log_always(facility::V::Exec, severity::V::Error, "Two");
+
+  EXPECT_EQ(1, handoff.calls);
+  EXPECT_EQ("One\nTwo\n", logstream.str());
+  EXPECT_EQ("Two\n", other.str());
+}
+
+TEST_F(LogSinkTest, flight_recorder_wrap) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  sled::log::flight_recorder_sink recorder(16, severity::V::Error, fds[1],
+                                           sled::log::SinkFlags{});
+  sled::log::Sink rec_sink(recorder);
+  logman.add_sink(rec_sink, severity::V::Trace, true);
+
+  logman.log_always(facility::V::Exec, severity::V::Trace, "aaaa");
+  logman.log_always(facility::V::Exec, severity::V::Trace, "bbbb");
+  EXPECT_EQ("aaaa\nbbbb\n", recorder.contents());
+
+  logman.log_always(facility::V::Exec, severity::V::Trace, "cccc");
+  logman.log_always(facility::V::Exec, severity::V::Trace, "dddd");
+  EXPECT_EQ("bbbb\ncccc\ndddd\n", recorder.contents());
+
+  logman.log_always(facility::V::Exec, severity::V::Error, "eeee");
+  char buf[64] = {};
+  ssize_t r = read(fds[0], buf, sizeof(buf));
+  ASSERT_GT(r, 0);
+  EXPECT_EQ("cccc\ndddd\neeee\n", std::string(buf, static_cast<size_t>(r)));
+  EXPECT_EQ("", recorder.contents());
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(LogSinkTest, rotating_file) {
+  TempDir dir;
+  auto path = dir.file("test.log");
+  sled::log::rotating_file_options opts;
+  opts.max_bytes = 12;
+  opts.max_files = 2;
+  opts.flags = {};
+  {
+    sled::log::rotating_file_sink file(path, opts);
+    sled::log::Sink file_sink(file);
+    logman.add_sink(file_sink);
+    for (auto const *line : {"one", "two", "three", "four", "five"}) {
+      logman.log_always(facility::V::Exec, severity::V::Warning, line);
+    }
+    file.flush();
+  }
+  EXPECT_EQ("five\n", read_file(path));
+  EXPECT_EQ("three\nfour\n", read_file(path + ".1"));
+  EXPECT_EQ("one\ntwo\n", read_file(path + ".2"));
+  EXPECT_EQ(-1, access((path + ".3").c_str(), F_OK));
+}
+
+TEST_F(LogSinkTest, rotating_file_open_error) {
+  EXPECT_THROW(sled::log::rotating_file_sink("/nonexistent/dir/test.log"),
+               sled::Exception);
+}
+
+TEST_F(LogSinkTest, mmap_file) {
+  TempDir dir;
+  auto path = dir.file("test.log");
+  {
+    sled::log::mmap_file_sink file(path, 8, sled::log::SinkFlags{});
+    sled::log::Sink file_sink(file);
+    logman.add_sink(file_sink);
+    logman.log_always(facility::V::Exec, severity::V::Warning, "Hello");
+    logman.log_always(facility::V::Exec, severity::V::Warning, "World!");
+    EXPECT_EQ(13, file.size());
+  }
+  EXPECT_EQ("Hello\nWorld!\n", read_file(path));
+}
@@ -8,6 +8,8 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
 class LogTest : public ::testing::Test {
  protected:
   LogTest() : sink(logstream), logman(sink) {}
@@ -65,3 +67,181 @@ TEST_F(LogTest, add_facilty) {
 
   EXPECT_LT(facility::V::User3.v, facility1.v);
 }
+
+TEST_F(LogTest, tsc_monotonic) {
+  auto t0 = sled::log::tsc_t::now();
+  auto t1 = sled::log::tsc_t::now_ordered();
+  EXPECT_LE(t0.v, t1.v);
+}
+
+TEST_F(LogTest, tsc_calibration) {
+  auto &cal = sled::log::tsc_calibration::get();
+  EXPECT_NE(0u, cal.mult);
+  EXPECT_EQ(&cal, &sled::log::tsc_calibration::get());
+
+  sled::stopwatch sw;
+  auto t0 = sled::log::tsc_t::now_ordered();
+  while (sw.current() < sled::time::from_msec(5)) {
+  }
+  auto t1 = sled::log::tsc_t::now_ordered();
+  auto elapsed = cal.relative(t1) - cal.relative(t0);
+  EXPECT_GT(elapsed, sled::time::from_msec(4));
+  EXPECT_LT(elapsed, sled::time::from_msec(50));
+  EXPECT_LT(cal.relative(cal.base_tsc - sled::log::tsc_t{1000}),
+            sled::time_zero);
+}
+
+TEST_F(LogTest, thread_id) {
+  auto tid = sled::log::thr_id_t::self();
+  EXPECT_NE(0u, tid.v);
+  EXPECT_EQ(tid, sled::log::thr_id_t::self());
+
+  sled::log::thr_id_t other{0};
+  std::thread thr([&]() { other = sled::log::thr_id_t::self(); });
+  thr.join();
+  EXPECT_NE(0u, other.v);
+  EXPECT_NE(tid, other);
+}
+
+TEST_F(LogTest, task_scope) {
+  EXPECT_EQ(0u, sled::log::task_id_t::self().v);
+  {
+    sled::log::task_scope outer(sled::log::task_id_t{5});
+    EXPECT_EQ(5u, sled::log::task_id_t::self().v);
+    {
+      sled::log::task_scope inner(sled::log::task_id_t{7});
+      sled::log::stream_message msg(facility::V::Test, severity::V::Trace);
+      EXPECT_EQ(7u, msg.task_id.v);
+    }
+    EXPECT_EQ(5u, sled::log::task_id_t::self().v);
+  }
+  EXPECT_EQ(0u, sled::log::task_id_t::self().v);
+}
+
+TEST_F(LogTest, sink_prefix) {
+  std::stringstream ss;
+  sled::log::ostream_sink out(ss, {sled::log::SinkFlag::V::RelativeTime,
+                                   sled::log::SinkFlag::V::TaskId});
+  sled::log::LoggingManager logman2(out);
+  sled::log::task_scope scope(sled::log::task_id_t{3});
+
+  logman2.log_always(facility::V::Exec, severity::V::Warning, "Hello World!");
+
+  auto line = ss.str();
+  ASSERT_EQ('[', line[0]);
+  EXPECT_EQ('.', line[7]);
+  EXPECT_EQ("] task:3 Hello World!\n", line.substr(14));
+}
+
+TEST_F(LogTest, facility_threshold) {
+  EXPECT_EQ(severity::V::Notice, logman.threshold(facility::V::Exec));
+  EXPECT_FALSE(logman.enabled(facility::V::Exec, severity::V::Debug));
+
+  logman.set_threshold(facility::V::Exec, severity::V::Debug);
+  EXPECT_TRUE(logman.enabled(facility::V::Exec, severity::V::Debug));
+  EXPECT_FALSE(logman.enabled(facility::V::Perf, severity::V::Debug));
+
+  // Inherited facilities follow the global threshold.
+  logman.set_threshold(severity::V::Error);
+  EXPECT_FALSE(logman.enabled(facility::V::Perf, severity::V::Warning));
+  EXPECT_TRUE(logman.enabled(facility::V::Exec, severity::V::Warning));
+
+  logman.set_threshold(facility::V::Exec, severity::V::Inherited);
+  EXPECT_EQ(severity::V::Error, logman.threshold(facility::V::Exec));
+
+  logman.decrease_threshold();
+  EXPECT_EQ(severity::V::Critical, logman.threshold(facility::V::Exec));
+}
+
+TEST_F(LogTest, configure) {
+  auto custom = logman.add_facility("Custom");
+  logman.configure("Warning, exec=Trace,custom=Info");
+
+  EXPECT_EQ(severity::V::Warning, logman.threshold());
+  EXPECT_EQ(severity::V::Trace, logman.threshold(facility::V::Exec));
+  EXPECT_EQ(severity::V::Info, logman.threshold(custom));
+  EXPECT_EQ(severity::V::Warning, logman.threshold(facility::V::Perf));
+
+  EXPECT_THROW(logman.configure("unknown=Trace"), sled::ConversionError);
+  EXPECT_THROW(logman.configure("Exec=Loud"), sled::ConversionError);
+}
+
+TEST_F(LogTest, too_many_facilities) {
+  EXPECT_THROW(
+      {
+        for (uint32_t i = 0; i < sled::log::LoggingManager::max_facilities;
+             i++) {
+          logman.add_facility("f" + std::to_string(i));
+        }
+      },
+      sled::Exception);
+}
+
+TEST_F(LogTest, log_macro_lazy) {
+  int evaluated = 0;
+  auto arg = [&]() {
+    evaluated++;
+    return "Hello World!";
+  };
+
+  SLED_DEBUG(logman, facility::V::Exec, arg());
+  EXPECT_EQ(0, evaluated);
+  EXPECT_EQ("", logstream.str());
+
+  SLED_WARNING(logman, facility::V::Exec, arg());
+  EXPECT_EQ(1, evaluated);
+  EXPECT_EQ("Hello World!\n", logstream.str());
+}
+
+TEST_F(LogTest, compiled_in) {
+  EXPECT_TRUE(sled::log::compiled_in(severity::V::Fatal));
+  EXPECT_EQ(SLED_LOG_MIN_SEVERITY == 0,
+            sled::log::compiled_in(severity::V::Trace));
+}
+
+static void log_once_helper(sled::log::LoggingManager &logman, int i) {
+  SLED_LOG_ONCE(logman, facility::V::Exec, severity::V::Warning, "once ", i);
+}
+
+TEST_F(LogTest, log_once) {
+  for (int i = 0; i < 3; i++) {
+    log_once_helper(logman, i);
+  }
+  EXPECT_EQ("once 0\n", logstream.str());
+}
+
+TEST_F(LogTest, log_every_n) {
+  for (int i = 0; i < 10; i++) {
+    SLED_LOG_EVERY_N(logman, facility::V::Exec, severity::V::Warning, 4, i);
+  }
+  EXPECT_EQ("0\n4\n8\n", logstream.str());
+}
+
+TEST_F(LogTest, log_rate_site) {
+  sled::log::log_rate_site site(100, 2);
+  uint64_t suppressed = 0;
+  EXPECT_TRUE(site.acquire(suppressed));
+  EXPECT_TRUE(site.acquire(suppressed));
+  for (int i = 0; i < 5; i++) {
+    EXPECT_FALSE(site.acquire(suppressed));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_TRUE(site.acquire(suppressed));
+  EXPECT_EQ(5, suppressed);
+}
+
+TEST_F(LogTest, log_rate_site_zero) {
+  // Zero rate and burst behave as one message per second.
+  sled::log::log_rate_site site(0, 0);
+  uint64_t suppressed = 0;
+  EXPECT_TRUE(site.acquire(suppressed));
+  EXPECT_FALSE(site.acquire(suppressed));
+}
+
+TEST_F(LogTest, log_rate_limited) {
+  for (int i = 0; i < 10; i++) {
+    SLED_LOG_RATE_LIMITED(logman, facility::V::Exec, severity::V::Warning, 1,
+                          1, "flood ", i);
+  }
+  EXPECT_EQ("flood 0\n", logstream.str());
+}
@@ -82,3 +82,23 @@ TEST_F(NumericTest, KiB_tests) {
   kib_test("1KiB", 1024);
   kib_test("1.0KiB", 1024 + 1);
 }
+
+TEST_F(NumericTest, fmt_paths_agree) {
+  auto check = [](std::string const &expected, auto const &v) {
+    std::stringstream ss;
+    ss << v;
+    EXPECT_EQ(expected, ss.str());
+    EXPECT_EQ(expected, fmt_string(v));
+    EXPECT_EQ(expected, sled::format(SLED_FMT("{}"), v));
+  };
+  check("0xBEEF", sled::HexFmt(uint16_t{0xbeef}));
+  check("$1F", sled::HexFmt(uint32_t{0x1f}, {sled::HexFormat::AltPrefix,
+                                             sled::HexFormat::NoPadding}));
+  check("2.5KiB", sled::IntFmt(2560, {sled::IntegerFormat::KiB}));
+  check("12345", sled::IntFmt(12345));
+
+  // Wider than the stack buffer.
+  sled::HexFmt wide(uint8_t{0xab});
+  wide.w = 100;
+  check("0x" + std::string(98, '0') + "AB", wide);
+}
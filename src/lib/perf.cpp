@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/perf.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sled::perf {
+
+#ifdef __linux__
+
+/**
+ * perf_event_attr type/config for each Event.
+ */
+static constexpr std::array<std::pair<uint32_t, uint64_t>, num_events>
+    event_config{{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd) {
+  return static_cast<int>(::syscall(SYS_perf_event_open, attr, 0, -1,
+                                    group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+event_group::event_group() {
+  fds_.fill(-1);
+  int leader = -1;
+  for (size_t i = 0; i < num_events; i++) {
+    struct perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = event_config[i].first;
+    attr.config = event_config[i].second;
+    attr.disabled = (leader == -1) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int fd = perf_event_open(&attr, leader);
+    if (fd == -1) {
+      continue;
+    }
+    fds_[i] = fd;
+    if (leader == -1) {
+      leader = fd;
+    }
+    void *page = ::mmap(nullptr, static_cast<size_t>(sysconf(_SC_PAGESIZE)),
+                        PROT_READ, MAP_SHARED, fd, 0);
+    pages_[i] = (page == MAP_FAILED) ? nullptr : page;
+  }
+  if (leader == -1) {
+    return;
+  }
+  available_ = true;
+  ::ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+  rdpmc_ = true;
+  for (size_t i = 0; i < num_events; i++) {
+    if (fds_[i] == -1) {
+      continue;
+    }
+    auto *pc = static_cast<struct perf_event_mmap_page *>(pages_[i]);
+    if (pc == nullptr || pc->cap_user_rdpmc == 0) {
+      rdpmc_ = false;
+    }
+  }
+}
+
+event_group::~event_group() {
+  for (size_t i = 0; i < num_events; i++) {
+    if (pages_[i] != nullptr) {
+      ::munmap(pages_[i], static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    }
+    if (fds_[i] != -1) {
+      ::close(fds_[i]);
+    }
+  }
+}
+
+uint64_t event_group::read_rdpmc(size_t idx) const {
+  auto *pc = static_cast<struct perf_event_mmap_page volatile *>(pages_[idx]);
+  uint32_t seq;
+  uint64_t count;
+  do {
+    seq = pc->lock;
+    std::atomic_signal_fence(std::memory_order_acq_rel);
+    count = static_cast<uint64_t>(pc->offset);
+    uint32_t index = pc->index;
+    if (index != 0) {
+      // Sign extend the pmc_width bit hardware counter.
+      auto width = pc->pmc_width;
+      auto pmc = static_cast<int64_t>(__rdpmc(static_cast<int>(index - 1)));
+      pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << (64 - width)) >>
+            (64 - width);
+      count += static_cast<uint64_t>(pmc);
+    }
+    std::atomic_signal_fence(std::memory_order_acq_rel);
+  } while (pc->lock != seq);
+  return count;
+}
+
+counters event_group::read() const {
+  counters result;
+  if (!available_) {
+    return result;
+  }
+  if (rdpmc_) {
+    for (size_t i = 0; i < num_events; i++) {
+      if (fds_[i] != -1) {
+        result.v[i] = read_rdpmc(i);
+      }
+    }
+    return result;
+  }
+  // PERF_FORMAT_GROUP: nr followed by one value per opened event, in
+  // opening order.
+  std::array<uint64_t, 1 + num_events> buf{};
+  int leader = -1;
+  for (int fd : fds_) {
+    if (fd != -1) {
+      leader = fd;
+      break;
+    }
+  }
+  if (::read(leader, buf.data(), sizeof(buf)) <= 0) {
+    return result;
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < num_events && n < buf[0]; i++) {
+    if (fds_[i] != -1) {
+      result.v[i] = buf[1 + n++];
+    }
+  }
+  return result;
+}
+
+#else
+
+event_group::event_group() { fds_.fill(-1); }
+
+event_group::~event_group() = default;
+
+uint64_t event_group::read_rdpmc(size_t) const { return 0; }
+
+counters event_group::read() const { return counters{}; }
+
+#endif
+
+event_group &event_group::current() {
+  thread_local event_group group;
+  return group;
+}
+
+//
+// region_stats
+//
+
+region_stats::region_stats(std::string name) : name_(std::move(name)) {}
+
+void region_stats::add(counters const &delta) {
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < num_events; i++) {
+    totals_[i].fetch_add(delta.v[i], std::memory_order_relaxed);
+  }
+}
+
+void region_stats::report_stats(StatisticsReporter &reporter) {
+  reporter.add(name_ + ".calls", StatisticImpl{static_cast<double>(calls())});
+  for (auto const &[id, event_name] : Event::names) {
+    reporter.add(name_ + "." + event_name,
+                 StatisticImpl{static_cast<double>(total(Event{id}))});
+  }
+  auto cycles = total(Event::V::Cycles);
+  reporter.add(name_ + ".ipc",
+               StatisticImpl{cycles == 0 ? 0.0
+                                         : static_cast<double>(total(
+                                               Event::V::Instructions)) /
+                                               static_cast<double>(cycles)});
+}
+
+}  // namespace sled::perf
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/perf.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+static uint64_t busy_work(uint64_t n) {
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    sum = sum + i;
+  }
+  return sum;
+}
+
+TEST(PerfTest, event_group) {
+  auto &group = sled::perf::event_group::current();
+  EXPECT_EQ(&group, &sled::perf::event_group::current());
+
+  auto before = group.read();
+  busy_work(100000);
+  auto delta = group.read() - before;
+  if (!group.available(sled::perf::Event::V::Instructions)) {
+    // Counters unavailable (container/VM), everything reads as zero.
+    EXPECT_EQ(0, delta[sled::perf::Event::V::Instructions]);
+    return;
+  }
+  EXPECT_GT(delta[sled::perf::Event::V::Instructions], 100000);
+}
+
+TEST(PerfTest, per_thread) {
+  auto *main_group = &sled::perf::event_group::current();
+  sled::perf::event_group *other = nullptr;
+  std::thread thread([&]() { other = &sled::perf::event_group::current(); });
+  thread.join();
+  EXPECT_NE(main_group, other);
+}
+
+TEST(PerfTest, perf_region) {
+  sled::perf::region_stats stats("test");
+  for (int i = 0; i < 3; i++) {
+    sled::perf::perf_region region(stats);
+    busy_work(10000);
+  }
+  EXPECT_EQ(3, stats.calls());
+
+  sled::StatisticsReport report;
+  stats.report_stats(report);
+  EXPECT_EQ(3, report.get("test.calls"));
+  EXPECT_EQ(stats.total(sled::perf::Event::V::Cycles),
+            report.get("test.cycles"));
+  if (sled::perf::event_group::current().available(
+          sled::perf::Event::V::Instructions)) {
+    EXPECT_GT(report.get("test.instructions"), 30000);
+  }
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/serialize.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+enum class cpu_mode : uint8_t { user = 1, supervisor = 5 };
+
+struct cpu_state final : sled::serializable<cpu_state> {
+  static constexpr uint32_t version = 3;
+
+  uint16_t pc{0};
+  uint8_t flags{0};
+  int8_t bias{0};
+  cpu_mode mode{cpu_mode::user};
+  uint64_t cycles{0};
+  int32_t delta{0};
+  uint32_t checksum{0};
+  std::array<uint8_t, 4> ram{};
+  std::array<uint16_t, 2> regs{};
+  std::optional<uint16_t> breakpoint;
+  uint8_t legacy{0};
+
+  static constexpr auto fields = std::make_tuple(
+      make_be_field(&cpu_state::pc, "pc"),
+      make_bits_field(&cpu_state::flags, 5, "flags"),
+      make_bits_field(&cpu_state::bias, 4, "bias"),
+      make_bits_field(&cpu_state::mode, 3, "mode"),
+      make_varint_field(&cpu_state::cycles, "cycles"),
+      make_zigzag_field(&cpu_state::delta, "delta"),
+      make_le_field(&cpu_state::checksum, "checksum"),
+      make_be_field(&cpu_state::ram, "ram"),
+      make_le_field(&cpu_state::regs, "regs").since(2),
+      make_be_field(&cpu_state::breakpoint, "breakpoint").since(3),
+      make_be_field(&cpu_state::legacy, "legacy").until(2));
+};
+
+static cpu_state make_state() {
+  cpu_state s;
+  s.pc = 0x1234;
+  s.flags = 0x15;
+  s.bias = -3;
+  s.mode = cpu_mode::supervisor;
+  s.cycles = 300;
+  s.delta = -2;
+  s.checksum = 0xAABBCCDD;
+  s.ram = {1, 2, 3, 4};
+  s.regs = {0x0102, 0x0304};
+  s.breakpoint = 0xBEEF;
+  s.legacy = 0x77;
+  return s;
+}
+
+static bool operator==(cpu_state const &a, cpu_state const &b) {
+  return a.pc == b.pc && a.flags == b.flags && a.bias == b.bias &&
+         a.mode == b.mode && a.cycles == b.cycles && a.delta == b.delta &&
+         a.checksum == b.checksum && a.ram == b.ram && a.regs == b.regs &&
+         a.breakpoint == b.breakpoint && a.legacy == b.legacy;
+}
+
+TEST(SerializeTest, layout) {
+  static_assert(cpu_state::max_encoded_size() ==
+                2 + 2 + 10 + 5 + 4 + 4 + 4 + 3);
+  static_assert(cpu_state::max_encoded_size(1) == 2 + 2 + 10 + 5 + 4 + 4 + 1);
+
+  std::array<std::byte, 64> buf{};
+  sled::byte_cursor c(buf);
+  auto s = make_state();
+  ASSERT_TRUE(s.encode(c));
+  std::vector<uint8_t> expected = {
+      0x12, 0x34,              // pc
+      0xAE, 0xD0,              // 10101 1101 101, padded
+      0xAC, 0x02,              // cycles
+      0x03,                    // delta
+      0xDD, 0xCC, 0xBB, 0xAA,  // checksum
+      0x01, 0x02, 0x03, 0x04,  // ram
+      0x02, 0x01, 0x04, 0x03,  // regs
+      0x01, 0xBE, 0xEF,        // breakpoint
+  };
+  ASSERT_EQ(expected.size(), c.position());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(std::byte{expected[i]}, buf[i]) << i;
+  }
+}
+
+TEST(SerializeTest, round_trip) {
+  std::array<std::byte, 64> buf{};
+  auto s = make_state();
+  for (auto bp : {std::optional<uint16_t>{}, std::optional<uint16_t>{7}}) {
+    s.breakpoint = bp;
+    sled::byte_cursor w(buf);
+    ASSERT_TRUE(s.serialize(w));
+    sled::byte_cursor r(sled::byte_span(buf).first(w.position()));
+    cpu_state d;
+    ASSERT_TRUE(d.deserialize(r));
+    EXPECT_EQ(w.position(), r.position());
+    d.legacy = s.legacy;
+    EXPECT_TRUE(s == d);
+  }
+}
+
+TEST(SerializeTest, decode_const) {
+  std::array<std::byte, 64> buf{};
+  auto s = make_state();
+  sled::byte_cursor w(buf);
+  ASSERT_TRUE(s.serialize(w));
+
+  std::array<std::byte, 64> const &rom = buf;
+  sled::const_byte_cursor r(sled::const_byte_span(rom).first(w.position()));
+  cpu_state d;
+  ASSERT_TRUE(d.deserialize(r));
+  EXPECT_EQ(w.position(), r.position());
+  d.legacy = s.legacy;
+  EXPECT_TRUE(s == d);
+}
+
+TEST(SerializeTest, versions) {
+  std::array<std::byte, 64> buf{};
+  auto s = make_state();
+  sled::byte_cursor w(buf);
+  ASSERT_TRUE(s.encode(w, 1));
+  EXPECT_EQ(2 + 2 + 2 + 1 + 4 + 4 + 1, w.position());
+
+  sled::byte_cursor r(sled::byte_span(buf).first(w.position()));
+  cpu_state d;
+  ASSERT_TRUE(d.decode(r, 1));
+  EXPECT_EQ(0x77, d.legacy);
+  EXPECT_EQ(0, d.regs[0]);
+  EXPECT_FALSE(d.breakpoint);
+  EXPECT_EQ(s.ram, d.ram);
+
+  // Newer than cpu_state::version.
+  sled::byte_cursor v(buf);
+  v.write_varint(4);
+  v.seek(0);
+  EXPECT_FALSE(d.deserialize(v));
+  EXPECT_EQ(0, v.position());
+}
+
+TEST(SerializeTest, short_buffers) {
+  auto s = make_state();
+  std::array<std::byte, 64> full{};
+  sled::byte_cursor fw(full);
+  ASSERT_TRUE(s.encode(fw));
+  size_t size = fw.position();
+
+  for (size_t len = 0; len < size; len++) {
+    std::array<std::byte, 64> buf{};
+    sled::byte_cursor w(sled::byte_span(buf).first(len));
+    EXPECT_FALSE(s.encode(w)) << len;
+    EXPECT_EQ(0, w.position());
+
+    sled::byte_cursor r(sled::byte_span(full).first(len));
+    cpu_state d;
+    EXPECT_FALSE(d.decode(r)) << len;
+    EXPECT_EQ(0, r.position());
+  }
+  // Exact fit takes the checked path.
+  std::array<std::byte, 64> buf{};
+  sled::byte_cursor w(sled::byte_span(buf).first(size));
+  EXPECT_TRUE(s.encode(w));
+  sled::byte_cursor r(sled::byte_span(buf).first(size));
+  cpu_state d;
+  d.legacy = s.legacy;
+  EXPECT_TRUE(d.decode(r));
+  EXPECT_TRUE(s == d);
+}
+
+TEST(SerializeTest, malformed) {
+  auto s = make_state();
+  std::array<std::byte, 64> buf{};
+  sled::byte_cursor w(buf);
+  ASSERT_TRUE(s.encode(w));
+  cpu_state d;
+  // Bad presence byte.
+  buf[19] = std::byte{2};
+  sled::byte_cursor r(buf);
+  EXPECT_FALSE(d.decode(r));
+  EXPECT_EQ(0, r.position());
+  // delta out of int32_t range.
+  buf[6] = std::byte{0xff};
+  sled::byte_cursor r2(buf);
+  EXPECT_FALSE(d.decode(r2));
+}
+
+struct flag_state final : sled::serializable<flag_state> {
+  bool halted{false};
+  std::array<bool, 2> irq{};
+
+  static constexpr auto fields =
+      std::make_tuple(make_be_field(&flag_state::halted, "halted"),
+                      make_le_field(&flag_state::irq, "irq"));
+};
+
+TEST(SerializeTest, bools) {
+  flag_state s;
+  s.halted = true;
+  s.irq = {false, true};
+  std::array<std::byte, 8> buf{};
+  sled::byte_cursor w(buf);
+  ASSERT_TRUE(s.encode(w));
+  EXPECT_EQ(3, w.position());
+
+  flag_state d;
+  sled::byte_cursor r(buf);
+  ASSERT_TRUE(d.decode(r));
+  EXPECT_TRUE(d.halted);
+  EXPECT_EQ(s.irq, d.irq);
+
+  // Only 0 and 1 are valid bools.
+  for (size_t i = 0; i < 3; i++) {
+    auto bad = buf;
+    bad[i] = std::byte{2};
+    sled::byte_cursor r2(bad);
+    EXPECT_FALSE(d.decode(r2)) << i;
+  }
+}
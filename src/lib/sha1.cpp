@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/sha1.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace sled {
+
+namespace {
+
+constexpr uint32_t sha1_init[5] = {0x67452301, 0xefcdab89, 0x98badcfe,
+                                   0x10325476, 0xc3d2e1f0};
+
+constexpr uint32_t sha1_k[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc,
+                                0xca62c1d6};
+
+a_forceinline uint32_t rotl(uint32_t v, int n) {
+  return (v << n) | (v >> (32 - n));
+}
+
+a_forceinline uint32_t load_be32(uint8_t const *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return __builtin_bswap32(v);
+}
+
+a_forceinline void store_be32(std::byte *p, uint32_t v) {
+  v = __builtin_bswap32(v);
+  memcpy(p, &v, sizeof(v));
+}
+
+sha1 digest(uint32_t const state[5]) {
+  sha1 result;
+  for (int i = 0; i < 5; i++) {
+    store_be32(&result.v[4 * i], state[i]);
+  }
+  return result;
+}
+
+/**
+ * Write the final padded block(s) of a @a len byte message to @a out.
+ *
+ * Returns the number of blocks written (1 or 2).
+ */
+size_t pad_tail(uint8_t const *tail, size_t tail_len, uint64_t len,
+                uint8_t out[128]) {
+  size_t blocks = tail_len + 9 <= 64 ? 1 : 2;
+  memset(out, 0, 64 * blocks);
+  memcpy(out, tail, tail_len);
+  out[tail_len] = 0x80;
+  uint64_t bits = __builtin_bswap64(len * 8);
+  memcpy(out + 64 * blocks - 8, &bits, sizeof(bits));
+  return blocks;
+}
+
+//
+// Portable
+//
+
+/**
+ * Round T.  Instead of shifting the working variables each round, their
+ * roles rotate through v[] so the unrolled rounds need no moves.
+ */
+template <int T>
+a_forceinline void scalar_round(uint32_t v[5], uint32_t w[16]) {
+  uint32_t &a = v[(80 - T) % 5];
+  uint32_t &b = v[(81 - T) % 5];
+  uint32_t &c = v[(82 - T) % 5];
+  uint32_t &d = v[(83 - T) % 5];
+  uint32_t &e = v[(84 - T) % 5];
+  if constexpr (T >= 16) {
+    w[T & 15] = rotl(
+        w[(T - 3) & 15] ^ w[(T - 8) & 15] ^ w[(T - 14) & 15] ^ w[T & 15], 1);
+  }
+  uint32_t f;
+  if constexpr (T < 20) {
+    f = d ^ (b & (c ^ d));
+  } else if constexpr (T < 40 || T >= 60) {
+    f = b ^ c ^ d;
+  } else {
+    f = (b & c) | (d & (b | c));
+  }
+  e += rotl(a, 5) + f + sha1_k[T / 20] + w[T & 15];
+  b = rotl(b, 30);
+}
+
+template <size_t... T>
+a_forceinline void scalar_rounds(uint32_t v[5], uint32_t w[16],
+                                 std::index_sequence<T...>) {
+  (scalar_round<T>(v, w), ...);
+}
+
+//
+// SHA extensions
+//
+
+/**
+ * Rounds 4G to 4G + 3.  Fully unrolled so the message words stay in
+ * registers.
+ */
+template <int G>
+__attribute__((target("sse4.1,sha"))) a_forceinline void shani_group(
+    __m128i w[4], __m128i &abcd, __m128i &prev) {
+  auto &wg = w[G % 4];
+  if constexpr (G >= 4) {
+    wg = _mm_sha1msg2_epu32(
+        _mm_xor_si128(_mm_sha1msg1_epu32(wg, w[(G + 1) % 4]), w[(G + 2) % 4]),
+        w[(G + 3) % 4]);
+  }
+  auto e = _mm_sha1nexte_epu32(prev, wg);
+  prev = abcd;
+  abcd = _mm_sha1rnds4_epu32(abcd, e, G / 5);
+}
+
+template <size_t... G>
+__attribute__((target("sse4.1,sha"))) a_forceinline void shani_groups(
+    __m128i w[4], __m128i &abcd, __m128i &prev, std::index_sequence<G...>) {
+  (shani_group<G + 1>(w, abcd, prev), ...);
+}
+
+__attribute__((target("sse4.1,sha"))) void compress_shani(
+    uint32_t state[5], uint8_t const *blocks, size_t count) {
+  auto const bswap =
+      _mm_set_epi64x(0x0001020304050607ull, 0x08090a0b0c0d0e0full);
+  // The instructions keep a in the most significant word.
+  auto abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<__m128i const *>(state)), 0x1b);
+  auto e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+  for (; count > 0; count--, blocks += 64) {
+    auto abcd_save = abcd;
+    auto e_save = e0;
+    __m128i w[4];
+    for (int i = 0; i < 4; i++) {
+      w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<__m128i const *>(blocks + 16 * i)),
+          bswap);
+    }
+
+    // Four rounds per group, group g uses message words 4g to 4g + 3.
+    __m128i e = _mm_add_epi32(e0, w[0]);
+    __m128i prev = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+    shani_groups(w, abcd, prev, std::make_index_sequence<19>{});
+
+    e0 = _mm_sha1nexte_epu32(prev, e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), abcd);
+  state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+//
+// AVX2 multi-buffer
+//
+
+struct lanes {
+  __m256i a, b, c, d, e;
+};
+
+__attribute__((target("avx2"))) a_forceinline __m256i rotl8(__m256i v,
+                                                            int n) {
+  return _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - n));
+}
+
+/**
+ * Load dwords [0, 8) of eight rows as columns, byte swapped.
+ */
+__attribute__((target("avx2"))) a_forceinline void load_transposed(
+    uint8_t const *const rows[8], size_t offset, __m256i out[8]) {
+  auto const bswap = _mm256_set_epi8(
+      12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8,
+      9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m256i r[8];
+  for (int i = 0; i < 8; i++) {
+    r[i] = _mm256_loadu_si256(
+        reinterpret_cast<__m256i const *>(rows[i] + offset));
+  }
+  __m256i t[8];
+  for (int i = 0; i < 8; i += 2) {
+    t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+  }
+  __m256i u[8];
+  for (int i = 0; i < 8; i += 4) {
+    u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+    u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+    u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+    u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+  }
+  for (int i = 0; i < 4; i++) {
+    out[i] = _mm256_shuffle_epi8(
+        _mm256_permute2x128_si256(u[i], u[i + 4], 0x20), bswap);
+    out[i + 4] = _mm256_shuffle_epi8(
+        _mm256_permute2x128_si256(u[i], u[i + 4], 0x31), bswap);
+  }
+}
+
+/**
+ * Round T on eight lanes, see scalar_round.
+ */
+template <int T>
+__attribute__((target("avx2"))) a_forceinline void x8_round(__m256i v[5],
+                                                            __m256i w[16]) {
+  __m256i &a = v[(80 - T) % 5];
+  __m256i &b = v[(81 - T) % 5];
+  __m256i &c = v[(82 - T) % 5];
+  __m256i &d = v[(83 - T) % 5];
+  __m256i &e = v[(84 - T) % 5];
+  if constexpr (T >= 16) {
+    w[T & 15] = rotl8(
+        _mm256_xor_si256(_mm256_xor_si256(w[(T - 3) & 15], w[(T - 8) & 15]),
+                         _mm256_xor_si256(w[(T - 14) & 15], w[T & 15])),
+        1);
+  }
+  __m256i f;
+  if constexpr (T < 20) {
+    f = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+  } else if constexpr (T < 40 || T >= 60) {
+    f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+  } else {
+    f = _mm256_or_si256(_mm256_and_si256(b, c),
+                        _mm256_and_si256(d, _mm256_or_si256(b, c)));
+  }
+  auto k = _mm256_set1_epi32(static_cast<int>(sha1_k[T / 20]));
+  e = _mm256_add_epi32(
+      _mm256_add_epi32(e, _mm256_add_epi32(rotl8(a, 5), f)),
+      _mm256_add_epi32(k, w[T & 15]));
+  b = rotl8(b, 30);
+}
+
+template <size_t... T>
+__attribute__((target("avx2"))) a_forceinline void x8_rounds(
+    __m256i v[5], __m256i w[16], std::index_sequence<T...>) {
+  (x8_round<T>(v, w), ...);
+}
+
+__attribute__((target("avx2"))) void compress_x8(lanes &s,
+                                                 uint8_t const *const rows[8],
+                                                 __m256i active) {
+  __m256i w[16];
+  load_transposed(rows, 0, w);
+  load_transposed(rows, 32, w + 8);
+
+  __m256i v[5] = {s.a, s.b, s.c, s.d, s.e};
+  x8_rounds(v, w, std::make_index_sequence<80>{});
+  // Lanes without a block keep their state.
+  s.a = _mm256_blendv_epi8(s.a, _mm256_add_epi32(s.a, v[0]), active);
+  s.b = _mm256_blendv_epi8(s.b, _mm256_add_epi32(s.b, v[1]), active);
+  s.c = _mm256_blendv_epi8(s.c, _mm256_add_epi32(s.c, v[2]), active);
+  s.d = _mm256_blendv_epi8(s.d, _mm256_add_epi32(s.d, v[3]), active);
+  s.e = _mm256_blendv_epi8(s.e, _mm256_add_epi32(s.e, v[4]), active);
+}
+
+__attribute__((target("avx2"))) void hash_x8(void const *const *data,
+                                             size_t const *len, sha1 *out,
+                                             size_t count) {
+  static uint8_t const zero_block[64] = {};
+  alignas(32) uint8_t tails[8][128];
+  uint8_t const *base[8];
+  size_t full[8];
+  alignas(32) int32_t blocks[8];
+  size_t max_blocks = 0;
+  for (size_t i = 0; i < 8; i++) {
+    if (i < count) {
+      base[i] = static_cast<uint8_t const *>(data[i]);
+      full[i] = len[i] / 64;
+      auto tail = pad_tail(base[i] + 64 * full[i], len[i] % 64, len[i],
+                           tails[i]);
+      blocks[i] = static_cast<int32_t>(full[i] + tail);
+    } else {
+      base[i] = zero_block;
+      full[i] = 0;
+      blocks[i] = 0;
+    }
+    max_blocks = std::max(max_blocks, static_cast<size_t>(blocks[i]));
+  }
+
+  lanes s;
+  s.a = _mm256_set1_epi32(static_cast<int>(sha1_init[0]));
+  s.b = _mm256_set1_epi32(static_cast<int>(sha1_init[1]));
+  s.c = _mm256_set1_epi32(static_cast<int>(sha1_init[2]));
+  s.d = _mm256_set1_epi32(static_cast<int>(sha1_init[3]));
+  s.e = _mm256_set1_epi32(static_cast<int>(sha1_init[4]));
+  auto remaining = _mm256_load_si256(reinterpret_cast<__m256i *>(blocks));
+
+  for (size_t j = 0; j < max_blocks; j++) {
+    uint8_t const *rows[8];
+    for (size_t i = 0; i < 8; i++) {
+      if (j < full[i]) {
+        rows[i] = base[i] + 64 * j;
+      } else if (j < static_cast<size_t>(blocks[i])) {
+        rows[i] = tails[i] + 64 * (j - full[i]);
+      } else {
+        rows[i] = zero_block;
+      }
+    }
+    auto active = _mm256_cmpgt_epi32(
+        remaining, _mm256_set1_epi32(static_cast<int>(j)));
+    compress_x8(s, rows, active);
+  }
+
+  alignas(32) uint32_t words[5][8];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(words[0]), s.a);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(words[1]), s.b);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(words[2]), s.c);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(words[3]), s.d);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(words[4]), s.e);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t state[5] = {words[0][i], words[1][i], words[2][i], words[3][i],
+                         words[4][i]};
+    out[i] = digest(state);
+  }
+}
+
+}  // namespace
+
+//
+// Compression
+//
+
+template <>
+void sha1_compress<hwarch>(uint32_t state[5], uint8_t const *blocks,
+                           size_t count) {
+  for (; count > 0; count--, blocks += 64) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+      w[i] = load_be32(blocks + 4 * i);
+    }
+    uint32_t v[5] = {state[0], state[1], state[2], state[3], state[4]};
+    scalar_rounds(v, w, std::make_index_sequence<80>{});
+    for (int i = 0; i < 5; i++) {
+      state[i] += v[i];
+    }
+  }
+}
+
+template <>
+void sha1_compress<sha_hwarch>(uint32_t state[5], uint8_t const *blocks,
+                               size_t count) {
+  compress_shani(state, blocks, count);
+}
+
+void sha1_compress(uint32_t state[5], uint8_t const *blocks, size_t count) {
+  using compress_fn = void (*)(uint32_t *, uint8_t const *, size_t);
+  static compress_fn const compress = sha_hwarch::available()
+                                          ? &sha1_compress<sha_hwarch>
+                                          : &sha1_compress<hwarch>;
+  compress(state, blocks, count);
+}
+
+//
+// sha1_hash
+//
+
+void sha1_hash::reset() {
+  std::copy(std::begin(sha1_init), std::end(sha1_init), state_);
+  size_ = 0;
+}
+
+void sha1_hash::update(void const *data, size_t len) {
+  auto const *p = static_cast<uint8_t const *>(data);
+  size_t used = size_ % 64;
+  size_ += len;
+  if (used != 0) {
+    size_t n = std::min(len, 64 - used);
+    memcpy(buf_ + used, p, n);
+    p += n;
+    len -= n;
+    if (used + n < 64) {
+      return;
+    }
+    sha1_compress(state_, buf_, 1);
+  }
+  if (len >= 64) {
+    sha1_compress(state_, p, len / 64);
+    p += len & ~size_t{63};
+    len %= 64;
+  }
+  memcpy(buf_, p, len);
+}
+
+sha1 sha1_hash::finalize() {
+  uint8_t tail[128];
+  auto blocks = pad_tail(buf_, size_ % 64, size_, tail);
+  sha1_compress(state_, tail, blocks);
+  return digest(state_);
+}
+
+//
+// Multi-buffer
+//
+
+template <>
+void sha1_hash_many<hwarch>(void const *const *data, size_t const *len,
+                            sha1 *out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = sha1_hash::compute(data[i], len[i]);
+  }
+}
+
+template <>
+void sha1_hash_many<avx2_hwarch>(void const *const *data, size_t const *len,
+                                 sha1 *out, size_t count) {
+  for (size_t i = 0; i < count; i += 8) {
+    hash_x8(data + i, len + i, out + i, std::min<size_t>(8, count - i));
+  }
+}
+
+void sha1_hash_many(void const *const *data, size_t const *len, sha1 *out,
+                    size_t count) {
+  static bool const avx2 = avx2_hwarch::available();
+  for (size_t i = 0; i < count; i += 8) {
+    auto n = std::min<size_t>(8, count - i);
+    // A lane runs at about a fifth of a single SHA-NI stream, so small
+    // groups are better hashed one at a time.
+    if (avx2 && n >= 5) {
+      hash_x8(data + i, len + i, out + i, n);
+    } else {
+      sha1_hash_many<hwarch>(data + i, len + i, out + i, n);
+    }
+  }
+}
+
+}  // namespace sled
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/sha1.h"
+
+#include "gtest/gtest.h"
+
+static std::string sha1_hex(std::string const &msg) {
+  return sled::sha1_hash::compute(msg.data(), msg.size()).hex();
+}
+
+TEST(Sha1Test, known_values) {
+  EXPECT_EQ("da39a3ee5e6b4b0d3255bfef95601890afd80709", sha1_hex(""));
+  EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", sha1_hex("abc"));
+  EXPECT_EQ("84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+            sha1_hex("abcdbcdecdefdefgefghfghighijhijk"
+                     "ijkljklmklmnlmnomnopnopq"));
+  EXPECT_EQ("34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+            sha1_hex(std::string(1000000, 'a')));
+}
+
+TEST(Sha1Test, streaming) {
+  std::string msg(1000, 'x');
+  for (size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<char>(i * 13);
+  }
+  sled::sha1_hash h;
+  size_t offset = 0;
+  for (size_t n : {1, 63, 64, 65, 200, 607}) {
+    h.update(std::string_view(msg).substr(offset, n));
+    offset += n;
+  }
+  EXPECT_EQ(sha1_hex(msg), h.finalize().hex());
+  h.reset();
+  h.update("abc");
+  EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", h.finalize().hex());
+}
+
+TEST(Sha1Test, sha_extensions) {
+  if (!sled::sha_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  std::vector<uint8_t> data(64 * 9);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * 7 + 3);
+  }
+  uint32_t scalar[5] = {1, 2, 3, 4, 5};
+  uint32_t shani[5] = {1, 2, 3, 4, 5};
+  sled::sha1_compress<sled::hwarch>(scalar, data.data(), 9);
+  sled::sha1_compress<sled::sha_hwarch>(shani, data.data(), 9);
+  EXPECT_EQ(0, memcmp(scalar, shani, sizeof(scalar)));
+}
+
+TEST(Sha1Test, hash_many) {
+  if (!sled::avx2_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  std::vector<std::string> msgs;
+  for (size_t len : {0, 3, 55, 56, 63, 64, 65, 119, 120, 1000, 4096}) {
+    msgs.push_back(std::string(len, static_cast<char>('a' + len % 26)));
+  }
+  std::vector<void const *> data;
+  std::vector<size_t> len;
+  for (auto const &m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+  }
+  std::vector<sled::sha1> out(msgs.size());
+  sled::sha1_hash_many<sled::avx2_hwarch>(data.data(), len.data(), out.data(),
+                                          msgs.size());
+  for (size_t i = 0; i < msgs.size(); i++) {
+    EXPECT_EQ(sha1_hex(msgs[i]), out[i].hex()) << "len " << len[i];
+  }
+}
+
+TEST(Sha1Test, hex) {
+  auto h = sled::sha1_hash::compute("abc", 3);
+  std::stringstream ss;
+  ss << h;
+  EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", ss.str());
+  EXPECT_EQ(h,
+            sled::sha1::from_hex("A9993E364706816ABA3E25717850C26C9CD0D89D"));
+  EXPECT_FALSE(sled::sha1::from_hex("a9993e").has_value());
+  EXPECT_FALSE(sled::sha1::from_hex(std::string(40, 'g')).has_value());
+  EXPECT_TRUE(static_cast<bool>(h));
+  EXPECT_FALSE(static_cast<bool>(sled::sha1{}));
+}
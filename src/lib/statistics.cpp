@@ -6,6 +6,8 @@
 
 #include "sled/statistics.h"
 
+#include "sled/exception.h"
+
 namespace sled {
 
 void StatisticsReport::add(const std::string &name, StatisticImpl stat) {
@@ -21,4 +23,132 @@ StatisticImpl StatisticsReport::get(const std::string &name) {
   return it->second;
 }
 
+//
+// StatsRegistry
+//
+
+thread_local std::array<StatsRegistry::ShardCache,
+                        StatsRegistry::cache_entries>
+    StatsRegistry::cache_{};
+
+static std::atomic<uint64_t> next_registry_serial{1};
+
+StatsRegistry::StatsRegistry(size_t capacity)
+    : serial_(next_registry_serial++), capacity_(capacity) {}
+
+StatsRegistry::~StatsRegistry() = default;
+
+MetricId StatsRegistry::add_metric(std::string const &name, MetricKind kind) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto const &metric : metrics_) {
+    if (metric.name == name) {
+      if (metric.kind != kind) {
+        throw sled::Exception("Metric ", name, " already registered as ",
+                              metric.kind);
+      }
+      return MetricId{metric.slot};
+    }
+  }
+  uint32_t slots = (kind == MetricKind::V::Aggregate) ? 2 : 1;
+  if (used_ + slots > capacity_) {
+    throw sled::Exception("Statistics registry full, unable to add ", name);
+  }
+  metrics_.push_back(Metric{name, kind, used_});
+  used_ += slots;
+  return MetricId{metrics_.back().slot};
+}
+
+MetricId StatsRegistry::add_counter(std::string const &name) {
+  return add_metric(name, MetricKind::V::Counter);
+}
+
+MetricId StatsRegistry::add_aggregate(std::string const &name) {
+  return add_metric(name, MetricKind::V::Aggregate);
+}
+
+MetricId StatsRegistry::find(std::string const &name) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto const &metric : metrics_) {
+    if (metric.name == name) {
+      return MetricId{metric.slot};
+    }
+  }
+  throw sled::Exception("Unknown metric: ", name);
+}
+
+StatsRegistry::Shard &StatsRegistry::register_thread() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto &shard = thread_shards_[std::this_thread::get_id()];
+  if (shard == nullptr) {
+    shards_.push_back(std::make_unique<Shard>(capacity_));
+    shard = shards_.back().get();
+  }
+  cache_[serial_ % cache_entries] = ShardCache{serial_, shard};
+  return *shard;
+}
+
+void StatsRegistry::Shard::read(std::vector<int64_t> &totals, size_t count) {
+  std::vector<int64_t> copy(count);
+  for (;;) {
+    auto before = seq.load(std::memory_order_acquire);
+    if ((before & 1) != 0) {
+      continue;
+    }
+    for (size_t i = 0; i < count; i++) {
+      copy[i] = slot(static_cast<uint32_t>(i)).load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq.load(std::memory_order_relaxed) == before) {
+      break;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    totals[i] += copy[i];
+  }
+}
+
+std::vector<int64_t> StatsRegistry::totals() const {
+  std::vector<int64_t> result(used_);
+  for (auto const &shard : shards_) {
+    shard->read(result, used_);
+  }
+  return result;
+}
+
+MetricValue StatsRegistry::get(MetricId id) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto totals = this->totals();
+  for (auto const &metric : metrics_) {
+    if (metric.slot == id.v) {
+      MetricValue value{metric.name, metric.kind, totals[metric.slot], 0};
+      if (metric.kind == MetricKind::V::Aggregate) {
+        value.count = totals[metric.slot + 1];
+      }
+      return value;
+    }
+  }
+  throw sled::Exception("Unknown metric id: ", id.v);
+}
+
+std::vector<MetricValue> StatsRegistry::snapshot() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto totals = this->totals();
+  std::vector<MetricValue> result;
+  result.reserve(metrics_.size());
+  for (auto const &metric : metrics_) {
+    MetricValue value{metric.name, metric.kind, totals[metric.slot], 0};
+    if (metric.kind == MetricKind::V::Aggregate) {
+      value.count = totals[metric.slot + 1];
+    }
+    result.push_back(std::move(value));
+  }
+  return result;
+}
+
+void StatsRegistry::report_stats(StatisticsReporter &reporter) {
+  for (auto const &value : snapshot()) {
+    reporter.add(value.name, value);
+  }
+}
+
 }  // namespace sled
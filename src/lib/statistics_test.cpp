@@ -8,6 +8,9 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+#include <vector>
+
 // XXX: eww
 namespace sled {
 
@@ -58,4 +61,85 @@ TEST_F(StatisticsTest, increment) {
   EXPECT_EQ(50, report.get("StatC"));
 }
 
+TEST(StatsRegistryTest, register_once) {
+  StatsRegistry stats;
+  auto a = stats.add_counter("a");
+  auto b = stats.add_aggregate("b");
+  EXPECT_NE(a, b);
+  EXPECT_EQ(a, stats.add_counter("a"));
+  EXPECT_EQ(b, stats.find("b"));
+  EXPECT_THROW(stats.add_aggregate("a"), sled::Exception);
+  EXPECT_THROW(stats.find("c"), sled::Exception);
+}
+
+TEST(StatsRegistryTest, capacity) {
+  StatsRegistry stats(3);
+  stats.add_counter("a");
+  stats.add_aggregate("b");
+  EXPECT_THROW(stats.add_counter("c"), sled::Exception);
+}
+
+TEST(StatsRegistryTest, threads) {
+  StatsRegistry stats;
+  auto count = stats.add_counter("count");
+  auto value = stats.add_aggregate("value");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 100000; i++) {
+        stats.add(count);
+        stats.record(value, 10);
+      }
+    });
+  }
+  // Snapshots taken while updating must stay consistent.
+  for (int i = 0; i < 100; i++) {
+    auto values = stats.snapshot();
+    ASSERT_EQ(2, values.size());
+    EXPECT_EQ(values[1].sum, values[1].count * 10);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(400000, stats.get(count).sum);
+  EXPECT_EQ(400000, stats.get(value).count);
+
+  StatisticsReport report;
+  stats.report_stats(report);
+  EXPECT_EQ(400000, report.get("count"));
+  EXPECT_EQ(10.0, report.get("value"));
+}
+
+TEST(StatsRegistryTest, multiple_registries) {
+  StatsRegistry a;
+  StatsRegistry b;
+  auto ca = a.add_counter("c");
+  auto cb = b.add_counter("c");
+  a.add(ca, 2);
+  b.add(cb, 3);
+  a.add(ca, 2);
+  EXPECT_EQ(4, a.get(ca).sum);
+  EXPECT_EQ(3, b.get(cb).sum);
+}
+
+TEST(StatsRegistryTest, many_registries) {
+  // More registries than per-thread cache entries, updated alternately.
+  std::vector<std::unique_ptr<StatsRegistry>> registries;
+  std::vector<MetricId> ids;
+  for (int i = 0; i < 20; i++) {
+    registries.push_back(std::make_unique<StatsRegistry>());
+    ids.push_back(registries.back()->add_counter("c"));
+  }
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 20; i++) {
+      registries[i]->add(ids[i], i);
+    }
+  }
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(3 * i, registries[i]->get(ids[i]).sum);
+  }
+}
+
 }
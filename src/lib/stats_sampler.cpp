@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/stats_sampler.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "sled/exception.h"
+
+namespace sled {
+
+/**
+ * Collects a single provider's statistics into a sample.
+ */
+class SampleReporter final : public StatisticsReporter {
+ public:
+  explicit SampleReporter(std::string const &prefix) : prefix_(prefix) {}
+
+  void add(const std::string &name, StatisticImpl stat) override {
+    values.emplace_back(prefix_ + name, stat.v);
+  }
+
+  StatisticImpl get(const std::string &name) override {
+    for (auto const &[n, v] : values) {
+      if (n == prefix_ + name) {
+        return StatisticImpl{v};
+      }
+    }
+    return StatisticImpl{};
+  }
+
+  std::vector<std::pair<std::string, double>> values;
+
+ private:
+  std::string const &prefix_;
+};
+
+/**
+ * Prometheus metric names are restricted to [a-zA-Z_:][a-zA-Z0-9_:]*.
+ */
+static std::string prometheus_name(std::string const &name) {
+  std::string result;
+  result.reserve(name.size() + 1);
+  if (name.empty() || isdigit(static_cast<unsigned char>(name[0]))) {
+    result.push_back('_');
+  }
+  for (char c : name) {
+    result.push_back(isalnum(static_cast<unsigned char>(c)) || c == ':' ? c
+                                                                        : '_');
+  }
+  return result;
+}
+
+static void write_all(int fd, std::string const &data) {
+  char const *p = data.data();
+  size_t len = data.size();
+  while (len > 0) {
+    ssize_t r = ::write(fd, p, len);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    p += r;
+    len -= static_cast<size_t>(r);
+  }
+}
+
+StatsSampler::StatsSampler(StatsSamplerOptions opts)
+    : opts_(std::move(opts)), start_(stopwatch::now()) {}
+
+StatsSampler::~StatsSampler() { stop(); }
+
+void StatsSampler::add_provider(StatsImpl &provider, std::string prefix) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  providers_.emplace_back(&provider, std::move(prefix));
+}
+
+void StatsSampler::remove_provider(StatsImpl &provider) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  providers_.erase(std::remove_if(providers_.begin(), providers_.end(),
+                                  [&](auto const &entry) {
+                                    return entry.first == &provider;
+                                  }),
+                   providers_.end());
+}
+
+void StatsSampler::track_rate(std::string const &name) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  rates_.insert(name);
+}
+
+void StatsSampler::start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  if (::pipe2(wake_fd_, O_CLOEXEC) != 0) {
+    throw sled::Exception("Unable to create pipe: ", strerror(errno));
+  }
+  if (!opts_.socket_path.empty()) {
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (opts_.socket_path.size() >= sizeof(addr.sun_path)) {
+      throw sled::Exception("Socket path too long: ", opts_.socket_path);
+    }
+    strncpy(addr.sun_path, opts_.socket_path.c_str(),
+            sizeof(addr.sun_path) - 1);
+    ::unlink(opts_.socket_path.c_str());
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ != -1 &&
+        ::bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr),
+               sizeof(addr)) == 0) {
+      bound_ = true;
+    }
+    if (!bound_ || ::listen(listen_fd_, 5) != 0) {
+      auto err = errno;
+      stop();
+      throw sled::Exception("Unable to listen on ", opts_.socket_path, ": ",
+                            strerror(err));
+    }
+  }
+  thread_ = std::thread([this]() { run(); });
+}
+
+void StatsSampler::stop() {
+  if (thread_.joinable()) {
+    write_all(wake_fd_[1], "x");
+    thread_.join();
+  }
+  for (int *fd : {&wake_fd_[0], &wake_fd_[1], &listen_fd_}) {
+    if (*fd != -1) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+  // Only remove a socket this instance bound, otherwise the path may
+  // belong to another sampler.
+  if (bound_) {
+    ::unlink(opts_.socket_path.c_str());
+    bound_ = false;
+  }
+}
+
+void StatsSampler::run() {
+  auto next = stopwatch::now();
+  for (;;) {
+    auto now = stopwatch::now();
+    if (now >= next) {
+      sample();
+      next = next + opts_.interval;
+      if (next < now) {
+        // Fell behind, don't try to catch up.
+        next = now + opts_.interval;
+      }
+      continue;
+    }
+    struct pollfd fds[2] = {{wake_fd_[0], POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+    auto timeout = (next - now).v / msec::NSECS + 1;
+    int r = ::poll(fds, listen_fd_ == -1 ? 1 : 2, static_cast<int>(timeout));
+    if (r < 0 && errno != EINTR) {
+      return;
+    }
+    if ((fds[0].revents & POLLIN) != 0) {
+      return;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      serve_client();
+    }
+  }
+}
+
+void StatsSampler::serve_client() {
+  int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  std::stringstream ss;
+  write_prometheus(ss);
+  write_all(fd, ss.str());
+  ::close(fd);
+}
+
+void StatsSampler::sample() { sample(stopwatch::now() - start_); }
+
+void StatsSampler::sample(sled::time when) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Sample sample{when, {}};
+    sample.values.assign(names_.size(), std::nan(""));
+    for (auto &[provider, prefix] : providers_) {
+      SampleReporter reporter(prefix);
+      provider->report_stats(reporter);
+      for (auto &[name, v] : reporter.values) {
+        auto it = index_.find(name);
+        if (it == index_.end()) {
+          it = index_.emplace(name, names_.size()).first;
+          names_.push_back(name);
+          sample.values.push_back(std::nan(""));
+        }
+        sample.values[it->second] = v;
+      }
+    }
+    samples_.push_back(std::move(sample));
+    while (samples_.size() > opts_.history) {
+      samples_.pop_front();
+    }
+  }
+  export_sample();
+}
+
+double StatsSampler::value(Sample const &sample, size_t idx) const {
+  return idx < sample.values.size() ? sample.values[idx] : std::nan("");
+}
+
+double StatsSampler::rate_locked(size_t idx) const {
+  if (samples_.size() < 2) {
+    return 0;
+  }
+  auto const &prev = samples_[samples_.size() - 2];
+  auto const &last = samples_.back();
+  auto dt = static_cast<double>((last.when - prev.when).v);
+  double dv = value(last, idx) - value(prev, idx);
+  if (dt <= 0 || std::isnan(dv)) {
+    return 0;
+  }
+  return dv * sec::NSECS / dt;
+}
+
+std::vector<std::string> StatsSampler::series() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return names_;
+}
+
+std::vector<std::pair<sled::time, double>> StatsSampler::history(
+    std::string const &name) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::vector<std::pair<sled::time, double>> result;
+  auto it = index_.find(name);
+  if (it == index_.end()) {
+    return result;
+  }
+  for (auto const &sample : samples_) {
+    auto v = value(sample, it->second);
+    if (!std::isnan(v)) {
+      result.emplace_back(sample.when, v);
+    }
+  }
+  return result;
+}
+
+double StatsSampler::latest(std::string const &name) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = index_.find(name);
+  if (it == index_.end() || samples_.empty()) {
+    return 0;
+  }
+  auto v = value(samples_.back(), it->second);
+  return std::isnan(v) ? 0 : v;
+}
+
+double StatsSampler::rate(std::string const &name) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = index_.find(name);
+  if (it == index_.end()) {
+    return 0;
+  }
+  return rate_locked(it->second);
+}
+
+void StatsSampler::write_prometheus_locked(std::ostream &os) const {
+  if (samples_.empty()) {
+    return;
+  }
+  auto const &last = samples_.back();
+  os.precision(std::numeric_limits<double>::max_digits10);
+  for (size_t i = 0; i < names_.size(); i++) {
+    auto v = value(last, i);
+    if (std::isnan(v)) {
+      continue;
+    }
+    auto name = prometheus_name(names_[i]);
+    os << "# TYPE " << name << " gauge\n" << name << " " << v << "\n";
+    if (rates_.count(names_[i]) != 0) {
+      os << "# TYPE " << name << "_rate gauge\n"
+         << name << "_rate " << rate_locked(i) << "\n";
+    }
+  }
+}
+
+void StatsSampler::write_prometheus(std::ostream &os) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  write_prometheus_locked(os);
+}
+
+void StatsSampler::write_csv(std::ostream &os) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  os << "time";
+  for (auto const &name : names_) {
+    os << "," << name;
+  }
+  os << "\n";
+  for (auto const &sample : samples_) {
+    os << static_cast<double>(sample.when);
+    for (size_t i = 0; i < names_.size(); i++) {
+      os << ",";
+      auto v = value(sample, i);
+      if (!std::isnan(v)) {
+        os << v;
+      }
+    }
+    os << "\n";
+  }
+}
+
+void StatsSampler::export_sample() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!opts_.prometheus_path.empty()) {
+    // Write and rename so readers never see a partial file.
+    auto tmp = opts_.prometheus_path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      write_prometheus_locked(out);
+    }
+    ::rename(tmp.c_str(), opts_.prometheus_path.c_str());
+  }
+  if (!opts_.csv_path.empty() && !samples_.empty()) {
+    std::ofstream out(opts_.csv_path, std::ios::app);
+    if (csv_columns_ != names_.size()) {
+      // New series showed up, start a new header.
+      out << "time";
+      for (auto const &name : names_) {
+        out << "," << name;
+      }
+      out << "\n";
+      csv_columns_ = names_.size();
+    }
+    auto const &last = samples_.back();
+    out << static_cast<double>(last.when);
+    for (size_t i = 0; i < names_.size(); i++) {
+      out << ",";
+      auto v = value(last, i);
+      if (!std::isnan(v)) {
+        out << v;
+      }
+    }
+    out << "\n";
+  }
+}
+
+}  // namespace sled
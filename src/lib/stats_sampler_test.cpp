@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/stats_sampler.h"
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+struct FrameStats : public sled::StatsImpl {
+  sled::Counter<int> frames{0};
+  sled::Aggregate<int> frame_time{};
+
+  void report_stats(sled::StatisticsReporter &reporter) final {
+    reporter.add("frames", frames);
+    reporter.add("frame time", frame_time);
+  }
+};
+
+std::string read_file(std::string const &path) {
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+}  // namespace
+
+class StatsSamplerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/sled-stats-XXXXXX";
+    dir = mkdtemp(tmpl);
+    stats.frame_time += 10;
+  }
+
+  void TearDown() override {
+    std::string cmd = "rm -rf " + dir;
+    EXPECT_EQ(0, system(cmd.c_str()));
+  }
+
+  std::string dir;
+  FrameStats stats;
+};
+
+TEST_F(StatsSamplerTest, history) {
+  sled::StatsSamplerOptions opts;
+  opts.history = 3;
+  sled::StatsSampler sampler(opts);
+  sampler.add_provider(stats, "emu.");
+
+  for (int i = 0; i < 5; i++) {
+    stats.frames += 60;
+    sampler.sample(sled::msec(500 * i));
+  }
+
+  EXPECT_EQ(std::vector<std::string>({"emu.frames", "emu.frame time"}),
+            sampler.series());
+  auto history = sampler.history("emu.frames");
+  ASSERT_EQ(3, history.size());
+  EXPECT_EQ(180, history[0].second);
+  EXPECT_EQ(300, history[2].second);
+  EXPECT_LT(history[0].first, history[2].first);
+  EXPECT_EQ(300, sampler.latest("emu.frames"));
+  // 60 frames every 500ms.
+  EXPECT_DOUBLE_EQ(120, sampler.rate("emu.frames"));
+  EXPECT_EQ(0, sampler.rate("emu.frame time"));
+  EXPECT_EQ(0, sampler.latest("unknown"));
+
+  sampler.remove_provider(stats);
+  sampler.sample();
+  EXPECT_EQ(2, sampler.history("emu.frames").size());
+}
+
+TEST_F(StatsSamplerTest, prometheus) {
+  sled::StatsSampler sampler;
+  sampler.add_provider(stats, "emu.");
+  sampler.track_rate("emu.frames");
+  sampler.sample(sled::sec(1));
+  stats.frames += 5;
+  sampler.sample(sled::sec(3));
+
+  std::stringstream ss;
+  sampler.write_prometheus(ss);
+  EXPECT_EQ(
+      "# TYPE emu_frames gauge\n"
+      "emu_frames 5\n"
+      "# TYPE emu_frames_rate gauge\n"
+      "emu_frames_rate 2.5\n"
+      "# TYPE emu_frame_time gauge\n"
+      "emu_frame_time 10\n",
+      ss.str());
+}
+
+TEST_F(StatsSamplerTest, files) {
+  sled::StatsSamplerOptions opts;
+  opts.prometheus_path = dir + "/stats.prom";
+  opts.csv_path = dir + "/stats.csv";
+  sled::StatsSampler sampler(opts);
+  sampler.add_provider(stats);
+  sampler.sample();
+  stats.frames += 1;
+  sampler.sample();
+
+  EXPECT_NE(std::string::npos,
+            read_file(opts.prometheus_path).find("frames 1\n"));
+  std::stringstream csv(read_file(opts.csv_path));
+  std::string line;
+  std::getline(csv, line);
+  EXPECT_EQ("time,frames,frame time", line);
+  std::getline(csv, line);
+  EXPECT_EQ(",0,10", line.substr(line.find(',')));
+  std::getline(csv, line);
+  EXPECT_EQ(",1,10", line.substr(line.find(',')));
+
+  std::stringstream all;
+  sampler.write_csv(all);
+  EXPECT_EQ(read_file(opts.csv_path), all.str());
+}
+
+TEST_F(StatsSamplerTest, socket) {
+  sled::StatsSamplerOptions opts;
+  opts.interval = sled::msec(10);
+  opts.socket_path = dir + "/stats.sock";
+  sled::StatsSampler sampler(opts);
+  sampler.add_provider(stats);
+  sampler.start();
+
+  while (sampler.history("frames").size() < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_NE(-1, fd);
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, opts.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  ASSERT_EQ(0, ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                         sizeof(addr)));
+  std::string text;
+  char buf[256];
+  ssize_t r;
+  while ((r = ::read(fd, buf, sizeof(buf))) > 0) {
+    text.append(buf, static_cast<size_t>(r));
+  }
+  ::close(fd);
+  EXPECT_NE(std::string::npos, text.find("frames 0\n"));
+
+  sampler.stop();
+  EXPECT_EQ(-1, ::access(opts.socket_path.c_str(), F_OK));
+}
+
+TEST_F(StatsSamplerTest, socket_not_owned) {
+  sled::StatsSamplerOptions opts;
+  opts.socket_path = dir + "/other.sock";
+  { std::ofstream out(opts.socket_path); }
+  {
+    sled::StatsSampler sampler(opts);
+    sampler.stop();
+  }
+  EXPECT_EQ(0, ::access(opts.socket_path.c_str(), F_OK));
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Deterministic pseudo-random test buffer.
+ *
+ * A small LCG, so the same @a seed always gives the same bytes.  @a T is any
+ * byte-sized type (uint8_t, std::byte, char).
+ */
+template <typename T = uint8_t>
+std::vector<T> test_bytes(size_t size, uint32_t seed = 1) {
+  static_assert(sizeof(T) == 1, "test_bytes requires a byte type");
+  std::vector<T> data(size);
+  uint32_t x = seed;
+  for (auto &b : data) {
+    x = x * 1103515245 + 12345;
+    b = static_cast<T>(x >> 16);
+  }
+  return data;
+}
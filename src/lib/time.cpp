@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/time.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "sled/x86arch.h"
+
+namespace sled {
+
+//
+// tsc_calibration
+//
+
+/**
+ * Sample the TSC and monotonic clock together.
+ *
+ * The TSC is read on both sides of the clock read and the narrowest window
+ * of several attempts is used.
+ */
+static std::pair<tsc_t, time> tsc_sample() {
+  uint64_t best_window = ~0ull;
+  std::pair<tsc_t, time> best{};
+  for (int i = 0; i < 5; i++) {
+    auto t0 = tsc_t::now_ordered();
+    auto mono = stopwatch::now();
+    auto t1 = tsc_t::now_ordered();
+    if (t1.v - t0.v < best_window) {
+      best_window = t1.v - t0.v;
+      best = std::make_pair(tsc_t{t0.v + (t1.v - t0.v) / 2}, mono);
+    }
+  }
+  return best;
+}
+
+static bool tsc_invariant() {
+  if (x86::CPUID80000000().eax() < 0x80000007) {
+    return false;
+  }
+  return x86::CPUID80000007().edx().is_set(
+      x86::CPUID80000007_EDX_FEATURE::V::INVARIANT_TSC);
+}
+
+static tsc_calibration tsc_calibrate() {
+  static constexpr auto calibration_period = time::from_msec(10);
+  tsc_calibration cal;
+
+  auto wall = std::chrono::system_clock::now().time_since_epoch();
+  auto [tsc0, mono0] = tsc_sample();
+  while (stopwatch::now() - mono0 < calibration_period) {
+  }
+  auto [tsc1, mono1] = tsc_sample();
+
+  auto elapsed_ns = static_cast<uint64_t>((mono1 - mono0).v);
+  auto elapsed_ticks = tsc1.v - tsc0.v;
+  cal.base_tsc = tsc0;
+  cal.base_mono = mono0;
+  cal.base_wall =
+      time{std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count()};
+  if (elapsed_ticks != 0) {
+    cal.mult = (elapsed_ns << tsc_calibration::shift) / elapsed_ticks;
+  }
+  cal.invariant = tsc_invariant();
+  return cal;
+}
+
+tsc_calibration const &tsc_calibration::get() {
+  static tsc_calibration const calibration = tsc_calibrate();
+  return calibration;
+}
+
+//
+// coarse_clock
+//
+
+std::atomic<int64_t> coarse_clock::now_{0};
+
+namespace {
+
+struct coarse_ticker {
+  ~coarse_ticker() {
+    std::thread old;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      running = false;
+      cv.notify_all();
+      old = std::move(thread);
+    }
+    if (old.joinable()) {
+      old.join();
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread thread;
+  bool running{false};
+  uint64_t generation{0};  // Bumped by every start()
+};
+
+coarse_ticker &ticker() {
+  static coarse_ticker t;
+  return t;
+}
+
+}  // namespace
+
+void coarse_clock::start(time resolution) {
+  auto &t = ticker();
+  std::thread old;
+  {
+    std::lock_guard<std::mutex> lock(t.mtx);
+    if (t.running) {
+      return;
+    }
+    // A racing stop() may not have joined its thread yet.
+    old = std::move(t.thread);
+    t.running = true;
+    auto generation = ++t.generation;
+    now_.store(stopwatch::now().v, std::memory_order_relaxed);
+    t.thread = std::thread([&t, resolution, generation]() {
+      std::unique_lock<std::mutex> lock(t.mtx);
+      while (t.running && t.generation == generation) {
+        now_.store(stopwatch::now().v, std::memory_order_relaxed);
+        t.cv.wait_for(lock, std::chrono::nanoseconds(resolution.v));
+      }
+    });
+  }
+  if (old.joinable()) {
+    old.join();
+  }
+}
+
+void coarse_clock::stop() {
+  auto &t = ticker();
+  std::thread old;
+  {
+    std::lock_guard<std::mutex> lock(t.mtx);
+    if (!t.running) {
+      return;
+    }
+    t.running = false;
+    t.cv.notify_all();
+    old = std::move(t.thread);
+    // The ticker only stores while running, under mtx.
+    now_.store(0, std::memory_order_relaxed);
+  }
+  if (old.joinable()) {
+    old.join();
+  }
+}
+
+}  // namespace sled
@@ -8,6 +8,9 @@
 
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <thread>
+
 class TimeTest : public ::testing::Test {
  protected:
   TimeTest() = default;
@@ -79,3 +82,41 @@ TEST_F(TimeTest, sw) {
   auto t1 = sw.split();
   EXPECT_GT(t1, t0);
 }
+
+TEST_F(TimeTest, tsc_clock) {
+  // Calibrate first, it busy waits on first use.
+  sled::tsc_calibration::get();
+  auto mono = sled::stopwatch::now();
+  auto tsc = sled::tsc_clock::now();
+  // Calibration drift over a test run is far below a millisecond.
+  EXPECT_LT((tsc - mono).v < 0 ? (mono - tsc).v : (tsc - mono).v,
+            sled::time::from_msec(1).v);
+
+  auto t0 = sled::tsc_clock::now_ordered();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto t1 = sled::tsc_clock::now_ordered();
+  EXPECT_GE(t1 - t0, sled::time::from_msec(2));
+
+  auto const &cal = sled::tsc_calibration::get();
+  EXPECT_NEAR(1'000'000, cal.to_nsec(cal.to_ticks(1'000'000)), 2);
+}
+
+TEST_F(TimeTest, coarse_clock) {
+  sled::coarse_clock::start(sled::msec(1));
+  auto t0 = sled::coarse_clock::now();
+  EXPECT_LT(sled::stopwatch::now() - t0, sled::time::from_msec(50));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_GT(sled::coarse_clock::now(), t0);
+  sled::coarse_clock::stop();
+  EXPECT_GT(sled::coarse_clock::now(), t0);
+}
+
+TEST_F(TimeTest, coarse_clock_restart) {
+  sled::coarse_clock::start(sled::msec(1));
+  sled::coarse_clock::stop();
+  sled::coarse_clock::start(sled::msec(1));
+  sled::coarse_clock::start(sled::msec(1));
+  EXPECT_LT(sled::stopwatch::now() - sled::coarse_clock::now(),
+            sled::time::from_msec(50));
+  // Left running; the ticker joins its thread at exit.
+}
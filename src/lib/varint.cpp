@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/varint.h"
+
+namespace sled {
+
+namespace {
+
+/**
+ * Masked-VByte decode tables.
+ *
+ * The continuation bits of the next 12 input bytes pick a pattern: up to 6
+ * values of 1 or 2 bytes gathered into 16-bit lanes, up to 4 values of 1
+ * to 3 bytes gathered into 32-bit lanes, or (count 0) a long value left to
+ * the scalar decoder.  Patterns are numbered by their lane width and value
+ * lengths; index maps a 12 bit mask to the pattern covering the most
+ * values, with the bytes it consumes in the high byte so the next load
+ * only waits on one table lookup.
+ */
+constexpr int narrow_patterns = 126;  // 2 + 4 + ... + 64
+constexpr int wide_patterns = 120;    // 3 + 9 + 27 + 81
+constexpr int scalar_pattern = narrow_patterns + wide_patterns;
+constexpr int num_patterns = scalar_pattern + 1;
+
+struct vbyte_tables {
+  alignas(16) uint8_t shuffle[num_patterns][16];
+  uint8_t count[num_patterns];
+  uint8_t consumed[num_patterns];
+  uint16_t index[1 << 12];
+};
+
+constexpr int narrow_id(int n, int lengths) { return (1 << n) - 2 + lengths; }
+
+constexpr int wide_id(int n, int lengths) {
+  int base = narrow_patterns;
+  for (int i = 1, p = 3; i < n; i++, p *= 3) {
+    base += p;
+  }
+  return base + lengths;
+}
+
+constexpr vbyte_tables make_vbyte_tables() {
+  vbyte_tables t{};
+  for (auto &shuffle : t.shuffle) {
+    for (auto &s : shuffle) {
+      s = 0x80;
+    }
+  }
+  // 16-bit lanes, bit i of lengths set for a 2 byte value.
+  for (int n = 1; n <= 6; n++) {
+    for (int lengths = 0; lengths < (1 << n); lengths++) {
+      int id = narrow_id(n, lengths);
+      int pos = 0;
+      for (int i = 0; i < n; i++) {
+        t.shuffle[id][2 * i] = static_cast<uint8_t>(pos++);
+        if ((lengths >> i) & 1) {
+          t.shuffle[id][2 * i + 1] = static_cast<uint8_t>(pos++);
+        }
+      }
+      t.count[id] = static_cast<uint8_t>(n);
+      t.consumed[id] = static_cast<uint8_t>(pos);
+    }
+  }
+  // 32-bit lanes, base 3 digit i of lengths is the length of value i less
+  // one.
+  for (int n = 1, combos = 3; n <= 4; n++, combos *= 3) {
+    for (int lengths = 0; lengths < combos; lengths++) {
+      int id = wide_id(n, lengths);
+      int pos = 0;
+      for (int i = 0, l = lengths; i < n; i++, l /= 3) {
+        for (int j = 0; j <= l % 3; j++) {
+          t.shuffle[id][4 * i + j] = static_cast<uint8_t>(pos++);
+        }
+      }
+      t.count[id] = static_cast<uint8_t>(n);
+      t.consumed[id] = static_cast<uint8_t>(pos);
+    }
+  }
+  for (int mask = 0; mask < (1 << 12); mask++) {
+    int lens[6] = {};
+    int k = 0;
+    for (int pos = 0; k < 6;) {
+      int len = 1;
+      while (pos + len - 1 < 12 && ((mask >> (pos + len - 1)) & 1)) {
+        len++;
+      }
+      if (pos + len > 12) {
+        break;
+      }
+      lens[k++] = len;
+      pos += len;
+    }
+    int n16 = 0;
+    int narrow = 0;
+    while (n16 < k && lens[n16] <= 2) {
+      narrow |= (lens[n16] - 1) << n16;
+      n16++;
+    }
+    int n32 = 0;
+    int wide = 0;
+    for (int p = 1; n32 < k && n32 < 4 && lens[n32] <= 3; p *= 3) {
+      wide += (lens[n32] - 1) * p;
+      n32++;
+    }
+    int id = scalar_pattern;
+    if (n16 > 0 && n16 >= n32) {
+      id = narrow_id(n16, narrow);
+    } else if (n32 > 0) {
+      id = wide_id(n32, wide);
+    }
+    t.index[mask] = static_cast<uint16_t>(id | t.consumed[id] << 8);
+  }
+  return t;
+}
+
+constexpr vbyte_tables vbyte = make_vbyte_tables();
+
+static_assert(vbyte.count[scalar_pattern] == 0);
+static_assert(vbyte.index[0] == (narrow_id(6, 0) | 6 << 8));
+
+}  // namespace
+
+size_t varint_decode_slow(uint64_t &v, uint8_t const *src, size_t len,
+                          int max_bits) {
+  size_t max_len = static_cast<size_t>(max_bits + 6) / 7;
+  uint64_t r = 0;
+  for (size_t i = 0; i < len && i < max_len; i++) {
+    uint64_t b = src[i] & 0x7f;
+    int shift = static_cast<int>(i) * 7;
+    if (shift + 7 > max_bits && (b >> (max_bits - shift)) != 0) {
+      return 0;
+    }
+    r |= b << shift;
+    if (src[i] < 0x80) {
+      v = r;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+template <>
+varint_decode_result varint_decode_array<hwarch>(uint32_t *dst, size_t count,
+                                                 uint8_t const *src,
+                                                 size_t len) {
+  varint_decode_result r;
+  for (; r.count < count; r.count++) {
+    size_t n = varint_decode(dst[r.count], src + r.consumed, len - r.consumed);
+    if (n == 0) {
+      break;
+    }
+    r.consumed += n;
+  }
+  return r;
+}
+
+template <>
+__attribute__((target("ssse3"))) varint_decode_result
+varint_decode_array<ssse3_hwarch>(uint32_t *dst, size_t count,
+                                  uint8_t const *src, size_t len) {
+  auto const zero = _mm_setzero_si128();
+  size_t i = 0;
+  size_t pos = 0;
+  // Every step loads 16 bytes and stores up to 16 values.
+  while (count - i >= 16 && len - pos >= 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + pos));
+    auto *out = reinterpret_cast<__m128i *>(dst + i);
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    if (mask == 0) {
+      auto lo = _mm_unpacklo_epi8(v, zero);
+      auto hi = _mm_unpackhi_epi8(v, zero);
+      _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+      i += 16;
+      pos += 16;
+      continue;
+    }
+    int entry = vbyte.index[mask & 0xfff];
+    int id = entry & 0xff;
+    if (id == scalar_pattern) {
+      size_t n = varint_decode(dst[i], src + pos, len - pos);
+      if (n == 0) {
+        return {i, pos};
+      }
+      i++;
+      pos += n;
+      continue;
+    }
+    auto shuffle =
+        _mm_load_si128(reinterpret_cast<__m128i const *>(vbyte.shuffle[id]));
+    auto g = _mm_shuffle_epi8(v, shuffle);
+    if (id < narrow_patterns) {
+      auto r = _mm_or_si128(
+          _mm_and_si128(g, _mm_set1_epi16(0x7f)),
+          _mm_srli_epi16(_mm_and_si128(g, _mm_set1_epi16(0x7f00)), 1));
+      _mm_storeu_si128(out, _mm_unpacklo_epi16(r, zero));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(r, zero));
+    } else {
+      auto r = _mm_or_si128(
+          _mm_and_si128(g, _mm_set1_epi32(0x7f)),
+          _mm_srli_epi32(_mm_and_si128(g, _mm_set1_epi32(0x7f00)), 1));
+      r = _mm_or_si128(
+          r, _mm_srli_epi32(_mm_and_si128(g, _mm_set1_epi32(0x7f0000)), 2));
+      _mm_storeu_si128(out, r);
+    }
+    i += vbyte.count[id];
+    pos += static_cast<size_t>(entry >> 8);
+  }
+  auto r = varint_decode_array<hwarch>(dst + i, count - i, src + pos,
+                                       len - pos);
+  return {i + r.count, pos + r.consumed};
+}
+
+varint_decode_result varint_decode_array(uint32_t *dst, size_t count,
+                                         uint8_t const *src, size_t len) {
+  using decode_fn = varint_decode_result (*)(uint32_t *, size_t,
+                                             uint8_t const *, size_t);
+  static decode_fn const decode = ssse3_hwarch::available()
+                                      ? &varint_decode_array<ssse3_hwarch>
+                                      : &varint_decode_array<hwarch>;
+  return decode(dst, count, src, len);
+}
+
+size_t varint_encode_array(uint8_t *dst, uint32_t const *src, size_t count) {
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    n += varint_encode(dst + n, src[i]);
+  }
+  return n;
+}
+
+}  // namespace sled
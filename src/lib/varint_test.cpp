@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2020, Dan Sledz
+ * All rights reserved.
+ * Licensed under BSD-2-Clause license.
+ */
+
+#include "sled/varint.h"
+
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "sled/bytestream.h"
+
+TEST(VarintTest, zigzag) {
+  EXPECT_EQ(0, sled::zigzag_encode(int64_t{0}));
+  EXPECT_EQ(1, sled::zigzag_encode(int64_t{-1}));
+  EXPECT_EQ(2, sled::zigzag_encode(int64_t{1}));
+  EXPECT_EQ(0xffffffffffffffff,
+            sled::zigzag_encode(std::numeric_limits<int64_t>::min()));
+  EXPECT_EQ(0xfffffffe, sled::zigzag_encode(int32_t{0x7fffffff}));
+  for (int64_t v : {int64_t{0}, int64_t{-1}, int64_t{63}, int64_t{-64},
+                    std::numeric_limits<int64_t>::min(),
+                    std::numeric_limits<int64_t>::max()}) {
+    EXPECT_EQ(v, sled::zigzag_decode(sled::zigzag_encode(v)));
+    auto v32 = static_cast<int32_t>(v);
+    EXPECT_EQ(v32, sled::zigzag_decode(sled::zigzag_encode(v32)));
+  }
+}
+
+TEST(VarintTest, round_trip) {
+  uint8_t buf[sled::varint_max_size + 1];
+  for (int bit = 0; bit < 64; bit++) {
+    for (uint64_t v : {uint64_t{1} << bit, (uint64_t{1} << bit) - 1,
+                       ~uint64_t{0} >> bit}) {
+      size_t n = sled::varint_encode(buf, v);
+      EXPECT_EQ(sled::varint_size(v), n) << v;
+      uint64_t d = 0;
+      EXPECT_EQ(n, sled::varint_decode(d, buf, sizeof(buf))) << v;
+      EXPECT_EQ(v, d);
+      // Exact length input.
+      EXPECT_EQ(n, sled::varint_decode(d, buf, n)) << v;
+      // Truncated.
+      EXPECT_EQ(0, sled::varint_decode(d, buf, n - 1)) << v;
+    }
+  }
+  EXPECT_EQ(1, sled::varint_size(0));
+  EXPECT_EQ(10, sled::varint_size(~uint64_t{0}));
+}
+
+TEST(VarintTest, encoding) {
+  uint8_t buf[sled::varint_max_size];
+  EXPECT_EQ(3, sled::varint_encode(buf, 624485));
+  EXPECT_EQ(0xE5, buf[0]);
+  EXPECT_EQ(0x8E, buf[1]);
+  EXPECT_EQ(0x26, buf[2]);
+  EXPECT_EQ(2, sled::varint_encode(buf, 300));
+  EXPECT_EQ(0xAC, buf[0]);
+  EXPECT_EQ(0x02, buf[1]);
+}
+
+TEST(VarintTest, malformed) {
+  uint32_t v32 = 0;
+  uint64_t v64 = 0;
+  // 2^32 does not fit.
+  uint8_t big[] = {0x80, 0x80, 0x80, 0x80, 0x10};
+  EXPECT_EQ(0, sled::varint_decode(v32, big, sizeof(big)));
+  EXPECT_EQ(5, sled::varint_decode(v64, big, sizeof(big)));
+  EXPECT_EQ(uint64_t{1} << 32, v64);
+  uint8_t max32[] = {0xff, 0xff, 0xff, 0xff, 0x0f};
+  EXPECT_EQ(5, sled::varint_decode(v32, max32, sizeof(max32)));
+  EXPECT_EQ(0xffffffff, v32);
+  // Overlong.
+  uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+  EXPECT_EQ(0, sled::varint_decode(v32, overlong, sizeof(overlong)));
+  uint8_t over64[11] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+                        0x80, 0x80, 0x80, 0x02, 0x00};
+  EXPECT_EQ(0, sled::varint_decode(v64, over64, sizeof(over64)));
+  EXPECT_EQ(0, sled::varint_decode(v64, over64, 0));
+}
+
+template <typename Arch>
+static void check_array(std::vector<uint32_t> const &values) {
+  std::vector<uint8_t> buf(values.size() * sled::varint32_max_size);
+  buf.resize(sled::varint_encode_array(buf.data(), values.data(),
+                                       values.size()));
+  std::vector<uint32_t> out(values.size());
+  auto r = sled::varint_decode_array<Arch>(out.data(), out.size(), buf.data(),
+                                           buf.size());
+  EXPECT_EQ(values.size(), r.count);
+  EXPECT_EQ(buf.size(), r.consumed);
+  EXPECT_EQ(values, out);
+
+  // Partial counts stop on a value boundary.
+  size_t half = values.size() / 2;
+  r = sled::varint_decode_array<Arch>(out.data(), half, buf.data(),
+                                      buf.size());
+  EXPECT_EQ(half, r.count);
+  size_t expected = 0;
+  for (size_t i = 0; i < half; i++) {
+    expected += sled::varint_size(values[i]);
+  }
+  EXPECT_EQ(expected, r.consumed);
+}
+
+template <typename Arch>
+static void check_arrays() {
+  uint64_t x = 1;
+  // Values of mixed sizes, mostly small ones, every run of lengths shows
+  // up somewhere.
+  for (int bits : {7, 14, 21, 32}) {
+    std::vector<uint32_t> values;
+    for (int i = 0; i < 5000; i++) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      int shift = static_cast<int>(x >> 59) % bits;
+      values.push_back(static_cast<uint32_t>(x >> 32) >> (32 - bits + shift));
+    }
+    check_array<Arch>(values);
+  }
+  check_array<Arch>(std::vector<uint32_t>(100, 0));
+  check_array<Arch>(std::vector<uint32_t>(100, 0xffffffff));
+}
+
+TEST(VarintTest, array) { check_arrays<sled::hwarch>(); }
+
+TEST(VarintTest, array_ssse3) {
+  if (!sled::ssse3_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  check_arrays<sled::ssse3_hwarch>();
+}
+
+TEST(VarintTest, array_ssse3_malformed) {
+  if (!sled::ssse3_hwarch::available()) {
+    GTEST_SKIP();
+  }
+  std::vector<uint8_t> buf(64, 0x01);
+  buf[40] = 0x80;
+  for (int i = 41; i < 46; i++) {
+    buf[i] = 0xff;
+  }
+  std::vector<uint32_t> out(64);
+  auto r = sled::varint_decode_array<sled::ssse3_hwarch>(
+      out.data(), out.size(), buf.data(), buf.size());
+  EXPECT_EQ(40, r.count);
+  EXPECT_EQ(40, r.consumed);
+  auto s = sled::varint_decode_array<sled::hwarch>(out.data(), out.size(),
+                                                   buf.data(), buf.size());
+  EXPECT_EQ(r.count, s.count);
+  EXPECT_EQ(r.consumed, s.consumed);
+}
+
+TEST(VarintTest, cursor) {
+  std::array<std::byte, 32> buf{};
+  sled::byte_cursor w(buf);
+  EXPECT_TRUE(w.write_varint(1));
+  EXPECT_TRUE(w.write_varint(300));
+  EXPECT_TRUE(w.write_svarint(-65));
+  EXPECT_TRUE(w.write_varint(~uint64_t{0}));
+  EXPECT_TRUE(w.write_varint(uint64_t{1} << 35));
+  // 1 + 2 + 2 + 10 + 6 bytes, the last write took the slow path.
+  EXPECT_EQ(21, w.position());
+  EXPECT_TRUE(w.write_varint(0x7f));
+  EXPECT_FALSE(w.overflow());
+
+  sled::byte_cursor r(sled::byte_span(buf).first(w.position()));
+  EXPECT_EQ(1, r.read_varint());
+  EXPECT_EQ(300, r.read_varint());
+  EXPECT_EQ(-65, r.read_svarint());
+  EXPECT_EQ(~uint64_t{0}, r.read_varint());
+  EXPECT_EQ(uint64_t{1} << 35, r.read_varint());
+  EXPECT_EQ(0x7f, r.read_varint());
+  EXPECT_FALSE(r.overflow());
+  EXPECT_EQ(0, r.read_varint());
+  EXPECT_TRUE(r.overflow());
+
+  sled::byte_cursor small(sled::byte_span(buf).first(3));
+  EXPECT_FALSE(small.write_varint(uint64_t{1} << 35));
+  EXPECT_EQ(0, small.position());
+}
+
+TEST(VarintTest, cursor_batch) {
+  std::vector<uint32_t> values;
+  for (uint32_t i = 0; i < 1000; i++) {
+    values.push_back(i * i);
+  }
+  std::vector<std::byte> buf(values.size() * sled::varint32_max_size);
+  sled::byte_cursor w(buf.data(), buf.data() + buf.size());
+  for (auto v : values) {
+    w.write_varint(v);
+  }
+  sled::byte_cursor r(buf.data(), buf.data() + w.position());
+  std::vector<uint32_t> out(values.size() + 1);
+  EXPECT_EQ(values.size(), r.read_varints(out.data(), values.size()));
+  EXPECT_FALSE(r.overflow());
+  out.pop_back();
+  EXPECT_EQ(values, out);
+  EXPECT_EQ(0, r.read_varints(out.data(), 1));
+  EXPECT_TRUE(r.overflow());
+}
@@ -7,6 +7,7 @@
 #include "gtest/gtest.h"
 
 #include "sled/arch.h"
+#include "sled/time.h"
 #include "sled/x86arch.h"
 
 class X86ArchTest : public ::testing::Test {
@@ -49,3 +50,15 @@ TEST_F(X86ArchTest, arch_supported) {
   bool b = avx512_supported();
   EXPECT_EQ(a, b);
 }
+
+TEST_F(X86ArchTest, cpuid80000007) {
+  if (sled::x86::CPUID80000000().eax() < 0x80000007u) {
+    EXPECT_FALSE(sled::tsc_clock::invariant());
+    GTEST_SKIP();
+  }
+  // VMs and older CPUs commonly clear INVARIANT_TSC.
+  sled::x86::CPUID80000007 cpuid;
+  EXPECT_EQ(sled::tsc_clock::invariant(),
+            cpuid.edx().is_set(
+                sled::x86::CPUID80000007_EDX_FEATURE::V::INVARIANT_TSC));
+}